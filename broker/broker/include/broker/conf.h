@@ -7,6 +7,9 @@
 #include <list>
 #include <optional>
 #include <string>
+#include <vector>
+
+#include "log/options.h"
 
 namespace wombat::broker {
 
@@ -14,23 +17,40 @@ class PartitionConf;
 
 class Conf {
  public:
-  explicit Conf(std::list<PartitionConf> partitions);
+  explicit Conf(std::list<PartitionConf> partitions,
+                std::vector<std::filesystem::path> dirs = {});
 
   std::list<PartitionConf> partitions() const { return partitions_; }
 
+  // Log directories partitions with an empty path are placed across (see
+  // log::LogDirs), configured with a "dirs:<dir>,<dir>..." line.
+  std::vector<std::filesystem::path> dirs() const { return dirs_; }
+
+  // Parses one partition per line, plus an optional dirs line. Returns
+  // nullopt if a partition that is not ephemeral has an empty path but no
+  // dirs are configured.
   static std::optional<Conf> Parse(const std::string& s);
 
  private:
   std::list<PartitionConf> partitions_;
+
+  std::vector<std::filesystem::path> dirs_;
 };
 
 class PartitionConf {
  public:
   enum class Type { kLeader, kReplica };
 
+  static constexpr uint32_t kDefaultEphemeralSegments = 8;
+
   PartitionConf() = default;
   PartitionConf(Type type, uint32_t id, const std::filesystem::path& path,
-                const std::string& addr, uint16_t port);
+                const std::string& addr, uint16_t port,
+                const log::Options& log_options = log::Options{},
+                uint32_t reader_threads = 0,
+                const std::filesystem::path& cold_dir = {},
+                uint32_t verify_threads = 0, uint64_t ephemeral_bytes = 0,
+                uint32_t ephemeral_segments = kDefaultEphemeralSegments);
 
   Type type() const { return type_; }
 
@@ -42,6 +62,32 @@ class PartitionConf {
 
   uint16_t port() const { return port_; }
 
+  // Returns the options of the partitions log. Only the options that may be
+  // set in the config are compared.
+  log::Options log_options() const { return log_options_; }
+
+  // Returns the number of threads serving consumes concurrently with
+  // appends, or 0 if consumes are served by the partition thread.
+  uint32_t reader_threads() const { return reader_threads_; }
+
+  // Returns the directory sealed segments are moved to once older than
+  // log::Options::cold_after_ms, or an empty path if segments stay local.
+  std::filesystem::path cold_dir() const { return cold_dir_; }
+
+  // Returns the number of threads verifying the log before it is opened at
+  // startup (see log::Verifier), or 0 if the log is not verified.
+  uint32_t verify_threads() const { return verify_threads_; }
+
+  // Returns true if the partition is held only in memory (see
+  // log::EphemeralLog), configured with ephemeral_bytes=<n>. The partition
+  // holds up to ephemeral_bytes in a ring of ephemeral_segments segments,
+  // dropping the oldest segment once full, and its path is ignored.
+  bool ephemeral() const { return ephemeral_bytes_ != 0; }
+
+  uint64_t ephemeral_bytes() const { return ephemeral_bytes_; }
+
+  uint32_t ephemeral_segments() const { return ephemeral_segments_; }
+
   bool operator==(const PartitionConf& cfg) const;
   bool operator!=(const PartitionConf& cfg) const;
 
@@ -54,11 +100,26 @@ class PartitionConf {
 
   static std::optional<uint16_t> ParsePort(const std::string& s);
 
+  static std::optional<log::Engine> ParseEngine(const std::string& s);
+
+  static std::optional<uint64_t> ParseU64(const std::string& s);
+
+  static std::optional<bool> ParseBool(const std::string& s);
+
+  // Parses an optional key=value setting into cfg.
+  static bool ParseOption(const std::string& s, PartitionConf* cfg);
+
   Type type_;
   uint32_t id_;
   std::filesystem::path path_;
   std::string addr_;
   uint16_t port_;
+  log::Options log_options_;
+  uint32_t reader_threads_;
+  std::filesystem::path cold_dir_;
+  uint32_t verify_threads_;
+  uint64_t ephemeral_bytes_;
+  uint32_t ephemeral_segments_;
 };
 
 }  // namespace wombat::broker
@@ -2,41 +2,102 @@
 
 #include "broker/conf.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <exception>
 #include <filesystem>
+#include <limits>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "glog/logging.h"
+#include "log/options.h"
 
 namespace wombat::broker {
 
 std::vector<std::string> Split(const std::string& s, char delimiter);
 
-Conf::Conf(std::list<PartitionConf> partitions) : partitions_{partitions} {}
+Conf::Conf(std::list<PartitionConf> partitions,
+           std::vector<std::filesystem::path> dirs)
+    : partitions_{partitions}, dirs_{dirs} {}
 
 std::optional<Conf> Conf::Parse(const std::string& s) {
+  const std::string kDirsPrefix = "dirs:";
+
   std::list<PartitionConf> partitions{};
+  std::vector<std::filesystem::path> dirs{};
   for (const std::string& c : Split(s, '\n')) {
+    if (c.rfind(kDirsPrefix, 0) == 0) {
+      for (const std::string& dir :
+           Split(c.substr(kDirsPrefix.size()), ',')) {
+        if (dir.empty()) {
+          LOG(ERROR) << "broker config log directory empty";
+          return std::nullopt;
+        }
+        dirs.push_back(dir);
+      }
+      continue;
+    }
+
     std::optional<PartitionConf> cfg = PartitionConf::Parse(c);
     if (!cfg) {
       return std::nullopt;
     }
     partitions.push_back(*cfg);
   }
-  return Conf(partitions);
+
+  for (const PartitionConf& cfg : partitions) {
+    if (cfg.path().empty() && !cfg.ephemeral() && dirs.empty()) {
+      LOG(ERROR) << "partition config " << cfg.id()
+                 << " has no path and no log directories configured";
+      return std::nullopt;
+    }
+  }
+  return Conf(partitions, dirs);
 }
 
 PartitionConf::PartitionConf(Type type, uint32_t id,
                              const std::filesystem::path& path,
-                             const std::string& addr, uint16_t port)
-    : type_{type}, id_{id}, path_{path}, addr_{addr}, port_{port} {}
+                             const std::string& addr, uint16_t port,
+                             const log::Options& log_options,
+                             uint32_t reader_threads,
+                             const std::filesystem::path& cold_dir,
+                             uint32_t verify_threads,
+                             uint64_t ephemeral_bytes,
+                             uint32_t ephemeral_segments)
+    : type_{type},
+      id_{id},
+      path_{path},
+      addr_{addr},
+      port_{port},
+      log_options_{log_options},
+      reader_threads_{reader_threads},
+      cold_dir_{cold_dir},
+      verify_threads_{verify_threads},
+      ephemeral_bytes_{ephemeral_bytes},
+      ephemeral_segments_{ephemeral_segments} {}
 
 bool PartitionConf::operator==(const PartitionConf& cfg) const {
   return type_ == cfg.type_ && id_ == cfg.id_ && path_ == cfg.path_ &&
-         addr_ == cfg.addr_ && port_ == cfg.port_;
+         addr_ == cfg.addr_ && port_ == cfg.port_ &&
+         log_options_.engine == cfg.log_options_.engine &&
+         log_options_.retention_bytes == cfg.log_options_.retention_bytes &&
+         log_options_.retention_ms == cfg.log_options_.retention_ms &&
+         log_options_.tail_cache_bytes == cfg.log_options_.tail_cache_bytes &&
+         log_options_.compaction == cfg.log_options_.compaction &&
+         log_options_.compaction_tombstone_ms ==
+             cfg.log_options_.compaction_tombstone_ms &&
+         log_options_.compression == cfg.log_options_.compression &&
+         log_options_.cold_after_ms == cfg.log_options_.cold_after_ms &&
+         log_options_.readahead_bytes == cfg.log_options_.readahead_bytes &&
+         log_options_.direct_io == cfg.log_options_.direct_io &&
+         log_options_.preallocate == cfg.log_options_.preallocate &&
+         reader_threads_ == cfg.reader_threads_ &&
+         cold_dir_ == cfg.cold_dir_ && verify_threads_ == cfg.verify_threads_ &&
+         ephemeral_bytes_ == cfg.ephemeral_bytes_ &&
+         ephemeral_segments_ == cfg.ephemeral_segments_;
 }
 
 bool PartitionConf::operator!=(const PartitionConf& cfg) const {
@@ -45,7 +106,8 @@ bool PartitionConf::operator!=(const PartitionConf& cfg) const {
 
 std::optional<PartitionConf> PartitionConf::Parse(const std::string& s) {
   const std::vector<std::string> fields = Split(s, ':');
-  if (fields.size() != 5) {
+  // Fields after the port are optional key=value settings.
+  if (fields.size() < 5) {
     LOG(ERROR) << "partition config invalid number of fields";
     return std::nullopt;
   }
@@ -64,6 +126,29 @@ std::optional<PartitionConf> PartitionConf::Parse(const std::string& s) {
   if (!ParsePort(fields[4])) return std::nullopt;
   cfg.port_ = *ParsePort(fields[4]);
 
+  cfg.log_options_ = log::Options{};
+  cfg.reader_threads_ = 0;
+  cfg.verify_threads_ = 0;
+  cfg.ephemeral_bytes_ = 0;
+  cfg.ephemeral_segments_ = kDefaultEphemeralSegments;
+  for (size_t i = 5; i != fields.size(); ++i) {
+    if (!ParseOption(fields[i], &cfg)) return std::nullopt;
+  }
+
+  // The active segment is never dropped so the ring needs at least two
+  // segments, each of which must fit a segment offset.
+  if (cfg.ephemeral()) {
+    const uint64_t segment_size =
+        cfg.ephemeral_bytes_ / std::max(cfg.ephemeral_segments_, 1U);
+    if (cfg.ephemeral_segments_ < 2 || segment_size == 0 ||
+        segment_size > std::numeric_limits<uint32_t>::max()) {
+      LOG(ERROR) << "partition config ephemeral segments invalid: "
+                 << cfg.ephemeral_bytes_ << " bytes in "
+                 << cfg.ephemeral_segments_ << " segments";
+      return std::nullopt;
+    }
+  }
+
   return cfg;
 }
 
@@ -109,6 +194,138 @@ std::optional<uint16_t> PartitionConf::ParsePort(const std::string& s) {
   }
 }
 
+std::optional<log::Engine> PartitionConf::ParseEngine(const std::string& s) {
+  if (s == "system") {
+    return log::Engine::kSystem;
+  } else if (s == "uring") {
+    return log::Engine::kUring;
+  }
+  LOG(ERROR) << "partition log engine not recognized: " << s;
+  return std::nullopt;
+}
+
+std::optional<uint64_t> PartitionConf::ParseU64(const std::string& s) {
+  try {
+    uint64_t n = std::stoull(s);
+    if (std::to_string(n) == s) {
+      return n;
+    } else {
+      LOG(ERROR) << "partition config value would over/under-flow: " << s;
+      return std::nullopt;
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "partition config value not a number: " << s;
+    return std::nullopt;
+  }
+}
+
+std::optional<bool> PartitionConf::ParseBool(const std::string& s) {
+  if (s == "true") {
+    return true;
+  } else if (s == "false") {
+    return false;
+  }
+  LOG(ERROR) << "partition config value not a boolean: " << s;
+  return std::nullopt;
+}
+
+bool PartitionConf::ParseOption(const std::string& s, PartitionConf* cfg) {
+  const size_t sep = s.find('=');
+  if (sep == std::string::npos) {
+    LOG(ERROR) << "partition config option invalid: " << s;
+    return false;
+  }
+  const std::string key = s.substr(0, sep);
+  const std::string value = s.substr(sep + 1);
+
+  if (key == "engine") {
+    const std::optional<log::Engine> engine = ParseEngine(value);
+    if (!engine) return false;
+    cfg->log_options_.engine = *engine;
+  } else if (key == "retention_bytes") {
+    const std::optional<uint64_t> bytes = ParseU64(value);
+    if (!bytes) return false;
+    cfg->log_options_.retention_bytes = *bytes;
+  } else if (key == "retention_ms") {
+    const std::optional<uint64_t> ms = ParseU64(value);
+    if (!ms) return false;
+    cfg->log_options_.retention_ms = *ms;
+  } else if (key == "tail_cache_bytes") {
+    const std::optional<uint64_t> bytes = ParseU64(value);
+    if (!bytes || *bytes > std::numeric_limits<uint32_t>::max()) {
+      LOG(ERROR) << "partition config tail_cache_bytes too large: " << value;
+      return false;
+    }
+    cfg->log_options_.tail_cache_bytes = *bytes;
+  } else if (key == "compaction") {
+    const std::optional<bool> compaction = ParseBool(value);
+    if (!compaction) return false;
+    cfg->log_options_.compaction = *compaction;
+  } else if (key == "compaction_tombstone_ms") {
+    const std::optional<uint64_t> ms = ParseU64(value);
+    if (!ms) return false;
+    cfg->log_options_.compaction_tombstone_ms = *ms;
+  } else if (key == "compression") {
+    const std::optional<bool> compression = ParseBool(value);
+    if (!compression) return false;
+    cfg->log_options_.compression = *compression;
+  } else if (key == "direct_io") {
+    const std::optional<bool> direct_io = ParseBool(value);
+    if (!direct_io) return false;
+    cfg->log_options_.direct_io = *direct_io;
+  } else if (key == "preallocate") {
+    const std::optional<bool> preallocate = ParseBool(value);
+    if (!preallocate) return false;
+    cfg->log_options_.preallocate = *preallocate;
+  } else if (key == "cold_dir") {
+    if (value.empty()) {
+      LOG(ERROR) << "partition config cold_dir empty";
+      return false;
+    }
+    cfg->cold_dir_ = value;
+  } else if (key == "cold_after_ms") {
+    const std::optional<uint64_t> ms = ParseU64(value);
+    if (!ms) return false;
+    cfg->log_options_.cold_after_ms = *ms;
+  } else if (key == "readahead_bytes") {
+    const std::optional<uint64_t> bytes = ParseU64(value);
+    if (!bytes || *bytes > std::numeric_limits<uint32_t>::max()) {
+      LOG(ERROR) << "partition config readahead_bytes too large: " << value;
+      return false;
+    }
+    cfg->log_options_.readahead_bytes = *bytes;
+  } else if (key == "reader_threads") {
+    const std::optional<uint64_t> threads = ParseU64(value);
+    if (!threads || *threads > std::numeric_limits<uint16_t>::max()) {
+      LOG(ERROR) << "partition config reader_threads too large: " << value;
+      return false;
+    }
+    cfg->reader_threads_ = *threads;
+  } else if (key == "verify_threads") {
+    const std::optional<uint64_t> threads = ParseU64(value);
+    if (!threads || *threads > std::numeric_limits<uint16_t>::max()) {
+      LOG(ERROR) << "partition config verify_threads too large: " << value;
+      return false;
+    }
+    cfg->verify_threads_ = *threads;
+  } else if (key == "ephemeral_bytes") {
+    const std::optional<uint64_t> bytes = ParseU64(value);
+    if (!bytes) return false;
+    cfg->ephemeral_bytes_ = *bytes;
+  } else if (key == "ephemeral_segments") {
+    const std::optional<uint64_t> segments = ParseU64(value);
+    if (!segments || *segments > std::numeric_limits<uint16_t>::max()) {
+      LOG(ERROR) << "partition config ephemeral_segments too large: " << value;
+      return false;
+    }
+    cfg->ephemeral_segments_ = *segments;
+  } else {
+    LOG(ERROR) << "partition config option not recognized: " << key;
+    return false;
+  }
+  return true;
+}
+
 std::vector<std::string> Split(const std::string& s, char delimiter) {
   std::vector<std::string> tokens;
   std::string token;
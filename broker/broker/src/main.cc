@@ -2,17 +2,26 @@
 
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <optional>
 #include <streambuf>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "broker/conf.h"
 #include "broker/router.h"
 #include "connection/event.h"
 #include "glog/logging.h"
+#include "log/directorycoldstore.h"
+#include "log/ephemerallog.h"
 #include "log/log.h"
+#include "log/logdirs.h"
+#include "log/options.h"
 #include "log/systemlog.h"
+#include "log/verifier.h"
 #include "partition/leader.h"
+#include "partition/migrator.h"
 #include "partition/partition.h"
 #include "server/listener.h"
 #include "server/responder.h"
@@ -32,6 +41,58 @@ std::optional<Conf> ParseConf(const std::filesystem::path& path) {
   return Conf::Parse(s);
 }
 
+// Verifies the log at path before it is opened, rebuilding its indexes.
+void Verify(const std::filesystem::path& path, const log::Options& options,
+            uint32_t threads) {
+  if (!std::filesystem::exists(path)) {
+    return;
+  }
+  LOG(INFO) << "verifying log " << path;
+  const std::vector<log::Verifier::Result> results =
+      log::Verifier{path, options, threads}.Verify();
+  for (const log::Verifier::Result& result : results) {
+    if (result.rebuilt) {
+      LOG(WARNING) << "rebuilt the indexes of segment " << result.id << " in "
+                   << path;
+    }
+  }
+  // Corrupt records are still detected when read so the log is opened.
+  if (!log::Verifier::Ok(results)) {
+    LOG(ERROR) << "log " << path << " has errors, see wombat-log-tool";
+  }
+}
+
+// Opens the log of the partition, placing it in the log directories if it
+// has no path.
+std::shared_ptr<log::Log> OpenLog(
+    const PartitionConf& p, std::shared_ptr<log::LogDirs> dirs,
+    std::unique_ptr<partition::Migrator>* migrator) {
+  log::Options options = p.log_options();
+  if (!p.cold_dir().empty()) {
+    options.cold_store =
+        std::make_shared<log::DirectoryColdStore>(p.cold_dir());
+  }
+  partition::Migrator::LogFactory open =
+      [options](const std::filesystem::path& path) {
+        return std::make_shared<log::SystemLog>(path, options);
+      };
+
+  // Partitions without a path are placed in the log directories, and can
+  // be moved between them.
+  const std::string name = "partition-" + std::to_string(p.id());
+  const std::filesystem::path log_path =
+      p.path().empty() ? dirs->Path(dirs->Place(name), name) : p.path();
+  if (p.verify_threads() != 0) {
+    Verify(log_path, options, p.verify_threads());
+  }
+  std::shared_ptr<log::Log> log = open(log_path);
+  if (p.path().empty()) {
+    dirs->Track(name, log);
+    *migrator = std::make_unique<partition::Migrator>(dirs, name, open);
+  }
+  return log;
+}
+
 void Run(const std::filesystem::path& path) {
   LOG(INFO) << "running wombat broker";
 
@@ -44,18 +105,33 @@ void Run(const std::filesystem::path& path) {
   std::shared_ptr<server::Responder> responder =
       std::make_shared<server::Responder>();
 
+  std::shared_ptr<log::LogDirs> dirs;
+  if (!cfg->dirs().empty()) {
+    dirs = std::make_shared<log::LogDirs>(cfg->dirs());
+  }
+
   Router router{};
   for (const PartitionConf& p : cfg->partitions()) {
     LOG(INFO) << "adding partition " << p.id();
 
-    std::shared_ptr<log::Log> log = std::make_shared<log::SystemLog>(p.path());
+    std::shared_ptr<log::Log> log;
+    std::unique_ptr<partition::Migrator> migrator;
+    if (p.ephemeral()) {
+      // Ephemeral partitions are held only in memory so have no files to
+      // place, verify or migrate.
+      log = std::make_shared<log::EphemeralLog>(
+          p.ephemeral_bytes() / p.ephemeral_segments(),
+          p.ephemeral_segments());
+    } else {
+      log = OpenLog(p, dirs, &migrator);
+    }
 
     switch (p.type()) {
       case PartitionConf::Type::kLeader:
         // TODO(AD) No packages should know about server package except this -
         // just pass the queue
-        router.AddPartition(
-            std::make_unique<partition::Leader>(p.id(), responder, log));
+        router.AddPartition(std::make_unique<partition::Leader>(
+            p.id(), responder, log, p.reader_threads(), std::move(migrator)));
         break;
       case PartitionConf::Type::kReplica:
         // TODO(AD) Replica not yet supported.
@@ -1,11 +1,14 @@
 // Copyright 2020 Andrew Dunstall
 
+#include <filesystem>
 #include <list>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "broker/conf.h"
 #include "gtest/gtest.h"
+#include "log/options.h"
 
 namespace wombat::broker {
 
@@ -25,6 +28,44 @@ replica:9258:/usr/local/wombat/log:10.26.104.122:9224)";
   EXPECT_EQ(expected, cfg->partitions());
 }
 
+TEST_F(ConfTest, ParseDirsOk) {
+  std::list<PartitionConf> expected{};
+  expected.emplace_back(PartitionConf::Type::kLeader, 9248, "",
+                        "192.168.1.5", 3101);
+  expected.emplace_back(PartitionConf::Type::kLeader, 9258,
+                        "/usr/local/wombat/log", "192.168.1.5", 3102);
+  const std::vector<std::filesystem::path> dirs{"/mnt/a/wombat",
+                                                "/mnt/b/wombat"};
+
+  const std::string s = R"(dirs:/mnt/a/wombat,/mnt/b/wombat
+leader:9248::192.168.1.5:3101
+leader:9258:/usr/local/wombat/log:192.168.1.5:3102)";
+  std::optional<Conf> cfg = Conf::Parse(s);
+  ASSERT_TRUE(cfg);
+  EXPECT_EQ(expected, cfg->partitions());
+  EXPECT_EQ(dirs, cfg->dirs());
+}
+
+TEST_F(ConfTest, ParseDirsInvalid) {
+  // Partitions without a path require log directories.
+  EXPECT_FALSE(Conf::Parse("leader:9248::192.168.1.5:3101"));
+  EXPECT_FALSE(Conf::Parse("dirs:,/mnt/a/wombat\nleader:9248::1.2.3.4:3101"));
+}
+
+TEST_F(ConfTest, ParseEphemeralOk) {
+  // Ephemeral partitions do not need a path or log directories.
+  std::list<PartitionConf> expected{};
+  expected.emplace_back(PartitionConf::Type::kLeader, 9248, "",
+                        "192.168.1.5", 3101, log::Options{}, 0,
+                        std::filesystem::path{}, 0, 64'000'000);
+
+  std::optional<Conf> cfg =
+      Conf::Parse("leader:9248::192.168.1.5:3101:ephemeral_bytes=64000000");
+  ASSERT_TRUE(cfg);
+  EXPECT_EQ(expected, cfg->partitions());
+  EXPECT_TRUE(cfg->partitions().front().ephemeral());
+}
+
 TEST_F(ConfTest, ParseInvalid) {
   const std::string s = "badconf";
   std::optional<Conf> cfg = Conf::Parse(s);
@@ -55,6 +96,86 @@ TEST_F(PartitionConfTest, ParseReplicaConfigOk) {
   EXPECT_EQ(expected, *cfg);
 }
 
+TEST_F(PartitionConfTest, ParseOptionsConfigOk) {
+  log::Options options{};
+  options.engine = log::Engine::kUring;
+  options.retention_bytes = 1'000'000'000;
+  options.retention_ms = 604'800'000;
+  options.tail_cache_bytes = 4'000'000;
+  options.compaction = true;
+  options.compaction_tombstone_ms = 3'600'000;
+  options.compression = true;
+  options.cold_after_ms = 604'800'000;
+  options.readahead_bytes = 1'048'576;
+  options.direct_io = true;
+  options.preallocate = true;
+  PartitionConf expected(PartitionConf::Type::kLeader, 8103,
+                         "/usr/local/wombat/log", "192.168.1.5", 3101,
+                         options, 4, "/mnt/cold/log", 8);
+
+  const std::string s =
+      "leader:8103:/usr/local/wombat/log:192.168.1.5:3101:engine=uring:"
+      "retention_bytes=1000000000:retention_ms=604800000:"
+      "tail_cache_bytes=4000000:reader_threads=4:compaction=true:"
+      "compaction_tombstone_ms=3600000:compression=true:"
+      "cold_dir=/mnt/cold/log:cold_after_ms=604800000:"
+      "readahead_bytes=1048576:verify_threads=8:direct_io=true:"
+      "preallocate=true";
+  std::optional<PartitionConf> cfg = PartitionConf::Parse(s);
+
+  ASSERT_TRUE(cfg);
+  EXPECT_EQ(expected, *cfg);
+}
+
+TEST_F(PartitionConfTest, ParseOptionsConfigInvalid) {
+  const std::string prefix =
+      "leader:8103:/usr/local/wombat/log:192.168.1.5:3101";
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":uring"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":engine=x"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":retention_ms=x"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":unknown=1"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":tail_cache_bytes=4294967296"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":reader_threads=65536"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":compaction=1"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":compression=yes"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":cold_dir="));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":cold_after_ms=-1"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":readahead_bytes=4294967296"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":verify_threads=65536"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":direct_io=on"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":preallocate=1"));
+}
+
+TEST_F(PartitionConfTest, ParseEphemeralConfigOk) {
+  PartitionConf expected(PartitionConf::Type::kLeader, 8103,
+                         "/usr/local/wombat/log", "192.168.1.5", 3101,
+                         log::Options{}, 0, {}, 0, 1'000'000, 4);
+
+  const std::string s =
+      "leader:8103:/usr/local/wombat/log:192.168.1.5:3101:"
+      "ephemeral_bytes=1000000:ephemeral_segments=4";
+  std::optional<PartitionConf> cfg = PartitionConf::Parse(s);
+
+  ASSERT_TRUE(cfg);
+  EXPECT_EQ(expected, *cfg);
+  EXPECT_TRUE(cfg->ephemeral());
+}
+
+TEST_F(PartitionConfTest, ParseEphemeralConfigInvalid) {
+  const std::string prefix =
+      "leader:8103:/usr/local/wombat/log:192.168.1.5:3101";
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":ephemeral_bytes=x"));
+  EXPECT_FALSE(PartitionConf::Parse(prefix + ":ephemeral_segments=65536"));
+  // The ring needs at least two segments of at least one byte, each
+  // smaller than 4GB.
+  EXPECT_FALSE(PartitionConf::Parse(
+      prefix + ":ephemeral_bytes=1000:ephemeral_segments=1"));
+  EXPECT_FALSE(PartitionConf::Parse(
+      prefix + ":ephemeral_bytes=1:ephemeral_segments=2"));
+  EXPECT_FALSE(PartitionConf::Parse(
+      prefix + ":ephemeral_bytes=10000000000:ephemeral_segments=2"));
+}
+
 TEST_F(PartitionConfTest, ParseConfigTypeInvalid) {
   const std::string s = "nan:0:/wombat/log/replica:10.26.104.122:9224";
   std::optional<PartitionConf> cfg = PartitionConf::Parse(s);
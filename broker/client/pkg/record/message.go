@@ -12,13 +12,33 @@ const (
 	ReplicaResponse
 	TypeStatRequest
 	TypeStatResponse
+	TypeSeekRequest
+	TypeSeekResponse
+	TypeErrorResponse
+	TypeSeekTimeRequest
+	TypeSeekTimeResponse
+	TypeProduceBatchRequest
+	TypeConsumeBatchRequest
+	TypeConsumeBatchResponse
 )
 
 const (
 	MessageHeaderSize = 12
 	PayloadLimit      = 512
+	BatchPayloadLimit = 1 << 20
 )
 
+// payloadLimit returns the maximum payload size of a message of the given
+// kind. Messages carrying record batches may be larger than other messages.
+func payloadLimit(kind uint32) uint32 {
+	switch kind & 0xffff {
+	case TypeProduceBatchRequest, TypeConsumeBatchResponse:
+		return BatchPayloadLimit
+	default:
+		return PayloadLimit
+	}
+}
+
 type MessageHeader struct {
 	kind        uint32
 	partitionID uint32
@@ -26,7 +46,7 @@ type MessageHeader struct {
 }
 
 func NewMessageHeader(kind uint32, partitionID uint32, payloadSize uint32) (MessageHeader, bool) {
-	if payloadSize > PayloadLimit {
+	if payloadSize > payloadLimit(kind) {
 		return MessageHeader{}, false
 	}
 	return MessageHeader{
@@ -8,6 +8,7 @@
 #include "connection/connectionexception.h"
 #include "connection/socket.h"
 #include "frame/message.h"
+#include "frame/messageheader.h"
 
 namespace wombat::broker::connection {
 
@@ -79,6 +80,10 @@ void Connection::SetHeaderPendingState() {
 void Connection::SetPayloadPendingState(uint32_t payload_size) {
   state_ = State::kPayloadPending;
   remaining_ = payload_size;
+  // Record batches may not fit the initial buffer.
+  if (buf_.size() < frame::MessageHeader::kSize + payload_size) {
+    buf_.resize(frame::MessageHeader::kSize + payload_size);
+  }
 }
 
 }  // namespace wombat::broker::connection
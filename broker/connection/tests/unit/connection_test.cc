@@ -1,5 +1,6 @@
 // Copyright 2020 Andrew Dunstall
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -82,6 +83,32 @@ TEST_F(ConnectionTest, ReceiveMessageWithPayload) {
   EXPECT_EQ(m, conn.Receive());
 }
 
+TEST_F(ConnectionTest, ReceiveRecordBatch) {
+  // Record batches may be larger than the initial buffer.
+  const std::vector<uint8_t> payload(4096, 0xab);
+  const frame::MessageHeader h{frame::Type::kProduceBatchRequest, 0,
+                               static_cast<uint32_t>(payload.size())};
+  const frame::Message m{h, payload};
+
+  std::unique_ptr<MockSocket> sock = std::make_unique<MockSocket>();
+  EXPECT_CALL(*sock, Read(::testing::_, 0, frame::MessageHeader::kSize))
+      .WillOnce(ResponseWriter(h.Encode()));
+  // Write the payload in place as a socket does, so fails if the buffer is
+  // too small.
+  EXPECT_CALL(*sock,
+              Read(::testing::_, frame::MessageHeader::kSize, payload.size()))
+      .WillOnce([&payload](std::vector<uint8_t>* buf, size_t from,
+                           size_t n) -> size_t {
+        if (buf->size() < from + n) return 0;
+        std::copy(payload.begin(), payload.end(), buf->begin() + from);
+        return n;
+      });
+
+  Connection conn{std::move(sock)};
+  EXPECT_EQ(std::nullopt, conn.Receive());
+  EXPECT_EQ(m, conn.Receive());
+}
+
 TEST_F(ConnectionTest, ReceiveMessageOneByteAtATime) {
   const frame::MessageHeader h{frame::Type::kDummy, 0, 5};
   const frame::Message m{frame::Type::kDummy, 0, {1, 2, 3, 4, 5}};
@@ -0,0 +1,49 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "frame/frame.h"
+
+namespace wombat::broker::frame {
+
+// Error is the payload of an error response, returned instead of the usual
+// response when a request cannot be served.
+class Error : public Frame {
+ public:
+  enum class Code : uint32_t {
+    // The requested offset is not the start of a record.
+    kMisalignedOffset,
+    // The requested offset or record is not in the log, either past the end
+    // of the log or before the log start.
+    kOffsetOutOfRange,
+    // The record does not match its checksum so is corrupt.
+    kCorruptRecord,
+    // The log could not be moved to the requested log directory.
+    kMigrateFailed,
+    // The log failed to read the requested records.
+    kReadFailed
+  };
+
+  explicit Error(Code code);
+
+  ~Error() override {}
+
+  bool operator==(const Error& error) const;
+
+  bool operator!=(const Error& error) const;
+
+  Code code() const { return code_; }
+
+  std::vector<uint8_t> Encode() const override;
+
+  static std::optional<Error> Decode(const std::vector<uint8_t>& enc);
+
+ private:
+  Code code_;
+};
+
+}  // namespace wombat::broker::frame
@@ -15,10 +15,12 @@ namespace wombat::broker::frame {
 // payload.
 class Message : public Frame {
  public:
-  Message(Type type, uint32_t partition_id,
-          const std::vector<uint8_t>& payload);
+  // The payload is taken by value so callers building it can move it in
+  // rather than copying it.
+  Message(Type type, uint32_t partition_id, std::vector<uint8_t> payload,
+          Version version = Version::kV1);
 
-  Message(MessageHeader header, const std::vector<uint8_t>& payload);
+  Message(MessageHeader header, std::vector<uint8_t> payload);
 
   ~Message() override {}
 
@@ -28,6 +30,8 @@ class Message : public Frame {
 
   Type type() const { return header_.type(); }
 
+  Version version() const { return header_.version(); }
+
   uint32_t partition_id() const { return header_.partition_id(); }
 
   std::vector<uint8_t> payload() const { return payload_; }
@@ -19,14 +19,38 @@ enum class Type : uint32_t {
   kReplicaResponse,
   kStatRequest,
   kStatResponse,
+  kSeekRequest,
+  kSeekResponse,
+  kErrorResponse,
+  kSeekTimeRequest,
+  kSeekTimeResponse,
+  kProduceBatchRequest,
+  kConsumeBatchRequest,
+  kConsumeBatchResponse,
+  // Moves the partitions log to the log directory with the index in the
+  // payload, or the least loaded other directory if the index is
+  // kAnyDirectory, responding with the index of the directory moved to.
+  kMigrateRequest,
+  kMigrateResponse,
   kDummy
 };
 
+// Version is the protocol version of a message. It is encoded in the upper 16
+// bits of the type, so messages from clients that predate versions are kV1.
+// Responses use the version of the request.
+enum class Version : uint16_t {
+  // Offsets are 32 bit.
+  kV1,
+  // Offsets are 64 bit.
+  kV2
+};
+
 class MessageHeader : public Frame {
  public:
   static constexpr int kSize = 12;
 
-  MessageHeader(Type type, uint32_t partition_id, uint32_t payload_size);
+  MessageHeader(Type type, uint32_t partition_id, uint32_t payload_size,
+                Version version = Version::kV1);
 
   ~MessageHeader() override {}
 
@@ -36,10 +60,16 @@ class MessageHeader : public Frame {
 
   Type type() const { return type_; }
 
+  Version version() const { return version_; }
+
   uint32_t partition_id() const { return partition_id_; }
 
   uint32_t payload_size() const { return payload_size_; }
 
+  // Returns the maximum payload size of a message of the given type.
+  // Messages carrying record batches may be larger than other messages.
+  static uint32_t PayloadLimit(Type type);
+
   std::vector<uint8_t> Encode() const override;
 
   static std::optional<MessageHeader> Decode(const std::vector<uint8_t>& enc);
@@ -48,8 +78,13 @@ class MessageHeader : public Frame {
   // Maximum record data size.
   static constexpr uint32_t kLimit = 512;
 
+  // Maximum record batch size.
+  static constexpr uint32_t kBatchLimit = 1 << 20;
+
   Type type_;
 
+  Version version_;
+
   uint32_t partition_id_;
 
   uint32_t payload_size_;
@@ -7,12 +7,17 @@
 #include <vector>
 
 #include "frame/frame.h"
+#include "frame/messageheader.h"
 
 namespace wombat::broker::frame {
 
+// Offset is a log offset, encoded as 32 bits with Version::kV1 and 64 bits
+// with Version::kV2.
 class Offset : public Frame {
  public:
-  explicit Offset(uint32_t offset);
+  // Throws std::invalid_argument if the offset cannot be encoded with the
+  // version.
+  explicit Offset(uint64_t offset, Version version = Version::kV1);
 
   ~Offset() override {}
 
@@ -20,14 +25,22 @@ class Offset : public Frame {
 
   bool operator!=(const Offset& record) const;
 
-  uint32_t offset() const { return offset_; }
+  uint64_t offset() const { return offset_; }
+
+  Version version() const { return version_; }
 
   std::vector<uint8_t> Encode() const override;
 
-  static std::optional<Offset> Decode(const std::vector<uint8_t>& data);
+  // Returns the maximum offset that can be encoded with the version.
+  static uint64_t Max(Version version);
+
+  static std::optional<Offset> Decode(const std::vector<uint8_t>& data,
+                                      Version version = Version::kV1);
 
  private:
-  uint32_t offset_;
+  uint64_t offset_;
+
+  Version version_;
 };
 
 }  // namespace wombat::broker::frame
@@ -26,6 +26,12 @@ class Record : public Frame {
 
   static std::optional<Record> Decode(const std::vector<uint8_t>& data);
 
+  static std::optional<Record> Decode(const uint8_t* enc, size_t size);
+
+  // Returns the size of the encoded record at the start of enc without
+  // decoding it, or nullopt if enc does not start with a valid record.
+  static std::optional<uint32_t> EncodedSize(const uint8_t* enc, size_t size);
+
  private:
   // Maximum record data size.
   static constexpr uint32_t kLimit = 512;
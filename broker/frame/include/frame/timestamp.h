@@ -0,0 +1,35 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "frame/frame.h"
+
+namespace wombat::broker::frame {
+
+// Timestamp is a time in milliseconds since the Unix epoch, encoded as 64 bits
+// with every version.
+class Timestamp : public Frame {
+ public:
+  explicit Timestamp(uint64_t timestamp);
+
+  ~Timestamp() override {}
+
+  bool operator==(const Timestamp& timestamp) const;
+
+  bool operator!=(const Timestamp& timestamp) const;
+
+  uint64_t timestamp() const { return timestamp_; }
+
+  std::vector<uint8_t> Encode() const override;
+
+  static std::optional<Timestamp> Decode(const std::vector<uint8_t>& data);
+
+ private:
+  uint64_t timestamp_;
+};
+
+}  // namespace wombat::broker::frame
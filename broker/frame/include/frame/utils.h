@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <vector>
@@ -12,4 +13,10 @@ std::vector<uint8_t> EncodeU32(uint32_t n);
 
 std::optional<uint32_t> DecodeU32(const std::vector<uint8_t>& enc);
 
+std::optional<uint32_t> DecodeU32(const uint8_t* enc, size_t size);
+
+std::vector<uint8_t> EncodeU64(uint64_t n);
+
+std::optional<uint64_t> DecodeU64(const std::vector<uint8_t>& enc);
+
 }  // namespace wombat::broker::frame
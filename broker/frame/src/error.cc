@@ -0,0 +1,33 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "frame/error.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "frame/utils.h"
+
+namespace wombat::broker::frame {
+
+Error::Error(Code code) : code_{code} {}
+
+bool Error::operator==(const Error& error) const {
+  return code_ == error.code_;
+}
+
+bool Error::operator!=(const Error& error) const { return !(*this == error); }
+
+std::vector<uint8_t> Error::Encode() const {
+  return EncodeU32(static_cast<uint32_t>(code_));
+}
+
+std::optional<Error> Error::Decode(const std::vector<uint8_t>& enc) {
+  std::optional<uint32_t> code = DecodeU32(enc);
+  if (!code) {
+    return std::nullopt;
+  }
+  return std::optional<Error>{static_cast<Code>(*code)};
+}
+
+}  // namespace wombat::broker::frame
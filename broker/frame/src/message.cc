@@ -4,18 +4,22 @@
 
 #include <cstdint>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include "frame/utils.h"
 
 namespace wombat::broker::frame {
 
+// The header is initialized before the payload is moved.
 Message::Message(Type type, uint32_t partition_id,
-                 const std::vector<uint8_t>& payload)
-    : Message{MessageHeader(type, partition_id, payload.size()), payload} {}
+                 std::vector<uint8_t> payload, Version version)
+    : header_{type, partition_id, static_cast<uint32_t>(payload.size()),
+              version},
+      payload_{std::move(payload)} {}
 
-Message::Message(MessageHeader header, const std::vector<uint8_t>& payload)
-    : header_{header}, payload_{payload} {}
+Message::Message(MessageHeader header, std::vector<uint8_t> payload)
+    : header_{header}, payload_{std::move(payload)} {}
 
 bool Message::operator==(const Message& message) const {
   return header_ == message.header_ && payload_ == message.payload_;
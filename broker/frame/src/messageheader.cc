@@ -11,15 +11,19 @@
 namespace wombat::broker::frame {
 
 MessageHeader::MessageHeader(Type type, uint32_t partition_id,
-                             uint32_t payload_size)
-    : type_{type}, partition_id_{partition_id}, payload_size_{payload_size} {
-  if (payload_size_ > kLimit) {
+                             uint32_t payload_size, Version version)
+    : type_{type},
+      version_{version},
+      partition_id_{partition_id},
+      payload_size_{payload_size} {
+  if (payload_size_ > PayloadLimit(type_)) {
     throw std::invalid_argument{"invalid payload size"};
   }
 }
 
 bool MessageHeader::operator==(const MessageHeader& header) const {
-  return type_ == header.type_ && partition_id_ == header.partition_id_ &&
+  return type_ == header.type_ && version_ == header.version_ &&
+         partition_id_ == header.partition_id_ &&
          payload_size_ == header.payload_size_;
 }
 
@@ -28,7 +32,9 @@ bool MessageHeader::operator!=(const MessageHeader& header) const {
 }
 
 std::vector<uint8_t> MessageHeader::Encode() const {
-  std::vector<uint8_t> enc = EncodeU32(static_cast<uint32_t>(type_));
+  std::vector<uint8_t> enc =
+      EncodeU32(static_cast<uint32_t>(version_) << 16 |
+                static_cast<uint32_t>(type_));
   std::vector<uint8_t> id = EncodeU32(partition_id_);
   enc.insert(enc.end(), id.begin(), id.end());
   std::vector<uint8_t> size = EncodeU32(payload_size_);
@@ -39,7 +45,7 @@ std::vector<uint8_t> MessageHeader::Encode() const {
 std::optional<MessageHeader> MessageHeader::Decode(
     const std::vector<uint8_t>& enc) {
   std::optional<uint32_t> type = DecodeU32(enc);
-  if (!type) {
+  if (!type || (*type >> 16) > static_cast<uint32_t>(Version::kV2)) {
     return std::nullopt;
   }
 
@@ -51,11 +57,23 @@ std::optional<MessageHeader> MessageHeader::Decode(
 
   std::optional<uint32_t> payload_size = DecodeU32(std::vector<uint8_t>(
       enc.begin() + sizeof(uint32_t) + sizeof(uint32_t), enc.end()));
-  if (!payload_size || payload_size > kLimit) {
+  if (!payload_size ||
+      *payload_size > PayloadLimit(static_cast<Type>(*type & 0xffff))) {
     return std::nullopt;
   }
 
-  return MessageHeader{static_cast<Type>(*type), *id, *payload_size};
+  return MessageHeader{static_cast<Type>(*type & 0xffff), *id, *payload_size,
+                       static_cast<Version>(*type >> 16)};
+}
+
+uint32_t MessageHeader::PayloadLimit(Type type) {
+  switch (type) {
+    case Type::kProduceBatchRequest:
+    case Type::kConsumeBatchResponse:
+      return kBatchLimit;
+    default:
+      return kLimit;
+  }
 }
 
 }  // namespace wombat::broker::frame
@@ -3,31 +3,60 @@
 #include "frame/offset.h"
 
 #include <cstdint>
+#include <limits>
 #include <optional>
+#include <stdexcept>
 #include <vector>
 
+#include "frame/messageheader.h"
 #include "frame/utils.h"
 
 namespace wombat::broker::frame {
 
-Offset::Offset(uint32_t offset) : offset_{offset} {}
+Offset::Offset(uint64_t offset, Version version)
+    : offset_{offset}, version_{version} {
+  if (offset_ > Max(version_)) {
+    throw std::invalid_argument{"offset exceeds version limit"};
+  }
+}
 
 bool Offset::operator==(const Offset& record) const {
-  return offset_ == record.offset_;
+  return offset_ == record.offset_ && version_ == record.version_;
 }
 
 bool Offset::operator!=(const Offset& record) const {
   return !(*this == record);
 }
 
-std::vector<uint8_t> Offset::Encode() const { return EncodeU32(offset_); }
+std::vector<uint8_t> Offset::Encode() const {
+  if (version_ == Version::kV1) {
+    return EncodeU32(offset_);
+  }
+  return EncodeU64(offset_);
+}
+
+uint64_t Offset::Max(Version version) {
+  if (version == Version::kV1) {
+    return std::numeric_limits<uint32_t>::max();
+  }
+  return std::numeric_limits<uint64_t>::max();
+}
+
+std::optional<Offset> Offset::Decode(const std::vector<uint8_t>& enc,
+                                     Version version) {
+  if (version == Version::kV1) {
+    std::optional<uint32_t> offset = DecodeU32(enc);
+    if (!offset) {
+      return std::nullopt;
+    }
+    return std::optional<Offset>{Offset{*offset, version}};
+  }
 
-std::optional<Offset> Offset::Decode(const std::vector<uint8_t>& enc) {
-  std::optional<uint32_t> offset = DecodeU32(enc);
+  std::optional<uint64_t> offset = DecodeU64(enc);
   if (!offset) {
     return std::nullopt;
   }
-  return std::optional<Offset>{*offset};
+  return std::optional<Offset>{Offset{*offset, version}};
 }
 
 }  // namespace wombat::broker::frame
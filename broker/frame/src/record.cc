@@ -30,17 +30,29 @@ std::vector<uint8_t> Record::Encode() const {
 }
 
 std::optional<Record> Record::Decode(const std::vector<uint8_t>& enc) {
-  std::optional<uint32_t> size = DecodeU32(enc);
+  return Decode(enc.data(), enc.size());
+}
+
+std::optional<Record> Record::Decode(const uint8_t* enc, size_t enc_size) {
+  const std::optional<uint32_t> size = EncodedSize(enc, enc_size);
+  if (!size) {
+    return std::nullopt;
+  }
+
+  std::vector<uint8_t> data(enc + sizeof(uint32_t), enc + *size);
+  return std::optional<Record>{data};
+}
+
+std::optional<uint32_t> Record::EncodedSize(const uint8_t* enc,
+                                            size_t enc_size) {
+  std::optional<uint32_t> size = DecodeU32(enc, enc_size);
   if (!size || *size > kLimit) {
     return std::nullopt;
   }
-  if (*size > enc.size() - sizeof(uint32_t)) {
+  if (*size > enc_size - sizeof(uint32_t)) {
     return std::nullopt;
   }
-
-  std::vector<uint8_t> data(enc.begin() + sizeof(uint32_t),
-                            enc.begin() + sizeof(uint32_t) + *size);
-  return std::optional<Record>{data};
+  return sizeof(uint32_t) + *size;
 }
 
 }  // namespace wombat::broker::frame
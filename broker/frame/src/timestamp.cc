@@ -0,0 +1,33 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "frame/timestamp.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "frame/utils.h"
+
+namespace wombat::broker::frame {
+
+Timestamp::Timestamp(uint64_t timestamp) : timestamp_{timestamp} {}
+
+bool Timestamp::operator==(const Timestamp& timestamp) const {
+  return timestamp_ == timestamp.timestamp_;
+}
+
+bool Timestamp::operator!=(const Timestamp& timestamp) const {
+  return !(*this == timestamp);
+}
+
+std::vector<uint8_t> Timestamp::Encode() const { return EncodeU64(timestamp_); }
+
+std::optional<Timestamp> Timestamp::Decode(const std::vector<uint8_t>& enc) {
+  std::optional<uint64_t> timestamp = DecodeU64(enc);
+  if (!timestamp) {
+    return std::nullopt;
+  }
+  return std::optional<Timestamp>{Timestamp{*timestamp}};
+}
+
+}  // namespace wombat::broker::frame
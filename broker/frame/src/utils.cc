@@ -19,13 +19,35 @@ std::vector<uint8_t> EncodeU32(uint32_t n) {
 }
 
 std::optional<uint32_t> DecodeU32(const std::vector<uint8_t>& enc) {
-  if (enc.size() < sizeof(uint32_t)) {
+  return DecodeU32(enc.data(), enc.size());
+}
+
+std::optional<uint32_t> DecodeU32(const uint8_t* enc, size_t size) {
+  if (size < sizeof(uint32_t)) {
     return std::nullopt;
   }
 
   uint32_t n;
-  std::memcpy(&n, enc.data(), sizeof(uint32_t));
+  std::memcpy(&n, enc, sizeof(uint32_t));
   return ntohl(n);
 }
 
+std::vector<uint8_t> EncodeU64(uint64_t n) {
+  std::vector<uint8_t> enc = EncodeU32(n >> 32);
+  const std::vector<uint8_t> low = EncodeU32(n);
+  enc.insert(enc.end(), low.begin(), low.end());
+  return enc;
+}
+
+std::optional<uint64_t> DecodeU64(const std::vector<uint8_t>& enc) {
+  if (enc.size() < sizeof(uint64_t)) {
+    return std::nullopt;
+  }
+
+  const uint64_t high = *DecodeU32(enc.data(), sizeof(uint32_t));
+  const uint64_t low =
+      *DecodeU32(enc.data() + sizeof(uint32_t), sizeof(uint32_t));
+  return (high << 32) | low;
+}
+
 }  // namespace wombat::broker::frame
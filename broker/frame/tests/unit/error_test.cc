@@ -0,0 +1,39 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <vector>
+
+#include "frame/error.h"
+#include "gtest/gtest.h"
+
+namespace wombat::broker::frame {
+
+class ErrorTest : public ::testing::Test {};
+
+TEST_F(ErrorTest, GetCode) {
+  const Error error{Error::Code::kOffsetOutOfRange};
+  EXPECT_EQ(Error::Code::kOffsetOutOfRange, error.code());
+}
+
+TEST_F(ErrorTest, Encode) {
+  const Error error{Error::Code::kOffsetOutOfRange};
+
+  const std::vector<uint8_t> expected{0x00, 0x00, 0x00, 0x01};
+  EXPECT_EQ(expected, error.Encode());
+}
+
+TEST_F(ErrorTest, DecodeOk) {
+  const std::vector<uint8_t> enc{0x00, 0x00, 0x00, 0x00};
+
+  const Error expected{Error::Code::kMisalignedOffset};
+
+  EXPECT_TRUE(Error::Decode(enc));
+  EXPECT_EQ(expected, *Error::Decode(enc));
+}
+
+TEST_F(ErrorTest, DecodeTooSmall) {
+  const std::vector<uint8_t> enc{1, 2};
+  EXPECT_FALSE(Error::Decode(enc));
+}
+
+}  // namespace wombat::broker::frame
@@ -1,6 +1,7 @@
 // Copyright 2020 Andrew Dunstall
 
 #include <cstdint>
+#include <optional>
 #include <vector>
 
 #include "frame/messageheader.h"
@@ -61,12 +62,48 @@ TEST_F(MessageHeaderTest, DecodeOk) {
       0x00, 0x00, 0x00, 0xfa,  // Payload size
   };
 
+  // Messages without a version are Version::kV1.
   const MessageHeader expected{Type::kConsumeRequest, 0xaabbccdd, 0xfa};
 
   EXPECT_TRUE(MessageHeader::Decode(enc));
   EXPECT_EQ(expected, *MessageHeader::Decode(enc));
 }
 
+TEST_F(MessageHeaderTest, EncodeVersion) {
+  const MessageHeader header{Type::kConsumeRequest, 0xaabbccdd, 0xff,
+                             Version::kV2};
+
+  const std::vector<uint8_t> expected{
+      0x00, 0x01, 0x00, 0x01,  // Version and type
+      0xaa, 0xbb, 0xcc, 0xdd,  // Partition ID
+      0x00, 0x00, 0x00, 0xff,  // Payload size
+  };
+  EXPECT_EQ(expected, header.Encode());
+}
+
+TEST_F(MessageHeaderTest, DecodeVersion) {
+  const std::vector<uint8_t> enc{
+      0x00, 0x01, 0x00, 0x01,  // Version and type
+      0xaa, 0xbb, 0xcc, 0xdd,  // Partition ID
+      0x00, 0x00, 0x00, 0xfa,  // Payload size
+  };
+
+  const std::optional<MessageHeader> header = MessageHeader::Decode(enc);
+  ASSERT_TRUE(header);
+  EXPECT_EQ(Type::kConsumeRequest, header->type());
+  EXPECT_EQ(Version::kV2, header->version());
+}
+
+TEST_F(MessageHeaderTest, DecodeUnknownVersion) {
+  const std::vector<uint8_t> enc{
+      0x00, 0x02, 0x00, 0x01,  // Version and type
+      0xaa, 0xbb, 0xcc, 0xdd,  // Partition ID
+      0x00, 0x00, 0x00, 0xfa,  // Payload size
+  };
+
+  EXPECT_FALSE(MessageHeader::Decode(enc));
+}
+
 TEST_F(MessageHeaderTest, DecodeHeaderTooSmall) {
   std::vector<uint8_t> enc{
       0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -82,4 +119,16 @@ TEST_F(MessageHeaderTest, DecodeExceedsLimit) {
   EXPECT_FALSE(MessageHeader::Decode(enc));
 }
 
+TEST_F(MessageHeaderTest, BatchLimit) {
+  // Messages carrying record batches may exceed the record limit.
+  const MessageHeader header{Type::kProduceBatchRequest, 0, 0x10000};
+  EXPECT_EQ(header, MessageHeader::Decode(header.Encode()));
+
+  EXPECT_THROW(MessageHeader(Type::kConsumeBatchResponse, 0, (1 << 20) + 1),
+               std::invalid_argument);
+  std::vector<uint8_t> enc{0x00, 0x00, 0x00, 0x0c, 0x00, 0x00,
+                           0x00, 0x00, 0x00, 0x10, 0x00, 0x01};
+  EXPECT_FALSE(MessageHeader::Decode(enc));
+}
+
 }  // namespace wombat::broker::frame
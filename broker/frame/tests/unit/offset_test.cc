@@ -1,6 +1,7 @@
 // Copyright 2020 Andrew Dunstall
 
 #include <cstdint>
+#include <stdexcept>
 #include <vector>
 
 #include "frame/offset.h"
@@ -39,4 +40,34 @@ TEST_F(OffsetTest, DecodeTooSmall) {
   EXPECT_FALSE(Offset::Decode(enc));
 }
 
+TEST_F(OffsetTest, EncodeV2) {
+  const uint64_t offset = 0x1aabbccdd;
+  const Offset request{offset, Version::kV2};
+
+  const std::vector<uint8_t> expected{0x00, 0x00, 0x00, 0x01,
+                                      0xaa, 0xbb, 0xcc, 0xdd};
+  EXPECT_EQ(expected, request.Encode());
+}
+
+TEST_F(OffsetTest, DecodeV2Ok) {
+  const std::vector<uint8_t> enc{0x00, 0x00, 0x00, 0x01,
+                                 0xaa, 0xbb, 0xcc, 0xdd};
+
+  const Offset expected{0x1aabbccdd, Version::kV2};
+
+  EXPECT_TRUE(Offset::Decode(enc, Version::kV2));
+  EXPECT_EQ(expected, *Offset::Decode(enc, Version::kV2));
+}
+
+TEST_F(OffsetTest, DecodeV2TooSmall) {
+  const std::vector<uint8_t> enc{0xaa, 0xbb, 0xcc, 0xdd};
+  EXPECT_FALSE(Offset::Decode(enc, Version::kV2));
+}
+
+TEST_F(OffsetTest, ExceedsVersionLimit) {
+  EXPECT_THROW(Offset(0x100000000), std::invalid_argument);
+  EXPECT_EQ(0xffffffffU, Offset::Max(Version::kV1));
+  EXPECT_NO_THROW(Offset(0x100000000, Version::kV2));
+}
+
 }  // namespace wombat::broker::frame
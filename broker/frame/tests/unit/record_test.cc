@@ -68,4 +68,15 @@ TEST_F(RecordTest, DecodeSizesDontMatch) {
   EXPECT_FALSE(Record::Decode(enc));
 }
 
+TEST_F(RecordTest, EncodedSize) {
+  std::vector<uint8_t> enc{0x0, 0x0, 0x0, 0x0f};
+  const std::vector<uint8_t> data(0x10, 0xff);
+  enc.insert(enc.end(), data.begin(), data.end());
+
+  // Data following the record is ignored.
+  EXPECT_EQ(19U, *Record::EncodedSize(enc.data(), enc.size()));
+  EXPECT_FALSE(Record::EncodedSize(enc.data(), 18));
+  EXPECT_FALSE(Record::EncodedSize(enc.data(), 2));
+}
+
 }  // namespace wombat::broker::frame
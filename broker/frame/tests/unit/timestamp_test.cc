@@ -0,0 +1,36 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <vector>
+
+#include "frame/timestamp.h"
+#include "gtest/gtest.h"
+
+namespace wombat::broker::frame {
+
+class TimestampTest : public ::testing::Test {};
+
+TEST_F(TimestampTest, Encode) {
+  const Timestamp timestamp{0x1747a3b2c4d};
+
+  const std::vector<uint8_t> expected{0x00, 0x00, 0x01, 0x74,
+                                      0x7a, 0x3b, 0x2c, 0x4d};
+  EXPECT_EQ(expected, timestamp.Encode());
+}
+
+TEST_F(TimestampTest, DecodeOk) {
+  const std::vector<uint8_t> enc{0x00, 0x00, 0x01, 0x74,
+                                 0x7a, 0x3b, 0x2c, 0x4d};
+
+  const Timestamp expected{0x1747a3b2c4d};
+
+  EXPECT_TRUE(Timestamp::Decode(enc));
+  EXPECT_EQ(expected, *Timestamp::Decode(enc));
+}
+
+TEST_F(TimestampTest, DecodeTooSmall) {
+  const std::vector<uint8_t> enc{0x7a, 0x3b, 0x2c, 0x4d};
+  EXPECT_FALSE(Timestamp::Decode(enc));
+}
+
+}  // namespace wombat::broker::frame
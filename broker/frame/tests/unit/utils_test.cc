@@ -22,4 +22,34 @@ TEST(TestDecodeU32, InvalidTooSmall) {
   EXPECT_EQ(std::nullopt, DecodeU32(enc));
 }
 
+TEST(TestEncodeU64, Ok) {
+  const uint64_t n = 0x1122334455667788;
+  const std::vector<uint8_t> expected{0x11, 0x22, 0x33, 0x44,
+                                      0x55, 0x66, 0x77, 0x88};
+  EXPECT_EQ(expected, EncodeU64(n));
+}
+
+TEST(TestDecodeU64, Ok) {
+  const std::vector<uint8_t> enc{0x11, 0x22, 0x33, 0x44,
+                                 0x55, 0x66, 0x77, 0x88};
+  const uint64_t expected = 0x1122334455667788;
+  EXPECT_EQ(expected, DecodeU64(enc));
+}
+
+TEST(TestDecodeU64, InvalidTooSmall) {
+  const std::vector<uint8_t> enc{0xaa, 0xbb, 0xcc, 0xdd};
+  EXPECT_EQ(std::nullopt, DecodeU64(enc));
+}
+
+TEST(TestDecodeU32, PointerOk) {
+  const uint8_t enc[] = {0xaa, 0xbb, 0xcc, 0xdd, 0xee};
+  const uint32_t expected = 0xaabbccdd;
+  EXPECT_EQ(expected, DecodeU32(enc, sizeof(enc)));
+}
+
+TEST(TestDecodeU32, PointerInvalidTooSmall) {
+  const uint8_t enc[] = {0xaa, 0xbb};
+  EXPECT_EQ(std::nullopt, DecodeU32(enc, sizeof(enc)));
+}
+
 }  // namespace wombat::broker::frame
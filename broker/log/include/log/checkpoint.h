@@ -0,0 +1,62 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wombat::broker::log {
+
+// Name of the checkpoint file in the log directory.
+const std::string kCheckpointName = "checkpoint";  // NOLINT
+
+// Checkpoint records the recovered state of the active segment of a log, so
+// reopening the log only has to recover data appended after the checkpoint
+// rather than rescanning the whole segment.
+//
+// The checkpoint only describes data that was flushed, according to the
+// durability policy, before it was written, and is ignored if it does not
+// match the log on disk.
+struct Checkpoint {
+  // Id and starting offset of the active segment, which is the latest entry
+  // in the segment directory.
+  uint32_t active;
+  uint64_t active_start;
+
+  // Offset of the end of the log.
+  uint64_t end;
+
+  // Position in the active segment up to which the segment has been verified
+  // against its checksums.
+  uint32_t position;
+
+  // Number of checksums covering the active segment up to position.
+  uint32_t checksums;
+
+  // Ordinal of the next record in the active segment after position, so the
+  // index only has to scan records after position.
+  uint64_t ordinal;
+
+  std::vector<uint8_t> Encode() const;
+
+  // Decodes the checkpoint. Returns nullopt if the checkpoint is corrupt.
+  static std::optional<Checkpoint> Decode(const std::vector<uint8_t>& enc);
+
+  // Atomically replaces the checkpoint in the log directory dir. The
+  // checkpoint is written to a temporary file which is renamed, so a crash
+  // leaves either the old or new checkpoint. If sync is true the file and
+  // directory are synced so the checkpoint is durable, otherwise it is left
+  // to the kernel to write back, as with Durability::kNone.
+  void Write(const std::filesystem::path& dir, bool sync = true) const;
+
+  // Reads the checkpoint in the log directory dir. Returns nullopt if there
+  // is no checkpoint or it is corrupt.
+  static std::optional<Checkpoint> Read(const std::filesystem::path& dir);
+
+  bool operator==(const Checkpoint& checkpoint) const;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,72 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// Suffix added to the segment name for the segments checksum file.
+const std::string kChecksumSuffix = ".crc";  // NOLINT
+
+// Checksums stores a CRC32C of each append to a segment in the segments
+// checksum file, so corrupt or partially written data can be detected without
+// changing the segment format.
+//
+// Each entry is the size and checksum of an append as 32 bit big endian
+// integers. As each append is one record, entry n is the checksum of the nth
+// record in the segment.
+class Checksums {
+ public:
+  static constexpr uint32_t kEntrySize = 8;
+
+  explicit Checksums(std::shared_ptr<Segment> file);
+
+  // Returns the number of appends with a checksum.
+  uint32_t size() const { return file_->size() / kEntrySize; }
+
+  const std::shared_ptr<Segment>& file() const { return file_; }
+
+  // Adds the checksum of an append of size bytes.
+  void Append(const uint8_t* data, uint32_t size);
+
+  // Returns true if data matches the checksum of the nth append. Appends
+  // without a checksum, written before checksums were added, are not
+  // verified.
+  bool Verify(uint32_t n, View data) const;
+
+  // Reads the entries of up to count appends starting from the nth append,
+  // so many appends can be verified with a single read using Matches.
+  std::vector<uint8_t> Read(uint32_t n, uint32_t count) const;
+
+  // Returns true if data matches the checksum entry.
+  static bool Matches(const uint8_t* entry, View data);
+
+  // Verifies the appends in segment in order and truncates both the segment
+  // and the checksum file after the last valid append, so a partially written
+  // tail is discarded. Returns the number of bytes truncated from the
+  // segment.
+  //
+  // If the first verified appends, ending at position, are known to be valid
+  // verification starts after them.
+  uint32_t Recover(Segment* segment, uint32_t verified = 0,
+                   uint32_t position = 0);
+
+  // Adds the checksums of each record in a segment written before checksums
+  // were added.
+  void Rebuild(Segment* segment);
+
+ private:
+  // Returns the checksum of size bytes of segment at position.
+  static uint32_t Checksum(Segment* segment, uint32_t position, uint32_t size);
+
+  std::shared_ptr<Segment> file_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,57 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wombat::broker::log {
+
+// Cleaner deletes the files of segments removed by retention on a background
+// thread. Deletions are rate limited to one file per interval so deleting
+// many large segments does not cause an I/O spike.
+class Cleaner {
+ public:
+  explicit Cleaner(std::chrono::milliseconds interval);
+
+  // Deletes any pending files, without rate limiting, before returning.
+  ~Cleaner();
+
+  Cleaner(const Cleaner&) = delete;
+  Cleaner& operator=(const Cleaner&) = delete;
+
+  Cleaner(Cleaner&&) = delete;
+  Cleaner& operator=(Cleaner&&) = delete;
+
+  // Returns the number of files waiting to be deleted.
+  uint32_t pending() const;
+
+  // Queues the files to be deleted.
+  void Delete(const std::vector<std::filesystem::path>& paths);
+
+ private:
+  void Run();
+
+  // Deletes the file, releasing the lock during the delete so files can be
+  // queued.
+  void Unlink(const std::filesystem::path& path,
+              std::unique_lock<std::mutex>* lk);
+
+  std::chrono::milliseconds interval_;
+
+  mutable std::mutex mut_;
+  std::condition_variable cv_;
+
+  std::deque<std::filesystem::path> pending_;
+
+  bool running_;
+  std::thread thread_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,102 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include "log/coldstore.h"
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// Name of the cold cache directory in the log directory.
+const std::string kColdCacheName = "cold-cache";  // NOLINT
+
+// ColdCache keeps local copies of files read from a cold store in a
+// directory, so segments in the cold store are read from local disk once
+// fetched. Once the cached files exceed the limit the least recently fetched
+// files are deleted, except files whose segment is still open, so the files
+// on disk only exceed the limit while segments are open.
+class ColdCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+  };
+
+  // Opens the segment of a cached file.
+  using Open =
+      std::function<std::shared_ptr<Segment>(const std::filesystem::path&)>;
+
+  // Creates the cache directory, removing any files cached before, as their
+  // fetch may not have completed.
+  ColdCache(std::shared_ptr<ColdStore> store,
+            const std::filesystem::path& path, uint64_t limit);
+
+  ColdCache(const ColdCache&) = delete;
+  ColdCache& operator=(const ColdCache&) = delete;
+  ColdCache(ColdCache&&) = delete;
+  ColdCache& operator=(ColdCache&&) = delete;
+
+  // Returns the segment of the local copy of the file name, fetching it from
+  // the store if it is not cached, or null if the store has no file with the
+  // name. The file is opened with open unless its segment is still open, and
+  // is not evicted until the segment is closed.
+  std::shared_ptr<Segment> Fetch(const std::string& name, const Open& open);
+
+  // Deletes the local copy of the file name, if cached, even if its segment
+  // is still open.
+  void Erase(const std::string& name);
+
+  uint64_t size() const;
+
+  Stats stats() const;
+
+ private:
+  struct File {
+    std::string name;
+    uint64_t size;
+    // The segment the file is open as, if any.
+    std::weak_ptr<Segment> segment;
+  };
+
+  // Deletes the least recently fetched files that are not open until the
+  // cache is within the limit, always keeping the most recently fetched
+  // file.
+  void Evict();
+
+  std::shared_ptr<ColdStore> store_;
+
+  std::filesystem::path path_;
+
+  uint64_t limit_;
+
+  // Guards the state below. Not held while copying from the store so reads
+  // of cached files do not wait for other files to be fetched.
+  mutable std::mutex mutex_;
+
+  // Notified when a fetch completes.
+  std::condition_variable fetched_;
+
+  // Names of the files being copied from the store, so each file is fetched
+  // once.
+  std::unordered_set<std::string> fetching_;
+
+  // Cached files, most recently fetched first.
+  std::list<File> files_;
+
+  uint64_t size_;
+
+  Stats stats_;
+};
+
+}  // namespace wombat::broker::log
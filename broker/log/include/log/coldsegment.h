@@ -0,0 +1,60 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// Implements a read-only Segment moved to the cold store. The segment is only
+// opened, which fetches it from the store, when first looked up, so the log
+// can load the indexes of cold segments using only their size.
+class ColdSegment : public Segment {
+ public:
+  // Opens the segment with open on the first lookup.
+  ColdSegment(uint32_t size, std::function<std::shared_ptr<Segment>()> open);
+
+  ~ColdSegment() override {}
+
+  ColdSegment(const ColdSegment&) = delete;
+  ColdSegment& operator=(const ColdSegment&) = delete;
+  ColdSegment(ColdSegment&&) = delete;
+  ColdSegment& operator=(ColdSegment&&) = delete;
+
+  // Returns zero as there is no local file to read directly.
+  uint32_t written() const override { return 0; }
+
+  // Throws LogException as a sealed segment cannot be modified.
+  void Append(const std::vector<uint8_t>& data) override;
+
+  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+
+  std::optional<View> LookupView(uint32_t offset, uint32_t size) override;
+
+  // Hints are passed to the opened segment, and ignored if the segment was
+  // not yet fetched from the store.
+  void WillNeed(uint32_t offset, uint32_t size) override;
+  void DontNeed(uint32_t offset, uint32_t size) override;
+  void AdviseSequential() override;
+
+ private:
+  // Returns the opened segment, opening it if needed.
+  std::shared_ptr<Segment> Open();
+
+  std::function<std::shared_ptr<Segment>()> open_;
+
+  // Guards segment_ as sealed segments are looked up concurrently.
+  std::mutex mutex_;
+
+  std::shared_ptr<Segment> segment_;
+};
+
+}  // namespace wombat::broker::log
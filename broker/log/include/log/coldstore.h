@@ -0,0 +1,35 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace wombat::broker::log {
+
+// Abstract class representing a cold store, such as a slower disk or an
+// object store, that sealed segments are moved to so local disk only holds
+// recent segments. Files are stored whole by name.
+//
+// Operations may block so are only used from background threads, except
+// reads of cold segments not in the local cache. Implementations throw
+// LogException on errors, and must be thread-safe.
+class ColdStore {
+ public:
+  virtual ~ColdStore() {}
+
+  // Copies the file at path to the store as name, replacing any file with
+  // the name. The file must be durable once Put returns.
+  virtual void Put(const std::string& name,
+                   const std::filesystem::path& path) = 0;
+
+  // Copies the file name in the store to path. Returns false if the store has
+  // no file with the name.
+  virtual bool Get(const std::string& name,
+                   const std::filesystem::path& path) = 0;
+
+  // Removes the file name from the store, if it exists.
+  virtual void Remove(const std::string& name) = 0;
+};
+
+}  // namespace wombat::broker::log
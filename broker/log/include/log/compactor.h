@@ -0,0 +1,83 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// Suffix added to the name of each file written by compaction until the
+// files replace the segment and its index, checksum and time index files.
+const std::string kCompactedSuffix = ".compacted";  // NOLINT
+
+// Suffix of the file marking the compacted files of a segment are complete,
+// so if the log closes while replacing the segment files the replacement is
+// finished when the log is reopened.
+const std::string kSwapSuffix = ".swap";  // NOLINT
+
+// Compactor removes records of keyed record batches that are superseded by a
+// later record with the same key, so a log of changes only keeps the latest
+// value of each key. Compaction runs on a background thread every interval.
+//
+// Removed records are replaced with padding (see RecordBatch) so the records
+// kept stay at the same offsets and the offsets of segments are unchanged.
+// The padding is not written, leaving a hole in the segment file, so disk
+// space is freed and consumers skip the removed records with one request.
+class Compactor {
+ public:
+  // Maps each key to the offset of the batch holding its latest record,
+  // which is the last record with the key in the batch.
+  using KeyMap = std::unordered_map<std::string, uint64_t>;
+
+  // Runs compact on a background thread every interval.
+  Compactor(std::chrono::milliseconds interval, std::function<void()> compact);
+
+  // Waits for any compaction in progress to complete.
+  ~Compactor();
+
+  Compactor(const Compactor&) = delete;
+  Compactor& operator=(const Compactor&) = delete;
+  Compactor(Compactor&&) = delete;
+  Compactor& operator=(Compactor&&) = delete;
+
+  // Adds the keys of the records in segment, which starts at offset start, to
+  // keys. Segments must be added in order so later records replace earlier
+  // records.
+  static void AddKeys(Segment* segment, uint64_t start, KeyMap* keys);
+
+  // Writes segment, which starts at offset start, to out, keeping only the
+  // records that are the latest record of their key, and only if
+  // remove_tombstones is false for tombstones. Records that are not in keyed
+  // batches are always kept. Sets positions to the position of each record
+  // in out.
+  //
+  // Returns false without writing out if no records would be removed, or
+  // false if the segment could not be fully read in which case out must be
+  // discarded.
+  static bool Rewrite(Segment* segment, uint64_t start, const KeyMap& keys,
+                      bool remove_tombstones, Segment* out,
+                      std::vector<uint32_t>* positions);
+
+ private:
+  void Run();
+
+  std::chrono::milliseconds interval_;
+  std::function<void()> compact_;
+
+  std::mutex mut_;
+  std::condition_variable cv_;
+  bool running_;
+  std::thread thread_;
+};
+
+}  // namespace wombat::broker::log
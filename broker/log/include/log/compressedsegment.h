@@ -0,0 +1,107 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// Suffix of the file holding a compressed segment, which replaces the
+// segment file.
+const std::string kCompressedSuffix = ".lz4";  // NOLINT
+
+// Implements a read-only Segment from a sealed segment compressed by
+// Compressor. The segment is split into blocks that are each compressed
+// independently, so a lookup only reads and decompresses the blocks it
+// covers. The most recently read blocks are kept decompressed, so sequential
+// lookups within a block decompress it once.
+//
+// The file holds the compressed blocks, followed by an entry for each block
+// with its position in the file, its size in the file and the CRC32C of the
+// stored block, then a footer with the block size, the size of the segment,
+// the number of blocks and kMagic. Blocks that do not compress are stored as
+// is.
+class CompressedSegment : public Segment {
+ public:
+  static constexpr uint32_t kMagic = 0x575a4c34;
+  static constexpr uint32_t kBlockEntrySize = 12;
+  static constexpr uint32_t kFooterSize = 16;
+
+  // Opens the compressed segment with the given id, keeping up to
+  // cached_blocks blocks decompressed.
+  CompressedSegment(uint32_t id, const std::filesystem::path& dir,
+                    uint32_t cached_blocks);
+
+  // Opens the compressed segment file at path directly.
+  CompressedSegment(const std::filesystem::path& path, uint32_t cached_blocks);
+
+  ~CompressedSegment() override;
+
+  CompressedSegment(const CompressedSegment&) = delete;
+  CompressedSegment& operator=(const CompressedSegment&) = delete;
+  CompressedSegment(CompressedSegment&&) = delete;
+  CompressedSegment& operator=(CompressedSegment&&) = delete;
+
+  // Returns zero as the file does not hold the segment data as is, so
+  // cannot be read directly.
+  uint32_t written() const override { return 0; }
+
+  // Ignored as offsets are within the decompressed data, and read blocks are
+  // cached decompressed.
+  void WillNeed(uint32_t offset, uint32_t size) override {}
+  void DontNeed(uint32_t offset, uint32_t size) override {}
+
+  // Throws LogException as a sealed segment cannot be modified.
+  void Append(const std::vector<uint8_t>& data) override;
+
+  // Returns nothing if a block covered is corrupt.
+  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+
+  // Returns nullopt as blocks are only decompressed into the cache, which
+  // may evict them while viewed.
+  std::optional<View> LookupView(uint32_t offset, uint32_t size) override;
+
+ private:
+  struct Block {
+    uint32_t position;
+    uint32_t size;
+    uint32_t crc;
+  };
+
+  // Reads the footer and block entries from the file. Returns false if the
+  // file is not a valid compressed segment.
+  bool Open();
+
+  // Returns the decompressed block with index n, or null if it is corrupt.
+  std::shared_ptr<const std::vector<uint8_t>> LookupBlock(uint32_t n);
+
+  // Reads and decompresses the block with index n, returning null if it is
+  // corrupt.
+  std::shared_ptr<const std::vector<uint8_t>> ReadBlock(uint32_t n) const;
+
+  uint32_t block_size_;
+
+  std::vector<Block> blocks_;
+
+  // Guards cache_ as sealed segments are looked up concurrently.
+  std::mutex mutex_;
+
+  // Decompressed blocks keyed by index, most recently used first.
+  std::list<std::pair<uint32_t, std::shared_ptr<const std::vector<uint8_t>>>>
+      cache_;
+
+  uint32_t cached_blocks_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,54 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// Suffix added to the name of a compressed segment file until it is complete
+// and replaces the segment file.
+const std::string kPartialSuffix = ".partial";  // NOLINT
+
+// Compressor compresses sealed segments into the format read by
+// CompressedSegment, on a background thread every interval.
+class Compressor {
+ public:
+  // Runs compress on a background thread every interval.
+  Compressor(std::chrono::milliseconds interval,
+             std::function<void()> compress);
+
+  // Waits for any compression in progress to complete.
+  ~Compressor();
+
+  Compressor(const Compressor&) = delete;
+  Compressor& operator=(const Compressor&) = delete;
+  Compressor(Compressor&&) = delete;
+  Compressor& operator=(Compressor&&) = delete;
+
+  // Writes segment to out compressed in blocks of block_size bytes. Returns
+  // false if the segment could not be fully read in which case out must be
+  // discarded.
+  static bool Compress(Segment* segment, uint32_t block_size, Segment* out);
+
+ private:
+  void Run();
+
+  std::chrono::milliseconds interval_;
+  std::function<void()> compress_;
+
+  std::mutex mut_;
+  std::condition_variable cv_;
+  bool running_;
+  std::thread thread_;
+};
+
+}  // namespace wombat::broker::log
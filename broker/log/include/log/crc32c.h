@@ -0,0 +1,21 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wombat::broker::log {
+
+// Computes the CRC32C (Castagnoli) checksum of data, extending crc which is
+// the checksum of any preceding data.
+//
+// Uses the SSE4.2 or ARMv8 CRC32 instructions when the CPU supports them,
+// otherwise a slicing-by-8 table.
+uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// Computes the checksum using the table, regardless of CPU support. Exposed
+// for testing.
+uint32_t Crc32cPortable(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,37 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "log/coldstore.h"
+
+namespace wombat::broker::log {
+
+// Implements a ColdStore as a local directory, which is typically on a
+// different mount to the log such as a larger, slower disk.
+class DirectoryColdStore : public ColdStore {
+ public:
+  // Creates the directory if it does not exist.
+  explicit DirectoryColdStore(const std::filesystem::path& path);
+
+  ~DirectoryColdStore() override {}
+
+  std::filesystem::path path() const { return path_; }
+
+  // Copies the file to a temporary file which is synced then renamed, so a
+  // crash never leaves a partial file in the store.
+  void Put(const std::string& name,
+           const std::filesystem::path& path) override;
+
+  bool Get(const std::string& name,
+           const std::filesystem::path& path) override;
+
+  void Remove(const std::string& name) override;
+
+ private:
+  std::filesystem::path path_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,99 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "log/systemsegment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// DirectSegment is an active segment whose appends are written with O_DIRECT,
+// bypassing the page cache, so appended data does not take memory from data
+// that is read and write latency does not depend on kernel writeback.
+//
+// As O_DIRECT writes must be aligned to the block size, appends are staged in
+// an aligned buffer and written in whole blocks once the buffer is full. The
+// data following the last whole block is kept in the buffer, so lookups of
+// data not yet in whole blocks are served from the buffer. Flushing writes
+// the partial block through the page cache, and it is written again with
+// O_DIRECT once the block is complete.
+//
+// Falls back to writing through the page cache if the file system does not
+// support O_DIRECT.
+class DirectSegment : public SystemSegment {
+ public:
+  static constexpr uint32_t kBlockSize = 4096;
+
+  // Stages up to buffer_size bytes, rounded up to whole blocks, writing them
+  // once the buffer is full or the oldest staged append is older than
+  // linger.
+  DirectSegment(uint32_t id, const std::filesystem::path& dir, uint32_t limit,
+                uint32_t buffer_size, std::chrono::milliseconds linger);
+
+  // Writes any staged appends.
+  ~DirectSegment() override;
+
+  DirectSegment(const DirectSegment&) = delete;
+  DirectSegment& operator=(const DirectSegment&) = delete;
+  DirectSegment(DirectSegment&&) = delete;
+  DirectSegment& operator=(DirectSegment&&) = delete;
+
+  // Returns true if writes bypass the page cache.
+  bool direct() const { return direct_fd_ != -1; }
+
+  uint32_t written() const override { return written_; }
+
+  void Append(const std::vector<uint8_t>& data) override;
+
+  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+
+  std::optional<View> LookupView(uint32_t offset, uint32_t size) override;
+
+  // Writes the whole blocks staged with O_DIRECT, and the partial block
+  // following them through the page cache.
+  void Flush() override;
+
+  void Poll() override;
+
+  void Truncate(uint32_t size) override;
+
+ private:
+  struct Free {
+    void operator()(uint8_t* p) const { std::free(p); }
+  };
+
+  // Writes the whole blocks staged, keeping the partial block following
+  // them.
+  void WriteBlocks();
+
+  // Reads the partial block at the end of the file into the staging buffer.
+  void LoadTail();
+
+  int direct_fd_;
+
+  // Holds the data from position blocks_, the end of the whole blocks
+  // written, to the end of the segment.
+  std::unique_ptr<uint8_t, Free> staging_;
+  uint32_t capacity_;
+
+  uint32_t blocks_;
+
+  // Position up to which the segment was written to the file, including any
+  // partial block written through the page cache.
+  uint32_t written_;
+
+  std::chrono::milliseconds linger_;
+
+  // Time the oldest append not yet written was staged.
+  std::chrono::steady_clock::time_point staged_at_;
+};
+
+}  // namespace wombat::broker::log
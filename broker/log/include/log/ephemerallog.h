@@ -0,0 +1,78 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "log/log.h"
+#include "log/memorysegment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// EphemeralLog is a log held only in memory, for streams such as telemetry
+// where durability does not matter. It is a bounded ring of MemorySegments:
+// once every segment is full the oldest segment is dropped, advancing the
+// start of the log, and its memory is reused for the next segment. So the log
+// never does disk I/O, and appends and lookups only copy memory.
+//
+// Each Append is one record, and records never span segments so can always
+// be viewed. A record larger than segment_size is given a segment of its own.
+class EphemeralLog : public Log {
+ public:
+  // Holds up to segments segments of segment_size bytes. Throws LogException
+  // if segment_size is zero or there are fewer than two segments, as the
+  // active segment is never dropped.
+  EphemeralLog(uint32_t segment_size, uint32_t segments);
+
+  uint64_t start() const override { return start_; }
+
+  void Append(const std::vector<uint8_t>& data) override;
+
+  // Returns nothing if the data is before the start of the log or spans
+  // segments.
+  std::vector<uint8_t> Lookup(uint64_t offset, uint32_t size) override;
+
+  std::optional<View> LookupView(uint64_t offset, uint32_t size) override;
+
+  bool Seek(uint64_t ordinal, uint64_t* offset) override;
+
+  bool IsAligned(uint64_t offset) override;
+
+ private:
+  // A segment in the ring and the position of each record in it.
+  struct Entry {
+    uint64_t start;
+    // Ordinal of the first record in the segment.
+    uint64_t base;
+    std::vector<uint32_t> records;
+    std::unique_ptr<MemorySegment> segment;
+  };
+
+  // Adds a segment with room for size bytes, dropping the oldest segment if
+  // the ring is full.
+  void Roll(uint32_t size);
+
+  // Returns the segment containing offset, which must be within the log.
+  Entry* Resolve(uint64_t offset);
+
+  uint32_t segment_size_;
+
+  uint32_t segments_;
+
+  std::deque<Entry> ring_;
+
+  uint64_t start_;
+
+  // Ordinal of the next record appended.
+  uint64_t next_;
+
+  // Id of the next segment created, which only names its memfd.
+  uint32_t id_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,98 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "log/checkpoint.h"
+#include "log/options.h"
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// Flusher syncs appended segments to disk according to the durability policy
+// and tracks the flushed offset, the offset up to which the log is durable.
+//
+// With Durability::kInterval and Durability::kGroupCommit syncs run on a
+// background thread so appends never block on disk. Appends that arrive while
+// a sync is in progress are batched into the next sync.
+//
+// Checkpoints are also written by the flusher, once the data they cover is
+// flushed, so checkpointing never syncs data early or blocks appends.
+class Flusher {
+ public:
+  Flusher(const Options& options, uint64_t flushed);
+
+  // Syncs any pending data, and writes any pending checkpoint, before
+  // returning.
+  ~Flusher();
+
+  Flusher(const Flusher&) = delete;
+  Flusher& operator=(const Flusher&) = delete;
+
+  Flusher(Flusher&&) = delete;
+  Flusher& operator=(Flusher&&) = delete;
+
+  uint64_t flushed() const { return flushed_; }
+
+  // Records that data up to offset in the log has been written to segment.
+  void Written(std::shared_ptr<Segment> segment, uint64_t offset);
+
+  // Waits for up to timeout for the log to be flushed up to offset. Returns
+  // true if offset has been flushed.
+  bool Wait(uint64_t offset, std::chrono::milliseconds timeout);
+
+  // Writes the checkpoint to the log directory dir once the log is flushed
+  // up to the end of the checkpoint, replacing any checkpoint not yet
+  // written. With Durability::kNone the checkpoint is written immediately
+  // without syncing.
+  void WriteCheckpoint(const std::filesystem::path& dir,
+                       const Checkpoint& checkpoint);
+
+ private:
+  void Run();
+
+  // Returns true if the pending checkpoint is covered by the flushed data.
+  bool CheckpointFlushed() const;
+
+  // Writes the pending checkpoint if covered by the flushed data, releasing
+  // the lock while writing.
+  void WritePending(std::unique_lock<std::mutex>* lk);
+
+  // Syncs all pending segments, releasing the lock during the sync so appends
+  // are not blocked.
+  void SyncPending(std::unique_lock<std::mutex>* lk);
+
+  Durability durability_;
+
+  std::chrono::milliseconds interval_;
+  uint32_t interval_bytes_;
+
+  std::mutex mut_;
+  std::condition_variable written_cv_;
+  std::condition_variable flushed_cv_;
+
+  // Segments written to since the last sync.
+  std::vector<std::shared_ptr<Segment>> pending_;
+
+  uint64_t written_;
+  std::atomic<uint64_t> flushed_;
+
+  // Log directory and checkpoint waiting for its data to be flushed.
+  std::filesystem::path checkpoint_dir_;
+  std::optional<Checkpoint> checkpoint_;
+
+  bool running_;
+  std::thread thread_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,87 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// Suffix added to the segment name for the segments index file.
+const std::string kIndexSuffix = ".index";  // NOLINT
+
+// Index is a sparse index of the records in a segment. It maps the ordinal of
+// a record (the number of records in the log before it) to the position of
+// the record in the segment.
+//
+// An entry is added at most every interval bytes so resolving an ordinal or
+// checking a position is aligned to a record only scans up to interval bytes
+// of the segment.
+class Index {
+ public:
+  struct Entry {
+    uint64_t ordinal;
+    uint32_t position;
+  };
+
+  // Opens the index stored in the given segment. If the index is empty it
+  // starts at the base ordinal.
+  Index(std::shared_ptr<Segment> segment, uint64_t base, uint32_t interval);
+
+  // Returns the ordinal of the first record in the segment.
+  uint64_t base() const { return entries_.front().ordinal; }
+
+  // Returns the ordinal of the next record appended to the segment.
+  uint64_t next() const { return next_; }
+
+  // Updates the index with a record of size bytes appended at position.
+  void Append(uint32_t position, uint32_t size);
+
+  // Closes the index file once the segment is sealed, keeping only the
+  // entries in memory. Entries added once closed are not persisted.
+  void Close() { segment_ = nullptr; }
+
+  // Returns the ordinal and position of the next record appended.
+  Entry tail() const { return Entry{next_, end_}; }
+
+  // Scans the records in segment following the last entry to recover the
+  // ordinal of the next record and any missing entries. If given, from is a
+  // previous tail of the index so only records after it are scanned.
+  void Recover(Segment* segment, Entry from = Entry{0, 0});
+
+  // Looks up the position of the record with the given ordinal in segment.
+  // Returns false if the record is not in the segment.
+  bool Lookup(uint64_t ordinal, Segment* segment, uint32_t* position) const;
+
+  // Returns true if a record in segment starts at position, or position is
+  // the end of the segment.
+  bool IsAligned(uint32_t position, Segment* segment) const;
+
+  // Sets ordinal to the ordinal of the record starting at position in
+  // segment. Returns false if no record starts at position.
+  bool Ordinal(uint32_t position, Segment* segment, uint64_t* ordinal) const;
+
+ private:
+  // Each entry is a 64 bit ordinal followed by a 32 bit position.
+  static constexpr uint32_t kEntrySize = 12;
+
+  void Load();
+
+  void Insert(uint64_t ordinal, uint32_t position);
+
+  std::shared_ptr<Segment> segment_;
+
+  std::vector<Entry> entries_;
+
+  uint32_t interval_;
+
+  // Ordinal and position of the next record appended.
+  uint64_t next_;
+  uint32_t end_;
+};
+
+}  // namespace wombat::broker::log
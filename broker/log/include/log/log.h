@@ -2,31 +2,116 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
+#include "log/logreader.h"
+#include "log/view.h"
+
 namespace wombat::broker::log {
 
 class Log {
  public:
-  explicit Log(uint32_t size = 0) : size_{size} {}
+  using LookupCallback = std::function<void(std::vector<uint8_t> data)>;
+
+  explicit Log(uint64_t size = 0) : size_{size} {}
 
   virtual ~Log() {}
 
   Log(const Log&) = delete;
   Log& operator=(const Log&) = delete;
 
-  Log(Log&&) = default;
-  Log& operator=(Log&&) = default;
+  Log(Log&&) = delete;
+  Log& operator=(Log&&) = delete;
+
+  // Returns the end of the log. The end is only advanced once the appended
+  // data can be looked up, so may be read from any thread.
+  uint64_t size() const { return size_; }
+
+  // Returns true if the log may be read from other threads concurrently with
+  // the thread appending to it, with any method other than Append, Poll and
+  // LookupView. Each reader must only be used by one thread at a time.
+  virtual bool concurrent_reads() const { return false; }
 
-  uint32_t size() const { return size_; }
+  // Returns the offset of the first record in the log. Records before the
+  // start have been deleted by retention.
+  virtual uint64_t start() const { return 0; }
+
+  // Returns the offset up to which the log is durable. Logs without a
+  // durability policy treat all appended data as flushed.
+  virtual uint64_t flushed() const { return size_; }
+
+  // Waits for up to timeout for the log to be flushed up to offset. Returns
+  // true if offset has been flushed.
+  virtual bool WaitFlushed(uint64_t offset,
+                           std::chrono::milliseconds timeout) {
+    return offset <= flushed();
+  }
 
   virtual void Append(const std::vector<uint8_t>& data) = 0;
 
-  virtual std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) = 0;
+  virtual std::vector<uint8_t> Lookup(uint64_t offset, uint32_t size) = 0;
+
+  // Looks up size bytes at offset as with Lookup, passing the data to
+  // callback either before returning or from a later call to Poll. Logs that
+  // do not support asynchronous lookups call Lookup directly.
+  virtual void LookupAsync(uint64_t offset, uint32_t size,
+                           LookupCallback callback) {
+    callback(Lookup(offset, size));
+  }
+
+  // Performs periodic work such as writing buffered appends and completing
+  // asynchronous operations. Called regularly by the thread appending to the
+  // log.
+  virtual void Poll() {}
+
+  // Returns the number of asynchronous operations that have not completed,
+  // which complete in Poll.
+  virtual uint32_t in_flight() const { return 0; }
+
+  // Sets offset to the position of the record with the given ordinal (the
+  // number of records appended before it), where each Append is one record.
+  // Returns false if the log does not index records or the record does not
+  // exist.
+  virtual bool Seek(uint64_t ordinal, uint64_t* offset) { return false; }
+
+  // Sets offset to the position of the first record appended at or after
+  // timestamp, in milliseconds since the Unix epoch, or the end of the log if
+  // there is no such record. Returns false if the log does not index
+  // timestamps.
+  virtual bool SeekTime(uint64_t timestamp, uint64_t* offset) {
+    return false;
+  }
+
+  // Returns true if offset is the start of a record or past the end of the
+  // log. Logs that do not index records treat every offset as aligned.
+  virtual bool IsAligned(uint64_t offset) { return true; }
+
+  // Returns true if record, the record at offset, matches the checksum stored
+  // when it was appended. Logs that do not store checksums treat every record
+  // as valid.
+  virtual bool Verify(uint64_t offset, View record) { return true; }
+
+  // Returns a reader positioned at offset, which must be the start of a
+  // record, or null if the log does not support readers in which case Lookup
+  // must be used. The reader must not outlive the log.
+  virtual std::unique_ptr<LogReader> NewReader(uint64_t offset) {
+    return nullptr;
+  }
+
+  // Returns a view of the data at offset without copying if supported by the
+  // log, otherwise nullopt in which case Lookup must be used.
+  virtual std::optional<View> LookupView(uint64_t offset, uint32_t size) {
+    return std::nullopt;
+  }
 
  protected:
-  uint32_t size_ = 0;
+  std::atomic<uint64_t> size_;
 };
 
 }  // namespace wombat::broker::log
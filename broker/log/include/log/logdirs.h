@@ -0,0 +1,147 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "log/log.h"
+
+namespace wombat::broker::log {
+
+// Name of the file marking a log directory as a partial copy of a log being
+// moved.
+const std::string kMovingName = "moving";  // NOLINT
+
+// LogDirs places the logs of partitions across log directories, each
+// typically on its own disk, so appends are spread across the disks. New logs
+// are placed in the least loaded directory, by both the bytes stored in the
+// directory and the recent append throughput of the logs in it, and logs may
+// be moved between directories while the broker runs.
+//
+// Each log is a directory named by the log in one of the log directories.
+// Moving a log first copies it to the new directory while the log is still
+// used, then copies the files changed since once the log is closed. The copy
+// is marked partial until complete, so if the broker stops while moving a
+// log the partial copy is removed when the log is next placed.
+//
+// Thread-safe as partitions move their logs on their own threads.
+class LogDirs {
+ public:
+  struct Load {
+    // Bytes allocated, which excludes the holes in compacted segments.
+    uint64_t bytes;
+    // Bytes appended per second to the tracked logs in the directory since
+    // the load was last computed.
+    uint64_t throughput;
+  };
+
+  // Creates the directories if they do not exist. Throws LogException if
+  // there are no directories.
+  explicit LogDirs(const std::vector<std::filesystem::path>& dirs);
+
+  LogDirs(const LogDirs&) = delete;
+  LogDirs& operator=(const LogDirs&) = delete;
+  LogDirs(LogDirs&&) = delete;
+  LogDirs& operator=(LogDirs&&) = delete;
+
+  const std::vector<std::filesystem::path>& dirs() const { return dirs_; }
+
+  // Returns the index of the directory holding the log with the given name,
+  // placing a new log in the least loaded directory.
+  size_t Place(const std::string& name);
+
+  // Returns the path of the log with the given name in directory dir.
+  std::filesystem::path Path(size_t dir, const std::string& name) const {
+    return dirs_[dir] / name;
+  }
+
+  // Tracks the append throughput of the placed log with the given name.
+  void Track(const std::string& name, std::weak_ptr<Log> log);
+
+  // Returns the load of each directory.
+  std::vector<Load> Loads();
+
+  // Returns the least loaded directory other than exclude, unless there is
+  // only one directory. Each directory is weighted by its share of the total
+  // bytes plus its share of the total throughput.
+  size_t LeastLoaded(std::optional<size_t> exclude = std::nullopt);
+
+  // Copies the log with the given name to directory dir, marking the copy
+  // partial. The log may still be in use.
+  void Copy(const std::string& name, size_t dir);
+
+  // Completes moving the log with the given name to directory dir, which must
+  // follow Copy with the log closed. Copies the files changed since Copy,
+  // including files rewritten without changing their size or modification
+  // time, and places the log in dir. The log is kept in its previous
+  // directory until removed with Remove, or moved back with Revert if it
+  // fails to open in dir.
+  void Move(const std::string& name, size_t dir);
+
+  // Places the log with the given name back in directory dir, which it was
+  // moved from, removing the copy it was moved to.
+  void Revert(const std::string& name, size_t dir);
+
+  // Removes the copy of the log with the given name in directory dir, unless
+  // the log is placed in dir.
+  void Remove(const std::string& name, size_t dir);
+
+  // Removes the partial copy of the log with the given name in directory dir
+  // after a failed move.
+  void Abort(const std::string& name, size_t dir);
+
+ private:
+  struct Tracked {
+    size_t dir;
+    std::weak_ptr<Log> log;
+    uint64_t size;
+    std::chrono::steady_clock::time_point sampled;
+  };
+
+  // Identifies the version of a file that was copied. Replacing the file
+  // changes its inode, and writing it changes its status change time, which
+  // unlike the modification time cannot be set back.
+  struct Version {
+    uint64_t inode;
+    int64_t changed_ns;
+  };
+
+  // Versions of the files copied, keyed by file name.
+  using Versions = std::unordered_map<std::string, Version>;
+
+  // Makes the files in to match the files in from, copying files unless
+  // copied has their current version, and removing files not in from.
+  // Records the versions copied in copied, except files changed within a
+  // second of copying, as the status change time may not change if the file
+  // is written again within the timestamp granularity. The modification
+  // times are kept as retention depends on them, and holes are kept so
+  // compacted segments are not reallocated.
+  static void Mirror(const std::filesystem::path& from,
+                     const std::filesystem::path& to, Versions* copied);
+
+  // Places the log with the given name in directory dir.
+  void Replace(const std::string& name, size_t dir);
+
+  std::vector<std::filesystem::path> dirs_;
+
+  std::mutex mutex_;
+
+  // Directory of each placed log.
+  std::unordered_map<std::string, size_t> placed_;
+
+  std::unordered_map<std::string, Tracked> tracked_;
+
+  // Versions of the files copied by Copy for each log being moved.
+  std::unordered_map<std::string, Versions> copied_;
+};
+
+}  // namespace wombat::broker::log
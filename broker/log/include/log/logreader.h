@@ -0,0 +1,40 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// LogReader is a cursor over the records of a log. It remembers its position
+// so reading successive records does not resolve the offset again, and may
+// read ahead so a sequential reader makes one system call per block rather
+// than two per record.
+class LogReader {
+ public:
+  virtual ~LogReader() {}
+
+  // Returns the offset of the next record.
+  virtual uint64_t offset() const = 0;
+
+  // Returns the next record, including its size prefix, and advances to the
+  // following record. Returns nullopt if there is no complete record at the
+  // offset, in which case Next may be called again once more records are
+  // appended.
+  //
+  // Padding left by compaction (see RecordBatch) is returned as its header
+  // alone, so does not match its checksum.
+  //
+  // The view is only valid until the next call to the reader.
+  virtual std::optional<View> Next() = 0;
+
+  // Returns true if record, the record last returned by Next, matches the
+  // checksum stored when it was appended. Unlike Log::Verify this does not
+  // resolve the record from its offset.
+  virtual bool Verify(View record) = 0;
+};
+
+}  // namespace wombat::broker::log
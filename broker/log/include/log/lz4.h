@@ -0,0 +1,21 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wombat::broker::log {
+
+// Compresses data in the LZ4 block format, using a single pass greedy match
+// finder which favours speed over compression ratio.
+std::vector<uint8_t> Lz4Compress(const uint8_t* data, size_t size);
+
+// Decompresses the LZ4 block in src into dst, which must be the size of the
+// decompressed data. Returns false if the block is corrupt or does not
+// decompress to exactly dst_size bytes.
+bool Lz4Decompress(const uint8_t* src, size_t src_size, uint8_t* dst,
+                   size_t dst_size);
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,57 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// MemorySegment is a Segment held only in memory, in an anonymous file created
+// with memfd_create that is mapped and populated up front, so appends and
+// lookups are a copy to or from the mapping with no system calls or page
+// faults. The file is discarded when the segment is destroyed.
+//
+// Unlike InMemorySegment it owns its file rather than sharing it through a
+// global, so is safe to use outside tests.
+class MemorySegment : public Segment {
+ public:
+  // Creates an empty segment that holds up to limit bytes.
+  MemorySegment(uint32_t id, uint32_t limit);
+
+  ~MemorySegment() override;
+
+  MemorySegment(const MemorySegment&) = delete;
+  MemorySegment& operator=(const MemorySegment&) = delete;
+  MemorySegment(MemorySegment&&) = delete;
+  MemorySegment& operator=(MemorySegment&&) = delete;
+
+  uint32_t limit() const { return limit_; }
+
+  // Returns the number of bytes the segment has room for, unlike is_full
+  // which is only true once the limit is reached.
+  uint32_t available() const { return limit_ - size_; }
+
+  // Throws LogException if the data does not fit in the segment.
+  void Append(const std::vector<uint8_t>& data) override;
+
+  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+
+  std::optional<View> LookupView(uint32_t offset, uint32_t size) override;
+
+  // Discards the data after size bytes. The memory is kept, so the segment
+  // may be truncated to zero and reused without allocating.
+  void Truncate(uint32_t size) override;
+
+  // Does nothing as there is no disk to sync to.
+  void Sync() override {}
+
+ private:
+  uint8_t* map_;
+};
+
+}  // namespace wombat::broker::log
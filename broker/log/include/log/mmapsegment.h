@@ -0,0 +1,40 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// Implements a read-only Segment by memory-mapping a sealed segment file.
+// Lookups are served from the mapping so cost no system calls.
+class MmapSegment : public Segment {
+ public:
+  MmapSegment(uint32_t id, const std::filesystem::path& dir);
+
+  ~MmapSegment() override;
+
+  MmapSegment(const MmapSegment&) = delete;
+  MmapSegment& operator=(const MmapSegment&) = delete;
+
+  MmapSegment(MmapSegment&& segment);
+  MmapSegment& operator=(MmapSegment&& segment);
+
+  // Throws LogException as a sealed segment cannot be modified.
+  void Append(const std::vector<uint8_t>& data) override;
+
+  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+
+  std::optional<View> LookupView(uint32_t offset, uint32_t size) override;
+
+ private:
+  uint8_t* map_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,42 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace wombat::broker::log {
+
+// Offloader moves sealed segments to the cold store on a background thread
+// every interval, so moving large segments to a slow store never blocks the
+// log.
+class Offloader {
+ public:
+  // Runs offload on a background thread every interval.
+  Offloader(std::chrono::milliseconds interval,
+            std::function<void()> offload);
+
+  // Waits for any move in progress to complete.
+  ~Offloader();
+
+  Offloader(const Offloader&) = delete;
+  Offloader& operator=(const Offloader&) = delete;
+  Offloader(Offloader&&) = delete;
+  Offloader& operator=(Offloader&&) = delete;
+
+ private:
+  void Run();
+
+  std::chrono::milliseconds interval_;
+  std::function<void()> offload_;
+
+  std::mutex mut_;
+  std::condition_variable cv_;
+  bool running_;
+  std::thread thread_;
+};
+
+}  // namespace wombat::broker::log
@@ -3,33 +3,99 @@
 #pragma once
 
 #include <cstdint>
-#include <map>
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "log/segment.h"
 
 namespace wombat::broker::log {
 
+// Suffix added to the offsets segment name for the file recording the log
+// start offset.
+const std::string kStartSuffix = ".start";  // NOLINT
+
+// Offsets maps the offset of the start of each segment to the segments id.
+//
+// The entries are held in a contiguous array sorted by offset, and so by id
+// as ids increase with offset, so resolving an offset is a binary search and
+// stays fast as the number of segments grows.
+//
+// Files written before offsets were 64 bits store offsets as 32 bit integers.
+// They are upgraded on open by appending kWideMarker, after which offsets are
+// 64 bit integers, so the upgrade never rewrites existing entries.
 class Offsets {
  public:
-  explicit Offsets(std::shared_ptr<Segment> segment);
+  // Opens the offsets stored in segment. If given the log start offset is
+  // persisted in start.
+  explicit Offsets(std::shared_ptr<Segment> segment,
+                   std::shared_ptr<Segment> start = nullptr);
+
+  // Returns the offset of the first segment in the log. Segments before the
+  // start have been removed by retention.
+  uint64_t start() const { return start_; }
+
+  // Looks up the id and starting offset of the segment containing offset.
+  // Returns false if offset is before the first segment.
+  bool Lookup(uint64_t offset, uint32_t* id, uint64_t* start) const;
+
+  uint64_t MaxOffset() const;
 
-  bool Lookup(uint32_t offset, uint32_t* id, uint32_t* start);
+  // Looks up the offset of the start of the segment with the given id.
+  // Returns false if the id is not found.
+  bool Start(uint32_t id, uint64_t* start) const;
 
-  uint32_t MaxOffset();
+  // Adds a segment starting at offset, which must follow the existing
+  // segments. The entry is persisted with a single append.
+  void Insert(uint64_t offset, uint32_t id);
 
-  void Insert(uint32_t offset, uint32_t id);
+  // Removes the segments before offset, which must be the start of a segment.
+  // The new start is synced to disk before returning, as the removed
+  // segments are deleted after.
+  void Truncate(uint64_t offset);
+
+  // Syncs the offsets to disk.
+  void Sync();
 
  private:
-  bool LoadOffset(uint32_t offset);
+  struct Entry {
+    uint64_t offset;
+    uint32_t id;
+  };
+
+  // Marks the end of the 32 bit entries in a file.
+  static constexpr uint32_t kWideMarker = 0xffffffff;
+
+  void LoadOffsets();
 
-  void WriteU32(uint32_t n);
+  void LoadStart();
 
-  bool ReadU32(uint32_t offset, uint32_t* n);
+  // Removes the entries of segments starting before offset.
+  void EraseBefore(uint64_t offset);
 
-  std::map<uint32_t, uint32_t> offsets_;
+  // Reads the entries in segment with a single read, each an offset followed
+  // by suffix bytes, calling fn with each offset and its suffix. Discards any
+  // partially written entry and upgrades the file to 64 bit offsets.
+  static void Load(Segment* segment, uint32_t suffix,
+                   const std::function<void(uint64_t, const uint8_t*)>& fn);
+
+  static void EncodeU32(uint32_t n, std::vector<uint8_t>* enc);
+
+  static void EncodeU64(uint64_t n, std::vector<uint8_t>* enc);
+
+  static uint32_t DecodeU32(const uint8_t* enc);
+
+  static uint64_t DecodeU64(const uint8_t* enc);
+
+  // Sorted by offset.
+  std::vector<Entry> entries_;
 
   std::shared_ptr<Segment> segment_;
+
+  std::shared_ptr<Segment> start_segment_;
+
+  uint64_t start_;
 };
 
 }  // namespace wombat::broker::log
@@ -0,0 +1,163 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace wombat::broker::log {
+
+class ColdStore;
+class SegmentCache;
+
+// Durability determines when appended data is synced to disk.
+enum class Durability {
+  // Never sync, leaving write back to the kernel. Data is considered flushed
+  // once appended.
+  kNone,
+  // Sync every flush_interval_ms or flush_interval_bytes, whichever is first.
+  kInterval,
+  // Sync as soon as data is appended, batching appends that arrive while a
+  // sync is in progress into the next sync.
+  kGroupCommit
+};
+
+// Engine determines how segment I/O is performed.
+enum class Engine {
+  // Blocking system calls on the thread using the log.
+  kSystem,
+  // Appends and lookups are submitted asynchronously with io_uring and
+  // complete when the log is polled, so the thread using the log never blocks
+  // on disk. Falls back to kSystem if io_uring is not supported.
+  kUring
+};
+
+// Options configures a SystemLog.
+struct Options {
+  // Maximum size of a segment in bytes before a new segment is opened.
+  uint32_t segment_limit = 128'000'000;
+
+  // If true sealed segments are memory-mapped read-only so lookups are served
+  // from the mapping without system calls.
+  bool mmap_sealed = false;
+
+  // If true the next segment is created in the background ahead of the roll
+  // and segments have disk space allocated up to segment_limit, so rolling
+  // does not block appends and appends do not allocate blocks.
+  bool preallocate = false;
+
+  // Maximum number of sealed segments kept open for lookups. The active
+  // segment is always open.
+  uint32_t open_segments = 64;
+
+  // Maximum number of checksum files of sealed segments kept open for
+  // verifying records, cached separately from the segments.
+  uint32_t open_checksum_files = 64;
+
+  // If set the cache of open segments to use, which may be shared by multiple
+  // logs, otherwise each log has its own cache of open_segments.
+  std::shared_ptr<SegmentCache> segment_cache;
+
+  // Number of bytes between entries in each segments record index.
+  uint32_t index_interval = 4096;
+
+  // Resolution of the timestamps appends are stamped with in each segments
+  // time index, which holds at most one entry per resolution.
+  uint32_t timestamp_resolution_ms = 10;
+
+  // If non-zero appends to the active segment are buffered until this many
+  // bytes are buffered or the oldest append has been buffered for
+  // append_linger_ms, then written with a single system call.
+  uint32_t append_buffer_bytes = 0;
+  uint32_t append_linger_ms = 5;
+
+  // If true the active segment is written with O_DIRECT, bypassing the page
+  // cache, for logs whose data is rarely read once written (see
+  // DirectSegment). Appends are staged in a buffer of direct_buffer_bytes and
+  // written in whole blocks, and the partial block following them is written
+  // once staged for append_linger_ms. Replaces append_buffer_bytes, and is
+  // ignored with Engine::kUring.
+  bool direct_io = false;
+  uint32_t direct_buffer_bytes = 1024 * 1024;
+
+  // Number of bytes a LogReader reads from a segment at a time.
+  uint32_t reader_block_bytes = 64 * 1024;
+
+  // If non-zero the log gives the kernel hints so the page cache holds the
+  // data consumers read next rather than data just written: consumers
+  // reading sealed segments in order have readahead_bytes ahead of them read
+  // into the page cache (see Readahead), sealed segments are dropped from the
+  // page cache once flushed unless a consumer is still reading them, and the
+  // last readahead_bytes of the active segment are read into the page cache
+  // when the log is opened.
+  uint32_t readahead_bytes = 0;
+
+  // If non-zero the most recently appended tail_cache_bytes of the log are
+  // kept in memory, so consumers reading near the end of the log are served
+  // without reading the segments.
+  uint32_t tail_cache_bytes = 0;
+
+  Engine engine = Engine::kSystem;
+
+  // Maximum number of I/O operations in flight with Engine::kUring. Appends
+  // are not buffered with Engine::kUring as each is submitted asynchronously.
+  uint32_t uring_entries = 256;
+
+  // Retention deletes the oldest sealed segments once the log would still
+  // hold retention_bytes without them, or once they were last appended to
+  // more than retention_ms ago. Zero disables each policy.
+  uint64_t retention_bytes = 0;
+  uint64_t retention_ms = 0;
+
+  // Interval between checks for segments to delete.
+  uint32_t retention_check_ms = 1000;
+
+  // If true the sealed segments of logs of keyed record batches are compacted
+  // on a background thread every compaction_interval_ms, keeping only the
+  // latest record of each key (see Compactor). Tombstones are also removed
+  // once their segment was last appended to more than
+  // compaction_tombstone_ms ago, so consumers have time to see the delete.
+  bool compaction = false;
+  uint32_t compaction_interval_ms = 60'000;
+  uint64_t compaction_tombstone_ms = 86'400'000;
+
+  // If true sealed segments are compressed on a background thread every
+  // compression_interval_ms, in blocks of compression_block_bytes that are
+  // each compressed independently so lookups only decompress the blocks they
+  // read (see CompressedSegment). Each open compressed segment keeps its
+  // compression_cache_blocks most recently read blocks decompressed.
+  bool compression = false;
+  uint32_t compression_interval_ms = 60'000;
+  uint32_t compression_block_bytes = 64 * 1024;
+  uint32_t compression_cache_blocks = 4;
+
+  // If set sealed segments last appended to more than cold_after_ms ago are
+  // moved to the cold store, checking every cold_interval_ms, so local disk
+  // only holds recent segments and the indexes of every segment. Reads of
+  // moved segments fetch the whole segment into a local cache holding up to
+  // cold_cache_bytes of segments, exceeded only by segments still open. Each
+  // log must have its own store.
+  std::shared_ptr<ColdStore> cold_store;
+  uint64_t cold_after_ms = 86'400'000;
+  uint32_t cold_interval_ms = 60'000;
+  uint64_t cold_cache_bytes = 1'000'000'000;
+
+  // Minimum interval between deleting files, so deleting many large segments
+  // does not cause an I/O spike.
+  uint32_t delete_interval_ms = 100;
+
+  // Interval between checkpoints of the active segment, so reopening the log
+  // only recovers data appended since the last checkpoint. A checkpoint is
+  // also written when the log is closed. Checkpoints are written by the
+  // flusher once the data they cover is flushed, so never force a sync.
+  // Zero disables periodic checkpoints.
+  uint32_t checkpoint_interval_ms = 10'000;
+
+  Durability durability = Durability::kNone;
+
+  // Maximum time and number of bytes between syncs with Durability::kInterval.
+  uint32_t flush_interval_ms = 1000;
+  uint32_t flush_interval_bytes = 1'000'000;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,61 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace wombat::broker::log {
+
+// Readahead detects sequential streams of lookups in a log, such as
+// consumers reading records in order, so the data ahead of each stream is
+// read into the page cache before it is looked up.
+//
+// A lookup continues a stream if it starts within the previous lookup of the
+// stream, so looking up the size of a record then the record is one stream.
+// A stream is sequential once a lookup moves forward. Up to kStreams streams
+// are tracked, replacing the least recently continued stream.
+//
+// Lookups may run concurrently.
+class Readahead {
+ public:
+  static constexpr size_t kStreams = 16;
+
+  // Reads ahead window bytes of each sequential stream. Streams not
+  // continued for idle are no longer considered reading.
+  explicit Readahead(uint32_t window, std::chrono::milliseconds idle =
+                                          std::chrono::seconds{10});
+
+  // Records a lookup of size bytes at offset. Returns true if the data from
+  // offset from for size ahead bytes should be read ahead, which is once a
+  // sequential stream is within half a window of the data read ahead so
+  // lookups never wait for it.
+  bool Lookup(uint64_t offset, uint32_t size, uint64_t* from, uint32_t* ahead);
+
+  // Returns true if a sequential stream is reading between offsets start
+  // and end.
+  bool Reading(uint64_t start, uint64_t end) const;
+
+ private:
+  struct Stream {
+    // Offset of the last lookup and the end of the furthest lookup.
+    uint64_t offset;
+    uint64_t end;
+    // Offset up to which data was read ahead.
+    uint64_t ahead;
+    bool sequential;
+    std::chrono::steady_clock::time_point used;
+  };
+
+  uint32_t window_;
+
+  std::chrono::milliseconds idle_;
+
+  mutable std::mutex mutex_;
+
+  std::vector<Stream> streams_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,152 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// RecordBatch is a batch of records sharing one header, so small records are
+// stored with a few bytes of overhead rather than a header each. Batches are
+// encoded by the producer and appended, stored and served as a single unit,
+// so the broker never re-encodes the individual records.
+//
+// The encoding, with integers big endian, is:
+//
+//   u32 length           number of bytes following the length
+//   u64 base offset      offset of the batch in the log, set on append
+//   u32 crc              CRC32C of the bytes following the crc
+//   u16 attributes       compression in bits 0-2, keyed in bit 3, padding
+//                        in bit 4, other bits are zero
+//   u32 count            number of records
+//   u64 first timestamp  earliest record timestamp, in ms since the epoch
+//   u64 max timestamp    latest record timestamp
+//   records
+//
+// Each record is encoded as an unsigned varint timestamp delta from the
+// first timestamp, an unsigned varint size, then the record data.
+//
+// Records of keyed batches are instead encoded as the timestamp delta, an
+// unsigned varint key size, the key, an unsigned varint of the value size plus
+// one, then the value. A value size of zero marks a tombstone, which deletes
+// the key, so compaction can remove every earlier record with the key.
+//
+// Compaction replaces the records it removes with padding, so the records
+// kept stay at the same offsets. Padding is a batch with no records whose
+// length covers the removed records but only its header is stored, so its CRC
+// only covers the header. Consumers skip padding using its length.
+//
+// The length prefix doubles as the record size prefix of the log, so a batch
+// is a single record to the log. The base offset is excluded from the CRC so
+// the broker can set it without re-encoding the batch.
+class RecordBatch {
+ public:
+  // Record is a decoded record. Records of batches that are not keyed have no
+  // key.
+  struct Record {
+    uint64_t timestamp;
+    std::optional<View> key;
+    // Unset if the record is a tombstone.
+    std::optional<View> value;
+  };
+
+  struct Header {
+    uint32_t length;
+    uint64_t base_offset;
+    uint32_t crc;
+    uint16_t attributes;
+    uint32_t count;
+    uint64_t first_timestamp;
+    uint64_t max_timestamp;
+  };
+
+  // Builder encodes records into a batch.
+  class Builder {
+   public:
+    Builder();
+
+    bool empty() const { return records_.empty(); }
+
+    // Returns the size of the batch if built now.
+    uint32_t size() const;
+
+    // Adds a record to a batch that is not keyed. Throws
+    // std::invalid_argument if keyed records were added.
+    void Add(uint64_t timestamp, const std::vector<uint8_t>& data);
+
+    // Adds a keyed record, or a tombstone if value is unset. Throws
+    // std::invalid_argument if records that are not keyed were added.
+    void Add(uint64_t timestamp, const std::vector<uint8_t>& key,
+             const std::optional<std::vector<uint8_t>>& value);
+
+    std::vector<uint8_t> Build() const;
+
+   private:
+    struct Record {
+      uint64_t timestamp;
+      std::vector<uint8_t> key;
+      std::optional<std::vector<uint8_t>> value;
+    };
+
+    std::vector<Record> records_;
+
+    // Set once a record is added.
+    std::optional<bool> keyed_;
+
+    uint64_t first_timestamp_;
+    uint64_t max_timestamp_;
+  };
+
+  static constexpr uint32_t kHeaderSize = 38;
+
+  static constexpr uint16_t kCompressionMask = 0x7;
+  static constexpr uint16_t kKeyedAttribute = 1 << 3;
+  static constexpr uint16_t kPaddingAttribute = 1 << 4;
+
+  // Parses the header of the encoded batch. Returns nullopt if enc is not a
+  // complete batch, where the header alone is a complete padding batch. The
+  // batch must outlive the parsed RecordBatch.
+  static std::optional<RecordBatch> Parse(View enc);
+
+  // Encodes the header of padding with the given base offset covering size
+  // bytes, including its length prefix. The size must be at least
+  // kHeaderSize.
+  static std::vector<uint8_t> Padding(uint64_t base_offset, uint32_t size);
+
+  const Header& header() const { return header_; }
+
+  bool keyed() const { return header_.attributes & kKeyedAttribute; }
+
+  bool padding() const { return header_.attributes & kPaddingAttribute; }
+
+  // Returns the encoded batch, which is only the header for padding.
+  View data() const { return enc_; }
+
+  // Returns true if the batch matches its CRC.
+  bool VerifyCrc() const;
+
+  // Returns true if the batch matches its CRC, has no unsupported attributes
+  // and its records are well formed and match the count. Padding is never
+  // valid as it is only written by compaction.
+  bool Validate() const;
+
+  // Calls fn with each record in order, stopping early if fn returns false.
+  // Returns false if the records are malformed.
+  bool ForEach(const std::function<bool(const Record& record)>& fn) const;
+
+  // Sets the base offset of the encoded batch in place.
+  static void SetBaseOffset(uint8_t* enc, uint64_t base_offset);
+
+ private:
+  RecordBatch(View enc, Header header);
+
+  View enc_;
+  Header header_;
+};
+
+}  // namespace wombat::broker::log
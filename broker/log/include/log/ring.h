@@ -0,0 +1,108 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace wombat::broker::log {
+
+// Ring submits file I/O asynchronously using io_uring.
+//
+// Operations are queued and submitted together on the next call to Poll,
+// which also runs the callbacks of completed operations. Callbacks are passed
+// the result of the operation, which is the number of bytes transferred or a
+// negative errno. Callbacks should record errors rather than throw, though if
+// one does throw the other completed callbacks still run and the first
+// exception is rethrown from Poll. Buffers passed to the ring must remain
+// valid until the operation completes.
+//
+// The ring is not thread safe so must only be used by the thread polling it.
+class Ring {
+ public:
+  using Callback = std::function<void(int32_t res)>;
+
+  // Creates a ring that can have up to entries operations in flight.
+  explicit Ring(uint32_t entries);
+
+  // Waits for operations in flight to complete without running their
+  // callbacks.
+  ~Ring();
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  Ring(Ring&&) = delete;
+  Ring& operator=(Ring&&) = delete;
+
+  // Returns true if the kernel supports the io_uring operations used.
+  static bool Supported();
+
+  // Returns the number of operations queued or submitted that have not yet
+  // completed.
+  uint32_t in_flight() const { return callbacks_.size(); }
+
+  void Write(int fd, const uint8_t* data, uint32_t size, uint64_t offset,
+             Callback callback);
+
+  void Read(int fd, uint8_t* data, uint32_t size, uint64_t offset,
+            Callback callback);
+
+  // Syncs the files data, as with fdatasync.
+  void Sync(int fd, Callback callback);
+
+  // Submits queued operations and runs the callbacks of completed operations.
+  // If wait is true and operations are in flight blocks until at least one
+  // completes.
+  void Poll(bool wait = false);
+
+  // Waits for all operations in flight to complete without running their
+  // callbacks.
+  void Drain();
+
+ private:
+  void Queue(uint8_t opcode, int fd, uint64_t addr, uint32_t len,
+             uint64_t offset, uint32_t flags, Callback callback);
+
+  // Submits queued operations, waiting for min_complete to complete.
+  void Enter(uint32_t min_complete);
+
+  // Removes completed operations and runs their callbacks if run is true.
+  void Reap(bool run);
+
+  int fd_;
+
+  uint32_t entries_;
+
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t* sq_mask_;
+  uint32_t* sq_array_;
+
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t* cq_mask_;
+  io_uring_cqe* cqes_;
+
+  // Number of queued operations not yet submitted.
+  uint32_t queued_;
+
+  uint64_t next_id_;
+
+  std::unordered_map<uint64_t, Callback> callbacks_;
+};
+
+}  // namespace wombat::broker::log
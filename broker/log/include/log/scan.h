@@ -0,0 +1,26 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// Records are stored prefixed by their size as a 32 bit big endian integer
+// (see frame::Record).
+constexpr uint32_t kRecordPrefixSize = 4;
+
+// Scans the complete records in segment between positions from and to, calling
+// fn with the position of each record and a view of the record (including its
+// size prefix). The view is only valid for the duration of the call.
+//
+// Scanning stops when fn returns false or the next record is incomplete.
+// Returns the position following the last record scanned.
+uint32_t ScanRecords(Segment* segment, uint32_t from, uint32_t to,
+                     const std::function<bool(uint32_t, View)>& fn);
+
+}  // namespace wombat::broker::log
@@ -2,10 +2,14 @@
 
 #pragma once
 
+#include <chrono>
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "log/view.h"
+
 namespace wombat::broker::log {
 
 constexpr int ID_PADDING = 20;
@@ -23,14 +27,61 @@ class Segment {
 
   uint32_t size() const { return size_; }
 
+  // Returns the number of bytes written to the file, which excludes appends
+  // still in the append buffer.
+  virtual uint32_t written() const { return size_ - buffer_.size(); }
+
+  int fd() const { return fd_; }
+
   bool is_full() const { return size_ >= limit_; }
 
-  void Append(const std::vector<uint8_t>& data);
+  // Buffers appends in memory until size bytes are buffered or the oldest
+  // buffered append is older than linger, then writes them with a single
+  // system call. Buffered appends are visible to lookups.
+  void EnableBuffering(uint32_t size, std::chrono::milliseconds linger);
 
-  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size);
+  virtual void Append(const std::vector<uint8_t>& data);
+
+  virtual std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size);
+
+  // Returns a view of the data at offset without copying, or nullopt if the
+  // segment cannot be viewed directly in which case Lookup must be used.
+  virtual std::optional<View> LookupView(uint32_t offset, uint32_t size);
 
   uint32_t Send(uint32_t offset, uint32_t size, int fd);
 
+  // Writes any buffered appends to the file.
+  virtual void Flush();
+
+  // Writes buffered appends if the oldest has been buffered for longer than
+  // the linger.
+  virtual void Poll();
+
+  // Allocates disk space for the segment up to its limit without changing its
+  // size, so appends do not need to allocate blocks.
+  void Preallocate();
+
+  // Truncates the segment to size bytes, discarding any data after it.
+  virtual void Truncate(uint32_t size);
+
+  // Syncs the segments data to disk. Only data written to the file is synced
+  // so buffered appends must be flushed first.
+  virtual void Sync();
+
+  // Hints that the size bytes at offset will be read soon, so the kernel
+  // reads them into the page cache in the background. Hints are ignored by
+  // segments without a file.
+  virtual void WillNeed(uint32_t offset, uint32_t size);
+
+  // Hints that the size bytes at offset will not be read soon, so their
+  // pages are dropped from the page cache. Pages not yet written back are
+  // kept.
+  virtual void DontNeed(uint32_t offset, uint32_t size);
+
+  // Hints that the segment will be read sequentially, which increases the
+  // kernels readahead for the file.
+  virtual void AdviseSequential();
+
  protected:
   Segment(const std::filesystem::path& path, uint32_t limit);
 
@@ -42,8 +93,23 @@ class Segment {
 
   int fd_;
 
- private:
   uint32_t limit_;
+
+  // Reads size bytes from the file at offset into data. Returns false if the
+  // file ends before size bytes are read.
+  bool Read(uint32_t offset, uint8_t* data, size_t size) const;
+
+ private:
+  // Writes size bytes to the end of the file.
+  void Write(const uint8_t* data, size_t size);
+
+  std::vector<uint8_t> buffer_;
+
+  uint32_t buffer_limit_;
+
+  std::chrono::milliseconds linger_;
+
+  std::chrono::steady_clock::time_point buffered_at_;
 };
 
 std::string IdToName(uint32_t id);
@@ -0,0 +1,87 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// SegmentCache is a bounded LRU cache of open segments, which limits the
+// number of file descriptors and mappings held by lookups of old segments.
+//
+// Segments are keyed by the log that owns them and their id, so a cache can
+// be shared by multiple logs. Evicting a segment only drops the caches
+// reference, so segments still in use stay open until released.
+//
+// The cache is thread safe.
+class SegmentCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+  };
+
+  // Creates a cache holding up to capacity segments.
+  explicit SegmentCache(uint32_t capacity);
+
+  SegmentCache(const SegmentCache&) = delete;
+  SegmentCache& operator=(const SegmentCache&) = delete;
+
+  SegmentCache(SegmentCache&&) = delete;
+  SegmentCache& operator=(SegmentCache&&) = delete;
+
+  uint32_t capacity() const { return capacity_; }
+
+  uint32_t size() const;
+
+  Stats stats() const;
+
+  // Returns the segment with the given id owned by log, or null if the
+  // segment is not cached.
+  std::shared_ptr<Segment> Lookup(const void* log, uint32_t id);
+
+  // Adds the segment, evicting the least recently used segment if the cache
+  // is full.
+  void Insert(const void* log, uint32_t id, std::shared_ptr<Segment> segment);
+
+  // Removes the segment if cached.
+  void Erase(const void* log, uint32_t id);
+
+  // Removes all segments owned by log.
+  void EraseAll(const void* log);
+
+ private:
+  using Key = std::pair<const void*, uint32_t>;
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return std::hash<const void*>{}(key.first) ^
+             (std::hash<uint32_t>{}(key.second) << 1);
+    }
+  };
+
+  using Entry = std::pair<Key, std::shared_ptr<Segment>>;
+
+  uint32_t capacity_;
+
+  mutable std::mutex mut_;
+
+  // Entries ordered from most to least recently used.
+  std::list<Entry> entries_;
+
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+
+  Stats stats_;
+};
+
+}  // namespace wombat::broker::log
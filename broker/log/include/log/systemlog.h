@@ -2,17 +2,40 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
-
 #include <filesystem>
+#include <future>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "log/checkpoint.h"
+#include "log/checksums.h"
+#include "log/cleaner.h"
+#include "log/coldcache.h"
+#include "log/compactor.h"
+#include "log/compressor.h"
+#include "log/flusher.h"
+#include "log/index.h"
 #include "log/log.h"
+#include "log/logreader.h"
+#include "log/offloader.h"
 #include "log/offsets.h"
+#include "log/options.h"
+#include "log/readahead.h"
+#include "log/ring.h"
+#include "log/segmentcache.h"
+#include "log/tailcache.h"
+#include "log/tiers.h"
+#include "log/timeindex.h"
+#include "log/view.h"
 
 namespace wombat::broker::log {
 
@@ -21,26 +44,403 @@ constexpr uint32_t OFFSET_SEGMENT_ID = 0;
 class SystemLog : public Log {
  public:
   explicit SystemLog(const std::filesystem::path& path,
-                     uint32_t segment_limit = 128'000'000);
+                     const Options& options = Options{});
+
+  // Writes any buffered or in flight appends before closing.
+  ~SystemLog() override;
+
+  uint64_t start() const override;
+
+  uint64_t flushed() const override { return flusher_->flushed(); }
 
-  ~SystemLog() override {}
+  bool WaitFlushed(uint64_t offset,
+                   std::chrono::milliseconds timeout) override;
 
   void Append(const std::vector<uint8_t>& data) override;
 
-  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+  std::vector<uint8_t> Lookup(uint64_t offset, uint32_t size) override;
+
+  void LookupAsync(uint64_t offset, uint32_t size,
+                   LookupCallback callback) override;
+
+  void Poll() override;
+
+  // Reads are concurrent except with Engine::kUring, as lookups are
+  // completed by Poll.
+  bool concurrent_reads() const override { return !ring_; }
+
+  uint32_t in_flight() const override {
+    return ring_ ? ring_->in_flight() : 0;
+  }
+
+  std::optional<View> LookupView(uint64_t offset, uint32_t size) override;
+
+  // Returns null with Engine::kUring, as readers read synchronously.
+  std::unique_ptr<LogReader> NewReader(uint64_t offset) override;
+
+  bool Seek(uint64_t ordinal, uint64_t* offset) override;
+
+  bool SeekTime(uint64_t timestamp, uint64_t* offset) override;
+
+  bool IsAligned(uint64_t offset) override;
+
+  bool Verify(uint64_t offset, View record) override;
+
+  // Compacts the sealed segments, if any segments were sealed since the last
+  // compaction, replacing each segment with records to remove. Segments still
+  // in the tail cache are not compacted as the cache serves the records as
+  // appended. Runs in the background if Options::compaction is set.
+  void Compact();
+
+  // Compresses the sealed segments that are not yet compressed, replacing
+  // each segment file with a compressed segment file. Runs in the background
+  // if Options::compression is set.
+  void Compress();
+
+  // Moves sealed segments last appended to more than Options::cold_after_ms
+  // ago to the cold store, oldest first, and removes segments deleted by
+  // retention from the store. Does nothing without Options::cold_store. Runs
+  // in the background if Options::cold_store is set.
+  void Offload();
+
+  // Returns the statistics of the open segment cache, which may be shared
+  // with other logs.
+  SegmentCache::Stats segment_cache_stats() const { return cache_->stats(); }
+
+  // Returns the statistics of the tail cache, which are zero if the tail
+  // cache is disabled.
+  TailCache::Stats tail_cache_stats() const {
+    return tail_cache_ ? tail_cache_->stats() : TailCache::Stats{};
+  }
+
+  // Returns the statistics of the cache of segments fetched from the cold
+  // store, which are zero without a cold store.
+  ColdCache::Stats cold_cache_stats() const {
+    return cold_cache_ ? cold_cache_->stats() : ColdCache::Stats{};
+  }
 
  private:
+  class Reader;
+
+  // A segment and its index, checksum and time index files created ahead of
+  // rolling to the segment.
+  struct Prepared {
+    std::shared_ptr<Segment> segment;
+    std::shared_ptr<Segment> index;
+    std::shared_ptr<Segment> checksums;
+    std::shared_ptr<Segment> time_index;
+  };
+
+  // The position of a sequential stream of verified records, so the next
+  // record of the stream is verified without resolving its ordinal from the
+  // index, using checksum entries read in blocks.
+  struct VerifyStream {
+    uint32_t id;
+    // Number of records in the segment before the next record.
+    uint32_t record;
+    // Checksum entries read starting from the entry of checksums_record.
+    std::vector<uint8_t> checksums;
+    uint32_t checksums_record;
+  };
+
+  // A sealed segment and the state needed to compact it.
+  struct Sealed {
+    uint32_t id;
+    uint64_t start;
+    std::shared_ptr<Segment> segment;
+    uint64_t base;
+    std::shared_ptr<TimeIndex> time_index;
+  };
+
   std::shared_ptr<Segment> LookupSegment(uint32_t id);
 
+  // Lazily loads the index for the segment with the given id, rebuilding any
+  // entries missing from the index file.
+  std::shared_ptr<Index> LookupIndex(uint32_t id);
+
+  // Looks up the index as above, though a sealed segment's index is loaded
+  // without holding lock, which is held shared on entry and return, so
+  // appends do not wait for the index file to be read. Returns null if the
+  // segment was deleted while the lock was released.
+  std::shared_ptr<Index> LookupIndex(uint32_t id,
+                                     std::shared_lock<std::shared_mutex>* lock);
+
+  // Loads the index for the segment with the given id from the index file,
+  // recovering records after from.
+  std::shared_ptr<Index> LoadIndex(uint32_t id, std::shared_ptr<Segment> file,
+                                   Index::Entry from = Index::Entry{0, 0});
+
+  std::shared_ptr<Segment> OpenIndexFile(uint32_t id) const;
+
+  // Lazily loads the time index for the segment with the given id.
+  std::shared_ptr<TimeIndex> LookupTimeIndex(uint32_t id);
+
+  // Loads the time index for the segment with the given id from the file.
+  std::shared_ptr<TimeIndex> LoadTimeIndex(uint32_t id,
+                                           std::shared_ptr<Segment> file);
+
+  std::shared_ptr<Segment> OpenTimeIndexFile(uint32_t id) const;
+
+  // Returns the checksums of the segment with the given id.
+  Checksums LookupChecksums(uint32_t id);
+
+  std::shared_ptr<Segment> OpenChecksumFile(uint32_t id) const;
+
+  // Removes and returns the verify stream whose next record is at offset in
+  // the segment with the given id, if any.
+  std::optional<VerifyStream> TakeVerifyStream(uint64_t offset, uint32_t id);
+
+  // Adds a verify stream whose next record is at offset, replacing an
+  // arbitrary stream if kVerifyStreams are tracked. The stream is discarded
+  // if a segment was compacted since compactions was read.
+  void AddVerifyStream(uint64_t offset, VerifyStream stream,
+                       uint64_t compactions);
+
+  // Discards any partially written data from the end of the active segment,
+  // or adds checksums to the segment if it was written before checksums were
+  // added. Only data after the checkpoint, if given, is verified.
+  void RecoverActiveSegment(bool has_checksums,
+                            const std::optional<Checkpoint>& checkpoint);
+
+  // Returns the checkpoint in the log directory if it matches the active
+  // segment.
+  std::optional<Checkpoint> LoadCheckpoint(bool has_checksums) const;
+
+  // Returns a checkpoint of the active segment if the checkpoint interval
+  // has passed.
+  std::optional<Checkpoint> MaybeCheckpoint();
+
+  // Returns a checkpoint covering the active segment, to be written by the
+  // flusher once the segment is flushed. Returns nullopt if appends to the
+  // active segment are still buffered or in flight.
+  std::optional<Checkpoint> CheckpointActive();
+
+  // Creates the segment with the given id and its index file, preallocating
+  // the segment if configured.
+  Prepared PrepareSegment(uint32_t id) const;
+
+  // Starts preparing the segment with the given id in the background if
+  // preallocation is enabled.
+  void PrepareNext(uint32_t id);
+
+  // Returns the segment prepared in the background, or prepares it now if
+  // there is none.
+  Prepared TakeNext(uint32_t id);
+
+  uint32_t FirstSegment();
+
+  // Deletes sealed segments expired by the retention policy, if the
+  // retention check interval has passed.
+  void Retain();
+
+  // Returns true if the sealed segment with the given id, which ends at end,
+  // is expired by the retention policy.
+  bool IsExpired(uint32_t id, uint64_t end) const;
+
+  // Sets modified to the time the segment with the given id was last
+  // appended to. Returns false if the segment file cannot be read.
+  bool LastModified(uint32_t id,
+                    std::chrono::system_clock::time_point* modified) const;
+
+  // Queues the files of the segments with the given ids to be deleted.
+  void DeleteSegments(const std::vector<uint32_t>& ids);
+
+  // Returns the segment with the given id if it is sealed and not deleted.
+  std::optional<Sealed> LookupSealed(uint32_t id);
+
+  // Writes the compacted segment and its index, checksum and time index files
+  // then replaces the segment files with them. Returns false if the segment
+  // has no records to remove.
+  bool CompactSegment(const Sealed& sealed, const Compactor::KeyMap& keys);
+
+  // Replaces the files of the segment with the given name with the compacted
+  // files written for it.
+  void SwapCompacted(const std::string& name);
+
+  // Finishes replacing segment files with compacted files if the log closed
+  // while replacing them, and removes any other compacted files.
+  void RecoverCompaction();
+
+  // Removes any compacted files written for the segment with the given name.
+  void RemoveCompacted(const std::string& name) const;
+
+  // Writes the compressed segment file for the sealed segment then replaces
+  // the segment file with it. Returns false if the segment was not replaced.
+  bool CompressSegment(const Sealed& sealed);
+
+  // Removes the segment files of segments whose compressed file is
+  // complete, in case the log closed while replacing them, and removes any
+  // partially written compressed files.
+  void RecoverCompression();
+
+  // Copies the data file of the sealed segment with the given id to the cold
+  // store then removes the local file. Returns false if the segment was
+  // deleted by retention while being copied.
+  bool OffloadSegment(uint32_t id,
+                      std::chrono::system_clock::time_point modified);
+
+  // Removes the local data files of segments moved to the cold store, in case
+  // the log closed before removing them.
+  void RecoverTiers();
+
+  // Returns the path of the file holding the data of the sealed segment with
+  // the given id, which is the compressed segment file if it exists.
+  std::filesystem::path SegmentPath(uint32_t id) const;
+
+  // Reads ahead of a lookup of size bytes at offset if it continues a
+  // sequential stream of lookups.
+  void ReadAhead(uint64_t offset, uint32_t size);
+
+  // Drops sealed segments from the page cache once flushed, unless a
+  // consumer is still reading them.
+  void DropSealed();
+
+  // Returns true if a reader or sequential stream of lookups is reading the
+  // segment with the given id, which spans offsets start to end.
+  bool IsReading(uint32_t id, uint64_t start, uint64_t end);
+
+  // Records a reader moving to or from the segment with the given id.
+  void AddReader(uint32_t id);
+  void RemoveReader(uint32_t id);
+
+  // Notifies the flusher of appends to segment once they are all written to
+  // the file.
+  void NotifyWritten(const std::shared_ptr<Segment>& segment);
+
+  // Syncs the log directory so newly created segments are durable.
+  void SyncDirectory() const;
+
+  std::shared_ptr<Segment> OpenSegment(uint32_t id) const;
+
+  // Opens the segment with the given id to append to.
+  std::shared_ptr<Segment> OpenActiveSegment(uint32_t id) const;
+
+  // Returns the id of the segment containing offset and sets position to the
+  // position of offset within that segment.
+  uint32_t ResolveSegment(uint64_t offset, uint32_t* position);
+
   Offsets offsets_;
 
   std::filesystem::path path_;
 
-  std::unordered_map<uint32_t, std::shared_ptr<Segment>> segments_;
+  // The ring used with Engine::kUring, otherwise null. Declared before the
+  // segments so it outlives them.
+  std::unique_ptr<Ring> ring_;
+
+  // The active segment is always open so is held outside the cache.
+  std::shared_ptr<Segment> active_segment_;
+
+  // Checksums of the active segment.
+  std::unique_ptr<Checksums> checksums_;
+
+  // Caches open segments.
+  std::shared_ptr<SegmentCache> cache_;
+
+  // Caches open checksum files of sealed segments, separately from the
+  // segments so verifying records never evicts segments.
+  SegmentCache checksum_files_;
+
+  // Recently appended records if Options::tail_cache_bytes is set, otherwise
+  // null.
+  std::unique_ptr<TailCache> tail_cache_;
+
+  // Guards the state of the log so lookups and readers may run on other
+  // threads concurrently with appends. Append and Poll hold it exclusively
+  // while lookups share it.
+  mutable std::shared_mutex mutex_;
+
+  // Guards indexes_ and time_indexes_ as lookups load indexes lazily while
+  // sharing mutex_. Entries are otherwise only added or removed while
+  // holding mutex_ exclusively.
+  std::mutex indexes_mutex_;
+
+  std::unordered_map<uint32_t, std::shared_ptr<Index>> indexes_;
+
+  std::unordered_map<uint32_t, std::shared_ptr<TimeIndex>> time_indexes_;
 
   uint32_t active_;
 
-  uint32_t segment_limit_;
+  // Timestamp of the latest append, so timestamps never decrease across
+  // segments.
+  uint64_t timestamp_;
+
+  // Offset up to which the flusher has been notified data is written.
+  uint64_t written_;
+
+  Options options_;
+
+  // The next segment being prepared in the background.
+  std::future<Prepared> next_;
+
+  std::chrono::steady_clock::time_point retention_checked_;
+
+  std::chrono::steady_clock::time_point checkpointed_;
+
+  // Detects sequential lookups if Options::readahead_bytes is set, otherwise
+  // null.
+  std::unique_ptr<Readahead> readahead_;
+
+  // Bounds the verify streams tracked as consumers may stop at any record.
+  static constexpr size_t kVerifyStreams = 64;
+
+  // Guards verify_streams_ as records are verified while sharing mutex_.
+  std::mutex verify_mutex_;
+
+  // Verify streams keyed by the offset of their next record.
+  std::unordered_map<uint64_t, VerifyStream> verify_streams_;
+
+  // Number of segments compacted, so state resolved before releasing mutex_
+  // is discarded if a segment was compacted meanwhile. Only modified holding
+  // both mutex_ exclusively and verify_mutex_, so may be read holding either.
+  uint64_t compactions_;
+
+  // Guards readers_ as readers move between segments while sharing mutex_.
+  std::mutex readers_mutex_;
+
+  // Number of readers reading each segment, excluding segments without
+  // readers.
+  std::unordered_map<uint32_t, uint32_t> readers_;
+
+  // Sealed segments not yet dropped from the page cache.
+  std::vector<uint32_t> undropped_;
+
+  // Lookups completed by the ring, whose callbacks run once Poll releases
+  // mutex_ as they may use the log. Only used with Engine::kUring so only by
+  // the polling thread.
+  std::vector<std::pair<LookupCallback, std::vector<uint8_t>>> completed_;
+
+  // Created when there are segments to delete.
+  std::unique_ptr<Cleaner> cleaner_;
+
+  // Serializes compactions, compressions and moves to the cold store, as each
+  // replaces segment files, and guards compacted_.
+  std::mutex compaction_mutex_;
+
+  // Segments before this id were sealed at the last compaction.
+  uint32_t compacted_;
+
+  // Records the segments moved to the cold store. Only modified holding both
+  // compaction_mutex_ and mutex_ exclusively, so may be read holding either.
+  std::unique_ptr<Tiers> tiers_;
+
+  // Created if Options::cold_store is set.
+  std::unique_ptr<ColdCache> cold_cache_;
+
+  // Declared after the segments so pending data is flushed before the
+  // segments close.
+  std::unique_ptr<Flusher> flusher_;
+
+  // Created if Options::compaction is set. Stopped first when the log is
+  // destroyed.
+  std::unique_ptr<Compactor> compactor_;
+
+  // Created if Options::compression is set. Stopped first when the log is
+  // destroyed.
+  std::unique_ptr<Compressor> compressor_;
+
+  // Created if Options::cold_store is set. Stopped first when the log is
+  // destroyed.
+  std::unique_ptr<Offloader> offloader_;
 };
 
 }  // namespace wombat::broker::log
@@ -13,6 +13,11 @@ class SystemSegment : public Segment {
  public:
   SystemSegment(uint32_t id, const std::filesystem::path& dir, uint32_t limit);
 
+  // Opens the file at path directly rather than the segment with an id. If
+  // create is false the file must already exist.
+  SystemSegment(const std::filesystem::path& path, uint32_t limit,
+                bool create = true);
+
   ~SystemSegment() override;
 
   SystemSegment(const SystemSegment&) = delete;
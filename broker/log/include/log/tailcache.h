@@ -0,0 +1,80 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// TailCache holds the most recently appended records of a log in a ring
+// buffer, so lookups near the end of the log, as made by consumers tailing
+// the log, are served from memory without system calls.
+//
+// The cache also records where each cached record starts so checking an
+// offset is aligned to a record does not scan the segment.
+//
+// Lookups may run concurrently with each other, though not with appends.
+class TailCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+  // Creates a cache holding up to capacity bytes of a log ending at end.
+  TailCache(uint32_t capacity, uint64_t end);
+
+  // Returns the lookups served by the cache and the lookups that had to read
+  // the segments. Views are only counted when served as a lookup that cannot
+  // be viewed falls back to copying.
+  Stats stats() const { return Stats{hits_, misses_}; }
+
+  // Returns the offset of the first cached byte.
+  uint64_t start() const { return end_ - size_; }
+
+  // Adds a record appended to the end of the log, evicting the oldest data
+  // once the cache is full.
+  void Append(const std::vector<uint8_t>& data);
+
+  // Returns a copy of size bytes at offset, or nullopt if not cached.
+  std::optional<std::vector<uint8_t>> Lookup(uint64_t offset, uint32_t size);
+
+  // Returns a view of size bytes at offset, valid until the next append, or
+  // nullopt if not cached or the data wraps around the end of the buffer.
+  std::optional<View> LookupView(uint64_t offset, uint32_t size);
+
+  // Sets aligned to true if a record starts at offset or offset is the end
+  // of the log. Returns false if offset is not cached.
+  bool IsAligned(uint64_t offset, bool* aligned) const;
+
+  // Sets valid to true if record matches the record appended at offset.
+  // Returns false if the record is not cached.
+  bool Verify(uint64_t offset, View record, bool* valid) const;
+
+ private:
+  bool Contains(uint64_t offset, uint32_t size) const;
+
+  // Copies size bytes at offset, which must be cached, to data.
+  void Copy(uint64_t offset, uint32_t size, uint8_t* data) const;
+
+  std::vector<uint8_t> buffer_;
+
+  // Offsets of the cached records, excluding a record partially evicted.
+  std::deque<uint64_t> records_;
+
+  // Offset of the end of the log and the number of bytes cached before it.
+  uint64_t end_;
+  uint32_t size_;
+
+  // Counted atomically as concurrent lookups update them.
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,84 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wombat::broker::log {
+
+// Name of the tiers file in the log directory.
+const std::string kTiersName = "tiers";  // NOLINT
+
+// Tiers records which sealed segments of a log were moved to its cold store,
+// in the file kTiersName in the log directory. Segments without an entry are
+// on local disk. Segments are moved oldest first so the entries are in id
+// order.
+//
+// The file is replaced atomically on each change, so a crash leaves either
+// the old or new entries.
+class Tiers {
+ public:
+  struct Entry {
+    uint32_t id;
+
+    // Size of the segment, and the ordinal and position following its last
+    // record, so the segment and its index are opened without fetching the
+    // segment from the store.
+    uint32_t size;
+    uint64_t ordinal;
+    uint32_t end;
+
+    // Time the segment was last appended to, in milliseconds since the Unix
+    // epoch, as the local segment file no longer exists.
+    uint64_t modified_ms;
+
+    // Set if the segment was compressed when moved.
+    bool compressed;
+
+    // Returns the name of the segment file in the cold store.
+    std::string name() const;
+
+    bool operator==(const Entry& entry) const;
+  };
+
+  // Loads the tiers file in the log directory dir, if it exists. Throws
+  // LogException if the file is corrupt, as the segments it records could
+  // not be found.
+  explicit Tiers(const std::filesystem::path& dir);
+
+  const std::vector<Entry>& entries() const { return entries_; }
+
+  // Returns the id following the last segment moved, or zero if none were
+  // moved.
+  uint32_t end() const;
+
+  // Sets entry to the entry of the segment with the given id. Returns false
+  // if the segment is on local disk.
+  bool Lookup(uint32_t id, Entry* entry) const;
+
+  // Records the segment was moved, which must follow the last segment moved.
+  void Add(const Entry& entry);
+
+  // Removes the entries of segments before id, which were deleted.
+  void Truncate(uint32_t id);
+
+  std::vector<uint8_t> Encode() const;
+
+  // Decodes the entries. Returns nullopt if the encoding is corrupt.
+  static std::optional<std::vector<Entry>> Decode(
+      const std::vector<uint8_t>& enc);
+
+ private:
+  // Atomically replaces the tiers file with the entries.
+  void Write() const;
+
+  std::filesystem::path dir_;
+
+  std::vector<Entry> entries_;
+};
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,74 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+// Suffix added to the segment name for the segments time index file.
+const std::string kTimeIndexSuffix = ".timeindex";  // NOLINT
+
+// TimeIndex maps the time appends were made to their position in a segment.
+//
+// Each append is stamped with a timestamp in milliseconds since the Unix
+// epoch, rounded down to a multiple of the resolution. An entry is added for
+// the first append with each timestamp, so the first append at or after a
+// time is found exactly while the index holds at most one entry per
+// resolution. Timestamps never decrease, so an append made after the clock
+// moves backwards has the timestamp of the previous append.
+class TimeIndex {
+ public:
+  // Opens the time index stored in the given segment.
+  TimeIndex(std::shared_ptr<Segment> segment, uint32_t resolution);
+
+  bool empty() const { return entries_.empty(); }
+
+  // Returns the timestamp of the latest append, or 0 if there are no
+  // appends.
+  uint64_t last() const { return empty() ? 0 : entries_.back().timestamp; }
+
+  // Stamps an append made at position in the segment with timestamp.
+  void Append(uint64_t timestamp, uint32_t position);
+
+  // Closes the index file once the segment is sealed, keeping only the
+  // entries in memory. Entries added once closed are not persisted.
+  void Close() { segment_ = nullptr; }
+
+  // Discards entries of appends that never reached the segment, where size
+  // is the size of the segment.
+  void Recover(uint32_t size);
+
+  // Sets position to the position of the first append stamped at or after
+  // timestamp. Returns false if every append is before timestamp.
+  bool Lookup(uint64_t timestamp, uint32_t* position) const;
+
+  // Calls fn with the timestamp and position of each entry in order.
+  void ForEach(
+      const std::function<void(uint64_t timestamp, uint32_t position)>& fn)
+      const;
+
+ private:
+  struct Entry {
+    uint64_t timestamp;
+    uint32_t position;
+  };
+
+  static constexpr uint32_t kEntrySize = 12;
+
+  void Load();
+
+  std::shared_ptr<Segment> segment_;
+
+  std::vector<Entry> entries_;
+
+  uint32_t resolution_;
+};
+
+}  // namespace wombat::broker::log
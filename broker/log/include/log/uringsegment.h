@@ -0,0 +1,77 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "log/ring.h"
+#include "log/systemsegment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+// UringSegment is an active segment whose appends are written asynchronously
+// through a Ring so appending never blocks on disk.
+//
+// Appends are copied and kept in memory until their write completes, so are
+// visible to lookups immediately. Writes complete when the ring is polled.
+//
+// A failed write is recorded rather than thrown from its completion, so the
+// other completions polled with it still run, and the segment is never
+// considered written past it. The error is then thrown from every later call
+// to Poll or Flush.
+class UringSegment : public SystemSegment {
+ public:
+  // The ring must outlive the segment.
+  UringSegment(uint32_t id, const std::filesystem::path& dir, uint32_t limit,
+               Ring* ring);
+
+  // Waits for appends in flight to be written.
+  ~UringSegment() override;
+
+  UringSegment(const UringSegment&) = delete;
+  UringSegment& operator=(const UringSegment&) = delete;
+
+  // Cannot move as writes in flight refer to the segment.
+  UringSegment(UringSegment&&) = delete;
+  UringSegment& operator=(UringSegment&&) = delete;
+
+  // Returns the offset up to which all appends have been written.
+  uint32_t written() const override;
+
+  void Append(const std::vector<uint8_t>& data) override;
+
+  std::vector<uint8_t> Lookup(uint32_t offset, uint32_t size) override;
+
+  std::optional<View> LookupView(uint32_t offset, uint32_t size) override;
+
+  // Waits for appends in flight to be written. Throws if a write failed.
+  void Flush() override;
+
+  // Writes complete when the ring is polled so only checks whether a write
+  // failed, throwing if so.
+  void Poll() override;
+
+ private:
+  // Submits the write of the append at position, done bytes of which have
+  // already been written.
+  void Submit(uint32_t position, uint32_t done);
+
+  void Complete(uint32_t position, uint32_t done, int32_t res);
+
+  Ring* ring_;
+
+  // Appends whose writes have not completed keyed by position.
+  std::map<uint32_t, std::vector<uint8_t>> in_flight_;
+
+  // The errno of the first failed write, or zero if no write failed, and the
+  // position of the earliest failed append.
+  int error_;
+  uint32_t failed_;
+};
+
+}  // namespace wombat::broker::log
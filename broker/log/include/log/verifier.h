@@ -0,0 +1,111 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "log/offsets.h"
+#include "log/options.h"
+#include "log/segment.h"
+#include "log/tiers.h"
+
+namespace wombat::broker::log {
+
+// Verifier checks every segment of a closed log, such as after an unclean
+// shutdown, and rebuilds the files derived from the segments.
+//
+// Each segment is scanned in large reads to check its records are framed and
+// match their checksums, and its record index and checksums are rebuilt if
+// missing or inconsistent with the records. If the offsets of the segments
+// were lost they are rebuilt from the segment files. Segments are verified in
+// parallel by a pool of threads, as the index of each segment only depends on
+// the number of records in the segments before it.
+//
+// The log must not be open while verifying.
+class Verifier {
+ public:
+  struct Result {
+    uint32_t id;
+
+    // Size of the segment and the number of complete records in it.
+    uint32_t bytes;
+    uint32_t records;
+
+    // Bytes following the last complete record, which are expected in the
+    // last segment after an unclean shutdown and truncated when the log is
+    // opened.
+    uint32_t partial;
+
+    // Number of records that do not match their checksum.
+    uint32_t corrupt;
+
+    // Set if the segment file is missing, or the segment does not start
+    // where the previous segment ends.
+    bool missing;
+    bool misplaced;
+
+    // Set if the record index or checksums of the segment were rebuilt.
+    bool rebuilt;
+
+    // Set if the segment was not verified, as it is in the cold store or is
+    // being replaced by compaction which completes when the log is opened.
+    bool skipped;
+
+    // Time taken to scan the segment.
+    std::chrono::microseconds elapsed;
+
+    // Returns the bytes scanned per second.
+    uint64_t throughput() const;
+  };
+
+  // Verifies the log in the directory path, which was written with the given
+  // options, using threads threads.
+  Verifier(const std::filesystem::path& path, const Options& options,
+           uint32_t threads);
+
+  // Verifies each segment, returning the result of each in order. Throws
+  // LogException if the log cannot be read.
+  std::vector<Result> Verify();
+
+  // Returns true if no segment is missing, misplaced or corrupt, or has
+  // partial records other than the last segment.
+  static bool Ok(const std::vector<Result>& results);
+
+ private:
+  // Scans the records of the segment, verifying them against its checksums
+  // and rebuilding the checksums if missing.
+  void Scan(const Tiers& tiers, Result* result) const;
+
+  // Recovers the record index of the segment, adding any missing entries.
+  // Returns the ordinal following the last record, or nullopt if the index
+  // is missing.
+  std::optional<uint64_t> RecoverIndex(const Tiers& tiers,
+                                       Result* result) const;
+
+  // Rebuilds the missing record index of the segment starting at base.
+  void RebuildIndex(uint64_t base, Result* result) const;
+
+  std::shared_ptr<Segment> OpenSegment(uint32_t id) const;
+
+  // Rebuilds the offsets of the segments from the segment files, if the log
+  // has segments but no offsets.
+  void RebuildOffsets(const Tiers& tiers, Offsets* offsets) const;
+
+  // Runs fn(i) for each i below n across the threads, rethrowing the first
+  // exception thrown once every thread completes.
+  void Parallel(size_t n, const std::function<void(size_t)>& fn) const;
+
+  std::filesystem::path path_;
+
+  Options options_;
+
+  uint32_t threads_;
+};
+
+}  // namespace wombat::broker::log
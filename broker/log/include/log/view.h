@@ -0,0 +1,22 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace wombat::broker::log {
+
+// View references a range of bytes owned by the log without copying. A view
+// is only valid until the next call to the log it was taken from, except a
+// view with an owner, which keeps the segment viewed open so stays valid
+// while the segment is not modified.
+struct View {
+  const uint8_t* data;
+  uint32_t size;
+  // Holds the segment viewed, if set, so the view stays valid when the
+  // segment is evicted from the segment cache or replaced.
+  std::shared_ptr<const void> owner;
+};
+
+}  // namespace wombat::broker::log
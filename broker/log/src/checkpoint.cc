@@ -0,0 +1,178 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/checkpoint.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/crc32c.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Format version of the checkpoint, written first so the format can change.
+constexpr uint32_t kVersion = 2;
+
+// Size of the encoded checkpoint, including the version and trailing
+// checksum.
+constexpr size_t kEncodedSize = 44;
+
+void EncodeU32(uint32_t n, std::vector<uint8_t>* enc) {
+  const uint32_t ordered = htonl(n);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&ordered);
+  enc->insert(enc->end(), data, data + sizeof(ordered));
+}
+
+void EncodeU64(uint64_t n, std::vector<uint8_t>* enc) {
+  EncodeU32(n >> 32, enc);
+  EncodeU32(n, enc);
+}
+
+uint32_t DecodeU32(const uint8_t* enc) {
+  uint32_t n;
+  std::memcpy(&n, enc, sizeof(n));
+  return ntohl(n);
+}
+
+uint64_t DecodeU64(const uint8_t* enc) {
+  return (static_cast<uint64_t>(DecodeU32(enc)) << 32) | DecodeU32(enc + 4);
+}
+
+// Writes all of data to fd, retrying short writes.
+void WriteAll(int fd, const std::vector<uint8_t>& data) {
+  size_t n = 0;
+  while (n != data.size()) {
+    const ssize_t res = write(fd, data.data() + n, data.size() - n);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw LogException{"checkpoint write failed", errno};
+    }
+    n += res;
+  }
+}
+
+void SyncDirectory(const std::filesystem::path& dir) {
+  const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd == -1) {
+    throw LogException{"failed to open log directory", errno};
+  }
+  const int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw LogException{"log directory fsync failed", errno};
+  }
+}
+
+}  // namespace
+
+std::vector<uint8_t> Checkpoint::Encode() const {
+  std::vector<uint8_t> enc{};
+  enc.reserve(kEncodedSize);
+  EncodeU32(kVersion, &enc);
+  EncodeU32(active, &enc);
+  EncodeU64(active_start, &enc);
+  EncodeU64(end, &enc);
+  EncodeU32(position, &enc);
+  EncodeU32(checksums, &enc);
+  EncodeU64(ordinal, &enc);
+  EncodeU32(Crc32c(enc.data(), enc.size()), &enc);
+  return enc;
+}
+
+std::optional<Checkpoint> Checkpoint::Decode(const std::vector<uint8_t>& enc) {
+  if (enc.size() != kEncodedSize) {
+    return std::nullopt;
+  }
+  const size_t body = kEncodedSize - sizeof(uint32_t);
+  if (DecodeU32(enc.data() + body) != Crc32c(enc.data(), body) ||
+      DecodeU32(enc.data()) != kVersion) {
+    return std::nullopt;
+  }
+
+  Checkpoint checkpoint;
+  checkpoint.active = DecodeU32(enc.data() + 4);
+  checkpoint.active_start = DecodeU64(enc.data() + 8);
+  checkpoint.end = DecodeU64(enc.data() + 16);
+  checkpoint.position = DecodeU32(enc.data() + 24);
+  checkpoint.checksums = DecodeU32(enc.data() + 28);
+  checkpoint.ordinal = DecodeU64(enc.data() + 32);
+  return checkpoint;
+}
+
+void Checkpoint::Write(const std::filesystem::path& dir, bool sync) const {
+  const std::filesystem::path path = dir / kCheckpointName;
+  const std::filesystem::path tmp = dir / (kCheckpointName + ".tmp");
+
+  const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    throw LogException{"failed to open checkpoint", errno};
+  }
+  try {
+    WriteAll(fd, Encode());
+  } catch (const LogException& e) {
+    close(fd);
+    throw;
+  }
+  const int res = sync ? fsync(fd) : 0;
+  close(fd);
+  if (res == -1) {
+    throw LogException{"checkpoint fsync failed", errno};
+  }
+
+  if (rename(tmp.c_str(), path.c_str()) == -1) {
+    throw LogException{"checkpoint rename failed", errno};
+  }
+  if (sync) {
+    SyncDirectory(dir);
+  }
+}
+
+std::optional<Checkpoint> Checkpoint::Read(const std::filesystem::path& dir) {
+  const std::filesystem::path path = dir / kCheckpointName;
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    if (errno != ENOENT) {
+      LOG(WARNING) << "failed to open checkpoint: " << std::strerror(errno);
+    }
+    return std::nullopt;
+  }
+
+  // Read one byte more than a checkpoint to detect trailing data.
+  std::vector<uint8_t> enc(kEncodedSize + 1);
+  size_t n = 0;
+  while (n != enc.size()) {
+    const ssize_t res = read(fd, enc.data() + n, enc.size() - n);
+    if (res == -1 && errno == EINTR) continue;
+    if (res <= 0) break;
+    n += res;
+  }
+  close(fd);
+  enc.resize(n);
+
+  std::optional<Checkpoint> checkpoint = Decode(enc);
+  if (!checkpoint) {
+    LOG(WARNING) << "ignoring corrupt checkpoint " << path;
+  }
+  return checkpoint;
+}
+
+bool Checkpoint::operator==(const Checkpoint& checkpoint) const {
+  return active == checkpoint.active &&
+         active_start == checkpoint.active_start && end == checkpoint.end &&
+         position == checkpoint.position &&
+         checksums == checkpoint.checksums && ordinal == checkpoint.ordinal;
+}
+
+}  // namespace wombat::broker::log
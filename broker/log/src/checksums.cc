@@ -0,0 +1,128 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/checksums.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "log/crc32c.h"
+#include "log/scan.h"
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Number of bytes read from the segment at a time when recovering.
+constexpr uint32_t kReadChunkSize = 64 * 1024;
+
+}  // namespace
+
+Checksums::Checksums(std::shared_ptr<Segment> file) : file_{std::move(file)} {}
+
+void Checksums::Append(const uint8_t* data, uint32_t size) {
+  const uint32_t enc[] = {htonl(size), htonl(Crc32c(data, size))};
+  const uint8_t* entry = reinterpret_cast<const uint8_t*>(enc);
+  file_->Append(std::vector<uint8_t>(entry, entry + kEntrySize));
+}
+
+bool Checksums::Verify(uint32_t n, View data) const {
+  if (n >= size()) {
+    return true;
+  }
+
+  const std::vector<uint8_t> enc = Read(n, 1);
+  return enc.size() == kEntrySize && Matches(enc.data(), data);
+}
+
+std::vector<uint8_t> Checksums::Read(uint32_t n, uint32_t count) const {
+  if (n >= size()) {
+    return {};
+  }
+  count = std::min(count, size() - n);
+  return file_->Lookup(n * kEntrySize, count * kEntrySize);
+}
+
+bool Checksums::Matches(const uint8_t* entry, View data) {
+  uint32_t enc[2];
+  std::memcpy(enc, entry, kEntrySize);
+  return ntohl(enc[0]) == data.size &&
+         ntohl(enc[1]) == Crc32c(data.data, data.size);
+}
+
+uint32_t Checksums::Recover(Segment* segment, uint32_t verified,
+                            uint32_t position) {
+  const uint32_t n = size();
+  if (verified > n || position > segment->size()) {
+    verified = 0;
+    position = 0;
+  }
+  const std::vector<uint8_t> enc =
+      file_->Lookup(verified * kEntrySize, (n - verified) * kEntrySize);
+
+  uint32_t valid = verified;
+  while (valid != n) {
+    uint32_t entry[2];
+    std::memcpy(entry, enc.data() + (valid - verified) * kEntrySize,
+                kEntrySize);
+    const uint32_t size = ntohl(entry[0]);
+    // Compare without adding to the position as a corrupt size may overflow.
+    if (size > segment->size() - position ||
+        Checksum(segment, position, size) != ntohl(entry[1])) {
+      break;
+    }
+    position += size;
+    ++valid;
+  }
+
+  if (file_->size() != valid * kEntrySize) {
+    file_->Truncate(valid * kEntrySize);
+  }
+  const uint32_t truncated = segment->size() - position;
+  if (truncated != 0) {
+    segment->Truncate(position);
+  }
+  return truncated;
+}
+
+void Checksums::Rebuild(Segment* segment) {
+  const uint32_t end = ScanRecords(segment, 0, segment->size(),
+                                   [this](uint32_t, View record) {
+                                     Append(record.data, record.size);
+                                     return true;
+                                   });
+  // Any data following the last complete record is kept as a single append.
+  if (end != segment->size()) {
+    const std::vector<uint8_t> data =
+        segment->Lookup(end, segment->size() - end);
+    Append(data.data(), data.size());
+  }
+}
+
+uint32_t Checksums::Checksum(Segment* segment, uint32_t position,
+                             uint32_t size) {
+  uint32_t crc = 0;
+  uint32_t n = 0;
+  while (n != size) {
+    const uint32_t len = std::min(kReadChunkSize, size - n);
+    const std::optional<View> view = segment->LookupView(position + n, len);
+    if (view) {
+      crc = Crc32c(view->data, view->size, crc);
+    } else {
+      const std::vector<uint8_t> data = segment->Lookup(position + n, len);
+      crc = Crc32c(data.data(), data.size(), crc);
+    }
+    n += len;
+  }
+  return crc;
+}
+
+}  // namespace wombat::broker::log
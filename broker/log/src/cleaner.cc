@@ -0,0 +1,76 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/cleaner.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace wombat::broker::log {
+
+Cleaner::Cleaner(std::chrono::milliseconds interval)
+    : interval_{interval}, pending_{}, running_{true} {
+  thread_ = std::thread{&Cleaner::Run, this};
+}
+
+Cleaner::~Cleaner() {
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+uint32_t Cleaner::pending() const {
+  std::lock_guard<std::mutex> lk(mut_);
+  return pending_.size();
+}
+
+void Cleaner::Delete(const std::vector<std::filesystem::path>& paths) {
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    pending_.insert(pending_.end(), paths.begin(), paths.end());
+  }
+  cv_.notify_one();
+}
+
+void Cleaner::Run() {
+  std::unique_lock<std::mutex> lk(mut_);
+  while (running_) {
+    cv_.wait(lk, [this] { return !running_ || !pending_.empty(); });
+    if (!running_) break;
+
+    const std::filesystem::path path = pending_.front();
+    Unlink(path, &lk);
+    // Wait for the interval before the next delete unless shutting down.
+    cv_.wait_for(lk, interval_, [this] { return !running_; });
+  }
+
+  // Delete any remaining files on shutdown so they are not left behind.
+  while (!pending_.empty()) {
+    const std::filesystem::path path = pending_.front();
+    Unlink(path, &lk);
+  }
+}
+
+void Cleaner::Unlink(const std::filesystem::path& path,
+                     std::unique_lock<std::mutex>* lk) {
+  lk->unlock();
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  if (ec) {
+    LOG(ERROR) << "failed to delete " << path << ": " << ec.message();
+  }
+  lk->lock();
+  // Only remove once deleted so pending includes files being deleted.
+  pending_.pop_front();
+}
+
+}  // namespace wombat::broker::log
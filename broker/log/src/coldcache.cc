@@ -0,0 +1,142 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/coldcache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "glog/logging.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+ColdCache::ColdCache(std::shared_ptr<ColdStore> store,
+                     const std::filesystem::path& path, uint64_t limit)
+    : store_{std::move(store)},
+      path_{path},
+      limit_{limit},
+      fetched_{},
+      fetching_{},
+      files_{},
+      size_{0},
+      stats_{} {
+  std::error_code ec;
+  std::filesystem::remove_all(path_, ec);
+  std::filesystem::create_directories(path_, ec);
+  if (ec) {
+    throw LogException{"failed to create cold cache directory", ec.value()};
+  }
+}
+
+std::shared_ptr<Segment> ColdCache::Fetch(const std::string& name,
+                                          const Open& open) {
+  std::unique_lock lock{mutex_};
+  fetched_.wait(lock, [&] { return fetching_.count(name) == 0; });
+
+  const std::filesystem::path path = path_ / name;
+  for (auto it = files_.begin(); it != files_.end(); ++it) {
+    if (it->name == name) {
+      files_.splice(files_.begin(), files_, it);
+      ++stats_.hits;
+      std::shared_ptr<Segment> segment = it->segment.lock();
+      if (!segment) {
+        segment = open(path);
+        it->segment = segment;
+      }
+      return segment;
+    }
+  }
+
+  // The file is copied without holding the lock, as the copy is of a whole
+  // segment.
+  ++stats_.misses;
+  fetching_.insert(name);
+  lock.unlock();
+  bool found;
+  uint64_t size = 0;
+  try {
+    found = store_->Get(name, path);
+    if (found) {
+      std::error_code ec;
+      size = std::filesystem::file_size(path, ec);
+      if (ec) {
+        throw LogException{"failed to stat cold cache file", ec.value()};
+      }
+    }
+  } catch (const LogException& e) {
+    // Note LogException logs the error.
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    lock.lock();
+    fetching_.erase(name);
+    fetched_.notify_all();
+    throw;
+  }
+  lock.lock();
+  fetching_.erase(name);
+  fetched_.notify_all();
+  if (!found) {
+    return nullptr;
+  }
+
+  // The file is cached before it is opened so it is evicted even if opening
+  // fails.
+  files_.push_front(File{name, size, {}});
+  size_ += size;
+  std::shared_ptr<Segment> segment = open(path);
+  files_.front().segment = segment;
+  Evict();
+  return segment;
+}
+
+void ColdCache::Erase(const std::string& name) {
+  std::lock_guard lock{mutex_};
+  for (auto it = files_.begin(); it != files_.end(); ++it) {
+    if (it->name == name) {
+      std::error_code ec;
+      std::filesystem::remove(path_ / name, ec);
+      size_ -= it->size;
+      files_.erase(it);
+      return;
+    }
+  }
+}
+
+uint64_t ColdCache::size() const {
+  std::lock_guard lock{mutex_};
+  return size_;
+}
+
+ColdCache::Stats ColdCache::stats() const {
+  std::lock_guard lock{mutex_};
+  return stats_;
+}
+
+void ColdCache::Evict() {
+  // Files still open are skipped, as deleting them would not free the disk
+  // space until their segment is closed.
+  auto it = files_.end();
+  while (size_ > limit_ && std::prev(it) != files_.begin()) {
+    --it;
+    if (!it->segment.expired()) {
+      continue;
+    }
+    std::error_code ec;
+    std::filesystem::remove(path_ / it->name, ec);
+    if (ec) {
+      LOG(ERROR) << "failed to delete cold cache file " << it->name << ": "
+                 << ec.message();
+    }
+    size_ -= it->size;
+    it = files_.erase(it);
+    ++stats_.evictions;
+  }
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,73 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/coldsegment.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+ColdSegment::ColdSegment(uint32_t size,
+                         std::function<std::shared_ptr<Segment>()> open)
+    : Segment{"", size}, open_{std::move(open)}, segment_{} {
+  fd_ = -1;
+  size_ = size;
+}
+
+void ColdSegment::Append(const std::vector<uint8_t>& data) {
+  throw LogException{"cannot append to sealed segment"};
+}
+
+std::vector<uint8_t> ColdSegment::Lookup(uint32_t offset, uint32_t size) {
+  // Reads past the end of the segment return nothing without fetching it.
+  if (offset > size_ || size > size_ - offset) {
+    return {};
+  }
+  return Open()->Lookup(offset, size);
+}
+
+std::optional<View> ColdSegment::LookupView(uint32_t offset, uint32_t size) {
+  if (offset > size_ || size > size_ - offset) {
+    return std::nullopt;
+  }
+  // Views stay valid while this segment holds the opened segment.
+  return Open()->LookupView(offset, size);
+}
+
+void ColdSegment::WillNeed(uint32_t offset, uint32_t size) {
+  std::lock_guard lock{mutex_};
+  if (segment_) {
+    segment_->WillNeed(offset, size);
+  }
+}
+
+void ColdSegment::DontNeed(uint32_t offset, uint32_t size) {
+  std::lock_guard lock{mutex_};
+  if (segment_) {
+    segment_->DontNeed(offset, size);
+  }
+}
+
+void ColdSegment::AdviseSequential() {
+  std::lock_guard lock{mutex_};
+  if (segment_) {
+    segment_->AdviseSequential();
+  }
+}
+
+std::shared_ptr<Segment> ColdSegment::Open() {
+  std::lock_guard lock{mutex_};
+  if (!segment_) {
+    segment_ = open_();
+  }
+  return segment_;
+}
+
+}  // namespace wombat::broker::log
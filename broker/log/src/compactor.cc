@@ -0,0 +1,294 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/compactor.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "log/logexception.h"
+#include "log/recordbatch.h"
+#include "log/scan.h"
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Padding is split so it is never larger than a batch may be, hence padding
+// can be served like any other batch.
+constexpr uint32_t kMaxPaddingSize = 1 << 20;
+
+// Number of bytes read from the segment at a time.
+constexpr uint32_t kReadBlockSize = 64 * 1024;
+
+std::string Key(View key) {
+  return std::string(reinterpret_cast<const char*>(key.data), key.size);
+}
+
+// Returns true if the view is padding.
+bool IsPadding(View record) {
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(record);
+  return batch && batch->padding() && batch->VerifyCrc();
+}
+
+// Scans the complete records in segment, calling fn with the position and
+// size of each record and a view of the record including its size prefix.
+// Padding is viewed as its header alone so the hole following the header is
+// never read. The view is only valid for the duration of the call.
+//
+// Scanning stops when fn returns false. Returns the position following the
+// last record scanned.
+uint32_t ScanBatches(
+    Segment* segment,
+    const std::function<bool(uint32_t position, uint32_t size, View record)>&
+        fn) {
+  std::vector<uint8_t> block;
+  uint32_t block_position = 0;
+  const uint32_t end = segment->size();
+
+  // Ensures the n bytes at position are in the block, returning false if
+  // they cannot be read.
+  auto fill = [&](uint32_t position, uint32_t n) {
+    if (position >= block_position &&
+        position - block_position + n <= block.size()) {
+      return true;
+    }
+    const uint32_t len = std::min(end - position, std::max(n, kReadBlockSize));
+    block = segment->Lookup(position, len);
+    block_position = position;
+    return block.size() == len;
+  };
+
+  uint32_t position = 0;
+  while (end - position >= kRecordPrefixSize) {
+    if (!fill(position, kRecordPrefixSize)) {
+      return position;
+    }
+    uint32_t prefix;
+    std::memcpy(&prefix, block.data() + (position - block_position),
+                kRecordPrefixSize);
+    // Compare without adding to the size as a corrupt size may overflow.
+    if (ntohl(prefix) > end - position - kRecordPrefixSize) {
+      return position;
+    }
+    const uint32_t size = kRecordPrefixSize + ntohl(prefix);
+
+    View record;
+    if (size > RecordBatch::kHeaderSize) {
+      if (!fill(position, RecordBatch::kHeaderSize)) {
+        return position;
+      }
+      record = View{block.data() + (position - block_position),
+                    RecordBatch::kHeaderSize};
+    }
+    if (size <= RecordBatch::kHeaderSize || !IsPadding(record)) {
+      if (!fill(position, size)) {
+        return position;
+      }
+      record = View{block.data() + (position - block_position), size};
+    }
+
+    if (!fn(position, size, record)) {
+      return position;
+    }
+    position += size;
+  }
+  return position;
+}
+
+// Returns the batch at offset with only the records that are kept, which is
+// empty if no records are kept, or nullopt if the batch is not keyed or
+// removing the records would not free enough space to add padding.
+std::optional<std::vector<uint8_t>> CompactBatch(
+    View record, uint64_t offset, const Compactor::KeyMap& keys,
+    bool remove_tombstones) {
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(record);
+  // Batches that fail validation are kept rather than risk losing records.
+  if (!batch || !batch->keyed() || !batch->Validate()) {
+    return std::nullopt;
+  }
+
+  // A key may appear more than once in a batch, where only the last record
+  // with the key can be its latest record.
+  std::unordered_map<std::string, uint32_t> last;
+  uint32_t n = 0;
+  batch->ForEach([&](const RecordBatch::Record& r) {
+    last[Key(*r.key)] = n++;
+    return true;
+  });
+
+  RecordBatch::Builder builder{};
+  n = 0;
+  bool removed = false;
+  batch->ForEach([&](const RecordBatch::Record& r) {
+    const std::string key = Key(*r.key);
+    auto it = keys.find(key);
+    // Keys missing from the map were added after the map was built so are
+    // only removed if superseded within the batch.
+    if ((!r.value && remove_tombstones) || last[key] != n++ ||
+        (it != keys.end() && it->second != offset)) {
+      removed = true;
+      return true;
+    }
+    const std::vector<uint8_t> k(r.key->data, r.key->data + r.key->size);
+    if (r.value) {
+      builder.Add(r.timestamp, k,
+                  std::vector<uint8_t>(r.value->data,
+                                       r.value->data + r.value->size));
+    } else {
+      builder.Add(r.timestamp, k, std::nullopt);
+    }
+    return true;
+  });
+
+  if (!removed) {
+    return std::nullopt;
+  }
+  if (builder.empty()) {
+    return std::vector<uint8_t>{};
+  }
+  if (record.size - builder.size() < RecordBatch::kHeaderSize) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> enc = builder.Build();
+  RecordBatch::SetBaseOffset(enc.data(), batch->header().base_offset);
+  return enc;
+}
+
+}  // namespace
+
+Compactor::Compactor(std::chrono::milliseconds interval,
+                     std::function<void()> compact)
+    : interval_{interval}, compact_{std::move(compact)}, running_{true} {
+  thread_ = std::thread{&Compactor::Run, this};
+}
+
+Compactor::~Compactor() {
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void Compactor::AddKeys(Segment* segment, uint64_t start, KeyMap* keys) {
+  ScanBatches(segment, [start, keys](uint32_t position, uint32_t,
+                                     View record) {
+    const std::optional<RecordBatch> batch = RecordBatch::Parse(record);
+    if (!batch || !batch->keyed() || !batch->Validate()) {
+      return true;
+    }
+    batch->ForEach([&](const RecordBatch::Record& r) {
+      (*keys)[Key(*r.key)] = start + position;
+      return true;
+    });
+    return true;
+  });
+}
+
+bool Compactor::Rewrite(Segment* segment, uint64_t start, const KeyMap& keys,
+                        bool remove_tombstones, Segment* out,
+                        std::vector<uint32_t>* positions) {
+  // Check there are records to remove before writing anything, so segments
+  // that are already compacted are not rewritten.
+  bool removed = false;
+  ScanBatches(segment, [&](uint32_t position, uint32_t, View record) {
+    removed =
+        CompactBatch(record, start + position, keys, remove_tombstones)
+            .has_value();
+    return !removed;
+  });
+  if (!removed) {
+    return false;
+  }
+
+  // Removed records are accumulated into a gap which is replaced by padding
+  // once a record is kept.
+  uint32_t gap_position = 0;
+  uint32_t gap = 0;
+  auto pad = [&]() {
+    while (gap != 0) {
+      uint32_t n = std::min(gap, kMaxPaddingSize);
+      // Never leave a remainder too small to hold the padding header.
+      if (gap != n && gap - n < RecordBatch::kHeaderSize) {
+        n = gap - RecordBatch::kHeaderSize;
+      }
+      positions->push_back(gap_position);
+      out->Append(RecordBatch::Padding(start + gap_position, n));
+      // Extend the file past the padding without writing it, leaving a hole.
+      out->Truncate(gap_position + n);
+      gap_position += n;
+      gap -= n;
+    }
+  };
+  auto keep = [&](uint32_t position, View record) {
+    pad();
+    positions->push_back(position);
+    out->Append(std::vector<uint8_t>(record.data, record.data + record.size));
+  };
+  auto remove = [&](uint32_t position, uint32_t size) {
+    if (gap == 0) {
+      gap_position = position;
+    }
+    gap += size;
+  };
+
+  const uint32_t end = ScanBatches(segment, [&](uint32_t position,
+                                                uint32_t size, View record) {
+    // Existing padding is merged with any records removed around it.
+    if (record.size != size || IsPadding(record)) {
+      remove(position, size);
+      return true;
+    }
+
+    const std::optional<std::vector<uint8_t>> compacted =
+        CompactBatch(record, start + position, keys, remove_tombstones);
+    if (!compacted) {
+      keep(position, record);
+    } else if (compacted->empty()) {
+      remove(position, size);
+    } else {
+      const uint32_t compacted_size = compacted->size();
+      keep(position, View{compacted->data(), compacted_size});
+      remove(position + compacted_size, size - compacted_size);
+    }
+    return true;
+  });
+  pad();
+  // The offsets of the following segments depend on the size of the segment
+  // so a segment that cannot be fully read is never replaced.
+  return end == segment->size();
+}
+
+void Compactor::Run() {
+  std::unique_lock<std::mutex> lk(mut_);
+  while (running_) {
+    cv_.wait_for(lk, interval_, [this] { return !running_; });
+    if (!running_) break;
+
+    lk.unlock();
+    try {
+      compact_();
+    } catch (const LogException& e) {
+      // Retry on the next interval in case the error was transient. Note
+      // LogException logs the error.
+    }
+    lk.lock();
+  }
+}
+
+}  // namespace wombat::broker::log
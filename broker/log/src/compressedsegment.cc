@@ -0,0 +1,196 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/compressedsegment.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/crc32c.h"
+#include "log/logexception.h"
+#include "log/lz4.h"
+
+namespace wombat::broker::log {
+
+CompressedSegment::CompressedSegment(uint32_t id,
+                                     const std::filesystem::path& dir,
+                                     uint32_t cached_blocks)
+    : CompressedSegment{dir / (IdToName(id) + kCompressedSuffix),
+                        cached_blocks} {}
+
+CompressedSegment::CompressedSegment(const std::filesystem::path& path,
+                                     uint32_t cached_blocks)
+    : Segment{path, 0},
+      block_size_{0},
+      blocks_{},
+      cache_{},
+      cached_blocks_{cached_blocks} {
+  fd_ = open(path_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    throw LogException{"failed to open compressed segment", errno};
+  }
+
+  bool valid;
+  try {
+    valid = Open();
+  } catch (const LogException& e) {
+    close(fd_);
+    throw;
+  }
+  if (!valid) {
+    close(fd_);
+    throw LogException{"invalid compressed segment"};
+  }
+}
+
+CompressedSegment::~CompressedSegment() {
+  if (fd_ > 0) {
+    close(fd_);
+  }
+}
+
+void CompressedSegment::Append(const std::vector<uint8_t>& data) {
+  throw LogException{"cannot append to sealed segment"};
+}
+
+std::vector<uint8_t> CompressedSegment::Lookup(uint32_t offset,
+                                               uint32_t size) {
+  // Match Segment::Lookup by treating a read past the end as EOF.
+  if (offset > size_ || size > size_ - offset) {
+    return {};
+  }
+
+  std::vector<uint8_t> data(size);
+  uint32_t n = 0;
+  while (n < size) {
+    const uint32_t position = offset + n;
+    const std::shared_ptr<const std::vector<uint8_t>> block =
+        LookupBlock(position / block_size_);
+    if (!block) {
+      return {};
+    }
+    const uint32_t start = position % block_size_;
+    const uint32_t len =
+        std::min<uint32_t>(size - n, block->size() - start);
+    std::memcpy(data.data() + n, block->data() + start, len);
+    n += len;
+  }
+  return data;
+}
+
+std::optional<View> CompressedSegment::LookupView(uint32_t offset,
+                                                  uint32_t size) {
+  return std::nullopt;
+}
+
+bool CompressedSegment::Open() {
+  const uint32_t file_size = Size();
+  if (file_size < kFooterSize) {
+    return false;
+  }
+  uint32_t footer[kFooterSize / sizeof(uint32_t)];
+  if (!Read(file_size - kFooterSize, reinterpret_cast<uint8_t*>(footer),
+            kFooterSize) ||
+      ntohl(footer[3]) != kMagic) {
+    return false;
+  }
+  block_size_ = ntohl(footer[0]);
+  size_ = ntohl(footer[1]);
+  const uint32_t count = ntohl(footer[2]);
+  // The segment is sealed so is always full.
+  limit_ = size_;
+
+  // The blocks must exactly cover the segment and their entries must fit in
+  // the file, which also bounds a corrupt count.
+  const uint32_t entries_size = file_size - kFooterSize;
+  if (block_size_ == 0 ||
+      count != (static_cast<uint64_t>(size_) + block_size_ - 1) / block_size_ ||
+      static_cast<uint64_t>(count) * kBlockEntrySize > entries_size) {
+    return false;
+  }
+  const uint32_t entries_position = entries_size - count * kBlockEntrySize;
+
+  std::vector<uint32_t> entries(count * kBlockEntrySize / sizeof(uint32_t));
+  if (!Read(entries_position, reinterpret_cast<uint8_t*>(entries.data()),
+            count * kBlockEntrySize)) {
+    return false;
+  }
+  blocks_.reserve(count);
+  for (uint32_t i = 0; i != count; ++i) {
+    const Block block{ntohl(entries[i * 3]), ntohl(entries[i * 3 + 1]),
+                      ntohl(entries[i * 3 + 2])};
+    if (block.position > entries_position ||
+        block.size > entries_position - block.position) {
+      return false;
+    }
+    blocks_.push_back(block);
+  }
+  return true;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> CompressedSegment::LookupBlock(
+    uint32_t n) {
+  {
+    std::lock_guard lock{mutex_};
+    for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+      if (it->first == n) {
+        cache_.splice(cache_.begin(), cache_, it);
+        return it->second;
+      }
+    }
+  }
+
+  // Decompress without holding the lock so lookups of cached blocks are not
+  // blocked. If another thread reads the same block concurrently both are
+  // cached until evicted.
+  std::shared_ptr<const std::vector<uint8_t>> block = ReadBlock(n);
+  if (!block) {
+    return nullptr;
+  }
+  std::lock_guard lock{mutex_};
+  cache_.emplace_front(n, block);
+  if (cache_.size() > cached_blocks_) {
+    cache_.pop_back();
+  }
+  return block;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> CompressedSegment::ReadBlock(
+    uint32_t n) const {
+  const Block& block = blocks_[n];
+  const uint32_t len = std::min(block_size_, size_ - n * block_size_);
+
+  std::vector<uint8_t> stored(block.size);
+  if (!Read(block.position, stored.data(), stored.size()) ||
+      Crc32c(stored.data(), stored.size()) != block.crc) {
+    LOG(ERROR) << "compressed segment block " << n << " corrupt: " << path_;
+    return nullptr;
+  }
+  // Blocks are only stored compressed if smaller than the data.
+  if (block.size == len) {
+    return std::make_shared<const std::vector<uint8_t>>(std::move(stored));
+  }
+
+  std::shared_ptr<std::vector<uint8_t>> data =
+      std::make_shared<std::vector<uint8_t>>(len);
+  if (!Lz4Decompress(stored.data(), stored.size(), data->data(), len)) {
+    LOG(ERROR) << "compressed segment block " << n
+               << " failed to decompress: " << path_;
+    return nullptr;
+  }
+  return data;
+}
+
+}  // namespace wombat::broker::log
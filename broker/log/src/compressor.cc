@@ -0,0 +1,100 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/compressor.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "log/compressedsegment.h"
+#include "log/crc32c.h"
+#include "log/logexception.h"
+#include "log/lz4.h"
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+void AppendU32(uint32_t n, std::vector<uint8_t>* out) {
+  const uint32_t enc = htonl(n);
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&enc);
+  out->insert(out->end(), p, p + sizeof(enc));
+}
+
+}  // namespace
+
+Compressor::Compressor(std::chrono::milliseconds interval,
+                       std::function<void()> compress)
+    : interval_{interval}, compress_{std::move(compress)}, running_{true} {
+  thread_ = std::thread{&Compressor::Run, this};
+}
+
+Compressor::~Compressor() {
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+bool Compressor::Compress(Segment* segment, uint32_t block_size,
+                          Segment* out) {
+  const uint32_t size = segment->size();
+  std::vector<uint8_t> entries;
+  uint32_t position = 0;
+  while (position != size) {
+    const uint32_t len = std::min(block_size, size - position);
+    std::vector<uint8_t> block = segment->Lookup(position, len);
+    if (block.size() != len) {
+      return false;
+    }
+    position += len;
+
+    std::vector<uint8_t> compressed = Lz4Compress(block.data(), block.size());
+    // Blocks that do not compress are stored as is, which CompressedSegment
+    // detects as the stored size equals the block size.
+    if (compressed.size() < block.size()) {
+      block = std::move(compressed);
+    }
+    AppendU32(out->size(), &entries);
+    AppendU32(block.size(), &entries);
+    AppendU32(Crc32c(block.data(), block.size()), &entries);
+    out->Append(block);
+  }
+
+  AppendU32(block_size, &entries);
+  AppendU32(size, &entries);
+  AppendU32((static_cast<uint64_t>(size) + block_size - 1) / block_size,
+            &entries);
+  AppendU32(CompressedSegment::kMagic, &entries);
+  out->Append(entries);
+  return true;
+}
+
+void Compressor::Run() {
+  std::unique_lock<std::mutex> lk(mut_);
+  while (running_) {
+    cv_.wait_for(lk, interval_, [this] { return !running_; });
+    if (!running_) break;
+
+    lk.unlock();
+    try {
+      compress_();
+    } catch (const LogException& e) {
+      // Retry on the next interval in case the error was transient. Note
+      // LogException logs the error.
+    }
+    lk.lock();
+  }
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,146 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/crc32c.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace wombat::broker::log {
+
+namespace {
+
+// CRC32C polynomial in reversed bit order.
+constexpr uint32_t kPolynomial = 0x82f63b78;
+
+using Table = std::array<std::array<uint32_t, 256>, 8>;
+
+// Builds the slicing-by-8 tables, where table[k][b] is the CRC of byte b
+// followed by k zero bytes.
+Table BuildTable() {
+  Table table{};
+  for (uint32_t b = 0; b != 256; ++b) {
+    uint32_t crc = b;
+    for (int i = 0; i != 8; ++i) {
+      crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+    }
+    table[0][b] = crc;
+  }
+  for (uint32_t b = 0; b != 256; ++b) {
+    for (size_t k = 1; k != table.size(); ++k) {
+      table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+    }
+  }
+  return table;
+}
+
+const Table& GetTable() {
+  static const Table table = BuildTable();
+  return table;
+}
+
+uint32_t UpdatePortable(uint32_t crc, const uint8_t* data, size_t size) {
+  const Table& t = GetTable();
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    // The tables are defined for little endian words.
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    word ^= crc;
+    crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+          t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+          t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+          t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    data += 8;
+    size -= 8;
+  }
+  while (size != 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+    ++data;
+    --size;
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2"))) uint32_t UpdateHardware(
+    uint32_t crc, const uint8_t* data, size_t size) {
+  uint64_t crc64 = crc;
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    size -= 8;
+  }
+  crc = crc64;
+  while (size != 0) {
+    crc = _mm_crc32_u8(crc, *data);
+    ++data;
+    --size;
+  }
+  return crc;
+}
+
+bool HardwareSupported() { return __builtin_cpu_supports("sse4.2"); }
+
+#elif defined(__aarch64__)
+
+__attribute__((target("+crc"))) uint32_t UpdateHardware(uint32_t crc,
+                                                        const uint8_t* data,
+                                                        size_t size) {
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    size -= 8;
+  }
+  while (size != 0) {
+    crc = __crc32cb(crc, *data);
+    ++data;
+    --size;
+  }
+  return crc;
+}
+
+bool HardwareSupported() { return getauxval(AT_HWCAP) & HWCAP_CRC32; }
+
+#else
+
+uint32_t UpdateHardware(uint32_t crc, const uint8_t* data, size_t size) {
+  return UpdatePortable(crc, data, size);
+}
+
+bool HardwareSupported() { return false; }
+
+#endif
+
+using Update = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+// Selects the implementation once rather than checking the CPU on every call.
+const Update kUpdate = HardwareSupported() ? UpdateHardware : UpdatePortable;
+
+}  // namespace
+
+uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc) {
+  return ~kUpdate(~crc, data, size);
+}
+
+uint32_t Crc32cPortable(const uint8_t* data, size_t size, uint32_t crc) {
+  return ~UpdatePortable(~crc, data, size);
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,84 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/directorycoldstore.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Syncs the file or directory at path.
+void Sync(const std::filesystem::path& path, int flags) {
+  const int fd = open(path.c_str(), flags);
+  if (fd == -1) {
+    throw LogException{"failed to open cold store file", errno};
+  }
+  const int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw LogException{"cold store fsync failed", errno};
+  }
+}
+
+}  // namespace
+
+DirectoryColdStore::DirectoryColdStore(const std::filesystem::path& path)
+    : path_{path} {
+  std::error_code ec;
+  std::filesystem::create_directories(path_, ec);
+  if (ec) {
+    throw LogException{"failed to create cold store directory", ec.value()};
+  }
+}
+
+void DirectoryColdStore::Put(const std::string& name,
+                             const std::filesystem::path& path) {
+  const std::filesystem::path tmp = path_ / (name + ".tmp");
+  std::error_code ec;
+  std::filesystem::copy_file(
+      path, tmp, std::filesystem::copy_options::overwrite_existing, ec);
+  if (ec) {
+    throw LogException{"failed to copy file to cold store", ec.value()};
+  }
+  Sync(tmp, O_RDONLY);
+
+  std::filesystem::rename(tmp, path_ / name, ec);
+  if (ec) {
+    throw LogException{"failed to rename file in cold store", ec.value()};
+  }
+  Sync(path_, O_RDONLY | O_DIRECTORY);
+}
+
+bool DirectoryColdStore::Get(const std::string& name,
+                             const std::filesystem::path& path) {
+  std::error_code ec;
+  std::filesystem::copy_file(
+      path_ / name, path, std::filesystem::copy_options::overwrite_existing,
+      ec);
+  if (ec == std::errc::no_such_file_or_directory) {
+    return false;
+  }
+  if (ec) {
+    throw LogException{"failed to copy file from cold store", ec.value()};
+  }
+  return true;
+}
+
+void DirectoryColdStore::Remove(const std::string& name) {
+  std::error_code ec;
+  std::filesystem::remove(path_ / name, ec);
+  if (ec) {
+    throw LogException{"failed to remove file from cold store", ec.value()};
+  }
+}
+
+}  // namespace wombat::broker::log
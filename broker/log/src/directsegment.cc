@@ -0,0 +1,185 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/directsegment.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+DirectSegment::DirectSegment(uint32_t id, const std::filesystem::path& dir,
+                             uint32_t limit, uint32_t buffer_size,
+                             std::chrono::milliseconds linger)
+    : SystemSegment{id, dir, limit},
+      direct_fd_{-1},
+      staging_{},
+      capacity_{std::max(kBlockSize, (buffer_size + kBlockSize - 1) /
+                                         kBlockSize * kBlockSize)},
+      blocks_{0},
+      written_{size_},
+      linger_{linger},
+      staged_at_{} {
+  staging_.reset(
+      static_cast<uint8_t*>(std::aligned_alloc(kBlockSize, capacity_)));
+  if (!staging_) {
+    throw LogException{"failed to allocate segment staging buffer"};
+  }
+
+  direct_fd_ = open(path_.c_str(), O_WRONLY | O_DIRECT);
+  if (direct_fd_ == -1) {
+    if (errno != EINVAL) {
+      throw LogException{"failed to open segment", errno};
+    }
+    LOG(WARNING) << "O_DIRECT not supported, writing segment through the "
+                    "page cache: "
+                 << path_;
+  }
+
+  LoadTail();
+}
+
+DirectSegment::~DirectSegment() {
+  try {
+    Flush();
+  } catch (const LogException& e) {
+    // Cannot throw from the destructor. Note LogException logs the error.
+  }
+  if (direct_fd_ != -1) {
+    close(direct_fd_);
+  }
+}
+
+void DirectSegment::Append(const std::vector<uint8_t>& data) {
+  if (size_ == written_) {
+    staged_at_ = std::chrono::steady_clock::now();
+  }
+
+  size_t n = 0;
+  while (n != data.size()) {
+    const uint32_t staged = size_ - blocks_;
+    const uint32_t len = std::min<size_t>(capacity_ - staged, data.size() - n);
+    std::memcpy(staging_.get() + staged, data.data() + n, len);
+    size_ += len;
+    n += len;
+    if (size_ - blocks_ == capacity_) {
+      WriteBlocks();
+    }
+  }
+  Poll();
+}
+
+std::vector<uint8_t> DirectSegment::Lookup(uint32_t offset, uint32_t size) {
+  // Reads past the end of the segment return nothing.
+  if (offset > size_ || size > size_ - offset) {
+    return {};
+  }
+
+  // Read the whole blocks from the file then copy the rest from the staging
+  // buffer.
+  std::vector<uint8_t> data(size);
+  uint32_t n = 0;
+  if (offset < blocks_) {
+    n = std::min(size, blocks_ - offset);
+    if (!Read(offset, data.data(), n)) {
+      return {};
+    }
+  }
+  if (n < size) {
+    std::memcpy(data.data() + n, staging_.get() + (offset + n - blocks_),
+                size - n);
+  }
+  return data;
+}
+
+std::optional<View> DirectSegment::LookupView(uint32_t offset, uint32_t size) {
+  if (offset < blocks_ || offset > size_ || size > size_ - offset) {
+    return std::nullopt;
+  }
+  return View{staging_.get() + (offset - blocks_), size};
+}
+
+void DirectSegment::Flush() {
+  WriteBlocks();
+  if (written_ >= size_) {
+    return;
+  }
+
+  // The partial block cannot be written with O_DIRECT, so is written through
+  // the page cache until the block is complete.
+  const uint32_t from = written_ - blocks_;
+  const uint32_t size = size_ - written_;
+  size_t n = 0;
+  while (n < size) {
+    const ssize_t res =
+        pwrite(fd_, staging_.get() + from + n, size - n, written_ + n);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw LogException{"segment write error", errno};
+    }
+    n += res;
+  }
+  written_ = size_;
+}
+
+void DirectSegment::Poll() {
+  if (size_ != written_ &&
+      std::chrono::steady_clock::now() - staged_at_ >= linger_) {
+    Flush();
+  }
+}
+
+void DirectSegment::Truncate(uint32_t size) {
+  Flush();
+  if (ftruncate(fd_, size) == -1) {
+    throw LogException{"segment ftruncate failed", errno};
+  }
+  size_ = size;
+  written_ = size;
+  LoadTail();
+}
+
+void DirectSegment::WriteBlocks() {
+  const uint32_t staged = size_ - blocks_;
+  const uint32_t len = staged - staged % kBlockSize;
+  if (len == 0) {
+    return;
+  }
+
+  const int fd = direct_fd_ != -1 ? direct_fd_ : fd_;
+  uint32_t n = 0;
+  while (n < len) {
+    const ssize_t res =
+        pwrite(fd, staging_.get() + n, len - n, blocks_ + n);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw LogException{"segment write error", errno};
+    }
+    n += res;
+  }
+
+  std::memmove(staging_.get(), staging_.get() + len, staged - len);
+  blocks_ += len;
+  written_ = std::max(written_, blocks_);
+}
+
+void DirectSegment::LoadTail() {
+  blocks_ = size_ - size_ % kBlockSize;
+  if (size_ != blocks_ && !Read(blocks_, staging_.get(), size_ - blocks_)) {
+    throw LogException{"segment read error"};
+  }
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,122 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/ephemerallog.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "log/logexception.h"
+#include "log/memorysegment.h"
+
+namespace wombat::broker::log {
+
+EphemeralLog::EphemeralLog(uint32_t segment_size, uint32_t segments)
+    : segment_size_{segment_size},
+      segments_{segments},
+      ring_{},
+      start_{0},
+      next_{0},
+      id_{1} {
+  if (segment_size_ == 0 || segments_ < 2) {
+    throw LogException{"ephemeral log needs at least two non-empty segments"};
+  }
+  Roll(segment_size_);
+}
+
+void EphemeralLog::Append(const std::vector<uint8_t>& data) {
+  if (data.size() > ring_.back().segment->available()) {
+    Roll(std::max<uint32_t>(segment_size_, data.size()));
+  }
+
+  Entry& active = ring_.back();
+  active.records.push_back(active.segment->size());
+  active.segment->Append(data);
+  ++next_;
+  size_ += data.size();
+}
+
+std::vector<uint8_t> EphemeralLog::Lookup(uint64_t offset, uint32_t size) {
+  if (offset < start_ || offset > size_) {
+    return {};
+  }
+  Entry* entry = Resolve(offset);
+  return entry->segment->Lookup(offset - entry->start, size);
+}
+
+std::optional<View> EphemeralLog::LookupView(uint64_t offset, uint32_t size) {
+  if (offset < start_ || offset > size_) {
+    return std::nullopt;
+  }
+  Entry* entry = Resolve(offset);
+  return entry->segment->LookupView(offset - entry->start, size);
+}
+
+bool EphemeralLog::Seek(uint64_t ordinal, uint64_t* offset) {
+  if (ordinal == next_) {
+    *offset = size_;
+    return true;
+  }
+  // Records before the first segment have been dropped.
+  if (ordinal > next_ || ordinal < ring_.front().base) {
+    return false;
+  }
+
+  // Find the last segment starting at or before the ordinal.
+  auto it = std::prev(std::upper_bound(
+      ring_.begin(), ring_.end(), ordinal,
+      [](uint64_t value, const Entry& entry) { return value < entry.base; }));
+  *offset = it->start + it->records[ordinal - it->base];
+  return true;
+}
+
+bool EphemeralLog::IsAligned(uint64_t offset) {
+  if (offset >= size_) {
+    return true;
+  }
+  if (offset < start_) {
+    return false;
+  }
+  const Entry* entry = Resolve(offset);
+  return std::binary_search(entry->records.begin(), entry->records.end(),
+                            offset - entry->start);
+}
+
+void EphemeralLog::Roll(uint32_t size) {
+  std::unique_ptr<MemorySegment> segment;
+  std::vector<uint32_t> records;
+  if (ring_.size() == segments_) {
+    // Reuse the memory of the dropped segment unless it is too small, or was
+    // enlarged for a large record so would hold the memory indefinitely.
+    segment = std::move(ring_.front().segment);
+    records = std::move(ring_.front().records);
+    records.clear();
+    ring_.pop_front();
+    start_ = ring_.front().start;
+    if (segment->limit() != size) {
+      segment.reset();
+    }
+  }
+  if (segment) {
+    segment->Truncate(0);
+  } else {
+    segment = std::make_unique<MemorySegment>(id_++, size);
+  }
+
+  ring_.push_back(Entry{size_, next_, std::move(records), std::move(segment)});
+}
+
+EphemeralLog::Entry* EphemeralLog::Resolve(uint64_t offset) {
+  // Find the last segment starting at or before the offset.
+  auto it = std::upper_bound(ring_.begin(), ring_.end(), offset,
+                             [](uint64_t value, const Entry& entry) {
+                               return value < entry.start;
+                             });
+  return &*std::prev(it);
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,165 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/flusher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/checkpoint.h"
+#include "log/logexception.h"
+#include "log/options.h"
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+Flusher::Flusher(const Options& options, uint64_t flushed)
+    : durability_{options.durability},
+      interval_{options.flush_interval_ms},
+      interval_bytes_{options.flush_interval_bytes},
+      pending_{},
+      written_{flushed},
+      flushed_{flushed},
+      checkpoint_dir_{},
+      checkpoint_{},
+      running_{true} {
+  if (durability_ != Durability::kNone) {
+    thread_ = std::thread{&Flusher::Run, this};
+  }
+}
+
+Flusher::~Flusher() {
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    running_ = false;
+  }
+  written_cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void Flusher::Written(std::shared_ptr<Segment> segment, uint64_t offset) {
+  if (durability_ == Durability::kNone) {
+    {
+      // Set holding the lock so a waiter checking flushed_ cannot miss the
+      // notification.
+      std::lock_guard<std::mutex> lk(mut_);
+      flushed_ = offset;
+    }
+    flushed_cv_.notify_all();
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(mut_);
+  if (std::find(pending_.begin(), pending_.end(), segment) == pending_.end()) {
+    pending_.push_back(std::move(segment));
+  }
+  written_ = offset;
+  if (durability_ == Durability::kGroupCommit ||
+      written_ - flushed_ >= interval_bytes_) {
+    written_cv_.notify_one();
+  }
+}
+
+bool Flusher::Wait(uint64_t offset, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lk(mut_);
+  return flushed_cv_.wait_for(lk, timeout,
+                              [this, offset] { return flushed_ >= offset; });
+}
+
+void Flusher::WriteCheckpoint(const std::filesystem::path& dir,
+                              const Checkpoint& checkpoint) {
+  if (durability_ == Durability::kNone) {
+    checkpoint.Write(dir, false);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    checkpoint_dir_ = dir;
+    checkpoint_ = checkpoint;
+  }
+  written_cv_.notify_one();
+}
+
+void Flusher::Run() {
+  std::unique_lock<std::mutex> lk(mut_);
+  while (running_) {
+    if (durability_ == Durability::kGroupCommit) {
+      written_cv_.wait(lk, [this] {
+        return !running_ || !pending_.empty() || CheckpointFlushed();
+      });
+    } else {
+      written_cv_.wait_for(lk, interval_, [this] {
+        return !running_ || written_ - flushed_ >= interval_bytes_ ||
+               CheckpointFlushed();
+      });
+    }
+    SyncPending(&lk);
+    WritePending(&lk);
+  }
+  // Flush any remaining data on shutdown.
+  SyncPending(&lk);
+  WritePending(&lk);
+}
+
+bool Flusher::CheckpointFlushed() const {
+  return checkpoint_ && checkpoint_->end <= flushed_;
+}
+
+void Flusher::WritePending(std::unique_lock<std::mutex>* lk) {
+  if (!CheckpointFlushed()) return;
+
+  const Checkpoint checkpoint = *checkpoint_;
+  const std::filesystem::path dir = checkpoint_dir_;
+  checkpoint_ = std::nullopt;
+
+  lk->unlock();
+  try {
+    checkpoint.Write(dir);
+  } catch (const LogException& e) {
+    // The checkpoint only shortens recovery so the next is written instead.
+    // Note LogException logs the error.
+  }
+  lk->lock();
+}
+
+void Flusher::SyncPending(std::unique_lock<std::mutex>* lk) {
+  if (pending_.empty()) return;
+
+  const uint64_t target = written_;
+  std::vector<std::shared_ptr<Segment>> segments;
+  segments.swap(pending_);
+
+  lk->unlock();
+  bool ok = true;
+  for (const std::shared_ptr<Segment>& segment : segments) {
+    try {
+      segment->Sync();
+    } catch (const LogException& e) {
+      ok = false;
+    }
+  }
+  lk->lock();
+
+  if (!ok) {
+    // Retry the failed segments in the next sync, backing off so a failing
+    // disk is not retried in a tight loop. Note LogException logs the error.
+    pending_.insert(pending_.begin(), segments.begin(), segments.end());
+    written_cv_.wait_for(*lk, interval_, [this] { return !running_; });
+    return;
+  }
+
+  flushed_ = target;
+  flushed_cv_.notify_all();
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,151 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/index.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "log/scan.h"
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+Index::Index(std::shared_ptr<Segment> segment, uint64_t base,
+             uint32_t interval)
+    : segment_{std::move(segment)}, entries_{}, interval_{interval} {
+  Load();
+  if (entries_.empty()) {
+    Insert(base, 0);
+  }
+  next_ = entries_.back().ordinal;
+  end_ = entries_.back().position;
+}
+
+void Index::Append(uint32_t position, uint32_t size) {
+  if (position - entries_.back().position >= interval_) {
+    Insert(next_, position);
+  }
+  ++next_;
+  end_ = position + size;
+}
+
+void Index::Recover(Segment* segment, Entry from) {
+  // Discard entries for records that never reached the segment.
+  while (entries_.size() > 1 && entries_.back().position > segment->size()) {
+    entries_.pop_back();
+  }
+  if (segment_ && segment_->size() > entries_.size() * kEntrySize) {
+    // Remove the discarded entries from the file so new entries follow the
+    // entries kept.
+    segment_->Truncate(entries_.size() * kEntrySize);
+  }
+  next_ = entries_.back().ordinal;
+  end_ = entries_.back().position;
+  // Any entries lost between the last entry and from are not added back,
+  // which only means lookups of those records scan further.
+  if (from.position > end_ && from.position <= segment->size() &&
+      from.ordinal >= next_) {
+    next_ = from.ordinal;
+    end_ = from.position;
+  }
+
+  end_ = ScanRecords(segment, end_, segment->size(),
+                     [this](uint32_t position, View record) {
+                       Append(position, record.size);
+                       return true;
+                     });
+}
+
+bool Index::Lookup(uint64_t ordinal, Segment* segment,
+                   uint32_t* position) const {
+  if (ordinal < base() || ordinal >= next_) {
+    return false;
+  }
+
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), ordinal,
+      [](uint64_t o, const Entry& entry) { return o < entry.ordinal; });
+  // Never the first entry as ordinal >= base.
+  const Entry& entry = *(it - 1);
+  const uint32_t to = it == entries_.end() ? end_ : it->position;
+
+  uint64_t current = entry.ordinal;
+  bool found = false;
+  ScanRecords(segment, entry.position, to, [&](uint32_t p, View record) {
+    if (current == ordinal) {
+      *position = p;
+      found = true;
+      return false;
+    }
+    ++current;
+    return true;
+  });
+  return found;
+}
+
+bool Index::IsAligned(uint32_t position, Segment* segment) const {
+  if (position >= end_) {
+    return position == end_;
+  }
+  uint64_t ordinal;
+  return Ordinal(position, segment, &ordinal);
+}
+
+bool Index::Ordinal(uint32_t position, Segment* segment,
+                    uint64_t* ordinal) const {
+  if (position >= end_) {
+    return false;
+  }
+
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), position,
+      [](uint32_t p, const Entry& entry) { return p < entry.position; });
+  // Never the first entry as the first entry is at position 0.
+  const Entry& entry = *(it - 1);
+
+  // Scanning up to position only stops at position if a record ends there.
+  uint32_t scanned = 0;
+  if (ScanRecords(segment, entry.position, position, [&](uint32_t, View) {
+        ++scanned;
+        return true;
+      }) != position) {
+    return false;
+  }
+  *ordinal = entry.ordinal + scanned;
+  return true;
+}
+
+void Index::Load() {
+  const uint32_t size = segment_->size() - segment_->size() % kEntrySize;
+  if (size == 0) return;
+
+  const std::vector<uint8_t> enc = segment_->Lookup(0, size);
+  entries_.reserve(size / kEntrySize);
+  for (uint32_t i = 0; i < enc.size(); i += kEntrySize) {
+    uint32_t ordinal[2];
+    uint32_t position;
+    std::memcpy(ordinal, enc.data() + i, sizeof(ordinal));
+    std::memcpy(&position, enc.data() + i + sizeof(ordinal), sizeof(position));
+    entries_.push_back(Entry{
+        (static_cast<uint64_t>(ntohl(ordinal[0])) << 32) | ntohl(ordinal[1]),
+        ntohl(position)});
+  }
+}
+
+void Index::Insert(uint64_t ordinal, uint32_t position) {
+  if (segment_) {
+    const uint32_t enc[] = {htonl(ordinal >> 32), htonl(ordinal),
+                            htonl(position)};
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(enc);
+    segment_->Append(std::vector<uint8_t>(data, data + kEntrySize));
+  }
+  entries_.push_back(Entry{ordinal, position});
+}
+
+}  // namespace wombat::broker::log
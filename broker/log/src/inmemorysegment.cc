@@ -49,6 +49,9 @@ InMemorySegment::InMemorySegment(uint32_t id, const std::filesystem::path& dir,
 }
 
 InMemorySegment::~InMemorySegment() {
+  if (fd_ > 0) {
+    Flush();
+  }
   // Do not close fd_ as this would destroy the in-memory state. This is
   // ok as only for testing.
 }
@@ -0,0 +1,449 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/logdirs.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Syncs the file or directory at path.
+void Sync(const std::filesystem::path& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw LogException{"failed to open file to sync", errno};
+  }
+  const int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw LogException{"fsync failed", errno};
+  }
+}
+
+// Copies count bytes at offset in fd from to the same offset in fd to.
+// Returns errno on failure.
+int CopyRange(int from, int to, off_t offset, size_t count) {
+  off_t in = offset;
+  off_t out = offset;
+  while (count != 0) {
+    const ssize_t n = copy_file_range(from, &in, to, &out, count, 0);
+    if (n > 0) {
+      count -= n;
+      continue;
+    }
+    if (n == 0) {
+      // Truncated since the range was found.
+      return 0;
+    }
+    if (errno != EXDEV && errno != ENOSYS && errno != EINVAL) {
+      return errno;
+    }
+
+    // The filesystems do not support copying between them, so copy through
+    // a buffer.
+    std::vector<uint8_t> buf(std::min<size_t>(count, 1 << 20));
+    while (count != 0) {
+      const ssize_t read = pread(from, buf.data(),
+                                 std::min(count, buf.size()), in);
+      if (read == -1) return errno;
+      if (read == 0) return 0;
+      for (ssize_t written = 0; written != read;) {
+        const ssize_t w =
+            pwrite(to, buf.data() + written, read - written, out + written);
+        if (w == -1) return errno;
+        written += w;
+      }
+      in += read;
+      out += read;
+      count -= read;
+    }
+  }
+  return 0;
+}
+
+// Copies the file at path from to path to, replacing any existing file. Only
+// the data regions are copied, so the holes left by compaction stay holes in
+// the copy. Returns errno on failure.
+int CopySparse(const std::filesystem::path& from,
+               const std::filesystem::path& to) {
+  const int in = open(from.c_str(), O_RDONLY);
+  if (in == -1) {
+    return errno;
+  }
+  const int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out == -1) {
+    const int err = errno;
+    close(in);
+    return err;
+  }
+
+  int err = 0;
+  const off_t size = lseek(in, 0, SEEK_END);
+  if (size == -1) {
+    err = errno;
+  }
+  for (off_t data = 0; err == 0 && data < size;) {
+    data = lseek(in, data, SEEK_DATA);
+    if (data == -1) {
+      // No data past the offset.
+      if (errno != ENXIO) err = errno;
+      break;
+    }
+    off_t hole = lseek(in, data, SEEK_HOLE);
+    if (hole == -1) {
+      err = errno;
+      break;
+    }
+    err = CopyRange(in, out, data, hole - data);
+    data = hole;
+  }
+  // Extend the copy past any trailing hole.
+  if (err == 0 && ftruncate(out, size) == -1) {
+    err = errno;
+  }
+
+  close(in);
+  close(out);
+  return err;
+}
+
+}  // namespace
+
+LogDirs::LogDirs(const std::vector<std::filesystem::path>& dirs)
+    : dirs_{dirs}, placed_{}, tracked_{} {
+  if (dirs_.empty()) {
+    throw LogException{"no log directories"};
+  }
+  for (const std::filesystem::path& dir : dirs_) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+      throw LogException{"failed to create log directory", ec.value()};
+    }
+  }
+}
+
+size_t LogDirs::Place(const std::string& name) {
+  std::unique_lock lock{mutex_};
+  auto it = placed_.find(name);
+  if (it != placed_.end()) {
+    return it->second;
+  }
+
+  std::optional<size_t> dir;
+  for (size_t i = 0; i != dirs_.size(); ++i) {
+    const std::filesystem::path path = Path(i, name);
+    if (!std::filesystem::exists(path)) continue;
+
+    // A partial copy, or a complete copy left when the broker stopped before
+    // removing the log it was copied from, which is identical.
+    if (dir || std::filesystem::exists(path / kMovingName)) {
+      LOG(WARNING) << "removing copy of log " << name << " in " << dirs_[i];
+      std::error_code ec;
+      std::filesystem::remove_all(path, ec);
+      if (ec) {
+        throw LogException{"failed to remove log copy", ec.value()};
+      }
+      continue;
+    }
+    dir = i;
+  }
+
+  if (!dir) {
+    // Loading the directories takes the lock.
+    lock.unlock();
+    dir = LeastLoaded();
+    lock.lock();
+    std::error_code ec;
+    std::filesystem::create_directories(Path(*dir, name), ec);
+    if (ec) {
+      throw LogException{"failed to create log directory", ec.value()};
+    }
+    LOG(INFO) << "placing log " << name << " in " << dirs_[*dir];
+  }
+  placed_[name] = *dir;
+  return *dir;
+}
+
+void LogDirs::Track(const std::string& name, std::weak_ptr<Log> log) {
+  std::lock_guard lock{mutex_};
+  const std::shared_ptr<Log> locked = log.lock();
+  tracked_[name] = Tracked{placed_.at(name), log, locked ? locked->size() : 0,
+                           std::chrono::steady_clock::now()};
+}
+
+std::vector<LogDirs::Load> LogDirs::Loads() {
+  std::vector<Load> loads(dirs_.size(), Load{0, 0});
+  for (size_t i = 0; i != dirs_.size(); ++i) {
+    // Files may be deleted while iterating so errors are skipped. Counts the
+    // blocks allocated rather than the file size, as compacted segments are
+    // sparse.
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it{dirs_[i], ec}, end;
+         !ec && it != end; it.increment(ec)) {
+      struct stat st;
+      if (lstat(it->path().c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        loads[i].bytes += static_cast<uint64_t>(st.st_blocks) * 512;
+      }
+    }
+  }
+
+  std::lock_guard lock{mutex_};
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  for (auto it = tracked_.begin(); it != tracked_.end();) {
+    const std::shared_ptr<Log> log = it->second.log.lock();
+    if (!log) {
+      it = tracked_.erase(it);
+      continue;
+    }
+    const uint64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            now - it->second.sampled)
+                            .count();
+    const uint64_t size = log->size();
+    if (ms != 0 && size >= it->second.size) {
+      loads[it->second.dir].throughput += (size - it->second.size) * 1000 / ms;
+      it->second.size = size;
+      it->second.sampled = now;
+    }
+    ++it;
+  }
+  return loads;
+}
+
+size_t LogDirs::LeastLoaded(std::optional<size_t> exclude) {
+  const std::vector<Load> loads = Loads();
+  uint64_t bytes = 0;
+  uint64_t throughput = 0;
+  for (const Load& load : loads) {
+    bytes += load.bytes;
+    throughput += load.throughput;
+  }
+
+  size_t least = 0;
+  double least_score = std::numeric_limits<double>::max();
+  for (size_t i = 0; i != loads.size(); ++i) {
+    if (exclude && *exclude == i) continue;
+    double score = 0;
+    if (bytes != 0) {
+      score += static_cast<double>(loads[i].bytes) / bytes;
+    }
+    if (throughput != 0) {
+      score += static_cast<double>(loads[i].throughput) / throughput;
+    }
+    if (score < least_score) {
+      least = i;
+      least_score = score;
+    }
+  }
+  return least;
+}
+
+void LogDirs::Copy(const std::string& name, size_t dir) {
+  size_t from;
+  {
+    std::lock_guard lock{mutex_};
+    from = placed_.at(name);
+  }
+  if (dir >= dirs_.size() || dir == from) {
+    throw LogException{"invalid log directory to move to"};
+  }
+
+  const std::filesystem::path to = Path(dir, name);
+  std::error_code ec;
+  std::filesystem::create_directories(to, ec);
+  if (ec) {
+    throw LogException{"failed to create log directory", ec.value()};
+  }
+  // Mark the copy partial before copying so it is never taken as the log.
+  std::ofstream{to / kMovingName};
+  Sync(to / kMovingName);
+  Sync(to);
+  Sync(dirs_[dir]);
+
+  Versions copied;
+  Mirror(Path(from, name), to, &copied);
+  std::lock_guard lock{mutex_};
+  copied_[name] = std::move(copied);
+}
+
+void LogDirs::Move(const std::string& name, size_t dir) {
+  size_t from;
+  Versions copied;
+  {
+    std::lock_guard lock{mutex_};
+    from = placed_.at(name);
+    auto it = copied_.find(name);
+    if (it != copied_.end()) {
+      copied = std::move(it->second);
+      copied_.erase(it);
+    }
+  }
+  const std::filesystem::path to = Path(dir, name);
+  Mirror(Path(from, name), to, &copied);
+
+  // The copy is complete once unmarked, after which either copy may be used
+  // if the broker stops before the log is removed from its previous
+  // directory.
+  std::error_code ec;
+  std::filesystem::remove(to / kMovingName, ec);
+  if (ec) {
+    throw LogException{"failed to remove log move marker", ec.value()};
+  }
+  Sync(to);
+
+  Replace(name, dir);
+  LOG(INFO) << "moved log " << name << " from " << dirs_[from] << " to "
+            << dirs_[dir];
+}
+
+void LogDirs::Revert(const std::string& name, size_t dir) {
+  size_t to;
+  {
+    std::lock_guard lock{mutex_};
+    to = placed_.at(name);
+  }
+  Replace(name, dir);
+  Remove(name, to);
+  LOG(INFO) << "moved log " << name << " back to " << dirs_[dir];
+}
+
+void LogDirs::Remove(const std::string& name, size_t dir) {
+  {
+    std::lock_guard lock{mutex_};
+    if (placed_.at(name) == dir) {
+      return;
+    }
+  }
+  // Mark the copy partial first so if the broker stops while removing it,
+  // the remaining files are never taken as the log.
+  const std::filesystem::path path = Path(dir, name);
+  std::error_code ec;
+  if (std::filesystem::exists(path, ec)) {
+    std::ofstream{path / kMovingName};
+  }
+  std::filesystem::remove_all(path, ec);
+  if (ec) {
+    LOG(ERROR) << "failed to remove copy of log " << name << " from "
+               << dirs_[dir] << ": " << ec.message();
+  }
+}
+
+void LogDirs::Abort(const std::string& name, size_t dir) {
+  {
+    std::lock_guard lock{mutex_};
+    copied_.erase(name);
+  }
+  Remove(name, dir);
+}
+
+void LogDirs::Replace(const std::string& name, size_t dir) {
+  std::lock_guard lock{mutex_};
+  placed_[name] = dir;
+  auto it = tracked_.find(name);
+  if (it != tracked_.end()) {
+    it->second.dir = dir;
+  }
+}
+
+void LogDirs::Mirror(const std::filesystem::path& from,
+                     const std::filesystem::path& to, Versions* copied) {
+  const int64_t started_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  try {
+    std::unordered_set<std::string> names;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(from)) {
+      // Directories, such as the cold cache, are recreated by the log.
+      if (!entry.is_regular_file()) continue;
+
+      const std::filesystem::path path = entry.path();
+      const std::filesystem::path copy = to / path.filename();
+      names.insert(path.filename());
+
+      // Read the version before copying, so if the file changes while
+      // copying it is copied again. The size and modification time are not
+      // enough, as compaction rewrites segments keeping both.
+      struct stat st;
+      if (stat(path.c_str(), &st) == -1) {
+        if (errno == ENOENT) {
+          // Deleted by the log since listed.
+          continue;
+        }
+        throw LogException{"failed to stat log file", errno};
+      }
+      const Version version{
+          static_cast<uint64_t>(st.st_ino),
+          static_cast<int64_t>(st.st_ctim.tv_sec) * 1'000'000'000 +
+              st.st_ctim.tv_nsec};
+      auto it = copied->find(path.filename());
+      if (it != copied->end() && it->second.inode == version.inode &&
+          it->second.changed_ns == version.changed_ns &&
+          std::filesystem::exists(copy)) {
+        continue;
+      }
+      copied->erase(path.filename());
+
+      std::error_code ec;
+      const std::filesystem::file_time_type modified =
+          std::filesystem::last_write_time(path, ec);
+      if (ec == std::errc::no_such_file_or_directory) {
+        continue;
+      }
+      if (ec) {
+        throw LogException{"failed to stat log file", ec.value()};
+      }
+
+      const int err = CopySparse(path, copy);
+      if (err == ENOENT) {
+        continue;
+      }
+      if (err != 0) {
+        throw LogException{"failed to copy log file", err};
+      }
+      std::filesystem::last_write_time(copy, modified);
+      Sync(copy);
+      if (version.changed_ns + 1'000'000'000 < started_ns) {
+        copied->emplace(path.filename(), version);
+      }
+    }
+
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(to)) {
+      const std::string name = entry.path().filename();
+      if (entry.is_regular_file() && name != kMovingName &&
+          names.find(name) == names.end()) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  } catch (const std::filesystem::filesystem_error& e) {
+    throw LogException{"failed to copy log", e.code().value()};
+  }
+  Sync(to);
+}
+
+}  // namespace wombat::broker::log
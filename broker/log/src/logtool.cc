@@ -0,0 +1,124 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/logexception.h"
+#include "log/options.h"
+#include "log/segment.h"
+#include "log/verifier.h"
+
+namespace wombat::broker::log {
+
+const std::string kUsage =  // NOLINT
+    "usage: wombat-log-tool [--threads=<n>] [--index_interval=<bytes>] "
+    "<log directory>...";
+
+// Parses the value of the flag with the given name from arg, such as
+// --threads=4.
+std::optional<uint32_t> ParseFlag(const std::string& arg,
+                                  const std::string& name) {
+  const std::string prefix = "--" + name + "=";
+  if (arg.rfind(prefix, 0) != 0) {
+    return std::nullopt;
+  }
+  try {
+    const uint32_t n = std::stoul(arg.substr(prefix.size()));
+    if (std::to_string(n) == arg.substr(prefix.size())) {
+      return n;
+    }
+  } catch (const std::exception& e) {
+  }
+  return std::nullopt;
+}
+
+std::string Status(const Verifier::Result& result, bool last) {
+  if (result.missing) return "missing";
+  if (result.skipped) return "skipped";
+  if (result.corrupt != 0) return "corrupt";
+  if (result.misplaced) return "misplaced";
+  if (result.partial != 0) return last ? "truncate" : "partial";
+  return "ok";
+}
+
+// Prints the result of each segment, returning false if the log has errors.
+bool Print(const std::filesystem::path& path,
+           const std::vector<Verifier::Result>& results,
+           std::chrono::milliseconds elapsed) {
+  uint64_t bytes = 0;
+  for (size_t i = 0; i != results.size(); ++i) {
+    const Verifier::Result& result = results[i];
+    bytes += result.bytes;
+    std::cout << std::left << std::setw(20) << IdToName(result.id)
+              << std::right << std::setw(12) << result.bytes << " bytes"
+              << std::setw(10) << result.records << " records"
+              << std::setw(10) << result.throughput() / 1'000'000 << " MB/s"
+              << "  " << Status(result, i + 1 == results.size())
+              << (result.corrupt != 0
+                      ? " (" + std::to_string(result.corrupt) + " records)"
+                      : "")
+              << (result.rebuilt ? " rebuilt" : "") << std::endl;
+  }
+
+  const bool ok = Verifier::Ok(results);
+  std::cout << path.string() << ": " << results.size() << " segments, "
+            << bytes << " bytes in " << elapsed.count() << " ms, "
+            << (ok ? "ok" : "errors found") << std::endl;
+  return ok;
+}
+
+int Run(int argc, char** argv) {
+  uint32_t threads = std::thread::hardware_concurrency();
+  Options options{};
+  std::vector<std::filesystem::path> paths;
+  for (int i = 1; i != argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      paths.push_back(arg);
+    } else if (ParseFlag(arg, "threads")) {
+      threads = *ParseFlag(arg, "threads");
+    } else if (ParseFlag(arg, "index_interval")) {
+      options.index_interval = *ParseFlag(arg, "index_interval");
+    } else {
+      std::cerr << kUsage << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << kUsage << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  for (const std::filesystem::path& path : paths) {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    try {
+      const std::vector<Verifier::Result> results =
+          Verifier{path, options, threads}.Verify();
+      ok &= Print(path, results,
+                  std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - start));
+    } catch (const LogException& e) {
+      std::cerr << path.string() << ": " << e.what() << std::endl;
+      ok = false;
+    }
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace wombat::broker::log
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  return wombat::broker::log::Run(argc, argv);
+}
@@ -0,0 +1,177 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/lz4.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace wombat::broker::log {
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+
+// The block format requires the last 5 bytes are literals and the last match
+// starts at least 12 bytes before the end of the block.
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchLimit = 12;
+
+// Matches are encoded with a 16 bit distance.
+constexpr size_t kMaxDistance = 65535;
+
+constexpr int kHashBits = 12;
+
+// Lengths of at least this are continued in the bytes following the token.
+constexpr size_t kMaxTokenLength = 15;
+
+uint32_t Load32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t Hash(uint32_t v) { return (v * 2654435761U) >> (32 - kHashBits); }
+
+void AppendLength(size_t n, std::vector<uint8_t>* out) {
+  n -= kMaxTokenLength;
+  while (n >= 255) {
+    out->push_back(255);
+    n -= 255;
+  }
+  out->push_back(n);
+}
+
+// Appends the literals followed by a match of match_size bytes at distance,
+// or only the literals if match_size is zero, which ends the block.
+void AppendSequence(const uint8_t* literals, size_t literals_size,
+                    size_t distance, size_t match_size,
+                    std::vector<uint8_t>* out) {
+  const size_t match_length = match_size == 0 ? 0 : match_size - kMinMatch;
+  out->push_back((std::min(literals_size, kMaxTokenLength) << 4) |
+                 std::min(match_length, kMaxTokenLength));
+  if (literals_size >= kMaxTokenLength) {
+    AppendLength(literals_size, out);
+  }
+  out->insert(out->end(), literals, literals + literals_size);
+  if (match_size == 0) {
+    return;
+  }
+
+  out->push_back(distance & 0xff);
+  out->push_back(distance >> 8);
+  if (match_length >= kMaxTokenLength) {
+    AppendLength(match_length, out);
+  }
+}
+
+}  // namespace
+
+std::vector<uint8_t> Lz4Compress(const uint8_t* data, size_t size) {
+  std::vector<uint8_t> out;
+  out.reserve(size + size / 255 + 16);
+
+  // Maps the hash of 4 bytes to the last position they were seen, plus one
+  // so zero marks an empty slot.
+  std::vector<uint32_t> table(1 << kHashBits, 0);
+
+  size_t anchor = 0;
+  size_t i = 0;
+  while (size > kMatchLimit && i < size - kMatchLimit) {
+    const uint32_t seq = Load32(data + i);
+    const uint32_t h = Hash(seq);
+    const size_t candidate = table[h];
+    table[h] = i + 1;
+    if (candidate == 0 || i - (candidate - 1) > kMaxDistance ||
+        Load32(data + candidate - 1) != seq) {
+      // Skip ahead faster the longer no match is found, so data that does
+      // not compress is passed over quickly.
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+
+    // Extend the match backwards over any literals then forwards.
+    size_t match = candidate - 1;
+    while (i > anchor && match > 0 && data[i - 1] == data[match - 1]) {
+      --i;
+      --match;
+    }
+    size_t len = kMinMatch;
+    while (i + len < size - kLastLiterals &&
+           data[i + len] == data[match + len]) {
+      ++len;
+    }
+
+    AppendSequence(data + anchor, i - anchor, i - match, len, &out);
+    i += len;
+    anchor = i;
+  }
+  AppendSequence(data + anchor, size - anchor, 0, 0, &out);
+  return out;
+}
+
+bool Lz4Decompress(const uint8_t* src, size_t src_size, uint8_t* dst,
+                   size_t dst_size) {
+  size_t s = 0;
+  size_t d = 0;
+
+  // Adds the continuation bytes of a length to n, returning false if the
+  // block ends first.
+  auto read_length = [&](size_t* n) {
+    uint8_t b;
+    do {
+      if (s == src_size) {
+        return false;
+      }
+      b = src[s++];
+      *n += b;
+    } while (b == 255);
+    return true;
+  };
+
+  while (s < src_size) {
+    const uint8_t token = src[s++];
+
+    size_t literals = token >> 4;
+    if (literals == kMaxTokenLength && !read_length(&literals)) {
+      return false;
+    }
+    if (literals > src_size - s || literals > dst_size - d) {
+      return false;
+    }
+    std::memcpy(dst + d, src + s, literals);
+    s += literals;
+    d += literals;
+
+    // The last sequence has no match.
+    if (s == src_size) {
+      break;
+    }
+
+    if (src_size - s < 2) {
+      return false;
+    }
+    const size_t distance = src[s] | (src[s + 1] << 8);
+    s += 2;
+    if (distance == 0 || distance > d) {
+      return false;
+    }
+    size_t match = token & 0xf;
+    if (match == kMaxTokenLength && !read_length(&match)) {
+      return false;
+    }
+    match += kMinMatch;
+    if (match > dst_size - d) {
+      return false;
+    }
+    // Copy a byte at a time as the match may overlap the bytes it copies.
+    for (size_t j = 0; j != match; ++j, ++d) {
+      dst[d] = dst[d - distance];
+    }
+  }
+  return d == dst_size;
+}
+
+}  // namespace wombat::broker::log
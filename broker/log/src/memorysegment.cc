@@ -0,0 +1,82 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/memorysegment.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+MemorySegment::MemorySegment(uint32_t id, uint32_t limit)
+    : Segment{IdToName(id), limit}, map_{nullptr} {
+  fd_ = memfd_create(path_.c_str(), MFD_CLOEXEC);
+  if (fd_ == -1) {
+    throw LogException{"memfd_create failed", errno};
+  }
+  if (ftruncate(fd_, limit_) == -1) {
+    close(fd_);
+    throw LogException{"segment ftruncate failed", errno};
+  }
+
+  // Cannot map an empty file.
+  if (limit_ == 0) return;
+
+  // Populate the mapping so appends never fault in pages.
+  void* map = mmap(nullptr, limit_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, 0);
+  if (map == MAP_FAILED) {
+    close(fd_);
+    throw LogException{"failed to mmap segment", errno};
+  }
+  map_ = static_cast<uint8_t*>(map);
+}
+
+MemorySegment::~MemorySegment() {
+  if (map_ != nullptr) {
+    munmap(map_, limit_);
+  }
+  if (fd_ > 0) {
+    close(fd_);
+  }
+}
+
+void MemorySegment::Append(const std::vector<uint8_t>& data) {
+  if (data.size() > available()) {
+    throw LogException{"memory segment full"};
+  }
+  if (data.empty()) return;
+
+  std::memcpy(map_ + size_, data.data(), data.size());
+  size_ += data.size();
+}
+
+std::vector<uint8_t> MemorySegment::Lookup(uint32_t offset, uint32_t size) {
+  std::optional<View> view = LookupView(offset, size);
+  if (!view) {
+    return {};
+  }
+  return std::vector<uint8_t>(view->data, view->data + view->size);
+}
+
+std::optional<View> MemorySegment::LookupView(uint32_t offset, uint32_t size) {
+  // Match Segment::Lookup by treating a read past the end as EOF.
+  if (map_ == nullptr || offset > size_ || size > size_ - offset) {
+    return std::nullopt;
+  }
+  return View{map_ + offset, size};
+}
+
+void MemorySegment::Truncate(uint32_t size) {
+  if (size < size_) {
+    size_ = size;
+  }
+}
+
+}  // namespace wombat::broker::log
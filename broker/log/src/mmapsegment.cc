@@ -0,0 +1,86 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/mmapsegment.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+MmapSegment::MmapSegment(uint32_t id, const std::filesystem::path& dir)
+    : Segment{dir / IdToName(id), 0}, map_{nullptr} {
+  fd_ = open(path_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    throw LogException{"failed to open segment", errno};
+  }
+
+  size_ = Size();
+  // The segment is sealed so is always full.
+  limit_ = size_;
+
+  // Cannot map an empty file.
+  if (size_ == 0) return;
+
+  void* map = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    close(fd_);
+    throw LogException{"failed to mmap segment", errno};
+  }
+  map_ = static_cast<uint8_t*>(map);
+}
+
+MmapSegment::~MmapSegment() {
+  if (map_ != nullptr) {
+    munmap(map_, size_);
+  }
+  if (fd_ > 0) {
+    close(fd_);
+  }
+}
+
+MmapSegment::MmapSegment(MmapSegment&& segment)
+    : Segment{std::move(segment)}, map_{segment.map_} {
+  // Set moved from map to null to avoid unmapping.
+  segment.map_ = nullptr;
+}
+
+MmapSegment& MmapSegment::operator=(MmapSegment&& segment) {
+  Segment::operator=(std::move(segment));
+  map_ = segment.map_;
+  // Set moved from map to null to avoid unmapping.
+  segment.map_ = nullptr;
+  return *this;
+}
+
+void MmapSegment::Append(const std::vector<uint8_t>& data) {
+  throw LogException{"cannot append to sealed segment"};
+}
+
+std::vector<uint8_t> MmapSegment::Lookup(uint32_t offset, uint32_t size) {
+  std::optional<View> view = LookupView(offset, size);
+  if (!view) {
+    return {};
+  }
+  return std::vector<uint8_t>(view->data, view->data + view->size);
+}
+
+std::optional<View> MmapSegment::LookupView(uint32_t offset, uint32_t size) {
+  // Match Segment::Lookup by treating a read past the end as EOF.
+  if (map_ == nullptr || offset >= size_ || size > size_ - offset) {
+    return std::nullopt;
+  }
+  return View{map_ + offset, size};
+}
+
+}  // namespace wombat::broker::log
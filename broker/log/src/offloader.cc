@@ -0,0 +1,47 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/offloader.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+Offloader::Offloader(std::chrono::milliseconds interval,
+                     std::function<void()> offload)
+    : interval_{interval}, offload_{std::move(offload)}, running_{true} {
+  thread_ = std::thread{&Offloader::Run, this};
+}
+
+Offloader::~Offloader() {
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void Offloader::Run() {
+  std::unique_lock<std::mutex> lk(mut_);
+  while (running_) {
+    cv_.wait_for(lk, interval_, [this] { return !running_; });
+    if (!running_) break;
+
+    lk.unlock();
+    try {
+      offload_();
+    } catch (const LogException& e) {
+      // Retry on the next interval in case the store was unavailable. Note
+      // LogException logs the error.
+    }
+    lk.lock();
+  }
+}
+
+}  // namespace wombat::broker::log
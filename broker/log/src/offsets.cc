@@ -2,8 +2,10 @@
 
 #include <arpa/inet.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -13,63 +15,166 @@
 
 namespace wombat::broker::log {
 
-Offsets::Offsets(std::shared_ptr<Segment> segment)
-    : offsets_{}, segment_{std::move(segment)} {
-  uint32_t offset = 0;
-  while (LoadOffset(offset)) {
-    offset += 8;
-  }
+Offsets::Offsets(std::shared_ptr<Segment> segment,
+                 std::shared_ptr<Segment> start)
+    : entries_{},
+      segment_{std::move(segment)},
+      start_segment_{std::move(start)},
+      start_{0} {
+  LoadOffsets();
+  LoadStart();
 }
 
-bool Offsets::Lookup(uint32_t offset, uint32_t* id, uint32_t* start) {
-  for (auto it = offsets_.rbegin(); it != offsets_.rend(); ++it) {
-    if (it->first <= offset) {
-      *start = it->first;
-      *id = it->second;
-      return true;
-    }
+bool Offsets::Lookup(uint64_t offset, uint32_t* id, uint64_t* start) const {
+  if (entries_.empty() || offset < entries_.front().offset) {
+    return false;
   }
-  return false;
+
+  // Most lookups are in the active segment so check the last entry first.
+  if (offset >= entries_.back().offset) {
+    *start = entries_.back().offset;
+    *id = entries_.back().id;
+    return true;
+  }
+
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), offset,
+      [](uint64_t o, const Entry& entry) { return o < entry.offset; });
+  // Never the first entry as offset is at least the first entries offset.
+  --it;
+  *start = it->offset;
+  *id = it->id;
+  return true;
 }
 
-uint32_t Offsets::MaxOffset() {
-  if (!offsets_.empty()) {
-    return offsets_.rbegin()->first;
+uint64_t Offsets::MaxOffset() const {
+  if (!entries_.empty()) {
+    return entries_.back().offset;
   }
   return 0;
 }
 
-void Offsets::Insert(uint32_t offset, uint32_t id) {
-  WriteU32(offset);
-  WriteU32(id);
-  offsets_.emplace(offset, id);
+bool Offsets::Start(uint32_t id, uint64_t* start) const {
+  // Segment ids increase with offset so the entries are also sorted by id.
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), id,
+      [](const Entry& entry, uint32_t i) { return entry.id < i; });
+  if (it == entries_.end() || it->id != id) {
+    return false;
+  }
+  *start = it->offset;
+  return true;
+}
+
+void Offsets::Insert(uint64_t offset, uint32_t id) {
+  // Write the entry with a single append.
+  std::vector<uint8_t> enc{};
+  EncodeU64(offset, &enc);
+  EncodeU32(id, &enc);
+  segment_->Append(enc);
+  entries_.push_back(Entry{offset, id});
 }
 
-bool Offsets::LoadOffset(uint32_t offset) {
-  uint32_t loaded_offset;
-  if (!ReadU32(offset, &loaded_offset)) return false;
-  uint32_t loaded_id;
-  if (!ReadU32(offset + 4, &loaded_id)) return false;
-  offsets_.emplace(loaded_offset, loaded_id);
+void Offsets::Truncate(uint64_t offset) {
+  EraseBefore(offset);
+  start_ = offset;
 
-  return true;
+  if (start_segment_) {
+    // The start only increases so the latest start is appended.
+    std::vector<uint8_t> enc{};
+    EncodeU64(offset, &enc);
+    start_segment_->Append(enc);
+    start_segment_->Sync();
+  }
 }
 
-void Offsets::WriteU32(uint32_t n) {
+void Offsets::Sync() { segment_->Sync(); }
+
+void Offsets::LoadOffsets() {
+  Load(segment_.get(), sizeof(uint32_t),
+       [this](uint64_t offset, const uint8_t* suffix) {
+         const uint32_t id = DecodeU32(suffix);
+         // Entries are appended in order, though an entry for an existing
+         // offset is ignored as the first entry for an offset is used.
+         if (entries_.empty() || offset > entries_.back().offset) {
+           entries_.push_back(Entry{offset, id});
+         }
+       });
+}
+
+void Offsets::LoadStart() {
+  if (!start_segment_) return;
+
+  Load(start_segment_.get(), 0,
+       [this](uint64_t offset, const uint8_t*) { start_ = offset; });
+  EraseBefore(start_);
+}
+
+void Offsets::EraseBefore(uint64_t offset) {
+  entries_.erase(entries_.begin(),
+                 std::lower_bound(entries_.begin(), entries_.end(), offset,
+                                  [](const Entry& entry, uint64_t o) {
+                                    return entry.offset < o;
+                                  }));
+}
+
+void Offsets::Load(Segment* segment, uint32_t suffix,
+                   const std::function<void(uint64_t, const uint8_t*)>& fn) {
+  const std::vector<uint8_t> enc = segment->Lookup(0, segment->size());
+
+  uint32_t position = 0;
+  bool wide = false;
+  while (true) {
+    const uint32_t remaining = enc.size() - position;
+    if (!wide) {
+      if (remaining < sizeof(uint32_t)) break;
+      if (DecodeU32(enc.data() + position) == kWideMarker) {
+        wide = true;
+        position += sizeof(uint32_t);
+        continue;
+      }
+    }
+
+    const uint32_t width = wide ? sizeof(uint64_t) : sizeof(uint32_t);
+    if (remaining < width + suffix) break;
+
+    const uint64_t offset = wide ? DecodeU64(enc.data() + position)
+                                 : DecodeU32(enc.data() + position);
+    fn(offset, enc.data() + position + width);
+    position += width + suffix;
+  }
+
+  if (segment->size() != position) {
+    // Discard a partially written entry so later entries are aligned.
+    segment->Truncate(position);
+  }
+  if (!wide) {
+    std::vector<uint8_t> marker{};
+    EncodeU32(kWideMarker, &marker);
+    segment->Append(marker);
+  }
+}
+
+void Offsets::EncodeU32(uint32_t n, std::vector<uint8_t>* enc) {
   uint32_t ordered = htonl(n);
-  std::vector<uint8_t> enc{(uint8_t)(ordered >> 0), (uint8_t)(ordered >> 8),
-                           (uint8_t)(ordered >> 16), (uint8_t)(ordered >> 24)};
-  segment_->Append(enc);
+  enc->insert(enc->end(), {(uint8_t)(ordered >> 0), (uint8_t)(ordered >> 8),
+                           (uint8_t)(ordered >> 16), (uint8_t)(ordered >> 24)});
 }
 
-bool Offsets::ReadU32(uint32_t offset, uint32_t* n) {
-  std::vector<uint8_t> enc = segment_->Lookup(offset, 4);
-  if (enc.empty()) return false;
+void Offsets::EncodeU64(uint64_t n, std::vector<uint8_t>* enc) {
+  EncodeU32(n >> 32, enc);
+  EncodeU32(n, enc);
+}
 
-  std::memcpy(n, enc.data(), 4);
+uint32_t Offsets::DecodeU32(const uint8_t* enc) {
+  uint32_t n;
+  std::memcpy(&n, enc, sizeof(n));
+  return ntohl(n);
+}
 
-  *n = ntohl(*n);
-  return true;
+uint64_t Offsets::DecodeU64(const uint8_t* enc) {
+  return (static_cast<uint64_t>(DecodeU32(enc)) << 32) |
+         DecodeU32(enc + sizeof(uint32_t));
 }
 
 }  // namespace wombat::broker::log
@@ -0,0 +1,68 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/readahead.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace wombat::broker::log {
+
+Readahead::Readahead(uint32_t window, std::chrono::milliseconds idle)
+    : window_{window}, idle_{idle}, streams_{} {
+  streams_.reserve(kStreams);
+}
+
+bool Readahead::Lookup(uint64_t offset, uint32_t size, uint64_t* from,
+                       uint32_t* ahead) {
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  std::lock_guard lock{mutex_};
+
+  auto it = std::find_if(
+      streams_.begin(), streams_.end(), [offset](const Stream& stream) {
+        return offset >= stream.offset && offset <= stream.end;
+      });
+  if (it == streams_.end()) {
+    const Stream stream{offset, offset + size, offset + size, false, now};
+    if (streams_.size() < kStreams) {
+      streams_.push_back(stream);
+    } else {
+      *std::min_element(streams_.begin(), streams_.end(),
+                        [](const Stream& a, const Stream& b) {
+                          return a.used < b.used;
+                        }) = stream;
+    }
+    return false;
+  }
+
+  if (offset > it->offset) {
+    it->sequential = true;
+  }
+  it->offset = offset;
+  it->end = std::max(it->end, offset + size);
+  it->used = now;
+  if (!it->sequential || it->ahead >= it->end + window_ / 2) {
+    return false;
+  }
+
+  *from = std::max(it->ahead, it->end);
+  *ahead = it->end + window_ - *from;
+  it->ahead = it->end + window_;
+  return true;
+}
+
+bool Readahead::Reading(uint64_t start, uint64_t end) const {
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  std::lock_guard lock{mutex_};
+  return std::any_of(
+      streams_.begin(), streams_.end(), [&](const Stream& stream) {
+        return stream.sequential && now - stream.used < idle_ &&
+               stream.end >= start && stream.end < end;
+      });
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,286 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/recordbatch.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "log/crc32c.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Positions of the header fields in the encoded batch.
+constexpr uint32_t kBaseOffsetPosition = 4;
+constexpr uint32_t kCrcPosition = 12;
+constexpr uint32_t kAttributesPosition = 16;
+constexpr uint32_t kCountPosition = 18;
+constexpr uint32_t kFirstTimestampPosition = 22;
+constexpr uint32_t kMaxTimestampPosition = 30;
+
+// Maximum size of an unsigned 64 bit varint.
+constexpr uint32_t kMaxVarintSize = 10;
+
+uint32_t VarintSize(uint64_t n) {
+  uint32_t size = 1;
+  while (n >= 0x80) {
+    n >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+void PutVarint(uint64_t n, std::vector<uint8_t>* enc) {
+  while (n >= 0x80) {
+    enc->push_back(static_cast<uint8_t>(n) | 0x80);
+    n >>= 7;
+  }
+  enc->push_back(static_cast<uint8_t>(n));
+}
+
+// Decodes a varint at *data, advancing *data past it. Returns false if the
+// varint does not end before end.
+bool GetVarint(const uint8_t** data, const uint8_t* end, uint64_t* n) {
+  *n = 0;
+  for (uint32_t i = 0; i != kMaxVarintSize && *data != end; ++i) {
+    const uint8_t b = *(*data)++;
+    *n |= static_cast<uint64_t>(b & 0x7f) << (7 * i);
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PutU16(uint16_t n, uint8_t* enc) {
+  n = htons(n);
+  std::memcpy(enc, &n, sizeof(n));
+}
+
+void PutU32(uint32_t n, uint8_t* enc) {
+  n = htonl(n);
+  std::memcpy(enc, &n, sizeof(n));
+}
+
+void PutU64(uint64_t n, uint8_t* enc) {
+  PutU32(n >> 32, enc);
+  PutU32(n, enc + sizeof(uint32_t));
+}
+
+uint16_t GetU16(const uint8_t* enc) {
+  uint16_t n;
+  std::memcpy(&n, enc, sizeof(n));
+  return ntohs(n);
+}
+
+uint32_t GetU32(const uint8_t* enc) {
+  uint32_t n;
+  std::memcpy(&n, enc, sizeof(n));
+  return ntohl(n);
+}
+
+uint64_t GetU64(const uint8_t* enc) {
+  return (static_cast<uint64_t>(GetU32(enc)) << 32) |
+         GetU32(enc + sizeof(uint32_t));
+}
+
+}  // namespace
+
+RecordBatch::Builder::Builder()
+    : records_{},
+      keyed_{},
+      first_timestamp_{std::numeric_limits<uint64_t>::max()},
+      max_timestamp_{0} {}
+
+uint32_t RecordBatch::Builder::size() const {
+  uint32_t size = kHeaderSize;
+  for (const Record& record : records_) {
+    size += VarintSize(record.timestamp - first_timestamp_);
+    if (*keyed_) {
+      size += VarintSize(record.key.size()) + record.key.size();
+      size += record.value ? VarintSize(record.value->size() + 1) +
+                                 record.value->size()
+                           : VarintSize(0);
+    } else {
+      size += VarintSize(record.value->size()) + record.value->size();
+    }
+  }
+  return size;
+}
+
+void RecordBatch::Builder::Add(uint64_t timestamp,
+                               const std::vector<uint8_t>& data) {
+  if (keyed_.value_or(false)) {
+    throw std::invalid_argument{"record batch is keyed"};
+  }
+  keyed_ = false;
+  first_timestamp_ = std::min(first_timestamp_, timestamp);
+  max_timestamp_ = std::max(max_timestamp_, timestamp);
+  records_.push_back(Record{timestamp, {}, data});
+}
+
+void RecordBatch::Builder::Add(
+    uint64_t timestamp, const std::vector<uint8_t>& key,
+    const std::optional<std::vector<uint8_t>>& value) {
+  if (!keyed_.value_or(true)) {
+    throw std::invalid_argument{"record batch is not keyed"};
+  }
+  keyed_ = true;
+  first_timestamp_ = std::min(first_timestamp_, timestamp);
+  max_timestamp_ = std::max(max_timestamp_, timestamp);
+  records_.push_back(Record{timestamp, key, value});
+}
+
+std::vector<uint8_t> RecordBatch::Builder::Build() const {
+  std::vector<uint8_t> enc(kHeaderSize);
+  enc.reserve(size());
+  const uint64_t first = empty() ? 0 : first_timestamp_;
+  const bool keyed = keyed_.value_or(false);
+  for (const Record& record : records_) {
+    PutVarint(record.timestamp - first, &enc);
+    if (keyed) {
+      PutVarint(record.key.size(), &enc);
+      enc.insert(enc.end(), record.key.begin(), record.key.end());
+      PutVarint(record.value ? record.value->size() + 1 : 0, &enc);
+    } else {
+      PutVarint(record.value->size(), &enc);
+    }
+    if (record.value) {
+      enc.insert(enc.end(), record.value->begin(), record.value->end());
+    }
+  }
+
+  PutU32(enc.size() - sizeof(uint32_t), enc.data());
+  PutU64(0, enc.data() + kBaseOffsetPosition);
+  PutU16(keyed ? kKeyedAttribute : 0, enc.data() + kAttributesPosition);
+  PutU32(records_.size(), enc.data() + kCountPosition);
+  PutU64(first, enc.data() + kFirstTimestampPosition);
+  PutU64(max_timestamp_, enc.data() + kMaxTimestampPosition);
+  PutU32(Crc32c(enc.data() + kAttributesPosition,
+                enc.size() - kAttributesPosition),
+         enc.data() + kCrcPosition);
+  return enc;
+}
+
+std::optional<RecordBatch> RecordBatch::Parse(View enc) {
+  if (enc.size < kHeaderSize) {
+    return std::nullopt;
+  }
+
+  Header header{};
+  header.length = GetU32(enc.data);
+  header.base_offset = GetU64(enc.data + kBaseOffsetPosition);
+  header.crc = GetU32(enc.data + kCrcPosition);
+  header.attributes = GetU16(enc.data + kAttributesPosition);
+  header.count = GetU32(enc.data + kCountPosition);
+  header.first_timestamp = GetU64(enc.data + kFirstTimestampPosition);
+  header.max_timestamp = GetU64(enc.data + kMaxTimestampPosition);
+
+  // Only the header of padding is stored, so padding may be parsed from its
+  // header alone.
+  if (header.attributes == kPaddingAttribute && header.count == 0 &&
+      header.length >= kHeaderSize - sizeof(uint32_t)) {
+    return RecordBatch{View{enc.data, kHeaderSize}, header};
+  }
+  if (header.length != enc.size - sizeof(uint32_t)) {
+    return std::nullopt;
+  }
+  return RecordBatch{enc, header};
+}
+
+std::vector<uint8_t> RecordBatch::Padding(uint64_t base_offset,
+                                          uint32_t size) {
+  std::vector<uint8_t> enc(kHeaderSize);
+  PutU32(size - sizeof(uint32_t), enc.data());
+  PutU64(base_offset, enc.data() + kBaseOffsetPosition);
+  PutU16(kPaddingAttribute, enc.data() + kAttributesPosition);
+  PutU32(Crc32c(enc.data() + kAttributesPosition,
+                kHeaderSize - kAttributesPosition),
+         enc.data() + kCrcPosition);
+  return enc;
+}
+
+bool RecordBatch::VerifyCrc() const {
+  return Crc32c(enc_.data + kAttributesPosition,
+                enc_.size - kAttributesPosition) == header_.crc;
+}
+
+bool RecordBatch::Validate() const {
+  // Compression is not supported so only the keyed attribute may be set.
+  if ((header_.attributes & ~kKeyedAttribute) != 0 || !VerifyCrc()) {
+    return false;
+  }
+  uint32_t count = 0;
+  if (!ForEach([&count](const Record&) {
+        ++count;
+        return true;
+      })) {
+    return false;
+  }
+  return count == header_.count;
+}
+
+bool RecordBatch::ForEach(
+    const std::function<bool(const Record& record)>& fn) const {
+  const uint8_t* data = enc_.data + kHeaderSize;
+  const uint8_t* end = enc_.data + enc_.size;
+  while (data != end) {
+    Record record{};
+    uint64_t delta;
+    if (!GetVarint(&data, end, &delta)) {
+      return false;
+    }
+    record.timestamp = header_.first_timestamp + delta;
+
+    uint64_t size;
+    if (keyed()) {
+      if (!GetVarint(&data, end, &size) ||
+          size > static_cast<uint64_t>(end - data)) {
+        return false;
+      }
+      record.key = View{data, static_cast<uint32_t>(size)};
+      data += size;
+      if (!GetVarint(&data, end, &size)) {
+        return false;
+      }
+      // Zero marks a tombstone, otherwise the size is offset by one.
+      if (size == 0) {
+        if (!fn(record)) {
+          return true;
+        }
+        continue;
+      }
+      --size;
+    } else if (!GetVarint(&data, end, &size)) {
+      return false;
+    }
+    if (size > static_cast<uint64_t>(end - data)) {
+      return false;
+    }
+    record.value = View{data, static_cast<uint32_t>(size)};
+    if (!fn(record)) {
+      return true;
+    }
+    data += size;
+  }
+  return true;
+}
+
+void RecordBatch::SetBaseOffset(uint8_t* enc, uint64_t base_offset) {
+  PutU64(base_offset, enc + kBaseOffsetPosition);
+}
+
+RecordBatch::RecordBatch(View enc, Header header)
+    : enc_{enc}, header_{header} {}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,256 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/ring.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "log/logexception.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Uses the system calls directly to avoid depending on liburing.
+int SysSetup(uint32_t entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int SysEnter(int fd, uint32_t to_submit, uint32_t min_complete,
+             uint32_t flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                 nullptr, 0);
+}
+
+int SysRegister(int fd, uint32_t opcode, void* arg, uint32_t nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+uint32_t* Offset(void* ring, uint32_t offset) {
+  return reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+}  // namespace
+
+Ring::Ring(uint32_t entries)
+    : sq_ring_{MAP_FAILED},
+      cq_ring_{MAP_FAILED},
+      sqes_{nullptr},
+      queued_{0},
+      next_id_{0},
+      callbacks_{} {
+  io_uring_params params{};
+  fd_ = SysSetup(entries, &params);
+  if (fd_ == -1) {
+    throw LogException{"io_uring_setup failed", errno};
+  }
+  entries_ = params.sq_entries;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  // Newer kernels map both rings with a single mmap.
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    cq_ring_size_ = sq_ring_size_;
+  }
+
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    close(fd_);
+    throw LogException{"failed to mmap io_uring", errno};
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+      close(fd_);
+      throw LogException{"failed to mmap io_uring", errno};
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    if (cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    close(fd_);
+    throw LogException{"failed to mmap io_uring", errno};
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  sq_head_ = Offset(sq_ring_, params.sq_off.head);
+  sq_tail_ = Offset(sq_ring_, params.sq_off.tail);
+  sq_mask_ = Offset(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = Offset(sq_ring_, params.sq_off.array);
+
+  cq_head_ = Offset(cq_ring_, params.cq_off.head);
+  cq_tail_ = Offset(cq_ring_, params.cq_off.tail);
+  cq_mask_ = Offset(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(
+      static_cast<uint8_t*>(cq_ring_) + params.cq_off.cqes);
+}
+
+Ring::~Ring() {
+  try {
+    Drain();
+  } catch (const LogException& e) {
+    // Cannot throw from the destructor. Note LogException logs the error.
+  }
+
+  munmap(sqes_, sqes_size_);
+  if (cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  munmap(sq_ring_, sq_ring_size_);
+  close(fd_);
+}
+
+bool Ring::Supported() {
+  io_uring_params params{};
+  const int fd = SysSetup(1, &params);
+  if (fd == -1) {
+    return false;
+  }
+
+  // Check the kernel supports each operation used.
+  std::vector<uint8_t> buf(sizeof(io_uring_probe) +
+                           IORING_OP_LAST * sizeof(io_uring_probe_op));
+  io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buf.data());
+  const bool ok =
+      SysRegister(fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0 &&
+      probe->last_op >= IORING_OP_WRITE &&
+      (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+      (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) &&
+      (probe->ops[IORING_OP_FSYNC].flags & IO_URING_OP_SUPPORTED);
+  close(fd);
+  return ok;
+}
+
+void Ring::Write(int fd, const uint8_t* data, uint32_t size, uint64_t offset,
+                 Callback callback) {
+  Queue(IORING_OP_WRITE, fd, reinterpret_cast<uint64_t>(data), size, offset,
+        0, std::move(callback));
+}
+
+void Ring::Read(int fd, uint8_t* data, uint32_t size, uint64_t offset,
+                Callback callback) {
+  Queue(IORING_OP_READ, fd, reinterpret_cast<uint64_t>(data), size, offset, 0,
+        std::move(callback));
+}
+
+void Ring::Sync(int fd, Callback callback) {
+  Queue(IORING_OP_FSYNC, fd, 0, 0, 0, IORING_FSYNC_DATASYNC,
+        std::move(callback));
+}
+
+void Ring::Poll(bool wait) {
+  const uint32_t min_complete = (wait && !callbacks_.empty()) ? 1 : 0;
+  if (queued_ != 0 || min_complete != 0) {
+    Enter(min_complete);
+  }
+  Reap(true);
+}
+
+void Ring::Drain() {
+  while (!callbacks_.empty()) {
+    Enter(1);
+    Reap(false);
+  }
+}
+
+void Ring::Queue(uint8_t opcode, int fd, uint64_t addr, uint32_t len,
+                 uint64_t offset, uint32_t flags, Callback callback) {
+  // Limiting the operations in flight to the ring size ensures there is
+  // always space in the submission queue and the completion queue cannot
+  // overflow.
+  while (callbacks_.size() >= entries_) {
+    Poll(true);
+  }
+
+  const uint32_t tail = *sq_tail_;
+  const uint32_t index = tail & *sq_mask_;
+
+  io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = len;
+  sqe->off = offset;
+  sqe->fsync_flags = flags;
+  sqe->user_data = next_id_;
+  sq_array_[index] = index;
+
+  // Publish the entry to the kernel.
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  ++queued_;
+
+  callbacks_.emplace(next_id_, std::move(callback));
+  ++next_id_;
+}
+
+void Ring::Enter(uint32_t min_complete) {
+  const uint32_t flags = (min_complete != 0) ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    const int res = SysEnter(fd_, queued_, min_complete, flags);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw LogException{"io_uring_enter failed", errno};
+    }
+    queued_ -= res;
+    return;
+  }
+}
+
+void Ring::Reap(bool run) {
+  std::vector<std::pair<Callback, int32_t>> completed;
+
+  uint32_t head = *cq_head_;
+  const uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+    auto it = callbacks_.find(cqe.user_data);
+    if (it != callbacks_.end()) {
+      completed.emplace_back(std::move(it->second), cqe.res);
+      callbacks_.erase(it);
+    }
+    ++head;
+  }
+  // Release the entries to the kernel.
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+  // Callbacks are run after the completion queue is released as they may
+  // queue further operations. Every callback is run even if one throws, as
+  // the operations have already been removed so would otherwise never
+  // complete.
+  if (run) {
+    std::exception_ptr error;
+    for (const auto& [callback, res] : completed) {
+      try {
+        callback(res);
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,72 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/scan.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "log/segment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Number of bytes read from the segment at a time.
+constexpr uint32_t kScanChunkSize = 64 * 1024;
+
+}  // namespace
+
+uint32_t ScanRecords(Segment* segment, uint32_t from, uint32_t to,
+                     const std::function<bool(uint32_t, View)>& fn) {
+  std::vector<uint8_t> buf;
+  uint32_t position = from;
+  uint32_t needed = kScanChunkSize;
+  while (position < to && to - position >= kRecordPrefixSize) {
+    const uint32_t len = std::min(needed, to - position);
+    needed = kScanChunkSize;
+
+    View chunk;
+    std::optional<View> view = segment->LookupView(position, len);
+    if (view) {
+      chunk = *view;
+    } else {
+      buf = segment->Lookup(position, len);
+      if (buf.empty()) return position;
+      chunk = View{buf.data(), len};
+    }
+
+    uint32_t n = 0;
+    while (chunk.size - n >= kRecordPrefixSize) {
+      uint32_t size;
+      std::memcpy(&size, chunk.data + n, kRecordPrefixSize);
+      size = ntohl(size);
+
+      // Compare without adding to the size as a corrupt size may overflow.
+      if (size > to - position - n - kRecordPrefixSize) {
+        // The record extends past the end of the range so is incomplete.
+        return position + n;
+      }
+      if (size > chunk.size - n - kRecordPrefixSize) {
+        // The record extends past the end of the chunk so read it next.
+        needed = kRecordPrefixSize + size;
+        break;
+      }
+
+      if (!fn(position + n, View{chunk.data + n, kRecordPrefixSize + size})) {
+        return position + n;
+      }
+      n += kRecordPrefixSize + size;
+    }
+    position += n;
+  }
+  return position;
+}
+
+}  // namespace wombat::broker::log
@@ -8,8 +8,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <optional>
 
 #include "glog/logging.h"
 #include "log/logexception.h"
@@ -19,7 +23,12 @@ namespace wombat::broker::log {
 Segment::Segment(Segment&& segment) {
   path_ = std::move(segment.path_);
   size_ = segment.size_;
+  limit_ = segment.limit_;
   fd_ = segment.fd_;
+  buffer_ = std::move(segment.buffer_);
+  buffer_limit_ = segment.buffer_limit_;
+  linger_ = segment.linger_;
+  buffered_at_ = segment.buffered_at_;
   // Set moved from fd to negative to avoid closing.
   segment.fd_ = -1;
 }
@@ -27,51 +36,81 @@ Segment::Segment(Segment&& segment) {
 Segment& Segment::operator=(Segment&& segment) {
   path_ = std::move(segment.path_);
   size_ = segment.size_;
+  limit_ = segment.limit_;
   fd_ = segment.fd_;
+  buffer_ = std::move(segment.buffer_);
+  buffer_limit_ = segment.buffer_limit_;
+  linger_ = segment.linger_;
+  buffered_at_ = segment.buffered_at_;
   // Set moved from fd to negative to avoid closing.
   segment.fd_ = -1;
 
   return *this;
 }
 
+void Segment::EnableBuffering(uint32_t size, std::chrono::milliseconds linger) {
+  buffer_limit_ = size;
+  linger_ = linger;
+  buffer_.reserve(size);
+}
+
 void Segment::Append(const std::vector<uint8_t>& data) {
-  // Must seek end as O_APPEND cannot be used.
-  if (lseek(fd_, 0, SEEK_END) == -1) {
-    LOG(ERROR) << "segment append failed - lseek " << strerror(errno);
-    throw LogException{"segment lseek error", errno};
+  if (buffer_limit_ == 0) {
+    Write(data.data(), data.size());
+    size_ += data.size();
+    return;
   }
 
-  ssize_t size = data.size();
-  ssize_t n = 0;
-  while (n < size) {
-    ssize_t written = write(fd_, data.data(), data.size());
-    if (written == -1) {
-      throw LogException{"segment write error", errno};
-    }
-    n += written;
+  if (buffer_.empty()) {
+    buffered_at_ = std::chrono::steady_clock::now();
   }
+  buffer_.insert(buffer_.end(), data.begin(), data.end());
   size_ += data.size();
+
+  if (buffer_.size() >= buffer_limit_) {
+    Flush();
+  } else {
+    Poll();
+  }
 }
 
 std::vector<uint8_t> Segment::Lookup(uint32_t offset, uint32_t size) {
-  if (lseek(fd_, offset, SEEK_SET) == -1) {
-    throw LogException{"segment lseek error", errno};
+  // Reads past the end of the segment return nothing.
+  if (offset > size_ || size > size_ - offset) {
+    return {};
   }
+
   std::vector<uint8_t> data(size);
-  ssize_t remaining = size;
-  while (0 < remaining) {
-    ssize_t n = read(fd_, data.data(), data.size());
-    if (n == -1) {
-      throw LogException{"segment read error", errno};
-    } else if (n == 0) {  // EOF
+  // Read the part in the file then copy the rest from the buffer.
+  const uint32_t end = written();
+  uint32_t n = 0;
+  if (offset < end) {
+    n = std::min(size, end - offset);
+    if (!Read(offset, data.data(), n)) {
       return {};
     }
-    remaining -= n;
+  }
+  if (n < size) {
+    std::memcpy(data.data() + n, buffer_.data() + (offset + n - end),
+                size - n);
   }
   return data;
 }
 
+std::optional<View> Segment::LookupView(uint32_t offset, uint32_t size) {
+  // Only buffered appends are in memory so can be viewed.
+  if (offset < written() || offset > size_ || size > size_ - offset) {
+    return std::nullopt;
+  }
+  return View{buffer_.data() + (offset - written()), size};
+}
+
 uint32_t Segment::Send(uint32_t offset, uint32_t size, int fd) {
+  // sendfile reads from the file so buffered appends must be written first.
+  if (offset + size > written()) {
+    Flush();
+  }
+
   off_t off = offset;
   ssize_t written = sendfile(fd, fd_, &off, size);
   if (written == -1) {
@@ -84,6 +123,66 @@ uint32_t Segment::Send(uint32_t offset, uint32_t size, int fd) {
   return written;
 }
 
+void Segment::Flush() {
+  if (buffer_.empty()) return;
+
+  Write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void Segment::Poll() {
+  if (!buffer_.empty() &&
+      std::chrono::steady_clock::now() - buffered_at_ >= linger_) {
+    Flush();
+  }
+}
+
+void Segment::Preallocate() {
+  // Keep the size so the allocated space is not mistaken for appended data.
+  if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, limit_) == -1) {
+    if (errno == EOPNOTSUPP) {
+      LOG(WARNING) << "segment preallocation not supported: " << path_;
+      return;
+    }
+    throw LogException{"segment fallocate failed", errno};
+  }
+}
+
+void Segment::Truncate(uint32_t size) {
+  // Write any buffered appends first so the file and size stay consistent.
+  Flush();
+  if (ftruncate(fd_, size) == -1) {
+    throw LogException{"segment ftruncate failed", errno};
+  }
+  size_ = size;
+}
+
+void Segment::Sync() {
+  if (fdatasync(fd_) == -1) {
+    throw LogException{"segment fdatasync failed", errno};
+  }
+}
+
+// Errors are ignored as the hints only affect performance.
+
+void Segment::WillNeed(uint32_t offset, uint32_t size) {
+  if (fd_ != -1) {
+    readahead(fd_, offset, size);
+  }
+}
+
+void Segment::DontNeed(uint32_t offset, uint32_t size) {
+  if (fd_ != -1) {
+    posix_fadvise(fd_, offset, size, POSIX_FADV_DONTNEED);
+  }
+}
+
+void Segment::AdviseSequential() {
+  if (fd_ != -1) {
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+}
+
 uint32_t Segment::Size() const {
   off_t seek = lseek(fd_, 0, SEEK_END);
   if (seek == -1) {
@@ -93,7 +192,42 @@ uint32_t Segment::Size() const {
 }
 
 Segment::Segment(const std::filesystem::path& path, uint32_t limit)
-    : path_{path}, size_{0}, limit_{limit} {}
+    : path_{path},
+      size_{0},
+      limit_{limit},
+      buffer_{},
+      buffer_limit_{0},
+      linger_{0} {}
+
+void Segment::Write(const uint8_t* data, size_t size) {
+  // Write at the tracked end of the file so no seek is needed. Note cannot
+  // use O_APPEND as this does not work with sendfile.
+  const off_t end = written();
+  size_t n = 0;
+  while (n < size) {
+    ssize_t res = pwrite(fd_, data + n, size - n, end + n);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw LogException{"segment write error", errno};
+    }
+    n += res;
+  }
+}
+
+bool Segment::Read(uint32_t offset, uint8_t* data, size_t size) const {
+  size_t n = 0;
+  while (n < size) {
+    ssize_t res = pread(fd_, data + n, size - n, offset + n);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      throw LogException{"segment read error", errno};
+    } else if (res == 0) {  // EOF
+      return false;
+    }
+    n += res;
+  }
+  return true;
+}
 
 std::string IdToName(uint32_t id) {
   std::string id_str = std::to_string(id);
@@ -0,0 +1,97 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/segmentcache.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+SegmentCache::SegmentCache(uint32_t capacity)
+    : capacity_{capacity}, entries_{}, index_{}, stats_{0, 0, 0} {}
+
+uint32_t SegmentCache::size() const {
+  std::lock_guard<std::mutex> lk(mut_);
+  return entries_.size();
+}
+
+SegmentCache::Stats SegmentCache::stats() const {
+  std::lock_guard<std::mutex> lk(mut_);
+  return stats_;
+}
+
+std::shared_ptr<Segment> SegmentCache::Lookup(const void* log, uint32_t id) {
+  std::lock_guard<std::mutex> lk(mut_);
+  auto it = index_.find(Key{log, id});
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return nullptr;
+  }
+  ++stats_.hits;
+  // Move to the front as most recently used.
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+void SegmentCache::Insert(const void* log, uint32_t id,
+                          std::shared_ptr<Segment> segment) {
+  // Release evicted segments after unlocking as closing may block.
+  std::shared_ptr<Segment> evicted;
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    const Key key{log, id};
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      evicted = std::exchange(it->second->second, std::move(segment));
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+
+    if (capacity_ == 0) return;
+
+    if (entries_.size() >= capacity_) {
+      evicted = std::move(entries_.back().second);
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+      ++stats_.evictions;
+    }
+
+    entries_.emplace_front(key, std::move(segment));
+    index_.emplace(key, entries_.begin());
+  }
+}
+
+void SegmentCache::Erase(const void* log, uint32_t id) {
+  std::shared_ptr<Segment> erased;
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    auto it = index_.find(Key{log, id});
+    if (it == index_.end()) return;
+    erased = std::move(it->second->second);
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+}
+
+void SegmentCache::EraseAll(const void* log) {
+  std::list<Entry> erased;
+  {
+    std::lock_guard<std::mutex> lk(mut_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (it->first.first == log) {
+        index_.erase(it->first);
+        auto next = std::next(it);
+        erased.splice(erased.end(), entries_, it);
+        it = next;
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+}  // namespace wombat::broker::log
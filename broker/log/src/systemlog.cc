@@ -2,66 +2,1892 @@
 
 #include "log/systemlog.h"
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
 
 #include "glog/logging.h"
+#include "log/checkpoint.h"
+#include "log/checksums.h"
+#include "log/coldsegment.h"
+#include "log/coldstore.h"
+#include "log/compactor.h"
+#include "log/compressedsegment.h"
+#include "log/compressor.h"
+#include "log/directsegment.h"
+#include "log/index.h"
 #include "log/logexception.h"
+#include "log/mmapsegment.h"
 #include "log/offsets.h"
+#include "log/readahead.h"
+#include "log/recordbatch.h"
+#include "log/scan.h"
 #include "log/systemsegment.h"
+#include "log/timeindex.h"
+#include "log/uringsegment.h"
 
 namespace wombat::broker::log {
 
-SystemLog::SystemLog(const std::filesystem::path& path, uint32_t segment_limit)
+namespace {
+
+// Checksums are buffered until the appends they cover are written.
+constexpr uint32_t kChecksumBufferSize = 4096;
+
+// Suffixes of the segment file and the files alongside it.
+const std::vector<std::string> kSegmentSuffixes{  // NOLINT
+    "", kIndexSuffix, kChecksumSuffix, kTimeIndexSuffix};
+
+// Returns the current time in milliseconds since the Unix epoch.
+uint64_t Now() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+// Reader reads records from the segments of a SystemLog in blocks of
+// Options::reader_block_bytes, moving to the next segment at the end of a
+// sealed segment. It counts the records read so checksums are read in blocks
+// too rather than resolving the ordinal of each record.
+class SystemLog::Reader : public LogReader {
+ public:
+  Reader(SystemLog* log, uint32_t id, uint32_t position, uint64_t offset,
+         uint32_t record)
+      : log_{log},
+        id_{id},
+        segment_{log->LookupSegment(id)},
+        position_{position},
+        offset_{offset},
+        record_{record},
+        block_{},
+        block_position_{0},
+        checksums_{},
+        checksums_record_{0},
+        ahead_{0},
+        sealed_{false} {
+    log_->AddReader(id_);
+    Advise();
+  }
+
+  ~Reader() override { log_->RemoveReader(id_); }
+
+  uint64_t offset() const override { return offset_; }
+
+  std::optional<View> Next() override {
+    std::shared_lock lock{log_->mutex_};
+
+    // Move to the next segment once a sealed segment is fully read. The
+    // active segment may still be appended to.
+    while (id_ != log_->active_ && position_ == segment_->size()) {
+      log_->RemoveReader(id_);
+      ++id_;
+      log_->AddReader(id_);
+      segment_ = log_->LookupSegment(id_);
+      position_ = 0;
+      record_ = 0;
+      block_.clear();
+      checksums_.clear();
+      ahead_ = 0;
+      Advise();
+    }
+
+    // Records near the end of the log may be served from the tail cache,
+    // which is keyed by offset so also covers recently sealed segments.
+    if (log_->tail_cache_ && NextCached()) {
+      const View record{block_.data(), static_cast<uint32_t>(block_.size())};
+      Advance(record.size);
+      return record;
+    }
+
+    // Sealed segments are never modified so are read without holding the
+    // lock, so appends do not wait for reads from disk.
+    sealed_ = id_ != log_->active_;
+    if (sealed_) {
+      lock.unlock();
+    }
+
+    if (!Fill(kRecordPrefixSize)) {
+      return std::nullopt;
+    }
+    uint32_t size;
+    std::memcpy(&size, block_.data() + (position_ - block_position_),
+                kRecordPrefixSize);
+    const uint64_t record_size = kRecordPrefixSize + ntohl(size);
+
+    // Padding left by compaction is returned as its header alone, as the
+    // records it replaced are not stored.
+    if (record_size > RecordBatch::kHeaderSize) {
+      if (!Fill(RecordBatch::kHeaderSize)) {
+        return std::nullopt;
+      }
+      const View header{block_.data() + (position_ - block_position_),
+                        RecordBatch::kHeaderSize};
+      const std::optional<RecordBatch> batch = RecordBatch::Parse(header);
+      if (batch && batch->padding() && batch->VerifyCrc()) {
+        Advance(record_size);
+        return header;
+      }
+    }
+
+    if (!Fill(record_size)) {
+      return std::nullopt;
+    }
+
+    const View record{block_.data() + (position_ - block_position_),
+                      static_cast<uint32_t>(record_size)};
+    Advance(record.size);
+    return record;
+  }
+
+  bool Verify(View record) override {
+    std::shared_lock lock{log_->mutex_};
+
+    bool valid;
+    if (log_->tail_cache_ &&
+        log_->tail_cache_->Verify(offset_ - record.size, record, &valid)) {
+      return valid;
+    }
+
+    const uint32_t n = record_ - 1;
+    if (n < checksums_record_ ||
+        n - checksums_record_ >= checksums_.size() / Checksums::kEntrySize) {
+      const uint32_t count = std::max<uint32_t>(
+          log_->options_.reader_block_bytes / Checksums::kEntrySize, 1);
+      const Checksums checksums = log_->LookupChecksums(id_);
+      if (id_ != log_->active_) {
+        lock.unlock();
+      }
+      checksums_ = checksums.Read(n, count);
+      checksums_record_ = n;
+      if (checksums_.empty()) {
+        // Records appended without checksums cannot be verified.
+        return true;
+      }
+    }
+    return Checksums::Matches(
+        checksums_.data() + (n - checksums_record_) * Checksums::kEntrySize,
+        record);
+  }
+
+ private:
+  // Copies the next record into the block if it is in the tail cache. The
+  // record is copied rather than viewed as appends from another thread may
+  // overwrite the cache once the lock is released.
+  bool NextCached() {
+    const std::optional<std::vector<uint8_t>> prefix =
+        log_->tail_cache_->Lookup(offset_, kRecordPrefixSize);
+    if (!prefix) {
+      return false;
+    }
+    uint32_t size;
+    std::memcpy(&size, prefix->data(), kRecordPrefixSize);
+    std::optional<std::vector<uint8_t>> record =
+        log_->tail_cache_->Lookup(offset_, kRecordPrefixSize + ntohl(size));
+    if (!record) {
+      return false;
+    }
+    block_ = std::move(*record);
+    block_position_ = position_;
+    return true;
+  }
+
+  void Advance(uint32_t size) {
+    position_ += size;
+    offset_ += size;
+    ++record_;
+  }
+
+  // Ensures the n bytes at the position are in the block, reading a new
+  // block if needed. Returns false if the segment does not contain n bytes
+  // at the position.
+  bool Fill(uint64_t n) {
+    if (position_ >= block_position_ &&
+        position_ - block_position_ + n <= block_.size()) {
+      return true;
+    }
+
+    const uint32_t available = segment_->size() - position_;
+    if (n > available) {
+      return false;
+    }
+    const uint32_t len = std::min<uint64_t>(
+        available, std::max<uint64_t>(n, log_->options_.reader_block_bytes));
+    block_ = segment_->Lookup(position_, len);
+    block_position_ = position_;
+    ReadAhead();
+    return block_.size() == len;
+  }
+
+  // Hints the segment is read sequentially if sealed, as the active segment
+  // is in the page cache having just been written.
+  void Advise() {
+    if (log_->readahead_ && id_ != log_->active_) {
+      segment_->AdviseSequential();
+    }
+  }
+
+  // Reads Options::readahead_bytes beyond the block into the page cache
+  // once within half that of the data read ahead, so reads of a sealed
+  // segment never wait for the disk.
+  void ReadAhead() {
+    const uint32_t window = log_->options_.readahead_bytes;
+    const uint64_t end = block_position_ + block_.size();
+    if (window == 0 || !sealed_ || ahead_ >= end + window / 2) {
+      return;
+    }
+    const uint64_t from = std::max<uint64_t>(ahead_, end);
+    const uint64_t to = std::min<uint64_t>(end + window, segment_->size());
+    if (to > from) {
+      segment_->WillNeed(from, to - from);
+    }
+    ahead_ = to;
+  }
+
+  SystemLog* log_;
+
+  uint32_t id_;
+  std::shared_ptr<Segment> segment_;
+
+  // Position of the next record in the segment and its offset in the log.
+  uint32_t position_;
+  uint64_t offset_;
+
+  // Number of records in the segment before the position.
+  uint32_t record_;
+
+  // Data read from the segment starting at block_position_.
+  std::vector<uint8_t> block_;
+  uint32_t block_position_;
+
+  // Checksum entries read starting from the entry of checksums_record_.
+  std::vector<uint8_t> checksums_;
+  uint32_t checksums_record_;
+
+  // Position up to which the segment was read ahead.
+  uint64_t ahead_;
+
+  // Whether the segment was sealed when last read, so is read without
+  // holding the lock.
+  bool sealed_;
+};
+
+SystemLog::SystemLog(const std::filesystem::path& path, const Options& options)
     : offsets_{std::make_shared<SystemSegment>(OFFSET_SEGMENT_ID, path,
-                                               segment_limit)},
+                                               options.segment_limit),
+               std::make_shared<SystemSegment>(
+                   path / (IdToName(OFFSET_SEGMENT_ID) + kStartSuffix),
+                   std::numeric_limits<uint32_t>::max())},
       path_{path},
-      segments_{},
+      ring_{},
+      active_segment_{},
+      checksums_{},
+      cache_{options.segment_cache},
+      checksum_files_{options.open_checksum_files},
       active_{1},
-      segment_limit_{segment_limit} {
-  segments_.emplace(
-      active_, std::make_shared<SystemSegment>(active_, path, segment_limit));
-  offsets_.Insert(0, active_);
+      timestamp_{0},
+      options_{options},
+      compactions_{0},
+      compacted_{0} {
+  if (options_.engine == Engine::kUring) {
+    if (Ring::Supported()) {
+      ring_ = std::make_unique<Ring>(options_.uring_entries);
+    } else {
+      LOG(WARNING) << "io_uring not supported, using system engine";
+    }
+  }
+
+  if (!cache_) {
+    cache_ = std::make_shared<SegmentCache>(options_.open_segments);
+  }
+
+  RecoverCompaction();
+  RecoverCompression();
+
+  tiers_ = std::make_unique<Tiers>(path_);
+  RecoverTiers();
+  if (options_.cold_store) {
+    cold_cache_ = std::make_unique<ColdCache>(options_.cold_store,
+                                              path_ / kColdCacheName,
+                                              options_.cold_cache_bytes);
+  }
 
   uint32_t id;
-  uint32_t offset;
-  offsets_.Lookup(offsets_.MaxOffset(), &id, &offset);
-  size_ = offsets_.MaxOffset() + LookupSegment(id)->size();
+  uint64_t offset;
+  if (offsets_.Lookup(offsets_.MaxOffset(), &id, &offset)) {
+    // Reopening an existing log so continue appending to the latest segment.
+    active_ = id;
+  } else {
+    offsets_.Insert(0, active_);
+  }
+
+  // Check for the checksum file before it is created by opening it.
+  const bool has_checksums = std::filesystem::exists(
+      path_ / (IdToName(active_) + kChecksumSuffix));
+  active_segment_ = OpenActiveSegment(active_);
+  checksums_ = std::make_unique<Checksums>(OpenChecksumFile(active_));
+  const std::optional<Checkpoint> checkpoint = LoadCheckpoint(has_checksums);
+  RecoverActiveSegment(has_checksums, checkpoint);
+  size_ = offsets_.MaxOffset() + active_segment_->size();
+  indexes_.emplace(
+      active_, LoadIndex(active_, OpenIndexFile(active_),
+                         checkpoint ? Index::Entry{checkpoint->ordinal,
+                                                   checkpoint->position}
+                                    : Index::Entry{0, 0}));
+  timestamp_ = LookupTimeIndex(active_)->last();
+  if (timestamp_ == 0 && active_ != FirstSegment()) {
+    timestamp_ = LookupTimeIndex(active_ - 1)->last();
+  }
+  if (options_.preallocate) {
+    active_segment_->Preallocate();
+  }
+  if (options_.readahead_bytes != 0) {
+    readahead_ = std::make_unique<Readahead>(options_.readahead_bytes);
+    // Consumers tailing the log read the end of the active segment first.
+    const uint32_t warm =
+        std::min(active_segment_->size(), options_.readahead_bytes);
+    active_segment_->WillNeed(active_segment_->size() - warm, warm);
+  }
+
+  if (options_.tail_cache_bytes != 0) {
+    tail_cache_ = std::make_unique<TailCache>(options_.tail_cache_bytes, size_);
+  }
+
+  written_ = size_;
+  flusher_ = std::make_unique<Flusher>(options_, size_);
+  checkpointed_ = std::chrono::steady_clock::now();
+
+  PrepareNext(active_ + 1);
+
+  // Delete any segments removed by retention whose files were not deleted
+  // before the log closed.
+  std::vector<uint32_t> removed;
+  for (uint32_t id = FirstSegment() - 1; id != OFFSET_SEGMENT_ID; --id) {
+    Tiers::Entry entry;
+    if (!std::filesystem::exists(SegmentPath(id)) &&
+        !tiers_->Lookup(id, &entry)) {
+      break;
+    }
+    removed.push_back(id);
+  }
+  if (!removed.empty()) {
+    DeleteSegments(removed);
+  }
+
+  if (options_.compaction) {
+    compactor_ = std::make_unique<Compactor>(
+        std::chrono::milliseconds{options_.compaction_interval_ms},
+        [this] { Compact(); });
+  }
+  if (options_.compression) {
+    compressor_ = std::make_unique<Compressor>(
+        std::chrono::milliseconds{options_.compression_interval_ms},
+        [this] { Compress(); });
+  }
+  if (options_.cold_store) {
+    offloader_ = std::make_unique<Offloader>(
+        std::chrono::milliseconds{options_.cold_interval_ms},
+        [this] { Offload(); });
+  }
+}
+
+SystemLog::~SystemLog() {
+  // Stop compacting, compressing and moving segments to the cold store before
+  // closing as each uses the log.
+  compactor_.reset();
+  compressor_.reset();
+  offloader_.reset();
+
+  try {
+    // Write the active segment so the flushers final sync includes it.
+    active_segment_->Flush();
+    NotifyWritten(active_segment_);
+    // Written by the flusher once it completes its final sync.
+    const std::optional<Checkpoint> checkpoint = CheckpointActive();
+    if (checkpoint) {
+      flusher_->WriteCheckpoint(path_, *checkpoint);
+    }
+
+    // Remove this logs segments in case the cache is shared.
+    cache_->EraseAll(this);
+
+    if (ring_) {
+      // Any remaining operations are lookups whose callbacks must not run as
+      // the requests may no longer exist.
+      ring_->Drain();
+    }
+  } catch (const LogException& e) {
+    // Cannot throw from the destructor. Note LogException logs the error.
+  }
 }
 
 void SystemLog::Append(const std::vector<uint8_t>& data) {
-  // Allow at() to throw as should never happen if the id is in offsets.
-  std::shared_ptr<Segment> segment = segments_.at(active_);
+  std::unique_lock lock{mutex_};
+
+  std::shared_ptr<Segment> segment = active_segment_;
+  const uint32_t position = segment->size();
   segment->Append(data);
+  checksums_->Append(data.data(), data.size());
+  LookupIndex(active_)->Append(position, data.size());
+  timestamp_ = std::max(timestamp_, Now());
+  LookupTimeIndex(active_)->Append(timestamp_, position);
+  if (tail_cache_) {
+    tail_cache_->Append(data);
+  }
+  size_ += data.size();
+
   if (segment->is_full()) {
+    // Write any buffered appends so the sealed segment is complete on disk.
+    segment->Flush();
+    NotifyWritten(segment);
+
+    const uint32_t sealed = active_;
     ++active_;
-    segments_.emplace(active_, std::make_shared<SystemSegment>(active_, path_,
-                                                               segment_limit_));
+    const Prepared next = TakeNext(active_);
+    active_segment_ = next.segment;
+    checksums_ = std::make_unique<Checksums>(next.checksums);
     offsets_.Insert(offsets_.MaxOffset() + segment->size(), active_);
+    // Create the index now so its base is written.
+    indexes_.emplace(active_, LoadIndex(active_, next.index));
+    time_indexes_.emplace(active_, LoadTimeIndex(active_, next.time_index));
+    PrepareNext(active_ + 1);
     LOG(INFO) << "opening new segment: " << active_;
+
+    if (options_.durability != Durability::kNone) {
+      // The new segment must be durable before data appended to it is
+      // considered flushed.
+      offsets_.Sync();
+      SyncDirectory();
+    }
+
+    // The sealed segment is no longer pinned so moves to the cache, and its
+    // index no longer needs the index file. A direct segment is reopened so
+    // its staging buffer is freed.
+    cache_->Insert(this, sealed,
+                   options_.mmap_sealed || options_.direct_io
+                       ? OpenSegment(sealed)
+                       : segment);
+    indexes_.at(sealed)->Close();
+    time_indexes_.at(sealed)->Close();
+    if (readahead_) {
+      undropped_.push_back(sealed);
+    }
+  } else {
+    NotifyWritten(segment);
   }
-  size_ += data.size();
 }
 
-std::vector<uint8_t> SystemLog::Lookup(uint32_t offset, uint32_t size) {
+void SystemLog::Poll() {
+  std::optional<Checkpoint> checkpoint;
+  std::vector<std::pair<LookupCallback, std::vector<uint8_t>>> completed;
+  {
+    std::unique_lock lock{mutex_};
+
+    if (ring_) {
+      ring_->Poll();
+      completed.swap(completed_);
+    }
+
+    active_segment_->Poll();
+    NotifyWritten(active_segment_);
+
+    Retain();
+    DropSealed();
+    checkpoint = MaybeCheckpoint();
+  }
+
+  // Written without holding the lock as writing may sync.
+  if (checkpoint) {
+    flusher_->WriteCheckpoint(path_, *checkpoint);
+  }
+
+  // Lookup callbacks run without holding the lock as they may use the log.
+  for (auto& [callback, data] : completed) {
+    callback(std::move(data));
+  }
+}
+
+bool SystemLog::WaitFlushed(uint64_t offset,
+                            std::chrono::milliseconds timeout) {
+  return flusher_->Wait(offset, timeout);
+}
+
+uint64_t SystemLog::start() const {
+  std::shared_lock lock{mutex_};
+  return offsets_.start();
+}
+
+std::vector<uint8_t> SystemLog::Lookup(uint64_t offset, uint32_t size) {
+  std::shared_lock lock{mutex_};
+
+  if (offset < offsets_.start()) {
+    return {};
+  }
+  if (tail_cache_) {
+    std::optional<std::vector<uint8_t>> data =
+        tail_cache_->Lookup(offset, size);
+    if (data) {
+      return std::move(*data);
+    }
+  }
+
+  uint32_t position;
+  const uint32_t id = ResolveSegment(offset, &position);
+  std::shared_ptr<Segment> segment = LookupSegment(id);
+  ReadAhead(offset, size);
+  // Sealed segments are never modified so are read without holding the
+  // lock, so appends do not wait for reads from disk. Holding the segment
+  // keeps its file open even if retention or compaction replaces it.
+  if (id != active_) {
+    lock.unlock();
+  }
+  return segment->Lookup(position, size);
+}
+
+void SystemLog::LookupAsync(uint64_t offset, uint32_t size,
+                            LookupCallback callback) {
+  // The callback runs without holding the lock as it may use the log.
+  std::optional<std::vector<uint8_t>> data;
+  std::shared_ptr<Segment> segment;
+  uint32_t position = 0;
+  bool direct = false;
+  {
+    std::shared_lock lock{mutex_};
+
+    if (offset < offsets_.start()) {
+      data.emplace();
+    } else if (tail_cache_) {
+      data = tail_cache_->Lookup(offset, size);
+    }
+
+    if (!data) {
+      const uint32_t id = ResolveSegment(offset, &position);
+      segment = LookupSegment(id);
+      ReadAhead(offset, size);
+
+      // Only data in the file is read asynchronously. Data still in memory,
+      // or past the end of the segment, is looked up directly, holding the
+      // lock if the segment is active as appends modify it.
+      direct = !ring_ || position > segment->written() ||
+               size > segment->written() - position ||
+               segment->LookupView(position, size);
+      if (direct && id == active_) {
+        data = segment->Lookup(position, size);
+      }
+    }
+  }
+
+  if (data) {
+    callback(std::move(*data));
+    return;
+  }
+  if (direct) {
+    callback(segment->Lookup(position, size));
+    return;
+  }
+
+  std::shared_ptr<std::vector<uint8_t>> buf =
+      std::make_shared<std::vector<uint8_t>>(size);
+  // The callback holds the segment so it is not closed while the read is in
+  // flight. The ring is polled holding the lock, so the lookup callback is
+  // queued to run once Poll releases it.
+  ring_->Read(segment->fd(), buf->data(), size, position,
+              [this, segment, buf, size,
+               callback = std::move(callback)](int32_t res) mutable {
+                // Errors are logged rather than thrown so the other
+                // completions polled with this one still run. The request is
+                // answered as not found, as are reads that are short, which
+                // are within the written file so only short if the file was
+                // truncated.
+                if (res < 0) {
+                  LOG(ERROR) << "segment read error: "
+                             << std::strerror(-res) << " (" << -res << ")";
+                }
+                if (res < 0 || static_cast<uint32_t>(res) != size) {
+                  buf->clear();
+                }
+                completed_.emplace_back(std::move(callback), std::move(*buf));
+              });
+}
+
+std::optional<View> SystemLog::LookupView(uint64_t offset, uint32_t size) {
+  std::shared_lock lock{mutex_};
+
+  if (offset < offsets_.start()) {
+    return std::nullopt;
+  }
+  if (tail_cache_) {
+    const std::optional<View> view = tail_cache_->LookupView(offset, size);
+    if (view) {
+      return view;
+    }
+  }
+
+  uint32_t position;
+  const uint32_t id = ResolveSegment(offset, &position);
+  std::shared_ptr<Segment> segment = LookupSegment(id);
+  ReadAhead(offset, size);
+  // Sealed segments are viewed without holding the lock as a segment in the
+  // cold store is fetched when first viewed.
+  if (id != active_) {
+    lock.unlock();
+  }
+  std::optional<View> view = segment->LookupView(position, size);
+  // The view holds the segment as the cache may close it once the lock is
+  // released, either by evicting it or as it was never cached.
+  if (view) {
+    view->owner = std::move(segment);
+  }
+  return view;
+}
+
+std::unique_ptr<LogReader> SystemLog::NewReader(uint64_t offset) {
+  std::shared_lock lock{mutex_};
+
+  if (ring_ || offset < offsets_.start() || offset > size_) {
+    return nullptr;
+  }
+
+  uint32_t position;
+  const uint32_t id = ResolveSegment(offset, &position);
+  const std::shared_ptr<Index> index = LookupIndex(id, &lock);
+  if (!index) {
+    return nullptr;
+  }
+  uint64_t ordinal = index->next();
+  if (position != index->tail().position &&
+      !index->Ordinal(position, LookupSegment(id).get(), &ordinal)) {
+    return nullptr;
+  }
+  return std::make_unique<Reader>(this, id, position, offset,
+                                  ordinal - index->base());
+}
+
+bool SystemLog::Seek(uint64_t ordinal, uint64_t* offset) {
+  std::shared_lock lock{mutex_};
+
+  const uint64_t next = LookupIndex(active_)->next();
+  if (ordinal == next) {
+    *offset = size_;
+    return true;
+  }
+  if (ordinal > next) {
+    return false;
+  }
+
+  // Binary search for the last segment starting at or before the ordinal.
+  uint32_t low = FirstSegment();
+  uint32_t high = active_;
+  while (low < high) {
+    const uint32_t mid = low + (high - low + 1) / 2;
+    if (LookupIndex(mid)->base() <= ordinal) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  uint64_t starting_offset;
+  uint32_t position;
+  if (!offsets_.Start(low, &starting_offset) ||
+      !LookupIndex(low)->Lookup(ordinal, LookupSegment(low).get(),
+                                &position)) {
+    return false;
+  }
+  *offset = starting_offset + position;
+  return true;
+}
+
+bool SystemLog::SeekTime(uint64_t timestamp, uint64_t* offset) {
+  std::shared_lock lock{mutex_};
+
+  if (timestamp > timestamp_) {
+    *offset = size_;
+    return true;
+  }
+
+  // Timestamps never decrease so binary search for the first segment with an
+  // append at or after the timestamp. Segments written before time indexes
+  // were added have no appends so are never found. The active segment has no
+  // appends just after a roll so is excluded unless it is the only segment.
+  uint32_t low = FirstSegment();
+  uint32_t high = active_;
+  if (LookupTimeIndex(active_)->empty() && high != low) {
+    --high;
+  }
+  while (low < high) {
+    const uint32_t mid = low + (high - low) / 2;
+    if (LookupTimeIndex(mid)->last() >= timestamp) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+
+  uint64_t starting_offset;
+  if (!offsets_.Start(low, &starting_offset)) {
+    return false;
+  }
+  uint32_t position;
+  if (!LookupTimeIndex(low)->Lookup(timestamp, &position)) {
+    // Only the last segment searched can have every append before the
+    // timestamp, which is after the latest append as stamped, rounded down
+    // to the resolution, though not after the time it was made.
+    *offset = size_;
+    return true;
+  }
+  *offset = starting_offset + position;
+  return true;
+}
+
+bool SystemLog::IsAligned(uint64_t offset) {
+  std::shared_lock lock{mutex_};
+
+  if (offset >= size_) {
+    return true;
+  }
+  if (offset < offsets_.start()) {
+    return false;
+  }
+  bool aligned;
+  if (tail_cache_ && tail_cache_->IsAligned(offset, &aligned)) {
+    return aligned;
+  }
+
+  uint32_t position;
+  const uint32_t id = ResolveSegment(offset, &position);
+  {
+    // The record following a verified record is known to be aligned.
+    std::lock_guard verify_lock{verify_mutex_};
+    auto it = verify_streams_.find(offset);
+    if (it != verify_streams_.end() && it->second.id == id) {
+      return true;
+    }
+  }
+  const std::shared_ptr<Index> index = LookupIndex(id, &lock);
+  if (!index) {
+    return false;
+  }
+  std::shared_ptr<Segment> segment = LookupSegment(id);
+  // Sealed segments are scanned without holding the lock, as with lookups.
+  if (id != active_) {
+    lock.unlock();
+  }
+  return index->IsAligned(position, segment.get());
+}
+
+bool SystemLog::Verify(uint64_t offset, View record) {
+  std::shared_lock lock{mutex_};
+
+  if (offset < offsets_.start() || offset >= size_) {
+    return false;
+  }
+  // Cached records are compared with the appended data directly.
+  bool valid;
+  if (tail_cache_ && tail_cache_->Verify(offset, record, &valid)) {
+    return valid;
+  }
+
+  uint32_t position;
+  const uint32_t id = ResolveSegment(offset, &position);
+
+  // A record following a record just verified continues its stream, so
+  // needs neither an index scan nor a read of the checksum file. Otherwise
+  // the record is resolved with the index.
+  std::optional<VerifyStream> stream = TakeVerifyStream(offset, id);
+  std::shared_ptr<Index> index;
+  if (!stream) {
+    index = LookupIndex(id, &lock);
+    if (!index) {
+      return false;
+    }
+  }
+  std::shared_ptr<Segment> segment = LookupSegment(id);
+  const Checksums checksums = LookupChecksums(id);
+  const uint64_t compactions = compactions_;
+  // Sealed segments are scanned and their checksums read without holding
+  // the lock, as with lookups.
+  if (id != active_) {
+    lock.unlock();
+  }
+  if (!stream) {
+    uint64_t ordinal;
+    if (!index->Ordinal(position, segment.get(), &ordinal)) {
+      return false;
+    }
+    // Records within a segment are counted from its base, which fits 32
+    // bits as each record takes at least one byte of the segment.
+    stream = VerifyStream{id, static_cast<uint32_t>(ordinal - index->base()),
+                          {}, 0};
+  }
+
+  // Checksums are read in blocks once a stream continues, as with readers,
+  // but only the one entry needed for a record verified on its own.
+  const uint32_t n = stream->record;
+  if (n < stream->checksums_record ||
+      n - stream->checksums_record >=
+          stream->checksums.size() / Checksums::kEntrySize) {
+    const uint32_t count =
+        stream->checksums.empty()
+            ? 1
+            : std::max<uint32_t>(
+                  options_.reader_block_bytes / Checksums::kEntrySize, 1);
+    stream->checksums = checksums.Read(n, count);
+    stream->checksums_record = n;
+  }
+  // Records appended without checksums cannot be verified.
+  if (!stream->checksums.empty() &&
+      !Checksums::Matches(stream->checksums.data() +
+                              (n - stream->checksums_record) *
+                                  Checksums::kEntrySize,
+                          record)) {
+    return false;
+  }
+
+  ++stream->record;
+  AddVerifyStream(offset + record.size, std::move(*stream), compactions);
+  return true;
+}
+
+void SystemLog::Compact() {
+  std::lock_guard compaction_lock{compaction_mutex_};
+
+  uint32_t first;
+  uint32_t end;
+  {
+    std::shared_lock lock{mutex_};
+    // Segments in the cold store are not compacted, and as they are older
+    // than the local segments never hold the latest record of a key.
+    first = std::max(FirstSegment(), tiers_->end());
+    end = active_;
+    uint64_t end_offset;
+    while (tail_cache_ && end != first && offsets_.Start(end, &end_offset) &&
+           end_offset > tail_cache_->start()) {
+      --end;
+    }
+  }
+  if (end <= compacted_) {
+    return;
+  }
+
+  // Segments are opened again for each pass rather than kept open, as there
+  // may be more segments than the segment cache holds.
+  Compactor::KeyMap keys;
+  for (uint32_t id = first; id != end; ++id) {
+    const std::optional<Sealed> sealed = LookupSealed(id);
+    if (sealed) {
+      Compactor::AddKeys(sealed->segment.get(), sealed->start, &keys);
+    }
+  }
+
+  uint32_t compacted = 0;
+  for (uint32_t id = first; id != end; ++id) {
+    const std::optional<Sealed> sealed = LookupSealed(id);
+    if (sealed && CompactSegment(*sealed, keys)) {
+      ++compacted;
+    }
+  }
+  compacted_ = end;
+
+  if (compacted != 0) {
+    LOG(INFO) << "compacted " << compacted << " segments, " << keys.size()
+              << " keys";
+  }
+}
+
+void SystemLog::Compress() {
+  std::lock_guard compaction_lock{compaction_mutex_};
+
+  uint32_t first;
+  uint32_t end;
+  {
+    std::shared_lock lock{mutex_};
+    first = std::max(FirstSegment(), tiers_->end());
+    end = active_;
+  }
+
+  uint32_t compressed = 0;
+  for (uint32_t id = first; id != end; ++id) {
+    // Compressed files are only added while holding the compaction mutex.
+    if (std::filesystem::exists(path_ / (IdToName(id) + kCompressedSuffix))) {
+      continue;
+    }
+    const std::optional<Sealed> sealed = LookupSealed(id);
+    if (sealed && CompressSegment(*sealed)) {
+      ++compressed;
+    }
+  }
+
+  if (compressed != 0) {
+    LOG(INFO) << "compressed " << compressed << " segments";
+  }
+}
+
+std::shared_ptr<Segment> SystemLog::LookupSegment(uint32_t id) {
+  if (id == active_) {
+    return active_segment_;
+  }
+
+  // Lazily open sealed segments, keeping recently used segments open.
+  std::shared_ptr<Segment> segment = cache_->Lookup(this, id);
+  if (!segment) {
+    segment = OpenSegment(id);
+    cache_->Insert(this, id, segment);
+  }
+  return segment;
+}
+
+std::shared_ptr<Segment> SystemLog::OpenSegment(uint32_t id) const {
+  Tiers::Entry entry;
+  if (tiers_->Lookup(id, &entry)) {
+    if (!cold_cache_) {
+      throw LogException{"segment in cold store but no cold store configured"};
+    }
+    // Fetch the segment from the store only once it is read, as opening the
+    // segment to load its index only needs its size.
+    // The cached file is opened by the cache so it is not evicted before it
+    // is open, and is never created if missing.
+    return std::make_shared<ColdSegment>(
+        entry.size, [this, entry]() -> std::shared_ptr<Segment> {
+          std::shared_ptr<Segment> segment = cold_cache_->Fetch(
+              entry.name(),
+              [this, &entry](const std::filesystem::path& path)
+                  -> std::shared_ptr<Segment> {
+                if (entry.compressed) {
+                  return std::make_shared<CompressedSegment>(
+                      path, options_.compression_cache_blocks);
+                }
+                return std::make_shared<SystemSegment>(
+                    path, options_.segment_limit, false);
+              });
+          if (!segment) {
+            throw LogException{"segment not found in cold store"};
+          }
+          return segment;
+        });
+  }
+  if (id != active_ && std::filesystem::exists(
+                           path_ / (IdToName(id) + kCompressedSuffix))) {
+    return std::make_shared<CompressedSegment>(
+        id, path_, options_.compression_cache_blocks);
+  }
+  if (options_.mmap_sealed && id != active_) {
+    return std::make_shared<MmapSegment>(id, path_);
+  }
+  return std::make_shared<SystemSegment>(id, path_, options_.segment_limit);
+}
+
+std::shared_ptr<Segment> SystemLog::OpenActiveSegment(uint32_t id) const {
+  if (ring_) {
+    return std::make_shared<UringSegment>(id, path_, options_.segment_limit,
+                                          ring_.get());
+  }
+
+  if (options_.direct_io) {
+    return std::make_shared<DirectSegment>(
+        id, path_, options_.segment_limit, options_.direct_buffer_bytes,
+        std::chrono::milliseconds{options_.append_linger_ms});
+  }
+
+  std::shared_ptr<Segment> segment =
+      std::make_shared<SystemSegment>(id, path_, options_.segment_limit);
+  if (options_.append_buffer_bytes != 0) {
+    segment->EnableBuffering(
+        options_.append_buffer_bytes,
+        std::chrono::milliseconds{options_.append_linger_ms});
+  }
+  return segment;
+}
+
+std::shared_ptr<Index> SystemLog::LookupIndex(uint32_t id) {
+  {
+    std::lock_guard lock{indexes_mutex_};
+    auto it = indexes_.find(id);
+    if (it != indexes_.end()) {
+      return it->second;
+    }
+  }
+
+  // Records in segments in the cold store are not scanned, as the entry
+  // records where the last record ends.
+  Index::Entry from{0, 0};
+  Tiers::Entry entry;
+  if (tiers_->Lookup(id, &entry)) {
+    from = Index::Entry{entry.ordinal, entry.end};
+  }
+
+  // Load without holding the lock as loading may look up the previous index.
+  // If another thread loads the index concurrently the first loaded is kept.
+  std::shared_ptr<Index> index = LoadIndex(id, OpenIndexFile(id), from);
+  std::lock_guard lock{indexes_mutex_};
+  return indexes_.emplace(id, index).first->second;
+}
+
+std::shared_ptr<Index> SystemLog::LookupIndex(
+    uint32_t id, std::shared_lock<std::shared_mutex>* lock) {
+  {
+    std::lock_guard indexes_lock{indexes_mutex_};
+    auto it = indexes_.find(id);
+    if (it != indexes_.end()) {
+      return it->second;
+    }
+  }
+
+  // An empty index file, as of a segment written before index files were
+  // added, is rebuilt from the previous index so is loaded holding the lock.
+  std::shared_ptr<Segment> file = OpenIndexFile(id);
+  if (id == active_ || file->size() == 0) {
+    return LookupIndex(id);
+  }
+
+  Index::Entry from{0, 0};
+  Tiers::Entry entry;
+  if (tiers_->Lookup(id, &entry)) {
+    from = Index::Entry{entry.ordinal, entry.end};
+  }
+  std::shared_ptr<Segment> segment = LookupSegment(id);
+  const uint64_t compactions = compactions_;
+
+  lock->unlock();
+  std::shared_ptr<Index> index =
+      std::make_shared<Index>(file, 0, options_.index_interval);
+  index->Recover(segment.get(), from);
+  index->Close();
+  lock->lock();
+
+  // While the lock was released the segment may have been deleted by
+  // retention, or compacted so the index loaded is of the replaced files.
+  if (id < FirstSegment()) {
+    return nullptr;
+  }
+  if (compactions != compactions_) {
+    return LookupIndex(id);
+  }
+  std::lock_guard indexes_lock{indexes_mutex_};
+  return indexes_.emplace(id, index).first->second;
+}
+
+std::shared_ptr<Index> SystemLog::LoadIndex(uint32_t id,
+                                            std::shared_ptr<Segment> file,
+                                            Index::Entry from) {
+  uint64_t base = 0;
+  if (file->size() == 0 && id != FirstSegment()) {
+    // Without an index the segment must follow the previous segment.
+    base = LookupIndex(id - 1)->next();
+  }
+
+  std::shared_ptr<Index> index =
+      std::make_shared<Index>(file, base, options_.index_interval);
+  index->Recover(LookupSegment(id).get(), from);
+  if (id != active_) {
+    index->Close();
+  }
+  return index;
+}
+
+std::shared_ptr<Segment> SystemLog::OpenIndexFile(uint32_t id) const {
+  return std::make_shared<SystemSegment>(
+      path_ / (IdToName(id) + kIndexSuffix),
+      std::numeric_limits<uint32_t>::max());
+}
+
+std::shared_ptr<TimeIndex> SystemLog::LookupTimeIndex(uint32_t id) {
+  {
+    std::lock_guard lock{indexes_mutex_};
+    auto it = time_indexes_.find(id);
+    if (it != time_indexes_.end()) {
+      return it->second;
+    }
+  }
+
+  std::shared_ptr<TimeIndex> index = LoadTimeIndex(id, OpenTimeIndexFile(id));
+  std::lock_guard lock{indexes_mutex_};
+  return time_indexes_.emplace(id, index).first->second;
+}
+
+std::shared_ptr<TimeIndex> SystemLog::LoadTimeIndex(
+    uint32_t id, std::shared_ptr<Segment> file) {
+  std::shared_ptr<TimeIndex> index = std::make_shared<TimeIndex>(
+      std::move(file), options_.timestamp_resolution_ms);
+  index->Recover(LookupSegment(id)->size());
+  if (id != active_) {
+    index->Close();
+  }
+  return index;
+}
+
+std::shared_ptr<Segment> SystemLog::OpenTimeIndexFile(uint32_t id) const {
+  return std::make_shared<SystemSegment>(
+      path_ / (IdToName(id) + kTimeIndexSuffix),
+      std::numeric_limits<uint32_t>::max());
+}
+
+Checksums SystemLog::LookupChecksums(uint32_t id) {
+  if (id == active_) {
+    return *checksums_;
+  }
+
+  std::shared_ptr<Segment> file = checksum_files_.Lookup(this, id);
+  if (!file) {
+    file = OpenChecksumFile(id);
+    checksum_files_.Insert(this, id, file);
+  }
+  return Checksums{file};
+}
+
+std::shared_ptr<Segment> SystemLog::OpenChecksumFile(uint32_t id) const {
+  std::shared_ptr<Segment> file = std::make_shared<SystemSegment>(
+      path_ / (IdToName(id) + kChecksumSuffix),
+      std::numeric_limits<uint32_t>::max());
+  file->EnableBuffering(kChecksumBufferSize,
+                        std::chrono::milliseconds{options_.append_linger_ms});
+  return file;
+}
+
+std::optional<SystemLog::VerifyStream> SystemLog::TakeVerifyStream(
+    uint64_t offset, uint32_t id) {
+  std::lock_guard lock{verify_mutex_};
+  auto it = verify_streams_.find(offset);
+  // A stream reaching the end of a segment is not continued into the next
+  // segment, whose ordinals restart from its own base.
+  if (it == verify_streams_.end() || it->second.id != id) {
+    return std::nullopt;
+  }
+  VerifyStream stream = std::move(it->second);
+  verify_streams_.erase(it);
+  return stream;
+}
+
+void SystemLog::AddVerifyStream(uint64_t offset, VerifyStream stream,
+                                uint64_t compactions) {
+  std::lock_guard lock{verify_mutex_};
+  // A segment compacted since the stream was resolved may have different
+  // ordinals.
+  if (compactions != compactions_) {
+    return;
+  }
+  if (verify_streams_.size() >= kVerifyStreams) {
+    verify_streams_.erase(verify_streams_.begin());
+  }
+  verify_streams_.insert_or_assign(offset, std::move(stream));
+}
+
+void SystemLog::RecoverActiveSegment(
+    bool has_checksums, const std::optional<Checkpoint>& checkpoint) {
+  if (!has_checksums) {
+    if (active_segment_->size() != 0) {
+      LOG(WARNING) << "segment " << active_
+                   << " has no checksums, adding checksums of its records";
+    }
+    checksums_->Rebuild(active_segment_.get());
+    return;
+  }
+
+  const uint32_t truncated =
+      checkpoint ? checksums_->Recover(active_segment_.get(),
+                                       checkpoint->checksums,
+                                       checkpoint->position)
+                 : checksums_->Recover(active_segment_.get());
+  if (truncated != 0) {
+    LOG(WARNING) << "truncated " << truncated
+                 << " bytes of partially written data from segment "
+                 << active_;
+  }
+}
+
+std::optional<Checkpoint> SystemLog::LoadCheckpoint(bool has_checksums) const {
+  std::optional<Checkpoint> checkpoint = Checkpoint::Read(path_);
+  if (!checkpoint) {
+    return std::nullopt;
+  }
+
+  // A checkpoint of an earlier active segment is expected after a roll, so
+  // is ignored silently.
+  if (checkpoint->active != active_) {
+    return std::nullopt;
+  }
+  if (!has_checksums || checkpoint->active_start != offsets_.MaxOffset() ||
+      checkpoint->end != checkpoint->active_start + checkpoint->position ||
+      checkpoint->position > active_segment_->size() ||
+      checkpoint->checksums > checksums_->size()) {
+    LOG(WARNING) << "checkpoint does not match segment " << active_
+                 << ", recovering the whole segment";
+    return std::nullopt;
+  }
+  return checkpoint;
+}
+
+std::optional<Checkpoint> SystemLog::MaybeCheckpoint() {
+  if (options_.checkpoint_interval_ms == 0) {
+    return std::nullopt;
+  }
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  if (now - checkpointed_ <
+      std::chrono::milliseconds{options_.checkpoint_interval_ms}) {
+    return std::nullopt;
+  }
+  checkpointed_ = now;
+
+  return CheckpointActive();
+}
+
+std::optional<Checkpoint> SystemLog::CheckpointActive() {
+  // The checkpoint must only cover data the flusher will make durable, else
+  // after a crash recovery could skip verifying data that was lost, so it
+  // only covers the active segment once all appends were passed to the
+  // flusher.
+  if (written_ != size_) {
+    return std::nullopt;
+  }
+
+  const Index::Entry tail = LookupIndex(active_)->tail();
+  Checkpoint checkpoint{};
+  checkpoint.active = active_;
+  checkpoint.active_start = offsets_.MaxOffset();
+  checkpoint.end = size_;
+  checkpoint.position = tail.position;
+  checkpoint.checksums = checksums_->size();
+  checkpoint.ordinal = tail.ordinal;
+  return checkpoint;
+}
+
+SystemLog::Prepared SystemLog::PrepareSegment(uint32_t id) const {
+  Prepared prepared{OpenActiveSegment(id), OpenIndexFile(id),
+                    OpenChecksumFile(id), OpenTimeIndexFile(id)};
+  if (options_.preallocate) {
+    prepared.segment->Preallocate();
+  }
+  return prepared;
+}
+
+void SystemLog::PrepareNext(uint32_t id) {
+  if (!options_.preallocate) return;
+  next_ = std::async(std::launch::async,
+                     [this, id] { return PrepareSegment(id); });
+}
+
+SystemLog::Prepared SystemLog::TakeNext(uint32_t id) {
+  if (next_.valid()) {
+    try {
+      return next_.get();
+    } catch (const LogException& e) {
+      // Retry below in case the error was transient. Note LogException logs
+      // the error.
+    }
+  }
+  return PrepareSegment(id);
+}
+
+uint32_t SystemLog::FirstSegment() {
   uint32_t id;
-  uint32_t starting_offset;
-  if (!offsets_.Lookup(offset, &id, &starting_offset)) {
-    // This should never happen a segment at offset 0 is always added.
+  uint64_t starting_offset;
+  if (!offsets_.Lookup(offsets_.start(), &id, &starting_offset)) {
+    // This should never happen as the start is always a segment.
     throw LogException("offset not found");
   }
-  return LookupSegment(id)->Lookup(offset - starting_offset, size);
+  return id;
 }
 
-std::shared_ptr<Segment> SystemLog::LookupSegment(uint32_t id) {
-  // Lazily load the segments. TODO(AD) if too make open FDs is an issue could
-  // only keep latest open (LRU cache).
-  if (segments_.find(id) == segments_.end()) {
-    segments_.emplace(
-        id, std::make_shared<SystemSegment>(id, path_, segment_limit_));
-  }
-  // Allow at() to throw as should never happen if the id is in offsets.
-  return segments_.at(id);
+void SystemLog::Retain() {
+  if (options_.retention_bytes == 0 && options_.retention_ms == 0) {
+    return;
+  }
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  if (now - retention_checked_ <
+      std::chrono::milliseconds{options_.retention_check_ms}) {
+    return;
+  }
+  retention_checked_ = now;
+
+  // Segments expire in order so stop at the first segment to keep. The
+  // active segment is never deleted.
+  std::vector<uint32_t> expired;
+  uint64_t new_start = offsets_.start();
+  for (uint32_t id = FirstSegment(); id != active_; ++id) {
+    uint64_t end;
+    if (!offsets_.Start(id + 1, &end) || !IsExpired(id, end)) {
+      break;
+    }
+    expired.push_back(id);
+    new_start = end;
+  }
+  if (expired.empty()) {
+    return;
+  }
+
+  // Advance the start before deleting the files so the segments are never
+  // referenced once deleted.
+  offsets_.Truncate(new_start);
+  for (uint32_t id : expired) {
+    cache_->Erase(this, id);
+    checksum_files_.Erase(this, id);
+    indexes_.erase(id);
+    time_indexes_.erase(id);
+  }
+  DeleteSegments(expired);
+  LOG(INFO) << "retention deleted " << expired.size()
+            << " segments, log start " << new_start;
+}
+
+bool SystemLog::IsExpired(uint32_t id, uint64_t end) const {
+  if (options_.retention_bytes != 0 &&
+      size_ - end >= options_.retention_bytes) {
+    return true;
+  }
+
+  if (options_.retention_ms != 0) {
+    std::chrono::system_clock::time_point modified;
+    if (LastModified(id, &modified) &&
+        std::chrono::system_clock::now() - modified >=
+            std::chrono::milliseconds{options_.retention_ms}) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool SystemLog::LastModified(
+    uint32_t id, std::chrono::system_clock::time_point* modified) const {
+  Tiers::Entry entry;
+  if (tiers_->Lookup(id, &entry)) {
+    *modified = std::chrono::system_clock::time_point{
+        std::chrono::milliseconds{entry.modified_ms}};
+    return true;
+  }
+
+  struct stat st;
+  if (stat(SegmentPath(id).c_str(), &st) == -1) {
+    LOG(ERROR) << "failed to stat segment " << id << ": "
+               << std::strerror(errno);
+    return false;
+  }
+  *modified = std::chrono::system_clock::from_time_t(st.st_mtime);
+  return true;
+}
+
+void SystemLog::DeleteSegments(const std::vector<uint32_t>& ids) {
+  if (!cleaner_) {
+    cleaner_ = std::make_unique<Cleaner>(
+        std::chrono::milliseconds{options_.delete_interval_ms});
+  }
+
+  std::vector<std::filesystem::path> paths;
+  for (uint32_t id : ids) {
+    for (const std::string& suffix : kSegmentSuffixes) {
+      paths.push_back(path_ / (IdToName(id) + suffix));
+    }
+    paths.push_back(path_ / (IdToName(id) + kCompressedSuffix));
+  }
+  cleaner_->Delete(paths);
+}
+
+std::optional<SystemLog::Sealed> SystemLog::LookupSealed(uint32_t id) {
+  std::shared_lock lock{mutex_};
+
+  uint64_t start;
+  if (id < FirstSegment() || id >= active_ || !offsets_.Start(id, &start)) {
+    return std::nullopt;
+  }
+  return Sealed{id, start, LookupSegment(id), LookupIndex(id)->base(),
+                LookupTimeIndex(id)};
+}
+
+bool SystemLog::CompactSegment(const Sealed& sealed,
+                               const Compactor::KeyMap& keys) {
+  const std::string name = IdToName(sealed.id);
+  auto open_compacted = [this, &name](const std::string& suffix) {
+    return std::make_shared<SystemSegment>(
+        path_ / (name + suffix + kCompactedSuffix),
+        std::numeric_limits<uint32_t>::max());
+  };
+
+  std::chrono::system_clock::time_point modified;
+  if (!LastModified(sealed.id, &modified)) {
+    return false;
+  }
+  const bool remove_tombstones =
+      std::chrono::system_clock::now() - modified >=
+      std::chrono::milliseconds{options_.compaction_tombstone_ms};
+
+  std::vector<uint32_t> positions;
+  std::shared_ptr<Segment> segment = open_compacted("");
+  if (!Compactor::Rewrite(sealed.segment.get(), sealed.start, keys,
+                          remove_tombstones, segment.get(), &positions)) {
+    segment = nullptr;
+    RemoveCompacted(name);
+    return false;
+  }
+
+  // The records kept are at the same positions but the records between them
+  // are replaced so the index and checksums are rebuilt.
+  std::shared_ptr<Segment> index_file = open_compacted(kIndexSuffix);
+  Index index{index_file, sealed.base, options_.index_interval};
+  for (size_t i = 0; i != positions.size(); ++i) {
+    const uint32_t end =
+        i + 1 == positions.size() ? segment->size() : positions[i + 1];
+    index.Append(positions[i], end - positions[i]);
+  }
+
+  std::shared_ptr<Segment> checksum_file = open_compacted(kChecksumSuffix);
+  Checksums{checksum_file}.Rebuild(segment.get());
+
+  // Appends that were removed are now covered by the record that replaced
+  // them, so their time index entries move to that record.
+  std::shared_ptr<Segment> time_index_file = open_compacted(kTimeIndexSuffix);
+  TimeIndex time_index{time_index_file, options_.timestamp_resolution_ms};
+  sealed.time_index->ForEach([&](uint64_t timestamp, uint32_t position) {
+    auto it = std::upper_bound(positions.begin(), positions.end(), position);
+    time_index.Append(timestamp, *(it - 1));
+  });
+
+  for (const std::shared_ptr<Segment>& file :
+       {segment, index_file, checksum_file, time_index_file}) {
+    file->Sync();
+  }
+  segment = nullptr;
+
+  // Keep the modification time of the segment as retention and tombstone
+  // removal depend on when the segment was last appended to.
+  std::error_code ec;
+  std::filesystem::last_write_time(
+      path_ / (name + kCompactedSuffix),
+      std::filesystem::last_write_time(SegmentPath(sealed.id), ec), ec);
+  if (ec) {
+    LOG(ERROR) << "failed to set the modification time of compacted segment "
+               << sealed.id << ": " << ec.message();
+    RemoveCompacted(name);
+    return false;
+  }
+
+  std::unique_lock lock{mutex_};
+  // The segment may have been deleted by retention while being compacted.
+  if (sealed.id < FirstSegment()) {
+    RemoveCompacted(name);
+    return false;
+  }
+
+  // Mark the compacted files complete before replacing any segment files, so
+  // if the log closes part way through the replacement is finished on open.
+  const std::filesystem::path swap = path_ / (name + kSwapSuffix);
+  const int fd = open(swap.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    RemoveCompacted(name);
+    throw LogException{"failed to create compaction swap file", errno};
+  }
+  close(fd);
+  SyncDirectory();
+  SwapCompacted(name);
+
+  // Lookups reopen the replaced files, though readers of the segment keep
+  // the files they have open which are still valid as no offsets change.
+  cache_->Erase(this, sealed.id);
+  checksum_files_.Erase(this, sealed.id);
+  indexes_.erase(sealed.id);
+  time_indexes_.erase(sealed.id);
+  {
+    // Compaction replaces records so the ordinals of streams may change.
+    std::lock_guard verify_lock{verify_mutex_};
+    verify_streams_.clear();
+    ++compactions_;
+  }
+  return true;
+}
+
+void SystemLog::SwapCompacted(const std::string& name) {
+  // The compacted segment replaces the segment whether or not it was
+  // compressed, so any compressed file is removed first. It is already
+  // removed if the compacted segment file was renamed before the log closed.
+  std::error_code ec;
+  std::filesystem::remove(path_ / (name + kCompressedSuffix), ec);
+  if (ec) {
+    throw LogException{"failed to remove compressed segment", ec.value()};
+  }
+
+  for (const std::string& suffix : kSegmentSuffixes) {
+    const std::filesystem::path compacted =
+        path_ / (name + suffix + kCompactedSuffix);
+    // Files already replaced before the log closed are skipped.
+    if (!std::filesystem::exists(compacted)) {
+      continue;
+    }
+    std::error_code ec;
+    std::filesystem::rename(compacted, path_ / (name + suffix), ec);
+    if (ec) {
+      throw LogException{"failed to replace segment file", ec.value()};
+    }
+  }
+  SyncDirectory();
+  std::filesystem::remove(path_ / (name + kSwapSuffix), ec);
+}
+
+void SystemLog::RecoverCompaction() {
+  std::vector<std::filesystem::path> swaps;
+  for (const std::filesystem::directory_entry& entry :
+       std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() == kSwapSuffix) {
+      swaps.push_back(entry.path());
+    }
+  }
+  for (const std::filesystem::path& swap : swaps) {
+    LOG(WARNING) << "finishing compaction of segment " << swap.stem().string();
+    SwapCompacted(swap.stem().string());
+  }
+
+  // Any other compacted files were not complete so are discarded.
+  std::vector<std::filesystem::path> compacted;
+  for (const std::filesystem::directory_entry& entry :
+       std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() == kCompactedSuffix) {
+      compacted.push_back(entry.path());
+    }
+  }
+  for (const std::filesystem::path& path : compacted) {
+    std::filesystem::remove(path);
+  }
+}
+
+void SystemLog::RemoveCompacted(const std::string& name) const {
+  for (const std::string& suffix : kSegmentSuffixes) {
+    std::error_code ec;
+    std::filesystem::remove(path_ / (name + suffix + kCompactedSuffix), ec);
+  }
+}
+
+bool SystemLog::CompressSegment(const Sealed& sealed) {
+  const std::string name = IdToName(sealed.id);
+  const std::filesystem::path compressed = path_ / (name + kCompressedSuffix);
+  const std::filesystem::path partial =
+      path_ / (name + kCompressedSuffix + kPartialSuffix);
+
+  // Remove any file left by a failed attempt as it would be appended to.
+  std::error_code ec;
+  std::filesystem::remove(partial, ec);
+  {
+    SystemSegment out{partial, std::numeric_limits<uint32_t>::max()};
+    if (!Compressor::Compress(sealed.segment.get(),
+                              options_.compression_block_bytes, &out)) {
+      std::filesystem::remove(partial, ec);
+      return false;
+    }
+    out.Sync();
+  }
+
+  // Keep the modification time of the segment as retention and tombstone
+  // removal depend on when the segment was last appended to.
+  std::filesystem::last_write_time(
+      partial, std::filesystem::last_write_time(path_ / name, ec), ec);
+  if (ec) {
+    LOG(ERROR) << "failed to set the modification time of compressed segment "
+               << sealed.id << ": " << ec.message();
+    std::filesystem::remove(partial, ec);
+    return false;
+  }
+
+  std::unique_lock lock{mutex_};
+  // The segment may have been deleted by retention while being compressed.
+  if (sealed.id < FirstSegment()) {
+    std::filesystem::remove(partial, ec);
+    return false;
+  }
+
+  // The compressed file is complete once renamed, so if the log closes
+  // before the segment file is removed it is removed when the log is
+  // reopened.
+  std::filesystem::rename(partial, compressed, ec);
+  if (ec) {
+    std::filesystem::remove(partial, ec);
+    throw LogException{"failed to replace segment file", ec.value()};
+  }
+  SyncDirectory();
+  std::filesystem::remove(path_ / name, ec);
+  if (ec) {
+    LOG(ERROR) << "failed to remove compressed segment " << sealed.id << ": "
+               << ec.message();
+  }
+
+  // Lookups reopen the segment compressed, though readers of the segment
+  // keep the segment file they have open.
+  cache_->Erase(this, sealed.id);
+  return true;
+}
+
+void SystemLog::RecoverCompression() {
+  std::vector<std::filesystem::path> compressed;
+  std::vector<std::filesystem::path> partial;
+  for (const std::filesystem::directory_entry& entry :
+       std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() == kCompressedSuffix) {
+      compressed.push_back(entry.path());
+    } else if (entry.path().extension() == kPartialSuffix) {
+      partial.push_back(entry.path());
+    }
+  }
+
+  // A complete compressed file replaces the segment file.
+  for (const std::filesystem::path& path : compressed) {
+    const std::filesystem::path segment = path_ / path.stem();
+    if (std::filesystem::exists(segment)) {
+      LOG(WARNING) << "finishing compression of segment "
+                   << path.stem().string();
+      std::filesystem::remove(segment);
+    }
+  }
+  for (const std::filesystem::path& path : partial) {
+    std::filesystem::remove(path);
+  }
+}
+
+void SystemLog::Offload() {
+  if (!options_.cold_store) {
+    return;
+  }
+
+  std::lock_guard compaction_lock{compaction_mutex_};
+
+  uint32_t first;
+  uint32_t end;
+  {
+    std::shared_lock lock{mutex_};
+    first = FirstSegment();
+    end = active_;
+  }
+
+  // Remove segments deleted by retention from the store before removing
+  // their entries, so if the log closes first they are removed again.
+  uint32_t deleted = 0;
+  for (const Tiers::Entry& entry : tiers_->entries()) {
+    if (entry.id >= first) break;
+    options_.cold_store->Remove(entry.name());
+    cold_cache_->Erase(entry.name());
+    ++deleted;
+  }
+  if (deleted != 0) {
+    std::unique_lock lock{mutex_};
+    tiers_->Truncate(first);
+  }
+
+  // Segments are moved oldest first so the segments in the cold store always
+  // precede the local segments.
+  const std::chrono::system_clock::time_point now =
+      std::chrono::system_clock::now();
+  uint32_t moved = 0;
+  for (uint32_t id = std::max(first, tiers_->end()); id != end; ++id) {
+    std::chrono::system_clock::time_point modified;
+    if (!LastModified(id, &modified) ||
+        now - modified < std::chrono::milliseconds{options_.cold_after_ms} ||
+        !OffloadSegment(id, modified)) {
+      break;
+    }
+    ++moved;
+  }
+
+  if (moved != 0) {
+    LOG(INFO) << "moved " << moved << " segments to the cold store";
+  }
+}
+
+bool SystemLog::OffloadSegment(uint32_t id,
+                               std::chrono::system_clock::time_point modified) {
+  // Only the segment data moves. The index, checksum and time index files
+  // stay local as they are small and looked up without reading the segment.
+  const std::filesystem::path path = SegmentPath(id);
+  Tiers::Entry entry{
+      id,
+      0,
+      0,
+      0,
+      static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              modified.time_since_epoch())
+              .count()),
+      path.extension() == kCompressedSuffix};
+  {
+    std::shared_lock lock{mutex_};
+    if (id < FirstSegment()) {
+      return false;
+    }
+    entry.size = LookupSegment(id)->size();
+    const Index::Entry tail = LookupIndex(id)->tail();
+    entry.ordinal = tail.ordinal;
+    entry.end = tail.position;
+  }
+
+  options_.cold_store->Put(entry.name(), path);
+
+  {
+    std::unique_lock lock{mutex_};
+    // The segment may have been deleted by retention while being copied.
+    if (id >= FirstSegment()) {
+      // The segment is in the cold store once recorded, so if the log closes
+      // before the local file is removed it is removed when the log is
+      // reopened.
+      tiers_->Add(entry);
+
+      // Lookups reopen the segment from the cold store, though readers of the
+      // segment keep the local file they have open.
+      cache_->Erase(this, id);
+      std::error_code ec;
+      std::filesystem::remove(path, ec);
+      if (ec) {
+        LOG(ERROR) << "failed to remove segment " << id
+                   << " moved to the cold store: " << ec.message();
+      }
+      return true;
+    }
+  }
+
+  options_.cold_store->Remove(entry.name());
+  return false;
+}
+
+void SystemLog::RecoverTiers() {
+  for (const Tiers::Entry& entry : tiers_->entries()) {
+    for (const std::string& suffix : {std::string{}, kCompressedSuffix}) {
+      const std::filesystem::path path = path_ / (IdToName(entry.id) + suffix);
+      if (std::filesystem::exists(path)) {
+        LOG(WARNING) << "finishing move of segment " << entry.id
+                     << " to the cold store";
+        std::filesystem::remove(path);
+      }
+    }
+  }
+}
+
+std::filesystem::path SystemLog::SegmentPath(uint32_t id) const {
+  const std::filesystem::path compressed =
+      path_ / (IdToName(id) + kCompressedSuffix);
+  if (std::filesystem::exists(compressed)) {
+    return compressed;
+  }
+  return path_ / IdToName(id);
+}
+
+void SystemLog::ReadAhead(uint64_t offset, uint32_t size) {
+  uint64_t from;
+  uint32_t ahead;
+  if (!readahead_ || !readahead_->Lookup(offset, size, &from, &ahead)) {
+    return;
+  }
+
+  // Only reads ahead within the segment, as the segment after is read ahead
+  // once the stream reaches it. The active segment is in the page cache
+  // having just been written.
+  uint32_t position;
+  const uint32_t id = ResolveSegment(from, &position);
+  if (id == active_) {
+    return;
+  }
+  std::shared_ptr<Segment> segment = LookupSegment(id);
+  if (position < segment->size()) {
+    segment->WillNeed(position,
+                      std::min(ahead, segment->size() - position));
+  }
+}
+
+void SystemLog::DropSealed() {
+  if (undropped_.empty()) {
+    return;
+  }
+
+  const uint64_t flushed = flusher_->flushed();
+  const uint32_t first = FirstSegment();
+  std::vector<uint32_t> undropped;
+  for (uint32_t id : undropped_) {
+    // Segments deleted by retention no longer need dropping.
+    if (id < first) continue;
+
+    uint64_t start;
+    uint64_t end;
+    if (!offsets_.Start(id, &start) || !offsets_.Start(id + 1, &end) ||
+        end > flushed || IsReading(id, start, end)) {
+      undropped.push_back(id);
+      continue;
+    }
+    LookupSegment(id)->DontNeed(0, end - start);
+  }
+  undropped_ = std::move(undropped);
+}
+
+bool SystemLog::IsReading(uint32_t id, uint64_t start, uint64_t end) {
+  {
+    std::lock_guard lock{readers_mutex_};
+    if (readers_.find(id) != readers_.end()) {
+      return true;
+    }
+  }
+  return readahead_->Reading(start, end);
+}
+
+void SystemLog::AddReader(uint32_t id) {
+  std::lock_guard lock{readers_mutex_};
+  ++readers_[id];
+}
+
+void SystemLog::RemoveReader(uint32_t id) {
+  std::lock_guard lock{readers_mutex_};
+  auto it = readers_.find(id);
+  if (--it->second == 0) {
+    readers_.erase(it);
+  }
+}
+
+void SystemLog::NotifyWritten(const std::shared_ptr<Segment>& segment) {
+  // Only notify the flusher once buffered and in flight appends are written.
+  if (segment->written() == segment->size() && written_ != size_) {
+    // The checksums must be durable along with the appends they cover, else
+    // recovery would discard the appends.
+    checksums_->file()->Flush();
+    flusher_->Written(checksums_->file(), size_);
+    flusher_->Written(segment, size_);
+    written_ = size_;
+  }
+}
+
+void SystemLog::SyncDirectory() const {
+  const int fd = open(path_.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd == -1) {
+    throw LogException{"failed to open log directory", errno};
+  }
+  const int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw LogException{"log directory fsync failed", errno};
+  }
+}
+
+uint32_t SystemLog::ResolveSegment(uint64_t offset, uint32_t* position) {
+  uint32_t id;
+  uint64_t starting_offset;
+  if (!offsets_.Lookup(offset, &id, &starting_offset)) {
+    // This should never happen a segment at offset 0 is always added.
+    throw LogException("offset not found");
+  }
+  // Segments are smaller than 4 GiB so the position within the segment is
+  // always 32 bits.
+  *position = offset - starting_offset;
+  return id;
 }
 
 }  // namespace wombat::broker::log
@@ -16,12 +16,19 @@ namespace wombat::broker::log {
 
 SystemSegment::SystemSegment(uint32_t id, const std::filesystem::path& dir,
                              uint32_t limit)
-    : Segment{dir / IdToName(id), limit} {
-  std::filesystem::create_directories(dir);
+    : SystemSegment{dir / IdToName(id), limit} {}
+
+SystemSegment::SystemSegment(const std::filesystem::path& path, uint32_t limit,
+                             bool create)
+    : Segment{path, limit} {
+  if (create) {
+    std::filesystem::create_directories(path.parent_path());
+  }
 
   // Note cannot use O_APPEND as this does not work with sendfile.
   // TODO(AD) Look into O_ASYNC and O_NONBLOCK
-  fd_ = open(path_.c_str(), O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+  fd_ = open(path_.c_str(), create ? O_CREAT | O_RDWR : O_RDWR,
+             S_IRUSR | S_IWUSR);
   if (fd_ == -1) {
     throw LogException{"failed to open segment", errno};
   }
@@ -31,6 +38,11 @@ SystemSegment::SystemSegment(uint32_t id, const std::filesystem::path& dir,
 
 SystemSegment::~SystemSegment() {
   if (fd_ > 0) {
+    try {
+      Flush();
+    } catch (const LogException& e) {
+      // Cannot throw from the destructor. Note LogException logs the error.
+    }
     close(fd_);
   }
 }
@@ -0,0 +1,121 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/tailcache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+TailCache::TailCache(uint32_t capacity, uint64_t end)
+    : buffer_(capacity),
+      records_{},
+      end_{end},
+      size_{0},
+      hits_{0},
+      misses_{0} {}
+
+void TailCache::Append(const std::vector<uint8_t>& data) {
+  const uint32_t capacity = buffer_.size();
+  records_.push_back(end_);
+
+  // Only the end of a record larger than the cache is kept.
+  const uint8_t* src = data.data();
+  uint64_t n = data.size();
+  end_ += n;
+  if (n > capacity) {
+    src += n - capacity;
+    n = capacity;
+  }
+
+  // Copy in up to two parts as the data may wrap around the end of the
+  // buffer.
+  const uint32_t position = (end_ - n) % capacity;
+  const uint32_t first = std::min<uint64_t>(n, capacity - position);
+  std::memcpy(buffer_.data() + position, src, first);
+  std::memcpy(buffer_.data(), src + first, n - first);
+
+  size_ = std::min<uint64_t>(size_ + data.size(), capacity);
+  while (!records_.empty() && records_.front() < start()) {
+    records_.pop_front();
+  }
+}
+
+std::optional<std::vector<uint8_t>> TailCache::Lookup(uint64_t offset,
+                                                      uint32_t size) {
+  if (!Contains(offset, size)) {
+    ++misses_;
+    return std::nullopt;
+  }
+
+  ++hits_;
+  std::vector<uint8_t> data(size);
+  Copy(offset, size, data.data());
+  return data;
+}
+
+std::optional<View> TailCache::LookupView(uint64_t offset, uint32_t size) {
+  if (!Contains(offset, size)) {
+    return std::nullopt;
+  }
+
+  const uint32_t position = offset % buffer_.size();
+  if (size > buffer_.size() - position) {
+    return std::nullopt;
+  }
+  ++hits_;
+  return View{buffer_.data() + position, size};
+}
+
+bool TailCache::IsAligned(uint64_t offset, bool* aligned) const {
+  if (offset < start() || offset > end_) {
+    return false;
+  }
+  *aligned = offset == end_ ||
+             std::binary_search(records_.begin(), records_.end(), offset);
+  return true;
+}
+
+bool TailCache::Verify(uint64_t offset, View record, bool* valid) const {
+  if (!Contains(offset, record.size)) {
+    return false;
+  }
+
+  // The record must be exactly one appended record.
+  auto it = std::lower_bound(records_.begin(), records_.end(), offset);
+  if (it == records_.end() || *it != offset) {
+    *valid = false;
+    return true;
+  }
+  const uint64_t next = it + 1 == records_.end() ? end_ : *(it + 1);
+  if (next - offset != record.size) {
+    *valid = false;
+    return true;
+  }
+
+  const uint32_t position = offset % buffer_.size();
+  const uint32_t first =
+      std::min<uint64_t>(record.size, buffer_.size() - position);
+  *valid = std::memcmp(buffer_.data() + position, record.data, first) == 0 &&
+           std::memcmp(buffer_.data(), record.data + first,
+                       record.size - first) == 0;
+  return true;
+}
+
+bool TailCache::Contains(uint64_t offset, uint32_t size) const {
+  return offset >= start() && offset <= end_ && size <= end_ - offset;
+}
+
+void TailCache::Copy(uint64_t offset, uint32_t size, uint8_t* data) const {
+  const uint32_t position = offset % buffer_.size();
+  const uint32_t first = std::min<uint64_t>(size, buffer_.size() - position);
+  std::memcpy(data, buffer_.data() + position, first);
+  std::memcpy(data + first, buffer_.data(), size - first);
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,239 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/tiers.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "log/compressedsegment.h"
+#include "log/crc32c.h"
+#include "log/logexception.h"
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Format version of the tiers file, written first so the format can change.
+// Version 1 stored 32 bit ordinals, and is still read so logs written with
+// it keep their cold segments.
+constexpr uint32_t kVersion = 2;
+constexpr uint32_t kVersion1 = 1;
+
+constexpr uint32_t kCompressedFlag = 1;
+
+// Sizes of the version and entry count, each entry and the trailing
+// checksum.
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kEntrySize = 32;
+constexpr size_t kEntrySizeV1 = 28;
+constexpr size_t kChecksumSize = 4;
+
+void EncodeU32(uint32_t n, std::vector<uint8_t>* enc) {
+  const uint32_t ordered = htonl(n);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&ordered);
+  enc->insert(enc->end(), data, data + sizeof(ordered));
+}
+
+void EncodeU64(uint64_t n, std::vector<uint8_t>* enc) {
+  EncodeU32(n >> 32, enc);
+  EncodeU32(n, enc);
+}
+
+uint32_t DecodeU32(const uint8_t* enc) {
+  uint32_t n;
+  std::memcpy(&n, enc, sizeof(n));
+  return ntohl(n);
+}
+
+uint64_t DecodeU64(const uint8_t* enc) {
+  return (static_cast<uint64_t>(DecodeU32(enc)) << 32) | DecodeU32(enc + 4);
+}
+
+void SyncDirectory(const std::filesystem::path& dir) {
+  const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd == -1) {
+    throw LogException{"failed to open log directory", errno};
+  }
+  const int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw LogException{"log directory fsync failed", errno};
+  }
+}
+
+}  // namespace
+
+std::string Tiers::Entry::name() const {
+  return IdToName(id) + (compressed ? kCompressedSuffix : "");
+}
+
+bool Tiers::Entry::operator==(const Entry& entry) const {
+  return id == entry.id && size == entry.size && ordinal == entry.ordinal &&
+         end == entry.end && modified_ms == entry.modified_ms &&
+         compressed == entry.compressed;
+}
+
+Tiers::Tiers(const std::filesystem::path& dir) : dir_{dir}, entries_{} {
+  const std::filesystem::path path = dir_ / kTiersName;
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
+      return;
+    }
+    throw LogException{"failed to open tiers file", errno};
+  }
+
+  std::vector<uint8_t> enc;
+  uint8_t buf[4096];
+  while (true) {
+    const ssize_t res = read(fd, buf, sizeof(buf));
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      close(fd);
+      throw LogException{"tiers file read failed", errno};
+    }
+    if (res == 0) break;
+    enc.insert(enc.end(), buf, buf + res);
+  }
+  close(fd);
+
+  std::optional<std::vector<Entry>> entries = Decode(enc);
+  if (!entries) {
+    throw LogException{"tiers file corrupt"};
+  }
+  entries_ = std::move(*entries);
+}
+
+uint32_t Tiers::end() const {
+  return entries_.empty() ? 0 : entries_.back().id + 1;
+}
+
+bool Tiers::Lookup(uint32_t id, Entry* entry) const {
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), id,
+      [](const Entry& e, uint32_t id) { return e.id < id; });
+  if (it == entries_.end() || it->id != id) {
+    return false;
+  }
+  *entry = *it;
+  return true;
+}
+
+void Tiers::Add(const Entry& entry) {
+  if (entry.id < end()) {
+    throw LogException{"segment moved out of order"};
+  }
+  entries_.push_back(entry);
+  try {
+    Write();
+  } catch (const LogException& e) {
+    entries_.pop_back();
+    throw;
+  }
+}
+
+void Tiers::Truncate(uint32_t id) {
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), id,
+      [](const Entry& e, uint32_t id) { return e.id < id; });
+  if (it == entries_.begin()) {
+    return;
+  }
+  entries_.erase(entries_.begin(), it);
+  Write();
+}
+
+std::vector<uint8_t> Tiers::Encode() const {
+  std::vector<uint8_t> enc{};
+  enc.reserve(kHeaderSize + entries_.size() * kEntrySize + kChecksumSize);
+  EncodeU32(kVersion, &enc);
+  EncodeU32(entries_.size(), &enc);
+  for (const Entry& entry : entries_) {
+    EncodeU32(entry.id, &enc);
+    EncodeU32(entry.size, &enc);
+    EncodeU64(entry.ordinal, &enc);
+    EncodeU32(entry.end, &enc);
+    EncodeU64(entry.modified_ms, &enc);
+    EncodeU32(entry.compressed ? kCompressedFlag : 0, &enc);
+  }
+  EncodeU32(Crc32c(enc.data(), enc.size()), &enc);
+  return enc;
+}
+
+std::optional<std::vector<Tiers::Entry>> Tiers::Decode(
+    const std::vector<uint8_t>& enc) {
+  if (enc.size() < kHeaderSize + kChecksumSize) {
+    return std::nullopt;
+  }
+  const size_t body = enc.size() - kChecksumSize;
+  const uint32_t version = DecodeU32(enc.data());
+  if (DecodeU32(enc.data() + body) != Crc32c(enc.data(), body) ||
+      (version != kVersion && version != kVersion1)) {
+    return std::nullopt;
+  }
+  const bool v1 = version == kVersion1;
+  const size_t entry_size = v1 ? kEntrySizeV1 : kEntrySize;
+  const uint32_t count = DecodeU32(enc.data() + 4);
+  if (body - kHeaderSize != static_cast<uint64_t>(count) * entry_size) {
+    return std::nullopt;
+  }
+
+  std::vector<Entry> entries;
+  entries.reserve(count);
+  for (uint32_t i = 0; i != count; ++i) {
+    const uint8_t* e = enc.data() + kHeaderSize + i * entry_size;
+    // Fields after the ordinal follow 4 bytes earlier with version 1.
+    const size_t shift = v1 ? 4 : 0;
+    entries.push_back(
+        Entry{DecodeU32(e), DecodeU32(e + 4),
+              v1 ? DecodeU32(e + 8) : DecodeU64(e + 8),
+              DecodeU32(e + 16 - shift), DecodeU64(e + 20 - shift),
+              (DecodeU32(e + 28 - shift) & kCompressedFlag) != 0});
+  }
+  return entries;
+}
+
+void Tiers::Write() const {
+  const std::filesystem::path path = dir_ / kTiersName;
+  const std::filesystem::path tmp = dir_ / (kTiersName + ".tmp");
+
+  const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    throw LogException{"failed to open tiers file", errno};
+  }
+  const std::vector<uint8_t> enc = Encode();
+  size_t n = 0;
+  while (n != enc.size()) {
+    const ssize_t res = write(fd, enc.data() + n, enc.size() - n);
+    if (res == -1) {
+      if (errno == EINTR) continue;
+      const int err = errno;
+      close(fd);
+      throw LogException{"tiers file write failed", err};
+    }
+    n += res;
+  }
+  const int res = fsync(fd);
+  close(fd);
+  if (res == -1) {
+    throw LogException{"tiers file fsync failed", errno};
+  }
+
+  if (rename(tmp.c_str(), path.c_str()) == -1) {
+    throw LogException{"tiers file rename failed", errno};
+  }
+  SyncDirectory(dir_);
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,88 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/timeindex.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "log/segment.h"
+
+namespace wombat::broker::log {
+
+TimeIndex::TimeIndex(std::shared_ptr<Segment> segment, uint32_t resolution)
+    : segment_{std::move(segment)},
+      entries_{},
+      resolution_{std::max(resolution, 1U)} {
+  Load();
+}
+
+void TimeIndex::Append(uint64_t timestamp, uint32_t position) {
+  timestamp -= timestamp % resolution_;
+  if (!entries_.empty() && timestamp <= entries_.back().timestamp) {
+    return;
+  }
+
+  if (segment_) {
+    const uint32_t enc[] = {htonl(timestamp >> 32), htonl(timestamp),
+                            htonl(position)};
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(enc);
+    segment_->Append(std::vector<uint8_t>(data, data + kEntrySize));
+  }
+  entries_.push_back(Entry{timestamp, position});
+}
+
+void TimeIndex::Recover(uint32_t size) {
+  const size_t n = entries_.size();
+  while (!entries_.empty() && entries_.back().position >= size) {
+    entries_.pop_back();
+  }
+  if (segment_ && (entries_.size() != n ||
+                   segment_->size() != entries_.size() * kEntrySize)) {
+    // Remove discarded and partially written entries from the file so new
+    // entries follow the entries kept.
+    segment_->Truncate(entries_.size() * kEntrySize);
+  }
+}
+
+bool TimeIndex::Lookup(uint64_t timestamp, uint32_t* position) const {
+  auto it = std::lower_bound(
+      entries_.begin(), entries_.end(), timestamp,
+      [](const Entry& entry, uint64_t t) { return entry.timestamp < t; });
+  if (it == entries_.end()) {
+    return false;
+  }
+  *position = it->position;
+  return true;
+}
+
+void TimeIndex::ForEach(
+    const std::function<void(uint64_t timestamp, uint32_t position)>& fn)
+    const {
+  for (const Entry& entry : entries_) {
+    fn(entry.timestamp, entry.position);
+  }
+}
+
+void TimeIndex::Load() {
+  const uint32_t size = segment_->size() - segment_->size() % kEntrySize;
+  if (size == 0) return;
+
+  const std::vector<uint8_t> enc = segment_->Lookup(0, size);
+  entries_.reserve(size / kEntrySize);
+  for (uint32_t i = 0; i < enc.size(); i += kEntrySize) {
+    uint32_t entry[3];
+    std::memcpy(entry, enc.data() + i, kEntrySize);
+    const uint64_t timestamp =
+        (static_cast<uint64_t>(ntohl(entry[0])) << 32) | ntohl(entry[1]);
+    entries_.push_back(Entry{timestamp, ntohl(entry[2])});
+  }
+}
+
+}  // namespace wombat::broker::log
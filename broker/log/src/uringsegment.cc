@@ -0,0 +1,148 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/uringsegment.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include "log/logexception.h"
+#include "log/ring.h"
+
+namespace wombat::broker::log {
+
+UringSegment::UringSegment(uint32_t id, const std::filesystem::path& dir,
+                           uint32_t limit, Ring* ring)
+    : SystemSegment{id, dir, limit},
+      ring_{ring},
+      in_flight_{},
+      error_{0},
+      failed_{0} {}
+
+UringSegment::~UringSegment() {
+  try {
+    Flush();
+  } catch (const LogException& e) {
+    // Cannot throw from the destructor. Note LogException logs the error.
+  }
+}
+
+uint32_t UringSegment::written() const {
+  // Writes may complete out of order so only data before the first append
+  // in flight, or the first failed append, is known to be in the file.
+  const uint32_t written =
+      in_flight_.empty() ? size_ : in_flight_.begin()->first;
+  return error_ != 0 ? std::min(written, failed_) : written;
+}
+
+void UringSegment::Append(const std::vector<uint8_t>& data) {
+  if (data.empty()) return;
+
+  const uint32_t position = size_;
+  in_flight_.emplace(position, data);
+  size_ += data.size();
+  Submit(position, 0);
+}
+
+std::vector<uint8_t> UringSegment::Lookup(uint32_t offset, uint32_t size) {
+  // Reads past the end of the segment return nothing.
+  if (offset > size_ || size > size_ - offset) {
+    return {};
+  }
+
+  // Copy data still in flight from memory and read the rest from the file.
+  std::vector<uint8_t> data(size);
+  const uint32_t end = offset + size;
+  uint32_t pos = offset;
+  auto it = in_flight_.upper_bound(pos);
+  if (it != in_flight_.begin()) --it;
+  while (pos < end) {
+    if (it != in_flight_.end() && it->first + it->second.size() <= pos) {
+      ++it;
+    } else if (it != in_flight_.end() && it->first <= pos) {
+      const uint32_t n = std::min<uint32_t>(
+          end - pos, it->first + it->second.size() - pos);
+      std::memcpy(data.data() + (pos - offset),
+                  it->second.data() + (pos - it->first), n);
+      pos += n;
+      ++it;
+    } else {
+      const uint32_t next =
+          (it == in_flight_.end()) ? end : std::min(end, it->first);
+      if (!Read(pos, data.data() + (pos - offset), next - pos)) {
+        return {};
+      }
+      pos = next;
+    }
+  }
+  return data;
+}
+
+std::optional<View> UringSegment::LookupView(uint32_t offset, uint32_t size) {
+  // Only appends in flight are in memory so can be viewed.
+  auto it = in_flight_.upper_bound(offset);
+  if (it == in_flight_.begin()) {
+    return std::nullopt;
+  }
+  --it;
+  if (offset - it->first > it->second.size() ||
+      size > it->second.size() - (offset - it->first)) {
+    return std::nullopt;
+  }
+  return View{it->second.data() + (offset - it->first), size};
+}
+
+void UringSegment::Flush() {
+  while (!in_flight_.empty()) {
+    ring_->Poll(true);
+  }
+  Poll();
+}
+
+void UringSegment::Poll() {
+  if (error_ != 0) {
+    throw LogException{"segment write error", error_};
+  }
+}
+
+void UringSegment::Submit(uint32_t position, uint32_t done) {
+  const std::vector<uint8_t>& data = in_flight_.at(position);
+  ring_->Write(fd_, data.data() + done, data.size() - done, position + done,
+               [this, position, done](int32_t res) {
+                 Complete(position, done, res);
+               });
+}
+
+void UringSegment::Complete(uint32_t position, uint32_t done, int32_t res) {
+  if (res == -EINTR || res == -EAGAIN) {
+    Submit(position, done);
+    return;
+  }
+  if (res < 0) {
+    // Drop the append so flushing does not wait for it. The error is thrown
+    // by the next Poll or Flush rather than here so the completions polled
+    // along with this one still run.
+    in_flight_.erase(position);
+    if (error_ == 0) {
+      error_ = -res;
+      failed_ = position;
+    } else {
+      failed_ = std::min(failed_, position);
+    }
+    return;
+  }
+
+  done += res;
+  if (done < in_flight_.at(position).size()) {
+    // Retry short writes.
+    Submit(position, done);
+    return;
+  }
+  in_flight_.erase(position);
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,337 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/verifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "log/checksums.h"
+#include "log/compactor.h"
+#include "log/compressedsegment.h"
+#include "log/index.h"
+#include "log/logexception.h"
+#include "log/offsets.h"
+#include "log/scan.h"
+#include "log/segment.h"
+#include "log/systemlog.h"
+#include "log/systemsegment.h"
+#include "log/tiers.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+namespace {
+
+// Number of checksum entries read at a time when verifying records.
+constexpr uint32_t kChecksumBatch = 4096;
+
+// Returns the id of the segment file with the given name, or nullopt if the
+// file is not a segment.
+std::optional<uint32_t> NameToId(const std::string& name) {
+  const std::string prefix = IdToName(0).substr(0, IdToName(0).find('-') + 1);
+  if (name.size() != IdToName(0).size() || name.rfind(prefix, 0) != 0 ||
+      !std::all_of(name.begin() + prefix.size(), name.end(), ::isdigit)) {
+    return std::nullopt;
+  }
+  return std::stoul(name.substr(prefix.size()));
+}
+
+}  // namespace
+
+uint64_t Verifier::Result::throughput() const {
+  if (elapsed.count() == 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(bytes) * 1'000'000 / elapsed.count();
+}
+
+Verifier::Verifier(const std::filesystem::path& path, const Options& options,
+                   uint32_t threads)
+    : path_{path}, options_{options}, threads_{std::max(threads, 1U)} {}
+
+std::vector<Verifier::Result> Verifier::Verify() {
+  if (!std::filesystem::is_directory(path_)) {
+    throw LogException{"log directory not found"};
+  }
+
+  const Tiers tiers{path_};
+  Offsets offsets{std::make_shared<SystemSegment>(OFFSET_SEGMENT_ID, path_,
+                                                  options_.segment_limit),
+                  std::make_shared<SystemSegment>(
+                      path_ / (IdToName(OFFSET_SEGMENT_ID) + kStartSuffix),
+                      std::numeric_limits<uint32_t>::max())};
+  RebuildOffsets(tiers, &offsets);
+
+  uint32_t first;
+  uint32_t last;
+  uint64_t start;
+  if (!offsets.Lookup(offsets.start(), &first, &start) ||
+      !offsets.Lookup(offsets.MaxOffset(), &last, &start)) {
+    // A new log without segments.
+    return {};
+  }
+
+  std::vector<Result> results(last - first + 1);
+  for (uint32_t id = first; id <= last; ++id) {
+    results[id - first] = Result{id, 0, 0, 0, 0, false, false,
+                                 false, false, std::chrono::microseconds{0}};
+  }
+  Parallel(results.size(), [&](size_t i) { Scan(tiers, &results[i]); });
+
+  // Each segment must start where the previous segment ends.
+  for (size_t i = 1; i < results.size(); ++i) {
+    uint64_t prev;
+    uint64_t start;
+    if (!offsets.Start(results[i - 1].id, &prev) ||
+        !offsets.Start(results[i].id, &start) ||
+        (!results[i - 1].missing && !results[i - 1].skipped &&
+         start != prev + results[i - 1].bytes)) {
+      results[i].misplaced = true;
+    }
+  }
+
+  // Indexes are recovered in parallel, then missing indexes are rebuilt in
+  // parallel once the ordinals of their segments are known, as each segment
+  // follows the ordinals of the previous segment.
+  std::vector<std::optional<uint64_t>> next(results.size());
+  Parallel(results.size(),
+           [&](size_t i) { next[i] = RecoverIndex(tiers, &results[i]); });
+  std::vector<uint64_t> bases(results.size());
+  std::vector<size_t> missing;
+  for (size_t i = 0; i != results.size(); ++i) {
+    if (next[i]) continue;
+    bases[i] = i == 0 ? 0 : *next[i - 1];
+    next[i] = bases[i] + results[i].records;
+    if (!results[i].missing && !results[i].skipped) {
+      missing.push_back(i);
+    }
+  }
+  Parallel(missing.size(), [&](size_t i) {
+    RebuildIndex(bases[missing[i]], &results[missing[i]]);
+  });
+
+  return results;
+}
+
+bool Verifier::Ok(const std::vector<Result>& results) {
+  for (size_t i = 0; i != results.size(); ++i) {
+    const Result& result = results[i];
+    if (result.missing || result.misplaced || result.corrupt != 0 ||
+        (result.partial != 0 && i + 1 != results.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Verifier::Scan(const Tiers& tiers, Result* result) const {
+  const std::string name = IdToName(result->id);
+  Tiers::Entry entry;
+  if (tiers.Lookup(result->id, &entry)) {
+    result->bytes = entry.size;
+    result->skipped = true;
+    return;
+  }
+
+  const bool raw = std::filesystem::exists(path_ / name);
+  const bool compressed =
+      std::filesystem::exists(path_ / (name + kCompressedSuffix));
+  if (!raw && !compressed) {
+    result->missing = true;
+    return;
+  }
+  // Compaction replacing the segment is completed by the log when opened, so
+  // the segment files may be partly replaced.
+  if (std::filesystem::exists(path_ / (name + kSwapSuffix))) {
+    result->skipped = true;
+    return;
+  }
+
+  const std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+
+  std::shared_ptr<Segment> segment = OpenSegment(result->id);
+  result->bytes = segment->size();
+
+  const std::filesystem::path checksum_path = path_ / (name + kChecksumSuffix);
+  const bool has_checksums = std::filesystem::exists(checksum_path);
+  Checksums checksums{std::make_shared<SystemSegment>(
+      checksum_path, std::numeric_limits<uint32_t>::max())};
+
+  std::vector<uint8_t> entries;
+  uint32_t entries_from = 0;
+  const uint32_t end = ScanRecords(
+      segment.get(), 0, segment->size(), [&](uint32_t, View record) {
+        const uint32_t n = result->records++;
+        if (n >= checksums.size()) {
+          return true;
+        }
+        if (n >= entries_from + entries.size() / Checksums::kEntrySize) {
+          entries = checksums.Read(n, kChecksumBatch);
+          entries_from = n;
+        }
+        if (!Checksums::Matches(
+                entries.data() + (n - entries_from) * Checksums::kEntrySize,
+                record)) {
+          ++result->corrupt;
+        }
+        return true;
+      });
+  result->partial = segment->size() - end;
+
+  if (!has_checksums && segment->size() != 0) {
+    checksums.Rebuild(segment.get());
+    checksums.file()->Sync();
+    result->rebuilt = true;
+  }
+
+  result->elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - begin);
+}
+
+std::optional<uint64_t> Verifier::RecoverIndex(const Tiers& tiers,
+                                               Result* result) const {
+  Tiers::Entry entry;
+  if (tiers.Lookup(result->id, &entry)) {
+    // The entry records the ordinal following the last record so the
+    // segment is not fetched from the cold store.
+    return entry.ordinal;
+  }
+
+  const std::filesystem::path path =
+      path_ / (IdToName(result->id) + kIndexSuffix);
+  std::error_code ec;
+  if (std::filesystem::file_size(path, ec) == 0 || ec) {
+    return std::nullopt;
+  }
+  std::shared_ptr<Segment> file = std::make_shared<SystemSegment>(
+      path, std::numeric_limits<uint32_t>::max());
+  Index index{file, 0, options_.index_interval};
+  if (result->missing || result->skipped) {
+    return index.next();
+  }
+
+  const uint32_t size = file->size();
+  index.Recover(OpenSegment(result->id).get());
+  if (file->size() != size) {
+    file->Sync();
+    result->rebuilt = true;
+  }
+  return index.next();
+}
+
+void Verifier::RebuildIndex(uint64_t base, Result* result) const {
+  std::shared_ptr<Segment> file = std::make_shared<SystemSegment>(
+      path_ / (IdToName(result->id) + kIndexSuffix),
+      std::numeric_limits<uint32_t>::max());
+  if (file->size() != 0) {
+    // Discard a partially written entry.
+    file->Truncate(0);
+  }
+  Index index{file, base, options_.index_interval};
+  index.Recover(OpenSegment(result->id).get());
+  file->Sync();
+  result->rebuilt = true;
+}
+
+std::shared_ptr<Segment> Verifier::OpenSegment(uint32_t id) const {
+  if (std::filesystem::exists(path_ / (IdToName(id) + kCompressedSuffix))) {
+    return std::make_shared<CompressedSegment>(
+        id, path_, options_.compression_cache_blocks);
+  }
+  return std::make_shared<SystemSegment>(id, path_, options_.segment_limit);
+}
+
+void Verifier::RebuildOffsets(const Tiers& tiers, Offsets* offsets) const {
+  uint32_t id;
+  uint64_t start;
+  if (offsets->Lookup(offsets->MaxOffset(), &id, &start)) {
+    return;
+  }
+
+  std::set<uint32_t> ids;
+  for (const Tiers::Entry& entry : tiers.entries()) {
+    ids.insert(entry.id);
+  }
+  std::error_code ec;
+  for (std::filesystem::directory_iterator it{path_, ec}, end;
+       !ec && it != end; it.increment(ec)) {
+    std::string name = it->path().filename();
+    if (name.size() > kCompressedSuffix.size() &&
+        name.compare(name.size() - kCompressedSuffix.size(),
+                     kCompressedSuffix.size(), kCompressedSuffix) == 0) {
+      name.resize(name.size() - kCompressedSuffix.size());
+    }
+    const std::optional<uint32_t> id = NameToId(name);
+    if (id && *id != OFFSET_SEGMENT_ID) {
+      ids.insert(*id);
+    }
+  }
+  if (ec) {
+    throw LogException{"failed to list log directory", ec.value()};
+  }
+  if (ids.empty()) {
+    return;
+  }
+  if (*ids.rbegin() - *ids.begin() + 1 != ids.size()) {
+    throw LogException{"cannot rebuild offsets as segments are missing"};
+  }
+
+  LOG(WARNING) << "rebuilding the offsets of " << ids.size()
+               << " segments in " << path_;
+  uint64_t offset = offsets->start();
+  for (uint32_t id : ids) {
+    offsets->Insert(offset, id);
+    Tiers::Entry entry;
+    offset += tiers.Lookup(id, &entry) ? entry.size : OpenSegment(id)->size();
+  }
+  offsets->Sync();
+}
+
+void Verifier::Parallel(size_t n, const std::function<void(size_t)>& fn) const {
+  std::atomic<size_t> next{0};
+  std::mutex mutex;
+  std::exception_ptr err;
+  auto run = [&] {
+    for (size_t i = next++; i < n; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard lock{mutex};
+        if (!err) {
+          err = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 1; i < std::min<size_t>(threads_, n); ++i) {
+    threads.emplace_back(run);
+  }
+  run();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  if (err) {
+    std::rethrow_exception(err);
+  }
+}
+
+}  // namespace wombat::broker::log
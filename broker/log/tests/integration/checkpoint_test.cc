@@ -0,0 +1,81 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/checkpoint.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class CheckpointTest : public ::testing::Test {
+ protected:
+  Checkpoint Create() {
+    Checkpoint checkpoint{};
+    checkpoint.active = 3;
+    checkpoint.active_start = 0x1ffffaaaa;
+    checkpoint.end = 0x1ffffaaaa + 1200;
+    checkpoint.position = 1200;
+    checkpoint.checksums = 15;
+    checkpoint.ordinal = 0x1000000aa;
+    return checkpoint;
+  }
+};
+
+TEST_F(CheckpointTest, EncodeDecode) {
+  const Checkpoint checkpoint = Create();
+  const std::optional<Checkpoint> decoded =
+      Checkpoint::Decode(checkpoint.Encode());
+  ASSERT_TRUE(decoded);
+  EXPECT_EQ(checkpoint, *decoded);
+}
+
+TEST_F(CheckpointTest, DecodeCorrupt) {
+  std::vector<uint8_t> enc = Create().Encode();
+  enc[10] ^= 1;
+  EXPECT_FALSE(Checkpoint::Decode(enc));
+
+  enc = Create().Encode();
+  enc.pop_back();
+  EXPECT_FALSE(Checkpoint::Decode(enc));
+}
+
+TEST_F(CheckpointTest, WriteRead) {
+  TempDir dir{};
+  Checkpoint checkpoint = Create();
+  checkpoint.Write(dir.path());
+
+  std::optional<Checkpoint> read = Checkpoint::Read(dir.path());
+  ASSERT_TRUE(read);
+  EXPECT_EQ(checkpoint, *read);
+
+  // Writing again replaces the checkpoint.
+  checkpoint.position = 1800;
+  checkpoint.end = checkpoint.active_start + 1800;
+  checkpoint.Write(dir.path());
+
+  read = Checkpoint::Read(dir.path());
+  ASSERT_TRUE(read);
+  EXPECT_EQ(checkpoint, *read);
+  EXPECT_FALSE(
+      std::filesystem::exists(dir.path() / (kCheckpointName + ".tmp")));
+}
+
+TEST_F(CheckpointTest, ReadMissing) {
+  TempDir dir{};
+  EXPECT_FALSE(Checkpoint::Read(dir.path()));
+}
+
+TEST_F(CheckpointTest, ReadCorrupt) {
+  TempDir dir{};
+  Create().Write(dir.path());
+  std::ofstream{dir.path() / kCheckpointName, std::ios::app} << "trailing";
+
+  EXPECT_FALSE(Checkpoint::Read(dir.path()));
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,73 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/cleaner.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+using namespace std::chrono_literals;  // NOLINT
+
+class CleanerTest : public ::testing::Test {
+ protected:
+  std::filesystem::path CreateFile(const std::filesystem::path& path) {
+    std::ofstream{path} << "data";
+    return path;
+  }
+};
+
+TEST_F(CleanerTest, DeletesFiles) {
+  TempDir dir{};
+  const std::vector<std::filesystem::path> paths{
+      CreateFile(dir.path() / "a"), CreateFile(dir.path() / "b")};
+
+  Cleaner cleaner{0ms};
+  cleaner.Delete(paths);
+
+  const auto deadline = std::chrono::steady_clock::now() + 10s;
+  while (cleaner.pending() != 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(0U, cleaner.pending());
+  EXPECT_FALSE(std::filesystem::exists(paths[0]));
+  EXPECT_FALSE(std::filesystem::exists(paths[1]));
+}
+
+TEST_F(CleanerTest, RateLimitsDeletes) {
+  TempDir dir{};
+  const std::vector<std::filesystem::path> paths{
+      CreateFile(dir.path() / "a"), CreateFile(dir.path() / "b")};
+
+  {
+    Cleaner cleaner{1h};
+    cleaner.Delete(paths);
+
+    // Only the first file is deleted before the interval.
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (std::filesystem::exists(paths[0]) &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_FALSE(std::filesystem::exists(paths[0]));
+    EXPECT_TRUE(std::filesystem::exists(paths[1]));
+    EXPECT_EQ(1U, cleaner.pending());
+  }
+
+  // Remaining files are deleted on shutdown.
+  EXPECT_FALSE(std::filesystem::exists(paths[1]));
+}
+
+TEST_F(CleanerTest, MissingFile) {
+  TempDir dir{};
+  Cleaner cleaner{0ms};
+  cleaner.Delete({dir.path() / "missing"});
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,138 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/coldcache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "log/directorycoldstore.h"
+#include "log/segment.h"
+#include "log/systemsegment.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class ColdCacheTest : public ::testing::Test {
+ protected:
+  // Puts a file of size bytes in the store as name.
+  void Put(const TempDir& dir, DirectoryColdStore* store,
+           const std::string& name, size_t size) {
+    std::ofstream{dir.path() / name} << std::string(size, 'a');
+    store->Put(name, dir.path() / name);
+  }
+
+  // Opens cached files as segments.
+  static std::shared_ptr<Segment> Open(const std::filesystem::path& path) {
+    return std::make_shared<SystemSegment>(
+        path, std::numeric_limits<uint32_t>::max(), false);
+  }
+};
+
+TEST_F(ColdCacheTest, Fetch) {
+  TempDir dir{};
+  std::shared_ptr<DirectoryColdStore> store =
+      std::make_shared<DirectoryColdStore>(dir.path() / "cold");
+  Put(dir, store.get(), "a", 10);
+  ColdCache cache{store, dir.path() / "cache", 100};
+
+  const std::filesystem::path path = dir.path() / "cache" / "a";
+  std::shared_ptr<Segment> segment = cache.Fetch("a", Open);
+  ASSERT_TRUE(segment);
+  EXPECT_EQ(10U, segment->size());
+  EXPECT_EQ(10U, std::filesystem::file_size(path));
+  EXPECT_EQ(10U, cache.size());
+
+  // Fetching again is served from the cache, even if removed from the store,
+  // reusing the segment while it is open.
+  store->Remove("a");
+  EXPECT_EQ(segment, cache.Fetch("a", Open));
+  segment.reset();
+  segment = cache.Fetch("a", Open);
+  ASSERT_TRUE(segment);
+  EXPECT_EQ(10U, segment->size());
+  EXPECT_EQ(2U, cache.stats().hits);
+  EXPECT_EQ(1U, cache.stats().misses);
+
+  cache.Erase("a");
+  EXPECT_FALSE(std::filesystem::exists(path));
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_FALSE(cache.Fetch("a", Open));
+}
+
+TEST_F(ColdCacheTest, Evict) {
+  TempDir dir{};
+  std::shared_ptr<DirectoryColdStore> store =
+      std::make_shared<DirectoryColdStore>(dir.path() / "cold");
+  Put(dir, store.get(), "a", 40);
+  Put(dir, store.get(), "b", 40);
+  Put(dir, store.get(), "c", 40);
+  ColdCache cache{store, dir.path() / "cache", 100};
+
+  ASSERT_TRUE(cache.Fetch("a", Open));
+  ASSERT_TRUE(cache.Fetch("b", Open));
+  // Fetching a makes b the least recently fetched.
+  ASSERT_TRUE(cache.Fetch("a", Open));
+  ASSERT_TRUE(cache.Fetch("c", Open));
+
+  EXPECT_EQ(80U, cache.size());
+  EXPECT_EQ(1U, cache.stats().evictions);
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / "cache" / "a"));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "cache" / "b"));
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / "cache" / "c"));
+}
+
+TEST_F(ColdCacheTest, KeepsLatestFile) {
+  TempDir dir{};
+  std::shared_ptr<DirectoryColdStore> store =
+      std::make_shared<DirectoryColdStore>(dir.path() / "cold");
+  Put(dir, store.get(), "a", 40);
+  ColdCache cache{store, dir.path() / "cache", 10};
+
+  // A file larger than the limit is kept until the next fetch.
+  ASSERT_TRUE(cache.Fetch("a", Open));
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / "cache" / "a"));
+  EXPECT_EQ(0U, cache.stats().evictions);
+}
+
+TEST_F(ColdCacheTest, KeepsOpenFiles) {
+  TempDir dir{};
+  std::shared_ptr<DirectoryColdStore> store =
+      std::make_shared<DirectoryColdStore>(dir.path() / "cold");
+  Put(dir, store.get(), "a", 40);
+  Put(dir, store.get(), "b", 40);
+  Put(dir, store.get(), "c", 40);
+  ColdCache cache{store, dir.path() / "cache", 50};
+
+  // a is still open so is not evicted, and is counted in the size.
+  std::shared_ptr<Segment> a = cache.Fetch("a", Open);
+  ASSERT_TRUE(a);
+  ASSERT_TRUE(cache.Fetch("b", Open));
+  EXPECT_EQ(80U, cache.size());
+  EXPECT_EQ(0U, cache.stats().evictions);
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / "cache" / "a"));
+
+  // Once closed a is evicted by the next fetch.
+  a.reset();
+  ASSERT_TRUE(cache.Fetch("c", Open));
+  EXPECT_EQ(40U, cache.size());
+  EXPECT_EQ(2U, cache.stats().evictions);
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "cache" / "a"));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "cache" / "b"));
+}
+
+TEST_F(ColdCacheTest, RemovesPreviousFiles) {
+  TempDir dir{};
+  std::shared_ptr<DirectoryColdStore> store =
+      std::make_shared<DirectoryColdStore>(dir.path() / "cold");
+  std::filesystem::create_directories(dir.path() / "cache");
+  std::ofstream{dir.path() / "cache" / "a"} << "partial";
+
+  ColdCache cache{store, dir.path() / "cache", 100};
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "cache" / "a"));
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,144 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/compressedsegment.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/compressor.h"
+#include "log/inmemorysegment.h"
+#include "log/logexception.h"
+#include "log/systemsegment.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class CompressedSegmentTest : public ::testing::Test {
+ protected:
+  // Returns data where every other block of 100 bytes compresses.
+  std::vector<uint8_t> Data(uint32_t size) {
+    std::mt19937 gen{1};
+    std::vector<uint8_t> data(size);
+    for (uint32_t i = 0; i != size; ++i) {
+      data[i] = (i / 100) % 2 == 0 ? i / 100 : gen();
+    }
+    return data;
+  }
+
+  // Writes data compressed in blocks of block_size as the segment with the
+  // given id.
+  void Write(const std::filesystem::path& dir, uint32_t id,
+             const std::vector<uint8_t>& data, uint32_t block_size) {
+    InMemorySegment segment{id, dir, 1'000'000};
+    segment.Append(data);
+    SystemSegment out{dir / (IdToName(id) + kCompressedSuffix), 1'000'000};
+    ASSERT_TRUE(Compressor::Compress(&segment, block_size, &out));
+  }
+};
+
+TEST_F(CompressedSegmentTest, Lookup) {
+  TempDir dir{};
+  const std::vector<uint8_t> data = Data(1050);
+  Write(dir.path(), 0x2478, data, 100);
+
+  CompressedSegment segment{0x2478, dir.path(), 2};
+  EXPECT_EQ(1050U, segment.size());
+  EXPECT_TRUE(segment.is_full());
+  EXPECT_LT(std::filesystem::file_size(dir.path() /
+                                       (IdToName(0x2478) + kCompressedSuffix)),
+            1050U);
+
+  EXPECT_EQ(data, segment.Lookup(0, 1050));
+  // Lookups within a block, spanning blocks and of the last partial block.
+  for (uint32_t offset : {0U, 150U, 290U, 1000U, 1049U}) {
+    const uint32_t size = std::min(250U, 1050U - offset);
+    EXPECT_EQ(std::vector<uint8_t>(data.begin() + offset,
+                                   data.begin() + offset + size),
+              segment.Lookup(offset, size));
+  }
+  EXPECT_FALSE(segment.LookupView(0, 10));
+}
+
+TEST_F(CompressedSegmentTest, LookupEof) {
+  TempDir dir{};
+  Write(dir.path(), 0x2478, Data(300), 100);
+
+  CompressedSegment segment{0x2478, dir.path(), 2};
+  EXPECT_TRUE(segment.Lookup(290, 20).empty());
+  EXPECT_TRUE(segment.Lookup(301, 0).empty());
+  EXPECT_THROW(segment.Append({1, 2, 3}), LogException);
+}
+
+TEST_F(CompressedSegmentTest, Empty) {
+  TempDir dir{};
+  Write(dir.path(), 0x2478, {}, 100);
+
+  CompressedSegment segment{0x2478, dir.path(), 2};
+  EXPECT_EQ(0U, segment.size());
+  EXPECT_TRUE(segment.Lookup(0, 1).empty());
+}
+
+TEST_F(CompressedSegmentTest, ConcurrentLookups) {
+  TempDir dir{};
+  const std::vector<uint8_t> data = Data(10'000);
+  Write(dir.path(), 0x2478, data, 256);
+
+  CompressedSegment segment{0x2478, dir.path(), 4};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t != 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (uint32_t offset = t * 7; offset < 9'900; offset += 97) {
+        EXPECT_EQ(std::vector<uint8_t>(data.begin() + offset,
+                                       data.begin() + offset + 100),
+                  segment.Lookup(offset, 100));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(CompressedSegmentTest, CorruptBlock) {
+  TempDir dir{};
+  const std::vector<uint8_t> data = Data(300);
+  Write(dir.path(), 0x2478, data, 100);
+
+  // Corrupt the first block.
+  const std::filesystem::path path =
+      dir.path() / (IdToName(0x2478) + kCompressedSuffix);
+  {
+    SystemSegment file{path, 1'000'000};
+    std::vector<uint8_t> enc = file.Lookup(0, file.size());
+    enc[0] ^= 0xff;
+    file.Truncate(0);
+    file.Append(enc);
+  }
+
+  CompressedSegment segment{0x2478, dir.path(), 2};
+  EXPECT_TRUE(segment.Lookup(0, 10).empty());
+  EXPECT_TRUE(segment.Lookup(90, 20).empty());
+  EXPECT_EQ(std::vector<uint8_t>(data.begin() + 100, data.end()),
+            segment.Lookup(100, 200));
+}
+
+TEST_F(CompressedSegmentTest, Invalid) {
+  TempDir dir{};
+  {
+    SystemSegment file{0x2478, dir.path(), 1'000'000};
+    file.Append(Data(300));
+  }
+  std::filesystem::rename(
+      dir.path() / IdToName(0x2478),
+      dir.path() / (IdToName(0x2478) + kCompressedSuffix));
+
+  EXPECT_THROW((CompressedSegment{0x2478, dir.path(), 2}), LogException);
+  EXPECT_THROW((CompressedSegment{0x2479, dir.path(), 2}), LogException);
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,63 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/directorycoldstore.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class DirectoryColdStoreTest : public ::testing::Test {
+ protected:
+  std::string Read(const std::filesystem::path& path) {
+    std::ifstream f{path};
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+  }
+};
+
+TEST_F(DirectoryColdStoreTest, PutAndGet) {
+  TempDir dir{};
+  DirectoryColdStore store{dir.path() / "cold"};
+  EXPECT_TRUE(std::filesystem::is_directory(dir.path() / "cold"));
+
+  std::ofstream{dir.path() / "a"} << "data";
+  store.Put("segment", dir.path() / "a");
+  EXPECT_EQ("data", Read(dir.path() / "cold" / "segment"));
+
+  EXPECT_TRUE(store.Get("segment", dir.path() / "b"));
+  EXPECT_EQ("data", Read(dir.path() / "b"));
+
+  // Putting replaces the file, and getting replaces the local copy.
+  std::ofstream{dir.path() / "a"} << "updated";
+  store.Put("segment", dir.path() / "a");
+  EXPECT_TRUE(store.Get("segment", dir.path() / "b"));
+  EXPECT_EQ("updated", Read(dir.path() / "b"));
+}
+
+TEST_F(DirectoryColdStoreTest, GetMissing) {
+  TempDir dir{};
+  DirectoryColdStore store{dir.path() / "cold"};
+  EXPECT_FALSE(store.Get("segment", dir.path() / "b"));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "b"));
+}
+
+TEST_F(DirectoryColdStoreTest, Remove) {
+  TempDir dir{};
+  DirectoryColdStore store{dir.path() / "cold"};
+  std::ofstream{dir.path() / "a"} << "data";
+  store.Put("segment", dir.path() / "a");
+
+  store.Remove("segment");
+  EXPECT_FALSE(store.Get("segment", dir.path() / "b"));
+  // Removing a missing file does nothing.
+  store.Remove("segment");
+}
+
+}  // namespace wombat::broker::log::testing
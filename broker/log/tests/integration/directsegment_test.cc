@@ -0,0 +1,148 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/directsegment.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/segment.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class DirectSegmentTest : public ::testing::Test {
+ protected:
+  static constexpr uint32_t kLimit = 1'000'000;
+
+  std::vector<uint8_t> Data(uint32_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (uint32_t i = 0; i != size; ++i) {
+      data[i] = seed + i * 7;
+    }
+    return data;
+  }
+
+  std::vector<uint8_t> ReadFile(const std::filesystem::path& path) {
+    std::ifstream f{path, std::ios::binary};
+    return std::vector<uint8_t>{std::istreambuf_iterator<char>{f}, {}};
+  }
+};
+
+TEST_F(DirectSegmentTest, AppendAndLookup) {
+  TempDir dir{};
+  DirectSegment segment{1, dir.path(), kLimit, 8192,
+                        std::chrono::milliseconds{60'000}};
+  // The temporary directory is expected to support O_DIRECT.
+  EXPECT_TRUE(segment.direct());
+
+  std::vector<uint8_t> expected;
+  for (uint8_t i = 0; i != 5; ++i) {
+    const std::vector<uint8_t> data = Data(3000, i);
+    segment.Append(data);
+    expected.insert(expected.end(), data.begin(), data.end());
+  }
+  EXPECT_EQ(15'000U, segment.size());
+  // Only whole blocks of the full staging buffer are written.
+  EXPECT_EQ(8192U, segment.written());
+  EXPECT_EQ(8192U, std::filesystem::file_size(dir.path() / IdToName(1)));
+
+  // Lookups span the data written and the data staged.
+  EXPECT_EQ(expected, segment.Lookup(0, 15'000));
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 8000,
+                                 expected.begin() + 9000),
+            segment.Lookup(8000, 1000));
+  EXPECT_TRUE(segment.Lookup(14'000, 1001).empty());
+
+  // Only staged data can be viewed.
+  EXPECT_FALSE(segment.LookupView(8000, 1000));
+  const std::optional<View> view = segment.LookupView(9000, 1000);
+  ASSERT_TRUE(view);
+  EXPECT_EQ(std::vector<uint8_t>(expected.begin() + 9000,
+                                 expected.begin() + 10'000),
+            std::vector<uint8_t>(view->data, view->data + view->size));
+}
+
+TEST_F(DirectSegmentTest, FlushPartialBlock) {
+  TempDir dir{};
+  DirectSegment segment{1, dir.path(), kLimit, 8192,
+                        std::chrono::milliseconds{60'000}};
+
+  std::vector<uint8_t> expected = Data(5000, 1);
+  segment.Append(expected);
+  segment.Flush();
+  EXPECT_EQ(5000U, segment.written());
+  EXPECT_EQ(expected, ReadFile(dir.path() / IdToName(1)));
+
+  // The partial block is rewritten once complete.
+  const std::vector<uint8_t> data = Data(5000, 2);
+  segment.Append(data);
+  expected.insert(expected.end(), data.begin(), data.end());
+  EXPECT_EQ(expected, segment.Lookup(0, 10'000));
+  segment.Flush();
+  EXPECT_EQ(10'000U, segment.written());
+  EXPECT_EQ(expected, ReadFile(dir.path() / IdToName(1)));
+}
+
+TEST_F(DirectSegmentTest, Reopen) {
+  TempDir dir{};
+  std::vector<uint8_t> expected = Data(5000, 1);
+  {
+    DirectSegment segment{1, dir.path(), kLimit, 4096,
+                          std::chrono::milliseconds{60'000}};
+    segment.Append(expected);
+  }
+
+  // The partial block is loaded into the staging buffer when reopened.
+  DirectSegment segment{1, dir.path(), kLimit, 4096,
+                        std::chrono::milliseconds{60'000}};
+  EXPECT_EQ(5000U, segment.size());
+  EXPECT_EQ(expected, segment.Lookup(0, 5000));
+  EXPECT_TRUE(segment.LookupView(4096, 904));
+
+  const std::vector<uint8_t> data = Data(5000, 2);
+  segment.Append(data);
+  expected.insert(expected.end(), data.begin(), data.end());
+  segment.Flush();
+  EXPECT_EQ(expected, ReadFile(dir.path() / IdToName(1)));
+}
+
+TEST_F(DirectSegmentTest, Truncate) {
+  TempDir dir{};
+  DirectSegment segment{1, dir.path(), kLimit, 4096,
+                        std::chrono::milliseconds{60'000}};
+  std::vector<uint8_t> expected = Data(10'000, 1);
+  segment.Append(expected);
+
+  segment.Truncate(6000);
+  expected.resize(6000);
+  EXPECT_EQ(6000U, segment.size());
+  EXPECT_EQ(expected, segment.Lookup(0, 6000));
+
+  const std::vector<uint8_t> data = Data(3000, 2);
+  segment.Append(data);
+  expected.insert(expected.end(), data.begin(), data.end());
+  segment.Flush();
+  EXPECT_EQ(expected, ReadFile(dir.path() / IdToName(1)));
+}
+
+TEST_F(DirectSegmentTest, Linger) {
+  TempDir dir{};
+  DirectSegment segment{1, dir.path(), kLimit, 4096,
+                        std::chrono::milliseconds{60'000}};
+  segment.Append(Data(100, 1));
+  segment.Poll();
+  EXPECT_EQ(0U, segment.written());
+
+  DirectSegment lingered{2, dir.path(), kLimit, 4096,
+                         std::chrono::milliseconds{0}};
+  lingered.Append(Data(100, 1));
+  EXPECT_EQ(100U, lingered.written());
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,246 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/logdirs.h"
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+#include "log/segment.h"
+#include "log/systemlog.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class LogDirsTest : public ::testing::Test {
+ protected:
+  void Write(const std::filesystem::path& path, size_t size) {
+    std::ofstream{path} << std::string(size, 'a');
+  }
+
+  std::vector<uint8_t> Record(uint8_t b) {
+    return std::vector<uint8_t>(100, b);
+  }
+};
+
+TEST_F(LogDirsTest, NoDirs) {
+  EXPECT_THROW(LogDirs{{}}, LogException);
+}
+
+TEST_F(LogDirsTest, PlaceLeastLoaded) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  EXPECT_TRUE(std::filesystem::is_directory(dir.path() / "a"));
+  EXPECT_TRUE(std::filesystem::is_directory(dir.path() / "b"));
+
+  Write(dir.path() / "a" / "data", 1000);
+  EXPECT_EQ(1U, dirs.Place("p1"));
+  EXPECT_TRUE(std::filesystem::is_directory(dir.path() / "b" / "p1"));
+  EXPECT_EQ(dir.path() / "b" / "p1", dirs.Path(1, "p1"));
+
+  // Placing again returns the same directory.
+  Write(dir.path() / "b" / "p1" / "data", 2000);
+  EXPECT_EQ(1U, dirs.Place("p1"));
+  EXPECT_EQ(0U, dirs.Place("p2"));
+
+  // The load counts the blocks allocated, which are rounded up.
+  const std::vector<LogDirs::Load> loads = dirs.Loads();
+  ASSERT_EQ(2U, loads.size());
+  EXPECT_LE(1000U, loads[0].bytes);
+  EXPECT_LE(2000U, loads[1].bytes);
+}
+
+TEST_F(LogDirsTest, PlaceExisting) {
+  TempDir dir{};
+  std::filesystem::create_directories(dir.path() / "b" / "p1");
+  Write(dir.path() / "a" / "data", 1000);
+
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  // The existing log is used even though its directory is more loaded.
+  Write(dir.path() / "b" / "p1" / "data", 2000);
+  EXPECT_EQ(1U, dirs.Place("p1"));
+}
+
+TEST_F(LogDirsTest, PlaceRemovesCopies) {
+  TempDir dir{};
+  // A partial copy in b and a complete copy in both a and c.
+  std::filesystem::create_directories(dir.path() / "a" / "p1");
+  std::filesystem::create_directories(dir.path() / "b" / "p1");
+  std::filesystem::create_directories(dir.path() / "c" / "p1");
+  Write(dir.path() / "b" / "p1" / kMovingName, 0);
+
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b", dir.path() / "c"}};
+  EXPECT_EQ(0U, dirs.Place("p1"));
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / "a" / "p1"));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "b" / "p1"));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / "c" / "p1"));
+}
+
+TEST_F(LogDirsTest, Move) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+
+  Options options{};
+  options.segment_limit = 1000;
+  std::shared_ptr<SystemLog> log =
+      std::make_shared<SystemLog>(dirs.Path(0, "p1"), options);
+  for (int i = 0; i != 20; ++i) {
+    log->Append(Record(i));
+  }
+
+  // The log is copied while still in use, and is only complete once moved.
+  dirs.Copy("p1", 1);
+  EXPECT_TRUE(std::filesystem::exists(dirs.Path(1, "p1") / kMovingName));
+  EXPECT_EQ(std::filesystem::last_write_time(dirs.Path(0, "p1") / IdToName(1)),
+            std::filesystem::last_write_time(dirs.Path(1, "p1") / IdToName(1)));
+  for (int i = 20; i != 30; ++i) {
+    log->Append(Record(i));
+  }
+  const uint64_t size = log->size();
+  log.reset();
+
+  // The log is kept in its previous directory until removed.
+  dirs.Move("p1", 1);
+  EXPECT_EQ(1U, dirs.Place("p1"));
+  EXPECT_TRUE(std::filesystem::exists(dirs.Path(0, "p1")));
+  EXPECT_FALSE(std::filesystem::exists(dirs.Path(1, "p1") / kMovingName));
+  dirs.Remove("p1", 0);
+  EXPECT_FALSE(std::filesystem::exists(dirs.Path(0, "p1")));
+
+  log = std::make_shared<SystemLog>(dirs.Path(1, "p1"), options);
+  EXPECT_EQ(size, log->size());
+  for (int i = 0; i != 30; ++i) {
+    EXPECT_EQ(Record(i), log->Lookup(i * 100, 100));
+  }
+}
+
+TEST_F(LogDirsTest, MoveCopiesRewrittenFiles) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+  const std::filesystem::path data = dirs.Path(0, "p1") / "data";
+  Write(data, 100);
+
+  // Files changed within a second of copying are always copied again, so
+  // wait for the file to be older.
+  std::this_thread::sleep_for(std::chrono::milliseconds{1100});
+  dirs.Copy("p1", 1);
+
+  // Rewrite the file keeping its size and modification time, as compaction
+  // does.
+  const std::filesystem::file_time_type modified =
+      std::filesystem::last_write_time(data);
+  std::ofstream{data} << std::string(100, 'b');
+  std::filesystem::last_write_time(data, modified);
+
+  dirs.Move("p1", 1);
+  std::string content;
+  std::ifstream{dirs.Path(1, "p1") / "data"} >> content;
+  EXPECT_EQ(std::string(100, 'b'), content);
+}
+
+TEST_F(LogDirsTest, Revert) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+  Write(dirs.Path(0, "p1") / "data", 100);
+
+  dirs.Copy("p1", 1);
+  dirs.Move("p1", 1);
+  dirs.Revert("p1", 0);
+  EXPECT_EQ(0U, dirs.Place("p1"));
+  EXPECT_FALSE(std::filesystem::exists(dirs.Path(1, "p1")));
+  EXPECT_TRUE(std::filesystem::exists(dirs.Path(0, "p1") / "data"));
+}
+
+TEST_F(LogDirsTest, CopyKeepsHoles) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+
+  // A segment with a hole left by compaction between two records.
+  const size_t size = 1 << 20;
+  const std::filesystem::path data = dirs.Path(0, "p1") / "data";
+  {
+    std::ofstream file{data};
+    file << std::string(100, 'a');
+    file.seekp(size - 100);
+    file << std::string(100, 'b');
+  }
+  std::filesystem::resize_file(data, size);
+
+  dirs.Copy("p1", 1);
+  dirs.Move("p1", 1);
+  dirs.Remove("p1", 0);
+
+  const std::filesystem::path copy = dirs.Path(1, "p1") / "data";
+  ASSERT_EQ(size, std::filesystem::file_size(copy));
+  std::string content;
+  std::ifstream{copy} >> content;
+  EXPECT_EQ(std::string(100, 'a'), content.substr(0, 100));
+  EXPECT_EQ(std::string(100, 'b'), content.substr(content.size() - 100));
+
+  // Only the records are allocated, in both the copy and the load.
+  struct stat st;
+  ASSERT_EQ(0, stat(copy.c_str(), &st));
+  EXPECT_GT(size / 2, static_cast<size_t>(st.st_blocks) * 512);
+  EXPECT_GT(size / 2, dirs.Loads()[1].bytes);
+}
+
+TEST_F(LogDirsTest, CopyInvalidDir) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+  EXPECT_THROW(dirs.Copy("p1", 0), LogException);
+  EXPECT_THROW(dirs.Copy("p1", 2), LogException);
+}
+
+TEST_F(LogDirsTest, Abort) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+  Write(dirs.Path(0, "p1") / "data", 100);
+
+  dirs.Copy("p1", 1);
+  EXPECT_TRUE(std::filesystem::exists(dirs.Path(1, "p1") / "data"));
+  dirs.Abort("p1", 1);
+  EXPECT_FALSE(std::filesystem::exists(dirs.Path(1, "p1")));
+  EXPECT_TRUE(std::filesystem::exists(dirs.Path(0, "p1") / "data"));
+  EXPECT_EQ(0U, dirs.Place("p1"));
+}
+
+TEST_F(LogDirsTest, Throughput) {
+  TempDir dir{};
+  LogDirs dirs{{dir.path() / "a", dir.path() / "b"}};
+  ASSERT_EQ(0U, dirs.Place("p1"));
+
+  std::shared_ptr<SystemLog> log =
+      std::make_shared<SystemLog>(dirs.Path(0, "p1"), Options{});
+  dirs.Track("p1", log);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  for (int i = 0; i != 10; ++i) {
+    log->Append(Record(i));
+  }
+  std::vector<LogDirs::Load> loads = dirs.Loads();
+  EXPECT_LT(0U, loads[0].throughput);
+  EXPECT_EQ(0U, loads[1].throughput);
+
+  // Logs no longer in use are no longer tracked.
+  log.reset();
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  loads = dirs.Loads();
+  EXPECT_EQ(0U, loads[0].throughput);
+}
+
+}  // namespace wombat::broker::log::testing
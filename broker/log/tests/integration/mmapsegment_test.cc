@@ -0,0 +1,125 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+#include "log/mmapsegment.h"
+#include "log/systemsegment.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class MmapSegmentTest : public ::testing::Test {};
+
+TEST_F(MmapSegmentTest, OpenSealed) {
+  TempDir dir{};
+  const std::vector<uint8_t> data{1, 2, 3, 4, 5};
+  {
+    SystemSegment segment{0x2478, dir.path(), 5};
+    segment.Append(data);
+  }
+
+  MmapSegment segment{0x2478, dir.path()};
+  EXPECT_EQ(5U, segment.size());
+  EXPECT_TRUE(segment.is_full());
+
+  EXPECT_EQ(data, segment.Lookup(0U, 5U));
+
+  const std::vector<uint8_t> expected{3, 4};
+  EXPECT_EQ(expected, segment.Lookup(2U, 2U));
+}
+
+TEST_F(MmapSegmentTest, LookupView) {
+  TempDir dir{};
+  const std::vector<uint8_t> data{1, 2, 3, 4, 5};
+  {
+    SystemSegment segment{0x2478, dir.path(), 5};
+    segment.Append(data);
+  }
+
+  MmapSegment segment{0x2478, dir.path()};
+  std::optional<View> view = segment.LookupView(1U, 3U);
+  ASSERT_TRUE(view);
+  const std::vector<uint8_t> expected{2, 3, 4};
+  EXPECT_EQ(expected,
+            std::vector<uint8_t>(view->data, view->data + view->size));
+}
+
+TEST_F(MmapSegmentTest, LookupEof) {
+  TempDir dir{};
+  {
+    SystemSegment segment{0x2478, dir.path(), 5};
+    segment.Append({1, 2, 3});
+  }
+
+  MmapSegment segment{0x2478, dir.path()};
+  EXPECT_TRUE(segment.Lookup(2U, 3U).empty());
+  EXPECT_FALSE(segment.LookupView(3U, 1U));
+}
+
+TEST_F(MmapSegmentTest, OpenEmpty) {
+  TempDir dir{};
+  { SystemSegment segment{0x2478, dir.path(), 5}; }
+
+  MmapSegment segment{0x2478, dir.path()};
+  EXPECT_EQ(0U, segment.size());
+  EXPECT_TRUE(segment.Lookup(0U, 1U).empty());
+}
+
+TEST_F(MmapSegmentTest, OpenNotExist) {
+  TempDir dir{};
+  EXPECT_THROW((MmapSegment{0x2478, dir.path()}), LogException);
+}
+
+TEST_F(MmapSegmentTest, AppendThrows) {
+  TempDir dir{};
+  { SystemSegment segment{0x2478, dir.path(), 5}; }
+
+  MmapSegment segment{0x2478, dir.path()};
+  EXPECT_THROW(segment.Append({1, 2, 3}), LogException);
+}
+
+TEST_F(MmapSegmentTest, MoveDoesntUnmap) {
+  TempDir dir{};
+  const std::vector<uint8_t> data{1, 2, 3};
+  {
+    SystemSegment segment{0x2478, dir.path(), 3};
+    segment.Append(data);
+  }
+
+  MmapSegment segment_original{0x2478, dir.path()};
+  MmapSegment segment_clone{std::move(segment_original)};
+  EXPECT_EQ(data, segment_clone.Lookup(0U, 3U));
+}
+
+TEST_F(MmapSegmentTest, Send) {
+  TempDir dir{};
+  const std::vector<uint8_t> data{1, 2, 3};
+  {
+    SystemSegment segment{0x2478, dir.path(), 3};
+    segment.Append(data);
+  }
+
+  MmapSegment segment{0x2478, dir.path()};
+
+  int fd = memfd_create("myfd", O_RDWR);
+  if (fd == -1) FAIL();
+
+  EXPECT_EQ(3U, segment.Send(0, 3, fd));
+
+  if (lseek(fd, 0, SEEK_SET) != 0) FAIL();
+  uint8_t buf[3];
+  if (read(fd, buf, 3) != 3) FAIL();
+
+  std::vector<uint8_t> read(buf, buf + 3);
+  EXPECT_EQ(data, read);
+}
+
+}  // namespace wombat::broker::log::testing
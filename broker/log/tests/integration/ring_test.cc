@@ -0,0 +1,133 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+#include "log/ring.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class RingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    if (!Ring::Supported()) {
+      GTEST_SKIP() << "io_uring not supported";
+    }
+  }
+};
+
+TEST_F(RingTest, WriteSyncAndRead) {
+  TempDir dir{};
+  const int fd = open((dir.path() / "ring").c_str(), O_CREAT | O_RDWR,
+                      S_IRUSR | S_IWUSR);
+  ASSERT_NE(-1, fd);
+
+  Ring ring{8};
+
+  const std::vector<uint8_t> data{1, 2, 3, 4, 5};
+  int32_t written = 0;
+  ring.Write(fd, data.data(), data.size(), 0,
+             [&](int32_t res) { written = res; });
+  EXPECT_EQ(1U, ring.in_flight());
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(5, written);
+
+  int32_t synced = -1;
+  ring.Sync(fd, [&](int32_t res) { synced = res; });
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(0, synced);
+
+  std::vector<uint8_t> read(3);
+  int32_t n = 0;
+  ring.Read(fd, read.data(), read.size(), 2, [&](int32_t res) { n = res; });
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(3, n);
+  const std::vector<uint8_t> expected{3, 4, 5};
+  EXPECT_EQ(expected, read);
+
+  close(fd);
+}
+
+TEST_F(RingTest, MoreOperationsThanEntries) {
+  TempDir dir{};
+  const int fd = open((dir.path() / "ring").c_str(), O_CREAT | O_RDWR,
+                      S_IRUSR | S_IWUSR);
+  ASSERT_NE(-1, fd);
+
+  Ring ring{2};
+
+  std::vector<uint8_t> data(100);
+  uint32_t completed = 0;
+  for (uint32_t i = 0; i != data.size(); ++i) {
+    data[i] = i;
+    ring.Write(fd, data.data() + i, 1, i, [&](int32_t res) {
+      EXPECT_EQ(1, res);
+      ++completed;
+    });
+  }
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(100U, completed);
+
+  std::vector<uint8_t> read(100);
+  ASSERT_EQ(100, pread(fd, read.data(), read.size(), 0));
+  EXPECT_EQ(data, read);
+
+  close(fd);
+}
+
+TEST_F(RingTest, ReadError) {
+  Ring ring{8};
+
+  uint8_t buf[1];
+  int32_t n = 0;
+  ring.Read(-1, buf, 1, 0, [&](int32_t res) { n = res; });
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(-EBADF, n);
+}
+
+TEST_F(RingTest, CallbackThrowsStillRunsOthers) {
+  Ring ring{8};
+
+  uint8_t buf[1];
+  uint32_t completed = 0;
+  for (int i = 0; i != 3; ++i) {
+    ring.Read(-1, buf, 1, 0, [&](int32_t res) {
+      ++completed;
+      throw LogException{"read error", -res};
+    });
+  }
+  while (completed != 3) {
+    EXPECT_THROW(ring.Poll(true), LogException);
+  }
+  EXPECT_EQ(0U, ring.in_flight());
+}
+
+TEST_F(RingTest, DrainDropsCallbacks) {
+  TempDir dir{};
+  const int fd = open((dir.path() / "ring").c_str(), O_CREAT | O_RDWR,
+                      S_IRUSR | S_IWUSR);
+  ASSERT_NE(-1, fd);
+
+  Ring ring{8};
+
+  const std::vector<uint8_t> data{1, 2, 3};
+  bool called = false;
+  ring.Write(fd, data.data(), data.size(), 0,
+             [&](int32_t res) { called = true; });
+  ring.Drain();
+
+  EXPECT_EQ(0U, ring.in_flight());
+  EXPECT_FALSE(called);
+
+  close(fd);
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,1466 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/checkpoint.h"
+#include "log/checksums.h"
+#include "log/coldcache.h"
+#include "log/compressedsegment.h"
+#include "log/compressor.h"
+#include "log/directorycoldstore.h"
+#include "log/index.h"
+#include "log/logreader.h"
+#include "log/offsets.h"
+#include "log/options.h"
+#include "log/recordbatch.h"
+#include "log/ring.h"
+#include "log/segmentcache.h"
+#include "log/systemsegment.h"
+#include "log/systemlog.h"
+#include "log/tempdir.h"
+#include "log/tiers.h"
+
+namespace wombat::broker::log::testing {
+
+class SystemLogTest : public ::testing::Test {};
+
+TEST_F(SystemLogTest, AppendAndLookup) {
+  TempDir dir{};
+  SystemLog log{dir.path()};
+
+  EXPECT_EQ(0U, log.size());
+
+  const std::vector<uint8_t> data{1, 2, 3};
+  log.Append(data);
+  log.Append(data);
+
+  EXPECT_EQ(6U, log.size());
+  EXPECT_EQ(data, log.Lookup(3U, 3U));
+  EXPECT_TRUE(log.Lookup(6U, 3U).empty());
+}
+
+TEST_F(SystemLogTest, AppendRollsSegments) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  SystemLog log{dir.path(), options};
+
+  for (uint8_t i = 0; i != 5; ++i) {
+    log.Append({i, i, i, i});
+  }
+
+  EXPECT_EQ(20U, log.size());
+  for (uint8_t i = 0; i != 5; ++i) {
+    const std::vector<uint8_t> expected{i, i, i, i};
+    EXPECT_EQ(expected, log.Lookup(i * 4, 4U));
+  }
+}
+
+TEST_F(SystemLogTest, ReopenContinuesActiveSegment) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  {
+    SystemLog log{dir.path(), options};
+    log.Append({1, 1, 1, 1});
+    log.Append({2, 2});
+  }
+
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(6U, log.size());
+
+  log.Append({3, 3});
+  EXPECT_EQ(8U, log.size());
+
+  const std::vector<uint8_t> expected{2, 2, 3, 3};
+  EXPECT_EQ(expected, log.Lookup(4U, 4U));
+}
+
+TEST_F(SystemLogTest, MmapSealedSegments) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.mmap_sealed = true;
+  SystemLog log{dir.path(), options};
+
+  log.Append({1, 2, 3, 4});
+  log.Append({5, 6});
+
+  // The first segment is sealed so can be viewed.
+  std::optional<View> view = log.LookupView(1U, 2U);
+  ASSERT_TRUE(view);
+  const std::vector<uint8_t> expected{2, 3};
+  EXPECT_EQ(expected,
+            std::vector<uint8_t>(view->data, view->data + view->size));
+
+  // The active segment cannot be viewed so falls back to Lookup.
+  EXPECT_FALSE(log.LookupView(4U, 2U));
+  const std::vector<uint8_t> active{5, 6};
+  EXPECT_EQ(active, log.Lookup(4U, 2U));
+}
+
+TEST_F(SystemLogTest, MmapSealedSegmentsReopen) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.mmap_sealed = true;
+  {
+    SystemLog log{dir.path(), options};
+    log.Append({1, 2, 3, 4});
+    log.Append({5, 6});
+  }
+
+  SystemLog log{dir.path(), options};
+  std::optional<View> view = log.LookupView(0U, 4U);
+  ASSERT_TRUE(view);
+  const std::vector<uint8_t> expected{1, 2, 3, 4};
+  EXPECT_EQ(expected,
+            std::vector<uint8_t>(view->data, view->data + view->size));
+}
+
+TEST_F(SystemLogTest, MmapSealedSegmentsUncached) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.mmap_sealed = true;
+  options.open_segments = 0;
+  SystemLog log{dir.path(), options};
+
+  log.Append({1, 2, 3, 4});
+  log.Append({5, 6, 7, 8});
+  log.Append({9});
+
+  // The segments are not cached so the views alone keep them mapped.
+  std::optional<View> first = log.LookupView(0U, 4U);
+  std::optional<View> second = log.LookupView(4U, 4U);
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  const std::vector<uint8_t> expected_first{1, 2, 3, 4};
+  EXPECT_EQ(expected_first,
+            std::vector<uint8_t>(first->data, first->data + first->size));
+  const std::vector<uint8_t> expected_second{5, 6, 7, 8};
+  EXPECT_EQ(expected_second,
+            std::vector<uint8_t>(second->data, second->data + second->size));
+}
+
+TEST_F(SystemLogTest, SeekByOrdinal) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 20;
+  options.index_interval = 8;
+  SystemLog log{dir.path(), options};
+
+  // Records of 6 bytes so segments roll every 4 records.
+  for (uint8_t i = 0; i != 10; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+
+  for (uint32_t ordinal = 0; ordinal != 10; ++ordinal) {
+    uint64_t offset;
+    EXPECT_TRUE(log.Seek(ordinal, &offset));
+    EXPECT_EQ(ordinal * 6, offset);
+  }
+
+  // Seeking to the next record gives the end of the log.
+  uint64_t offset;
+  EXPECT_TRUE(log.Seek(10, &offset));
+  EXPECT_EQ(60U, offset);
+  EXPECT_FALSE(log.Seek(11, &offset));
+}
+
+TEST_F(SystemLogTest, SeekAfterReopen) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 20;
+  options.index_interval = 8;
+  {
+    SystemLog log{dir.path(), options};
+    for (uint8_t i = 0; i != 10; ++i) {
+      log.Append({0, 0, 0, 2, i, i});
+    }
+  }
+
+  // Remove an index to check it is rebuilt.
+  std::filesystem::remove(dir.path() / (IdToName(2) + kIndexSuffix));
+
+  SystemLog log{dir.path(), options};
+  log.Append({0, 0, 0, 2, 10, 10});
+  for (uint32_t ordinal = 0; ordinal != 11; ++ordinal) {
+    uint64_t offset;
+    EXPECT_TRUE(log.Seek(ordinal, &offset));
+    EXPECT_EQ(ordinal * 6, offset);
+  }
+}
+
+TEST_F(SystemLogTest, SeekByTime) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 10;
+  options.timestamp_resolution_ms = 1;
+
+  const auto now = [] {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+  };
+
+  // Records at offsets 0, 6, 12 and 18, each in a different millisecond and
+  // every other record in a new segment. Each record is stamped between the
+  // times before and after it was appended.
+  std::vector<uint64_t> before;
+  std::vector<uint64_t> after;
+  {
+    SystemLog log{dir.path(), options};
+    for (uint8_t i = 0; i != 4; ++i) {
+      before.push_back(now());
+      log.Append({0, 0, 0, 2, i, i});
+      after.push_back(now());
+      std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    }
+  }
+
+  SystemLog log{dir.path(), options};
+  uint64_t offset;
+  EXPECT_TRUE(log.SeekTime(0, &offset));
+  EXPECT_EQ(0U, offset);
+  for (uint64_t i = 0; i != 4; ++i) {
+    EXPECT_TRUE(log.SeekTime(before[i], &offset));
+    EXPECT_EQ(i * 6, offset);
+    // Records appended before the timestamp are skipped.
+    EXPECT_TRUE(log.SeekTime(after[i] + 1, &offset));
+    EXPECT_EQ((i + 1) * 6, offset);
+  }
+}
+
+TEST_F(SystemLogTest, SeekByTimeWithinResolution) {
+  TempDir dir{};
+  Options options{};
+  options.timestamp_resolution_ms = 86'400'000;
+  SystemLog log{dir.path(), options};
+
+  const uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+  const uint64_t stamp = now - now % options.timestamp_resolution_ms;
+  log.Append({0, 0, 0, 2, 1, 1});
+
+  uint64_t offset;
+  EXPECT_TRUE(log.SeekTime(stamp, &offset));
+  EXPECT_EQ(0U, offset);
+  // A time after the append as stamped, though before it was made, seeks to
+  // the end of the log.
+  EXPECT_TRUE(log.SeekTime(stamp + 1, &offset));
+  EXPECT_EQ(6U, offset);
+}
+
+TEST_F(SystemLogTest, IsAligned) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 20;
+  options.index_interval = 8;
+  SystemLog log{dir.path(), options};
+
+  for (uint8_t i = 0; i != 10; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+
+  for (uint32_t offset = 0; offset != 70; ++offset) {
+    EXPECT_EQ(offset % 6 == 0 || offset >= 60, log.IsAligned(offset));
+  }
+}
+
+TEST_F(SystemLogTest, LargeOffsets) {
+  TempDir dir{};
+  const uint64_t base = 0x1ffffaaaa;
+  {
+    // Simulate a log past 4 GiB whose earlier segments have been deleted.
+    Offsets offsets{
+        std::make_shared<SystemSegment>(OFFSET_SEGMENT_ID, dir.path(), 100),
+        std::make_shared<SystemSegment>(
+            dir.path() / (IdToName(OFFSET_SEGMENT_ID) + kStartSuffix), 100)};
+    offsets.Insert(base, 1);
+    offsets.Truncate(base);
+  }
+
+  Options options{};
+  options.segment_limit = 4;
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(base, log.start());
+  EXPECT_EQ(base, log.size());
+
+  for (uint8_t i = 0; i != 3; ++i) {
+    log.Append({0, 0, 0, 1, i});
+  }
+  EXPECT_EQ(base + 15, log.size());
+
+  const std::vector<uint8_t> expected{0, 0, 0, 1, 2};
+  EXPECT_EQ(expected, log.Lookup(base + 10, 5));
+  EXPECT_TRUE(log.IsAligned(base + 5));
+  EXPECT_FALSE(log.IsAligned(base + 6));
+  EXPECT_TRUE(log.Verify(base + 10, View{expected.data(), 5}));
+
+  uint64_t offset;
+  EXPECT_TRUE(log.Seek(2, &offset));
+  EXPECT_EQ(base + 10, offset);
+}
+
+TEST_F(SystemLogTest, TornTailRecovery) {
+  TempDir dir{};
+  {
+    SystemLog log{dir.path()};
+    log.Append({0, 0, 0, 2, 1, 1});
+    log.Append({0, 0, 0, 2, 2, 2});
+  }
+
+  // Simulate a crash while writing an append, where the data reached the
+  // segment but the checksum did not.
+  std::ofstream{dir.path() / IdToName(1), std::ios::app} << "torn";
+
+  {
+    SystemLog log{dir.path()};
+    EXPECT_EQ(12U, log.size());
+    log.Append({0, 0, 0, 2, 3, 3});
+  }
+
+  // Simulate a crash where the last append was only partially written.
+  std::filesystem::resize_file(dir.path() / IdToName(1), 15);
+
+  SystemLog log{dir.path()};
+  EXPECT_EQ(12U, log.size());
+  const std::vector<uint8_t> expected{0, 0, 0, 2, 2, 2};
+  EXPECT_EQ(expected, log.Lookup(6U, 6U));
+
+  uint64_t offset;
+  EXPECT_TRUE(log.Seek(2, &offset));
+  EXPECT_EQ(12U, offset);
+  log.Append({0, 0, 0, 2, 4, 4});
+  EXPECT_TRUE(log.Seek(2, &offset));
+  EXPECT_EQ(12U, offset);
+  EXPECT_FALSE(log.Seek(4, &offset));
+}
+
+TEST_F(SystemLogTest, VerifyRecords) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 10;
+  SystemLog log{dir.path(), options};
+
+  // Records at offsets 0, 6, 12 in segment 1 and 18 in segment 2.
+  for (uint8_t i = 0; i != 4; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+
+  for (uint8_t i = 0; i != 4; ++i) {
+    const std::vector<uint8_t> record{0, 0, 0, 2, i, i};
+    EXPECT_TRUE(log.Verify(i * 6, View{record.data(), 6}));
+  }
+
+  const std::vector<uint8_t> corrupt{0, 0, 0, 2, 1, 0};
+  EXPECT_FALSE(log.Verify(6, View{corrupt.data(), 6}));
+  EXPECT_FALSE(log.Verify(18, View{corrupt.data(), 6}));
+  // Offsets that are not the start of a record fail verification.
+  EXPECT_FALSE(log.Verify(3, View{corrupt.data(), 6}));
+  EXPECT_FALSE(log.Verify(24, View{corrupt.data(), 6}));
+}
+
+TEST_F(SystemLogTest, VerifyKeepsSegmentsCached) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 6;
+  options.open_segments = 3;
+  options.open_checksum_files = 1;
+  SystemLog log{dir.path(), options};
+
+  // Each record fills a segment so segments 1 to 3 are sealed and cached.
+  for (uint8_t i = 0; i != 3; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+
+  // Verifying opens the checksum file of each segment, which are cached
+  // separately so never evict the segments.
+  for (int pass = 0; pass != 2; ++pass) {
+    for (uint8_t i = 0; i != 3; ++i) {
+      const std::vector<uint8_t> record{0, 0, 0, 2, i, i};
+      EXPECT_TRUE(log.Verify(i * 6, View{record.data(), 6}));
+    }
+  }
+  EXPECT_EQ(0U, log.segment_cache_stats().evictions);
+}
+
+TEST_F(SystemLogTest, ChecksumsAddedToExistingSegment) {
+  TempDir dir{};
+  {
+    SystemLog log{dir.path()};
+    log.Append({0, 0, 0, 2, 1, 1});
+    log.Append({0, 0, 0, 2, 2, 2});
+  }
+
+  // Segments written before checksums were added have no checksum file.
+  std::filesystem::remove(dir.path() / (IdToName(1) + kChecksumSuffix));
+
+  {
+    SystemLog log{dir.path()};
+    EXPECT_EQ(12U, log.size());
+    log.Append({0, 0, 0, 2, 3, 3});
+  }
+
+  SystemLog log{dir.path()};
+  EXPECT_EQ(18U, log.size());
+  const std::vector<uint8_t> record{0, 0, 0, 2, 2, 2};
+  EXPECT_TRUE(log.Verify(6, View{record.data(), 6}));
+}
+
+TEST_F(SystemLogTest, RecoveryResumesFromCheckpoint) {
+  TempDir dir{};
+  {
+    SystemLog log{dir.path()};
+    log.Append({0, 0, 0, 2, 1, 1});
+    log.Append({0, 0, 0, 2, 2, 2});
+  }
+
+  // Closing the log checkpoints the active segment.
+  const std::optional<Checkpoint> checkpoint = Checkpoint::Read(dir.path());
+  ASSERT_TRUE(checkpoint);
+  EXPECT_EQ(1U, checkpoint->active);
+  EXPECT_EQ(12U, checkpoint->end);
+  EXPECT_EQ(2U, checkpoint->checksums);
+  EXPECT_EQ(2U, checkpoint->ordinal);
+
+  // Corrupt data covered by the checkpoint, which recovery does not verify
+  // again, and add a torn tail after the checkpoint which it does.
+  {
+    std::fstream f{dir.path() / IdToName(1),
+                   std::ios::in | std::ios::out | std::ios::binary};
+    f.seekp(4);
+    f.put(9);
+  }
+  std::ofstream{dir.path() / IdToName(1), std::ios::app} << "torn";
+
+  SystemLog log{dir.path()};
+  EXPECT_EQ(12U, log.size());
+  const std::vector<uint8_t> record = log.Lookup(0, 6);
+  EXPECT_FALSE(log.Verify(0, View{record.data(), 6}));
+
+  uint64_t offset;
+  log.Append({0, 0, 0, 2, 3, 3});
+  EXPECT_TRUE(log.Seek(2, &offset));
+  EXPECT_EQ(12U, offset);
+  EXPECT_TRUE(log.Seek(3, &offset));
+  EXPECT_EQ(18U, offset);
+}
+
+TEST_F(SystemLogTest, PeriodicCheckpoint) {
+  TempDir dir{};
+  Options options{};
+  options.checkpoint_interval_ms = 1;
+  SystemLog log{dir.path(), options};
+  log.Append({0, 0, 0, 2, 1, 1});
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{5});
+  log.Poll();
+
+  const std::optional<Checkpoint> checkpoint = Checkpoint::Read(dir.path());
+  ASSERT_TRUE(checkpoint);
+  EXPECT_EQ(6U, checkpoint->end);
+  EXPECT_EQ(6U, checkpoint->position);
+  EXPECT_EQ(1U, checkpoint->ordinal);
+}
+
+TEST_F(SystemLogTest, BufferedAppends) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 8;
+  options.append_buffer_bytes = 100;
+  options.append_linger_ms = 60'000;
+  {
+    SystemLog log{dir.path(), options};
+    for (uint8_t i = 0; i != 5; ++i) {
+      log.Append({i, i, i});
+    }
+
+    // The sealed segment is written and the active segment buffered.
+    EXPECT_EQ(9U, log.flushed());
+    for (uint8_t i = 0; i != 5; ++i) {
+      const std::vector<uint8_t> expected{i, i, i};
+      EXPECT_EQ(expected, log.Lookup(i * 3, 3U));
+    }
+  }
+
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(15U, log.size());
+  const std::vector<uint8_t> expected{4, 4, 4};
+  EXPECT_EQ(expected, log.Lookup(12U, 3U));
+}
+
+TEST_F(SystemLogTest, DirectIO) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 10'000;
+  options.direct_io = true;
+  options.direct_buffer_bytes = 4096;
+  options.append_linger_ms = 60'000;
+  std::vector<std::vector<uint8_t>> records;
+  {
+    SystemLog log{dir.path(), options};
+    for (uint32_t i = 0; i != 150; ++i) {
+      records.emplace_back(100, i);
+      log.Append(records.back());
+    }
+
+    // The sealed segment is written and the active segment partly staged.
+    EXPECT_EQ(10'000U, log.flushed());
+    for (uint32_t i = 0; i != 150; ++i) {
+      EXPECT_EQ(records[i], log.Lookup(i * 100, 100U));
+    }
+  }
+
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(15'000U, log.size());
+  for (uint32_t i = 0; i != 150; ++i) {
+    EXPECT_EQ(records[i], log.Lookup(i * 100, 100U));
+  }
+}
+
+TEST_F(SystemLogTest, TailCache) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 10;
+  options.tail_cache_bytes = 12;
+  SystemLog log{dir.path(), options};
+
+  // Records at offsets 0, 6 and 12, where only the last two are cached.
+  for (uint8_t i = 0; i != 3; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+
+  const std::vector<uint8_t> expected{0, 0, 0, 2, 2, 2};
+  EXPECT_EQ(expected, log.Lookup(12, 6));
+  const std::optional<View> view = log.LookupView(12, 6);
+  ASSERT_TRUE(view);
+  EXPECT_EQ(expected, std::vector<uint8_t>(view->data, view->data + 6));
+  EXPECT_TRUE(log.IsAligned(12));
+  EXPECT_FALSE(log.IsAligned(13));
+  EXPECT_TRUE(log.Verify(12, View{expected.data(), 6}));
+
+  // Older records are read from the segments.
+  const std::vector<uint8_t> older{0, 0, 0, 2, 0, 0};
+  EXPECT_EQ(older, log.Lookup(0, 6));
+
+  const TailCache::Stats stats = log.tail_cache_stats();
+  EXPECT_EQ(2U, stats.hits);
+  EXPECT_EQ(1U, stats.misses);
+}
+
+TEST_F(SystemLogTest, Reader) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 16;
+  options.reader_block_bytes = 8;
+  SystemLog log{dir.path(), options};
+
+  // Records of 6 bytes so each segment holds two records.
+  for (uint8_t i = 0; i != 5; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+
+  EXPECT_FALSE(log.NewReader(3));
+  EXPECT_FALSE(log.NewReader(36));
+
+  std::unique_ptr<LogReader> reader = log.NewReader(6);
+  ASSERT_TRUE(reader);
+  for (uint8_t i = 1; i != 5; ++i) {
+    EXPECT_EQ(6U * i, reader->offset());
+    const std::optional<View> record = reader->Next();
+    ASSERT_TRUE(record);
+    const std::vector<uint8_t> expected{0, 0, 0, 2, i, i};
+    EXPECT_EQ(expected,
+              std::vector<uint8_t>(record->data, record->data + record->size));
+    EXPECT_TRUE(reader->Verify(*record));
+
+    const std::vector<uint8_t> corrupt{0, 0, 0, 2, i, 0xff};
+    EXPECT_FALSE(reader->Verify(View{corrupt.data(), 6}));
+  }
+
+  // Reading past the end of the log resumes once more records are appended.
+  EXPECT_FALSE(reader->Next());
+  log.Append({0, 0, 0, 1, 5});
+  const std::optional<View> record = reader->Next();
+  ASSERT_TRUE(record);
+  EXPECT_EQ(5U, record->size);
+  EXPECT_EQ(35U, reader->offset());
+}
+
+TEST_F(SystemLogTest, ReaderTailCache) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 10;
+  options.tail_cache_bytes = 12;
+  SystemLog log{dir.path(), options};
+
+  std::unique_ptr<LogReader> reader = log.NewReader(0);
+  ASSERT_TRUE(reader);
+  for (uint8_t i = 0; i != 3; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+    const std::optional<View> record = reader->Next();
+    ASSERT_TRUE(record);
+    EXPECT_EQ(i, record->data[4]);
+    EXPECT_TRUE(reader->Verify(*record));
+  }
+
+  // Each record is read from the cache as it is appended.
+  EXPECT_EQ(6U, log.tail_cache_stats().hits);
+}
+
+TEST_F(SystemLogTest, ConcurrentReads) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 64;
+  options.reader_block_bytes = 16;
+  options.tail_cache_bytes = 32;
+  SystemLog log{dir.path(), options};
+  ASSERT_TRUE(log.concurrent_reads());
+
+  // Readers follow the log while it is appended to, rolling segments and
+  // wrapping the tail cache, until every record has been read.
+  const uint8_t kRecords = 200;
+  std::vector<std::thread> readers;
+  std::vector<int> read(4);
+  for (int& n : read) {
+    readers.emplace_back([&log, &n] {
+      std::unique_ptr<LogReader> reader = log.NewReader(0);
+      while (n != kRecords) {
+        const uint64_t offset = reader->offset();
+        const std::optional<View> record = reader->Next();
+        if (!record) {
+          std::this_thread::yield();
+          continue;
+        }
+        const std::vector<uint8_t> expected{0, 0, 0, 2, static_cast<uint8_t>(n),
+                                            static_cast<uint8_t>(n)};
+        const std::vector<uint8_t> data(record->data,
+                                        record->data + record->size);
+        if (data != expected || !reader->Verify(*record) ||
+            log.Lookup(offset, 6) != expected || !log.IsAligned(offset)) {
+          return;
+        }
+        ++n;
+      }
+    });
+  }
+
+  for (uint8_t i = 0; i != kRecords; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+    log.Poll();
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  for (int n : read) {
+    EXPECT_EQ(kRecords, n);
+  }
+}
+
+TEST_F(SystemLogTest, UringEngine) {
+  if (!Ring::Supported()) {
+    GTEST_SKIP() << "io_uring not supported";
+  }
+
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 8;
+  options.engine = Engine::kUring;
+  {
+    SystemLog log{dir.path(), options};
+    for (uint8_t i = 0; i != 5; ++i) {
+      log.Append({i, i, i});
+    }
+    EXPECT_EQ(15U, log.size());
+
+    // Appends in flight are visible to lookups.
+    for (uint8_t i = 0; i != 5; ++i) {
+      const std::vector<uint8_t> expected{i, i, i};
+      EXPECT_EQ(expected, log.Lookup(i * 3, 3U));
+    }
+
+    while (log.in_flight() != 0) log.Poll();
+    EXPECT_EQ(15U, log.flushed());
+
+    // Lookups of written data complete when polled.
+    std::vector<uint8_t> found;
+    log.LookupAsync(3U, 3U, [&](std::vector<uint8_t> data) { found = data; });
+    EXPECT_EQ(1U, log.in_flight());
+    while (log.in_flight() != 0) log.Poll();
+    const std::vector<uint8_t> expected{1, 1, 1};
+    EXPECT_EQ(expected, found);
+
+    // Lookups past the end complete immediately.
+    bool called = false;
+    log.LookupAsync(15U, 3U, [&](std::vector<uint8_t> data) {
+      EXPECT_TRUE(data.empty());
+      called = true;
+    });
+    EXPECT_TRUE(called);
+
+    log.Append({5, 5, 5});
+  }
+
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(18U, log.size());
+  const std::vector<uint8_t> expected{5, 5, 5};
+  EXPECT_EQ(expected, log.Lookup(15U, 3U));
+}
+
+TEST_F(SystemLogTest, UringCallbacksUseLog) {
+  if (!Ring::Supported()) {
+    GTEST_SKIP() << "io_uring not supported";
+  }
+
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 12;
+  options.engine = Engine::kUring;
+  SystemLog log{dir.path(), options};
+  for (uint8_t i = 0; i != 5; ++i) {
+    log.Append({0, 0, 0, 2, i, i});
+  }
+  while (log.in_flight() != 0) log.Poll();
+
+  // Callbacks of lookups completed by Poll may look up and verify records,
+  // as consumes do.
+  bool verified = false;
+  std::vector<uint8_t> found;
+  log.LookupAsync(6U, 6U, [&](std::vector<uint8_t> data) {
+    const View record{data.data(), static_cast<uint32_t>(data.size())};
+    verified = log.IsAligned(6U) && log.Verify(6U, record);
+    log.LookupAsync(12U, 6U, [&](std::vector<uint8_t> data) { found = data; });
+  });
+  while (log.in_flight() != 0) log.Poll();
+
+  EXPECT_TRUE(verified);
+  const std::vector<uint8_t> expected{0, 0, 0, 2, 2, 2};
+  EXPECT_EQ(expected, found);
+}
+
+TEST_F(SystemLogTest, PreallocatedSegments) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.preallocate = true;
+  {
+    SystemLog log{dir.path(), options};
+    // Records of 5 bytes so segments roll every record.
+    for (uint8_t i = 0; i != 5; ++i) {
+      log.Append({0, 0, 0, 1, i});
+    }
+
+    EXPECT_EQ(25U, log.size());
+    for (uint8_t i = 0; i != 5; ++i) {
+      const std::vector<uint8_t> expected{0, 0, 0, 1, i};
+      EXPECT_EQ(expected, log.Lookup(i * 5, 5U));
+    }
+    uint64_t offset;
+    ASSERT_TRUE(log.Seek(3, &offset));
+    EXPECT_EQ(15U, offset);
+  }
+
+  // The segment prepared ahead of the roll is empty so is ignored on reopen.
+  EXPECT_EQ(0U, std::filesystem::file_size(dir.path() / IdToName(7)));
+
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(25U, log.size());
+  log.Append({0, 0, 0, 1, 5});
+  const std::vector<uint8_t> expected{0, 0, 0, 1, 5};
+  EXPECT_EQ(expected, log.Lookup(25U, 5U));
+  uint64_t offset;
+  ASSERT_TRUE(log.Seek(5, &offset));
+  EXPECT_EQ(25U, offset);
+}
+
+TEST_F(SystemLogTest, BoundedOpenSegments) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.open_segments = 2;
+  SystemLog log{dir.path(), options};
+
+  for (uint8_t i = 0; i != 6; ++i) {
+    log.Append({i, i, i, i});
+  }
+  for (uint8_t i = 6; i != 0; --i) {
+    const uint8_t n = i - 1;
+    const std::vector<uint8_t> expected{n, n, n, n};
+    EXPECT_EQ(expected, log.Lookup(n * 4, 4U));
+  }
+
+  // Sealed segments are cached as they roll so segments 5 and 6 hit and
+  // segments 1 to 4 miss.
+  const SegmentCache::Stats stats = log.segment_cache_stats();
+  EXPECT_EQ(2U, stats.hits);
+  EXPECT_EQ(4U, stats.misses);
+  EXPECT_EQ(8U, stats.evictions);
+}
+
+TEST_F(SystemLogTest, SharedSegmentCache) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.segment_cache = std::make_shared<SegmentCache>(2);
+  SystemLog log1{dir.path() / "1", options};
+  {
+    SystemLog log2{dir.path() / "2", options};
+    for (uint8_t i = 0; i != 2; ++i) {
+      log1.Append({1, 1, 1, i});
+      log2.Append({2, 2, 2, i});
+    }
+    EXPECT_EQ(2U, options.segment_cache->size());
+    const std::vector<uint8_t> expected{2, 2, 2, 1};
+    EXPECT_EQ(expected, log2.Lookup(4U, 4U));
+  }
+
+  // Closing a log removes its segments.
+  EXPECT_EQ(1U, options.segment_cache->size());
+  const std::vector<uint8_t> expected{1, 1, 1, 0};
+  EXPECT_EQ(expected, log1.Lookup(0U, 4U));
+}
+
+TEST_F(SystemLogTest, RetentionBytes) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.retention_bytes = 8;
+  options.delete_interval_ms = 0;
+  {
+    SystemLog log{dir.path(), options};
+    // Records of 5 bytes so segments roll every record.
+    for (uint8_t i = 0; i != 5; ++i) {
+      log.Append({0, 0, 0, 1, i});
+    }
+    log.Poll();
+
+    // Segments are deleted while the remaining log holds 8 bytes, leaving
+    // segments 4 and 5 and the empty active segment.
+    EXPECT_EQ(15U, log.start());
+    EXPECT_EQ(25U, log.size());
+    EXPECT_TRUE(log.Lookup(10U, 5U).empty());
+    EXPECT_FALSE(log.IsAligned(10U));
+    const std::vector<uint8_t> expected{0, 0, 0, 1, 3};
+    EXPECT_EQ(expected, log.Lookup(15U, 5U));
+
+    uint64_t offset;
+    EXPECT_FALSE(log.Seek(2, &offset));
+    EXPECT_TRUE(log.Seek(3, &offset));
+    EXPECT_EQ(15U, offset);
+  }
+
+  // The files are deleted and the start is persisted.
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / IdToName(1)));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / IdToName(3)));
+  EXPECT_FALSE(
+      std::filesystem::exists(dir.path() / (IdToName(3) + kIndexSuffix)));
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / IdToName(4)));
+
+  SystemLog log{dir.path(), options};
+  EXPECT_EQ(15U, log.start());
+  EXPECT_EQ(25U, log.size());
+  uint64_t offset;
+  EXPECT_TRUE(log.Seek(4, &offset));
+  EXPECT_EQ(20U, offset);
+}
+
+TEST_F(SystemLogTest, RetentionTime) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.retention_ms = 60'000;
+  SystemLog log{dir.path(), options};
+
+  for (uint8_t i = 0; i != 3; ++i) {
+    log.Append({0, 0, 0, 1, i});
+  }
+  log.Poll();
+  EXPECT_EQ(0U, log.start());
+
+  // Age the first segment past the retention.
+  const auto modified = std::filesystem::last_write_time(dir.path() /
+                                                         IdToName(1));
+  std::filesystem::last_write_time(dir.path() / IdToName(1),
+                                   modified - std::chrono::hours{1});
+
+  options.retention_check_ms = 0;
+  SystemLog reopened{dir.path(), options};
+  reopened.Poll();
+  EXPECT_EQ(5U, reopened.start());
+}
+
+TEST_F(SystemLogTest, FlushedWithoutDurability) {
+  TempDir dir{};
+  SystemLog log{dir.path()};
+
+  log.Append({1, 2, 3});
+  EXPECT_EQ(3U, log.flushed());
+}
+
+TEST_F(SystemLogTest, WaitFlushedBufferedWithoutDurability) {
+  TempDir dir{};
+  Options options{};
+  options.append_buffer_bytes = 100;
+  options.append_linger_ms = 1;
+  SystemLog log{dir.path(), options};
+
+  log.Append({1, 2, 3});
+  EXPECT_EQ(0U, log.flushed());
+
+  // The waiter wakes once polling writes the buffered append, rather than
+  // at the timeout.
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::thread waiter{[&log] {
+    EXPECT_TRUE(log.WaitFlushed(3, std::chrono::seconds{10}));
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  log.Poll();
+  waiter.join();
+  EXPECT_EQ(3U, log.flushed());
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{5});
+}
+
+TEST_F(SystemLogTest, GroupCommitFlushed) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 4;
+  options.durability = Durability::kGroupCommit;
+  SystemLog log{dir.path(), options};
+
+  for (uint8_t i = 0; i != 5; ++i) {
+    log.Append({i, i, i});
+  }
+  EXPECT_TRUE(log.WaitFlushed(15, std::chrono::seconds{10}));
+  EXPECT_EQ(15U, log.flushed());
+}
+
+namespace {
+
+// Appends a batch with a single keyed record, or a tombstone if value is
+// unset.
+void AppendKeyed(Log* log, const std::string& key,
+                 std::optional<uint8_t> value) {
+  RecordBatch::Builder builder{};
+  const std::vector<uint8_t> k(key.begin(), key.end());
+  if (value) {
+    builder.Add(1000, k, std::vector<uint8_t>(100, *value));
+  } else {
+    builder.Add(1000, k, std::nullopt);
+  }
+  std::vector<uint8_t> enc = builder.Build();
+  RecordBatch::SetBaseOffset(enc.data(), log->size());
+  log->Append(enc);
+}
+
+// Reads the log from the start, returning the offset and value of each
+// record and skipping padding.
+std::vector<std::pair<uint64_t, std::optional<uint8_t>>> ReadKeyed(
+    SystemLog* log, const std::string& key) {
+  std::vector<std::pair<uint64_t, std::optional<uint8_t>>> records;
+  std::unique_ptr<LogReader> reader = log->NewReader(0);
+  EXPECT_TRUE(reader);
+  while (true) {
+    const uint64_t offset = reader->offset();
+    const std::optional<View> record = reader->Next();
+    if (!record) break;
+    const std::optional<RecordBatch> batch = RecordBatch::Parse(*record);
+    EXPECT_TRUE(batch);
+    EXPECT_EQ(offset, batch->header().base_offset);
+    if (batch->padding()) {
+      EXPECT_EQ(RecordBatch::kHeaderSize, record->size);
+      continue;
+    }
+    EXPECT_TRUE(batch->Validate());
+    EXPECT_TRUE(log->IsAligned(offset));
+    batch->ForEach([&](const RecordBatch::Record& r) {
+      if (std::string(reinterpret_cast<const char*>(r.key->data),
+                      r.key->size) == key) {
+        records.emplace_back(
+            offset, r.value ? std::optional<uint8_t>{r.value->data[0]}
+                            : std::nullopt);
+      }
+      return true;
+    });
+  }
+  return records;
+}
+
+}  // namespace
+
+TEST_F(SystemLogTest, Compact) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  options.compaction_tombstone_ms = 3'600'000;
+  std::optional<SystemLog> log{std::in_place, dir.path(), options};
+
+  AppendKeyed(&*log, "b", 0);
+  AppendKeyed(&*log, "c", 0);
+  for (uint8_t i = 0; i != 20; ++i) {
+    AppendKeyed(&*log, "a", i);
+  }
+  AppendKeyed(&*log, "c", std::nullopt);
+  // Seal the segment holding the tombstone.
+  for (uint8_t i = 0; i != 10; ++i) {
+    AppendKeyed(&*log, "d", i);
+  }
+  const uint64_t size = log->size();
+  const std::vector<std::pair<uint64_t, std::optional<uint8_t>>> a =
+      ReadKeyed(&*log, "a");
+  const std::vector<std::pair<uint64_t, std::optional<uint8_t>>> c =
+      ReadKeyed(&*log, "c");
+
+  log->Compact();
+
+  // Only the latest record of each key is kept, at the same offset, and the
+  // tombstone is kept as it is recent.
+  EXPECT_EQ(size, log->size());
+  const std::vector<std::pair<uint64_t, std::optional<uint8_t>>>
+      expected_a{a.back()};
+  EXPECT_EQ(expected_a, ReadKeyed(&*log, "a"));
+  const std::vector<std::pair<uint64_t, std::optional<uint8_t>>>
+      expected_c{c.back()};
+  EXPECT_EQ(expected_c, ReadKeyed(&*log, "c"));
+  EXPECT_EQ(1U, ReadKeyed(&*log, "b").size());
+  // Records removed are no longer aligned, being covered by padding.
+  EXPECT_FALSE(log->IsAligned(a.front().first + 1000));
+
+  // The compacted segments replace the segments when reopened.
+  log.reset();
+  log.emplace(dir.path(), options);
+  EXPECT_EQ(size, log->size());
+  EXPECT_EQ(expected_a, ReadKeyed(&*log, "a"));
+  EXPECT_EQ(expected_c, ReadKeyed(&*log, "c"));
+  for (const std::filesystem::directory_entry& entry :
+       std::filesystem::directory_iterator(dir.path())) {
+    EXPECT_NE(kCompactedSuffix, entry.path().extension());
+  }
+
+  // Compacting again without a new segment sealed does nothing.
+  log->Compact();
+  EXPECT_EQ(expected_a, ReadKeyed(&*log, "a"));
+}
+
+TEST_F(SystemLogTest, CompactRemovesTombstones) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  options.compaction_tombstone_ms = 0;
+  SystemLog log{dir.path(), options};
+
+  AppendKeyed(&log, "a", 0);
+  AppendKeyed(&log, "a", std::nullopt);
+  for (uint8_t i = 0; i != 10; ++i) {
+    AppendKeyed(&log, "b", i);
+  }
+
+  log.Compact();
+  EXPECT_TRUE(ReadKeyed(&log, "a").empty());
+}
+
+TEST_F(SystemLogTest, CompactRecoverSwap) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  {
+    SystemLog log{dir.path(), options};
+    for (uint8_t i = 0; i != 20; ++i) {
+      AppendKeyed(&log, "a", i);
+    }
+  }
+
+  // Simulate closing part way through replacing the first segment with a
+  // compacted segment, holding a single copy of the first record.
+  const std::string name = IdToName(1);
+  std::vector<uint8_t> first;
+  {
+    SystemSegment segment{1, dir.path(), options.segment_limit};
+    const std::vector<uint8_t> prefix = segment.Lookup(0, 4);
+    first = segment.Lookup(0, 4 + prefix[3]);
+    SystemSegment compacted{dir.path() / (name + kCompactedSuffix),
+                            options.segment_limit};
+    compacted.Append(first);
+    compacted.Append(RecordBatch::Padding(first.size(),
+                                          segment.size() - first.size()));
+    compacted.Truncate(segment.size());
+  }
+  std::filesystem::remove(dir.path() / (name + kIndexSuffix));
+  std::filesystem::remove(dir.path() / (name + kTimeIndexSuffix));
+  std::filesystem::remove(dir.path() / (name + kChecksumSuffix));
+  std::ofstream{dir.path() / (name + kSwapSuffix)};
+  // Compacted files without a swap file are incomplete so discarded.
+  std::ofstream{dir.path() / (IdToName(2) + kCompactedSuffix)};
+
+  SystemLog log{dir.path(), options};
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / (name + kSwapSuffix)));
+  EXPECT_FALSE(
+      std::filesystem::exists(dir.path() / (IdToName(2) + kCompactedSuffix)));
+  std::unique_ptr<LogReader> reader = log.NewReader(0);
+  ASSERT_TRUE(reader);
+  std::optional<View> record = reader->Next();
+  ASSERT_TRUE(record);
+  EXPECT_EQ(first, std::vector<uint8_t>(record->data,
+                                        record->data + record->size));
+  record = reader->Next();
+  ASSERT_TRUE(record);
+  EXPECT_TRUE(RecordBatch::Parse(*record)->padding());
+  EXPECT_TRUE(log.Verify(0, View{first.data(),
+                                 static_cast<uint32_t>(first.size())}));
+}
+
+namespace {
+
+// Appends records of 104 bytes, so with a segment limit of 1000 each segment
+// holds 10 records, and returns the records appended.
+std::vector<std::vector<uint8_t>> AppendRecords(Log* log, uint8_t n) {
+  std::vector<std::vector<uint8_t>> records;
+  for (uint8_t i = 0; i != n; ++i) {
+    std::vector<uint8_t> record{0, 0, 0, 100};
+    record.insert(record.end(), 100, i);
+    log->Append(record);
+    records.push_back(record);
+  }
+  return records;
+}
+
+// Checks the records are looked up, verified and read from the start of the
+// log.
+void ExpectRecords(SystemLog* log,
+                   const std::vector<std::vector<uint8_t>>& records) {
+  for (size_t i = 0; i != records.size(); ++i) {
+    EXPECT_EQ(records[i], log->Lookup(i * 104, 104));
+    EXPECT_TRUE(log->Verify(i * 104, View{records[i].data(), 104}));
+  }
+
+  std::unique_ptr<LogReader> reader = log->NewReader(0);
+  ASSERT_TRUE(reader);
+  for (const std::vector<uint8_t>& expected : records) {
+    const std::optional<View> record = reader->Next();
+    ASSERT_TRUE(record);
+    EXPECT_EQ(expected,
+              std::vector<uint8_t>(record->data, record->data + record->size));
+    EXPECT_TRUE(reader->Verify(*record));
+  }
+  EXPECT_FALSE(reader->Next());
+}
+
+}  // namespace
+
+TEST_F(SystemLogTest, Compress) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  options.compression_block_bytes = 256;
+  options.reader_block_bytes = 100;
+  std::optional<SystemLog> log{std::in_place, dir.path(), options};
+
+  // Seals segments 1 to 3.
+  const std::vector<std::vector<uint8_t>> records = AppendRecords(&*log, 30);
+  const uint64_t size = log->size();
+  // Open the first segment so the cached segment is replaced.
+  EXPECT_EQ(records[0], log->Lookup(0, 104));
+
+  log->Compress();
+
+  for (uint32_t id = 1; id != 4; ++id) {
+    const std::filesystem::path path =
+        dir.path() / (IdToName(id) + kCompressedSuffix);
+    EXPECT_TRUE(std::filesystem::exists(path));
+    EXPECT_LT(std::filesystem::file_size(path), 1040U);
+    EXPECT_FALSE(std::filesystem::exists(dir.path() / IdToName(id)));
+  }
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / IdToName(4)));
+  ExpectRecords(&*log, records);
+  uint64_t offset;
+  EXPECT_TRUE(log->Seek(15, &offset));
+  EXPECT_EQ(15U * 104, offset);
+
+  // The compressed segments are opened when the log is reopened.
+  log.reset();
+  log.emplace(dir.path(), options);
+  EXPECT_EQ(size, log->size());
+  ExpectRecords(&*log, records);
+
+  // Segments already compressed are skipped.
+  log->Compress();
+  ExpectRecords(&*log, records);
+}
+
+TEST_F(SystemLogTest, CompressRecover) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  std::vector<std::vector<uint8_t>> records;
+  {
+    SystemLog log{dir.path(), options};
+    records = AppendRecords(&log, 20);
+  }
+
+  // Simulate closing after the first segment is compressed but before the
+  // segment file is removed, and part way through compressing the second.
+  {
+    SystemSegment segment{1, dir.path(), options.segment_limit};
+    SystemSegment compressed{dir.path() / (IdToName(1) + kCompressedSuffix),
+                             options.segment_limit};
+    ASSERT_TRUE(Compressor::Compress(&segment, 256, &compressed));
+  }
+  const std::filesystem::path partial =
+      dir.path() / (IdToName(2) + kCompressedSuffix + kPartialSuffix);
+  std::ofstream{partial} << "partial";
+
+  SystemLog log{dir.path(), options};
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / IdToName(1)));
+  EXPECT_FALSE(std::filesystem::exists(partial));
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / IdToName(2)));
+  ExpectRecords(&log, records);
+}
+
+TEST_F(SystemLogTest, CompressRetention) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  options.delete_interval_ms = 0;
+  {
+    SystemLog log{dir.path(), options};
+    AppendRecords(&log, 20);
+    log.Compress();
+  }
+
+  options.retention_bytes = 1040;
+  options.retention_check_ms = 0;
+  {
+    SystemLog log{dir.path(), options};
+    log.Poll();
+    EXPECT_EQ(1040U, log.start());
+  }
+  EXPECT_FALSE(
+      std::filesystem::exists(dir.path() / (IdToName(1) + kCompressedSuffix)));
+  EXPECT_TRUE(
+      std::filesystem::exists(dir.path() / (IdToName(2) + kCompressedSuffix)));
+}
+
+TEST_F(SystemLogTest, CompactCompressed) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  options.compaction_tombstone_ms = 3'600'000;
+  std::optional<SystemLog> log{std::in_place, dir.path(), options};
+
+  for (uint8_t i = 0; i != 30; ++i) {
+    AppendKeyed(&*log, "a", i);
+  }
+  // Seal the segment holding the latest record.
+  for (uint8_t i = 0; i != 10; ++i) {
+    AppendKeyed(&*log, "b", i);
+  }
+  const std::vector<std::pair<uint64_t, std::optional<uint8_t>>> a =
+      ReadKeyed(&*log, "a");
+  log->Compress();
+  EXPECT_EQ(a, ReadKeyed(&*log, "a"));
+
+  // Compacting replaces the compressed segments with compacted segments,
+  // which are compressed again by the next compression.
+  log->Compact();
+  const std::vector<std::pair<uint64_t, std::optional<uint8_t>>>
+      expected_a{a.back()};
+  EXPECT_EQ(expected_a, ReadKeyed(&*log, "a"));
+  EXPECT_FALSE(
+      std::filesystem::exists(dir.path() / (IdToName(1) + kCompressedSuffix)));
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / IdToName(1)));
+
+  log->Compress();
+  EXPECT_TRUE(
+      std::filesystem::exists(dir.path() / (IdToName(1) + kCompressedSuffix)));
+  EXPECT_EQ(expected_a, ReadKeyed(&*log, "a"));
+
+  log.reset();
+  log.emplace(dir.path(), options);
+  EXPECT_EQ(expected_a, ReadKeyed(&*log, "a"));
+}
+
+namespace {
+
+// Sets the modification time of the files to an hour ago, so segments are
+// moved to the cold store after 30 minutes.
+void Age(const std::vector<std::filesystem::path>& paths) {
+  for (const std::filesystem::path& path : paths) {
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now() -
+                  std::chrono::hours{1});
+  }
+}
+
+// Returns options that move segments to a store in dir after 30 minutes,
+// moving segments only when Offload is called.
+Options ColdOptions(const TempDir& dir) {
+  Options options{};
+  options.segment_limit = 1000;
+  options.reader_block_bytes = 100;
+  options.cold_store = std::make_shared<DirectoryColdStore>(dir.path());
+  options.cold_after_ms = 1'800'000;
+  options.cold_interval_ms = 3'600'000;
+  return options;
+}
+
+}  // namespace
+
+TEST_F(SystemLogTest, Offload) {
+  TempDir dir{};
+  TempDir cold{};
+  const Options options = ColdOptions(cold);
+  std::optional<SystemLog> log{std::in_place, dir.path(), options};
+
+  // Seals segments 1 to 3, of which only 1 and 2 are old enough to move.
+  const std::vector<std::vector<uint8_t>> records = AppendRecords(&*log, 30);
+  const uint64_t size = log->size();
+  Age({dir.path() / IdToName(1), dir.path() / IdToName(2)});
+  // Open the first segment so the cached segment is replaced.
+  EXPECT_EQ(records[0], log->Lookup(0, 104));
+
+  log->Offload();
+
+  for (uint32_t id = 1; id != 3; ++id) {
+    EXPECT_FALSE(std::filesystem::exists(dir.path() / IdToName(id)));
+    EXPECT_TRUE(std::filesystem::exists(cold.path() / IdToName(id)));
+    EXPECT_TRUE(
+        std::filesystem::exists(dir.path() / (IdToName(id) + kIndexSuffix)));
+  }
+  EXPECT_TRUE(std::filesystem::exists(dir.path() / IdToName(3)));
+  EXPECT_FALSE(std::filesystem::exists(cold.path() / IdToName(3)));
+  EXPECT_EQ(2U, Tiers{dir.path()}.entries().size());
+
+  ExpectRecords(&*log, records);
+  EXPECT_EQ(2U, log->cold_cache_stats().misses);
+  uint64_t offset;
+  EXPECT_TRUE(log->Seek(15, &offset));
+  EXPECT_EQ(15U * 104, offset);
+
+  // Segments in the cold store are opened without fetching them when the log
+  // is reopened, and fetched once read.
+  log.reset();
+  log.emplace(dir.path(), options);
+  EXPECT_EQ(size, log->size());
+  EXPECT_EQ(0U, log->cold_cache_stats().misses);
+  ExpectRecords(&*log, records);
+  EXPECT_EQ(2U, log->cold_cache_stats().misses);
+
+  // Segments already moved are skipped.
+  Age({dir.path() / IdToName(3)});
+  log->Offload();
+  EXPECT_TRUE(std::filesystem::exists(cold.path() / IdToName(3)));
+  ExpectRecords(&*log, records);
+}
+
+TEST_F(SystemLogTest, OffloadCompressed) {
+  TempDir dir{};
+  TempDir cold{};
+  Options options = ColdOptions(cold);
+  options.compression_block_bytes = 256;
+  SystemLog log{dir.path(), options};
+
+  const std::vector<std::vector<uint8_t>> records = AppendRecords(&log, 20);
+  log.Compress();
+  Age({dir.path() / (IdToName(1) + kCompressedSuffix)});
+  log.Offload();
+
+  EXPECT_FALSE(
+      std::filesystem::exists(dir.path() / (IdToName(1) + kCompressedSuffix)));
+  EXPECT_TRUE(
+      std::filesystem::exists(cold.path() / (IdToName(1) + kCompressedSuffix)));
+  ExpectRecords(&log, records);
+
+  // Segments in the cold store are not compressed or compacted again.
+  log.Compress();
+  log.Compact();
+  ExpectRecords(&log, records);
+}
+
+TEST_F(SystemLogTest, OffloadRecover) {
+  TempDir dir{};
+  TempDir cold{};
+  const Options options = ColdOptions(cold);
+  std::vector<std::vector<uint8_t>> records;
+  {
+    SystemLog log{dir.path(), options};
+    records = AppendRecords(&log, 20);
+    Age({dir.path() / IdToName(1)});
+    log.Offload();
+  }
+
+  // Simulate closing after the segment is moved but before the local file is
+  // removed.
+  std::filesystem::copy_file(cold.path() / IdToName(1),
+                             dir.path() / IdToName(1));
+
+  SystemLog log{dir.path(), options};
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / IdToName(1)));
+  ExpectRecords(&log, records);
+}
+
+TEST_F(SystemLogTest, OffloadRetention) {
+  TempDir dir{};
+  TempDir cold{};
+  Options options = ColdOptions(cold);
+  options.delete_interval_ms = 0;
+  {
+    SystemLog log{dir.path(), options};
+    AppendRecords(&log, 30);
+    Age({dir.path() / IdToName(1), dir.path() / IdToName(2)});
+    log.Offload();
+  }
+
+  // Retention by time uses the modification time of the segment when moved.
+  options.retention_ms = 1'800'000;
+  options.retention_check_ms = 0;
+  SystemLog log{dir.path(), options};
+  log.Poll();
+  EXPECT_EQ(2080U, log.start());
+  EXPECT_EQ(std::vector<uint8_t>{}, log.Lookup(0, 104));
+
+  // The deleted segments are removed from the store by the next move.
+  log.Offload();
+  EXPECT_FALSE(std::filesystem::exists(cold.path() / IdToName(1)));
+  EXPECT_FALSE(std::filesystem::exists(cold.path() / IdToName(2)));
+  EXPECT_TRUE(Tiers{dir.path()}.entries().empty());
+}
+
+TEST_F(SystemLogTest, Readahead) {
+  TempDir dir{};
+  Options options{};
+  options.segment_limit = 1000;
+  options.reader_block_bytes = 100;
+  options.readahead_bytes = 300;
+  std::optional<SystemLog> log{std::in_place, dir.path(), options};
+
+  const std::vector<std::vector<uint8_t>> records = AppendRecords(&*log, 30);
+  // Hold a reader in the first segment while the sealed segments are
+  // dropped from the page cache.
+  std::unique_ptr<LogReader> reader = log->NewReader(0);
+  ASSERT_TRUE(reader);
+  ASSERT_TRUE(reader->Next());
+  log->Poll();
+  ExpectRecords(&*log, records);
+  reader.reset();
+  log->Poll();
+
+  // Reopening reads the tail of the active segment into the page cache.
+  log.reset();
+  log.emplace(dir.path(), options);
+  ExpectRecords(&*log, records);
+}
+
+}  // namespace wombat::broker::log::testing
@@ -7,9 +7,13 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <iostream>
+#include <optional>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "log/systemsegment.h"
@@ -156,4 +160,116 @@ TEST_F(SystemSegmentTest, SendOverflow) {
   EXPECT_EQ(data, read);
 }
 
+TEST_F(SystemSegmentTest, BufferedAppendVisible) {
+  TempDir dir{};
+  SystemSegment segment{0x2478, dir.path(), 100};
+  segment.EnableBuffering(10, std::chrono::hours{1});
+
+  segment.Append({1, 2, 3});
+  segment.Append({4, 5});
+
+  EXPECT_EQ(5U, segment.size());
+  EXPECT_EQ(0U, segment.written());
+
+  const std::vector<uint8_t> expected{2, 3, 4};
+  EXPECT_EQ(expected, segment.Lookup(1U, 3U));
+
+  std::optional<View> view = segment.LookupView(3U, 2U);
+  ASSERT_TRUE(view);
+  const std::vector<uint8_t> expected_view{4, 5};
+  EXPECT_EQ(expected_view,
+            std::vector<uint8_t>(view->data, view->data + view->size));
+
+  // Not written to the file yet.
+  SystemSegment reader{0x2478, dir.path(), 100};
+  EXPECT_EQ(0U, reader.size());
+}
+
+TEST_F(SystemSegmentTest, BufferedAppendFlushedWhenFull) {
+  TempDir dir{};
+  SystemSegment segment{0x2478, dir.path(), 100};
+  segment.EnableBuffering(4, std::chrono::hours{1});
+
+  segment.Append({1, 2, 3});
+  EXPECT_EQ(0U, segment.written());
+  segment.Append({4, 5});
+  EXPECT_EQ(5U, segment.written());
+  segment.Append({6});
+  EXPECT_EQ(5U, segment.written());
+
+  // Lookup spanning the file and buffer.
+  const std::vector<uint8_t> expected{4, 5, 6};
+  EXPECT_EQ(expected, segment.Lookup(3U, 3U));
+  EXPECT_TRUE(segment.Lookup(3U, 4U).empty());
+  EXPECT_FALSE(segment.LookupView(3U, 3U));
+
+  SystemSegment reader{0x2478, dir.path(), 100};
+  const std::vector<uint8_t> expected_reader{1, 2, 3, 4, 5};
+  EXPECT_EQ(expected_reader, reader.Lookup(0U, 5U));
+}
+
+TEST_F(SystemSegmentTest, BufferedAppendFlushedAfterLinger) {
+  TempDir dir{};
+  SystemSegment segment{0x2478, dir.path(), 100};
+  segment.EnableBuffering(100, std::chrono::milliseconds{1});
+
+  segment.Append({1, 2, 3});
+  std::this_thread::sleep_for(std::chrono::milliseconds{2});
+  segment.Poll();
+  EXPECT_EQ(3U, segment.written());
+}
+
+TEST_F(SystemSegmentTest, BufferedAppendFlushedOnClose) {
+  TempDir dir{};
+  const std::vector<uint8_t> data{1, 2, 3};
+  {
+    SystemSegment segment{0x2478, dir.path(), 100};
+    segment.EnableBuffering(100, std::chrono::hours{1});
+    segment.Append(data);
+  }
+
+  SystemSegment reader{0x2478, dir.path(), 100};
+  EXPECT_EQ(data, reader.Lookup(0U, 3U));
+}
+
+TEST_F(SystemSegmentTest, SendBuffered) {
+  TempDir dir{};
+  SystemSegment segment{0x2478, dir.path(), 100};
+  segment.EnableBuffering(100, std::chrono::hours{1});
+
+  const std::vector<uint8_t> data{1, 2, 3};
+  segment.Append(data);
+
+  int fd = memfd_create("myfd", O_RDWR);
+  if (fd == -1) FAIL();
+
+  EXPECT_EQ(3U, segment.Send(0, 3, fd));
+
+  if (lseek(fd, 0, SEEK_SET) != 0) FAIL();
+  uint8_t buf[3];
+  if (read(fd, buf, 3) != 3) FAIL();
+
+  std::vector<uint8_t> read(buf, buf + 3);
+  EXPECT_EQ(data, read);
+}
+
+TEST_F(SystemSegmentTest, Preallocate) {
+  TempDir dir{};
+  SystemSegment segment{0x2478, dir.path(), 1 << 16};
+  segment.Append({1, 2, 3});
+  segment.Preallocate();
+
+  // The size is unchanged but the disk space is allocated.
+  struct stat st;
+  ASSERT_EQ(0, stat((dir.path() / IdToName(0x2478)).c_str(), &st));
+  EXPECT_EQ(3, st.st_size);
+  EXPECT_LE(1 << 16, st.st_blocks * 512);
+
+  segment.Append({4, 5});
+  EXPECT_EQ(5U, segment.size());
+
+  SystemSegment reader{0x2478, dir.path(), 1 << 16};
+  EXPECT_EQ(5U, reader.size());
+}
+
 }  // namespace wombat::broker::log::testing
@@ -0,0 +1,135 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/tiers.h"
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/crc32c.h"
+#include "log/logexception.h"
+#include "log/segment.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class TiersTest : public ::testing::Test {};
+
+TEST_F(TiersTest, Empty) {
+  TempDir dir{};
+  Tiers tiers{dir.path()};
+  EXPECT_TRUE(tiers.entries().empty());
+  EXPECT_EQ(0U, tiers.end());
+  Tiers::Entry entry;
+  EXPECT_FALSE(tiers.Lookup(1, &entry));
+  EXPECT_FALSE(std::filesystem::exists(dir.path() / kTiersName));
+}
+
+TEST_F(TiersTest, AddAndReload) {
+  TempDir dir{};
+  const std::vector<Tiers::Entry> entries{
+      Tiers::Entry{1, 1000, 10, 1000, 1'600'000'000'000, false},
+      Tiers::Entry{2, 1040, 20, 1040, 1'600'000'001'000, true}};
+  {
+    Tiers tiers{dir.path()};
+    for (const Tiers::Entry& entry : entries) {
+      tiers.Add(entry);
+    }
+    EXPECT_EQ(entries, tiers.entries());
+    EXPECT_EQ(3U, tiers.end());
+  }
+
+  Tiers tiers{dir.path()};
+  EXPECT_EQ(entries, tiers.entries());
+  Tiers::Entry entry;
+  EXPECT_TRUE(tiers.Lookup(2, &entry));
+  EXPECT_EQ(entries[1], entry);
+  EXPECT_EQ(IdToName(2) + ".lz4", entry.name());
+  EXPECT_FALSE(tiers.Lookup(3, &entry));
+  EXPECT_FALSE(tiers.Lookup(0, &entry));
+}
+
+TEST_F(TiersTest, AddOutOfOrder) {
+  TempDir dir{};
+  Tiers tiers{dir.path()};
+  tiers.Add(Tiers::Entry{2, 10, 1, 10, 0, false});
+  EXPECT_THROW(tiers.Add(Tiers::Entry{2, 10, 1, 10, 0, false}),
+               LogException);
+  EXPECT_THROW(tiers.Add(Tiers::Entry{1, 10, 1, 10, 0, false}),
+               LogException);
+  EXPECT_EQ(1U, tiers.entries().size());
+}
+
+TEST_F(TiersTest, Truncate) {
+  TempDir dir{};
+  {
+    Tiers tiers{dir.path()};
+    for (uint32_t id = 1; id != 5; ++id) {
+      tiers.Add(Tiers::Entry{id, 10, 1, 10, 0, false});
+    }
+    tiers.Truncate(3);
+    ASSERT_EQ(2U, tiers.entries().size());
+    EXPECT_EQ(3U, tiers.entries()[0].id);
+    EXPECT_EQ(5U, tiers.end());
+
+    // Truncating before the first entry does nothing.
+    tiers.Truncate(2);
+    EXPECT_EQ(2U, tiers.entries().size());
+  }
+
+  Tiers tiers{dir.path()};
+  EXPECT_EQ(2U, tiers.entries().size());
+  EXPECT_EQ(3U, tiers.entries()[0].id);
+}
+
+TEST_F(TiersTest, Decode) {
+  TempDir dir{};
+  Tiers tiers{dir.path()};
+  tiers.Add(Tiers::Entry{1, 1000, 0x1000000aa, 1000, 1'600'000'000'000, true});
+  std::vector<uint8_t> enc = tiers.Encode();
+
+  std::optional<std::vector<Tiers::Entry>> entries = Tiers::Decode(enc);
+  ASSERT_TRUE(entries);
+  EXPECT_EQ(tiers.entries(), *entries);
+
+  // Any modification fails the checksum.
+  enc[10] ^= 1;
+  EXPECT_FALSE(Tiers::Decode(enc));
+  enc[10] ^= 1;
+  enc.pop_back();
+  EXPECT_FALSE(Tiers::Decode(enc));
+  EXPECT_FALSE(Tiers::Decode({}));
+}
+
+TEST_F(TiersTest, DecodeVersion1) {
+  // Version 1 entries store 32 bit ordinals.
+  std::vector<uint8_t> enc{0, 0, 0, 1, 0, 0, 0, 1};
+  const std::vector<uint8_t> entry{
+      0, 0,    0,    1,    0,    0,    0x03, 0xe8,  // id, size
+      0, 0,    0,    10,   0,    0,    0x03, 0xe8,  // ordinal, end
+      0, 0,    0x01, 0x74, 0x87, 0x6e, 0x80, 0x00,  // modified_ms
+      0, 0,    0,    1};                             // compressed
+  enc.insert(enc.end(), entry.begin(), entry.end());
+  const uint32_t crc = htonl(Crc32c(enc.data(), enc.size()));
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(&crc);
+  enc.insert(enc.end(), data, data + sizeof(crc));
+
+  std::optional<std::vector<Tiers::Entry>> entries = Tiers::Decode(enc);
+  ASSERT_TRUE(entries);
+  ASSERT_EQ(1U, entries->size());
+  EXPECT_EQ((Tiers::Entry{1, 1000, 10, 1000, 1'600'000'000'000, true}),
+            (*entries)[0]);
+}
+
+TEST_F(TiersTest, Corrupt) {
+  TempDir dir{};
+  std::ofstream{dir.path() / kTiersName} << "corrupt";
+  EXPECT_THROW(Tiers{dir.path()}, LogException);
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,115 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+#include "log/ring.h"
+#include "log/systemsegment.h"
+#include "log/tempdir.h"
+#include "log/uringsegment.h"
+#include "log/view.h"
+
+namespace wombat::broker::log::testing {
+
+class UringSegmentTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    if (!Ring::Supported()) {
+      GTEST_SKIP() << "io_uring not supported";
+    }
+  }
+};
+
+TEST_F(UringSegmentTest, AppendVisibleBeforeWritten) {
+  TempDir dir{};
+  Ring ring{8};
+  UringSegment segment{0x2478, dir.path(), 100, &ring};
+
+  segment.Append({1, 2, 3});
+  segment.Append({4, 5});
+
+  EXPECT_EQ(5U, segment.size());
+  EXPECT_EQ(0U, segment.written());
+
+  const std::vector<uint8_t> expected{2, 3, 4};
+  EXPECT_EQ(expected, segment.Lookup(1U, 3U));
+  EXPECT_TRUE(segment.Lookup(3U, 3U).empty());
+
+  std::optional<View> view = segment.LookupView(3U, 2U);
+  ASSERT_TRUE(view);
+  const std::vector<uint8_t> expected_view{4, 5};
+  EXPECT_EQ(expected_view,
+            std::vector<uint8_t>(view->data, view->data + view->size));
+  // Cannot view across appends.
+  EXPECT_FALSE(segment.LookupView(1U, 3U));
+}
+
+TEST_F(UringSegmentTest, AppendWrittenWhenPolled) {
+  TempDir dir{};
+  Ring ring{8};
+  UringSegment segment{0x2478, dir.path(), 100, &ring};
+
+  segment.Append({1, 2, 3});
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(3U, segment.written());
+  EXPECT_FALSE(segment.LookupView(0U, 3U));
+
+  // Lookup spanning the file and an append in flight.
+  segment.Append({4, 5});
+  const std::vector<uint8_t> expected{2, 3, 4, 5};
+  EXPECT_EQ(expected, segment.Lookup(1U, 4U));
+
+  segment.Flush();
+  EXPECT_EQ(5U, segment.written());
+
+  SystemSegment reader{0x2478, dir.path(), 100};
+  const std::vector<uint8_t> expected_reader{1, 2, 3, 4, 5};
+  EXPECT_EQ(expected_reader, reader.Lookup(0U, 5U));
+}
+
+TEST_F(UringSegmentTest, FlushedOnClose) {
+  TempDir dir{};
+  Ring ring{2};
+  {
+    UringSegment segment{0x2478, dir.path(), 100, &ring};
+    for (uint8_t i = 0; i != 10; ++i) {
+      segment.Append({i});
+    }
+  }
+
+  SystemSegment reader{0x2478, dir.path(), 100};
+  const std::vector<uint8_t> expected{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  EXPECT_EQ(expected, reader.Lookup(0U, 10U));
+}
+
+TEST_F(UringSegmentTest, WriteErrorThrownFromPoll) {
+  TempDir dir{};
+  Ring ring{8};
+  UringSegment segment{0x2478, dir.path(), 100, &ring};
+
+  segment.Append({1, 2, 3});
+  segment.Flush();
+
+  // Replace the segment file with a read only descriptor so writes fail.
+  const int fd = open((dir.path() / IdToName(0x2478)).c_str(), O_RDONLY);
+  ASSERT_NE(-1, fd);
+  ASSERT_NE(-1, dup2(fd, segment.fd()));
+  close(fd);
+
+  segment.Append({4, 5});
+  segment.Append({6});
+  // Completing the failed writes does not throw, and flushing does not wait
+  // for them.
+  while (ring.in_flight() != 0) ring.Poll(true);
+  EXPECT_EQ(3U, segment.written());
+  EXPECT_THROW(segment.Poll(), LogException);
+  EXPECT_THROW(segment.Flush(), LogException);
+}
+
+}  // namespace wombat::broker::log::testing
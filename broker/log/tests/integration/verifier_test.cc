@@ -0,0 +1,220 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/verifier.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/checksums.h"
+#include "log/compressedsegment.h"
+#include "log/index.h"
+#include "log/logexception.h"
+#include "log/options.h"
+#include "log/segment.h"
+#include "log/systemlog.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class VerifierTest : public ::testing::Test {
+ protected:
+  Options LogOptions() const {
+    Options options{};
+    options.segment_limit = 1000;
+    options.index_interval = 200;
+    return options;
+  }
+
+  // Writes a log of 30 records of 104 bytes, 10 to each segment.
+  std::vector<std::vector<uint8_t>> WriteLog(const TempDir& dir,
+                                             bool compress = false) {
+    Options options = LogOptions();
+    options.compression = compress;
+    SystemLog log{dir.path(), options};
+    std::vector<std::vector<uint8_t>> records;
+    for (uint8_t i = 0; i != 30; ++i) {
+      std::vector<uint8_t> record{0, 0, 0, 100};
+      record.insert(record.end(), 100, i);
+      log.Append(record);
+      records.push_back(record);
+    }
+    if (compress) {
+      log.Compress();
+    }
+    return records;
+  }
+
+  std::string Read(const std::filesystem::path& path) const {
+    std::ifstream f{path, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{f}, {}};
+  }
+
+  void Corrupt(const std::filesystem::path& path, uint32_t position) const {
+    std::fstream f{path, std::ios::in | std::ios::out | std::ios::binary};
+    f.seekp(position);
+    f.put(0x7f);
+  }
+
+  void ExpectRecords(const TempDir& dir,
+                     const std::vector<std::vector<uint8_t>>& records) const {
+    SystemLog log{dir.path(), LogOptions()};
+    ASSERT_EQ(records.size() * 104, log.size());
+    for (uint32_t i = 0; i != records.size(); ++i) {
+      uint64_t offset;
+      ASSERT_TRUE(log.Seek(i, &offset));
+      EXPECT_EQ(i * 104U, offset);
+      EXPECT_EQ(records[i], log.Lookup(offset, 104));
+    }
+  }
+};
+
+TEST_F(VerifierTest, VerifyOk) {
+  TempDir dir{};
+  WriteLog(dir);
+
+  const std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 4}.Verify();
+  ASSERT_EQ(4U, results.size());
+  for (uint32_t i = 0; i != 3; ++i) {
+    EXPECT_EQ(i + 1, results[i].id);
+    EXPECT_EQ(1040U, results[i].bytes);
+    EXPECT_EQ(10U, results[i].records);
+    EXPECT_EQ(0U, results[i].partial);
+    EXPECT_EQ(0U, results[i].corrupt);
+    EXPECT_FALSE(results[i].missing);
+    EXPECT_FALSE(results[i].misplaced);
+    EXPECT_FALSE(results[i].rebuilt);
+    EXPECT_FALSE(results[i].skipped);
+  }
+  // The active segment is empty.
+  EXPECT_EQ(0U, results[3].bytes);
+  EXPECT_TRUE(Verifier::Ok(results));
+}
+
+TEST_F(VerifierTest, VerifyEmpty) {
+  TempDir dir{};
+  Verifier verifier{dir.path(), LogOptions(), 4};
+  EXPECT_TRUE(verifier.Verify().empty());
+  EXPECT_THROW(Verifier(dir.path() / "missing", LogOptions(), 4).Verify(),
+               LogException);
+}
+
+TEST_F(VerifierTest, VerifyCompressed) {
+  TempDir dir{};
+  const std::vector<std::vector<uint8_t>> records = WriteLog(dir, true);
+  ASSERT_TRUE(
+      std::filesystem::exists(dir.path() / (IdToName(1) + kCompressedSuffix)));
+  std::filesystem::remove(dir.path() / (IdToName(2) + kIndexSuffix));
+
+  const std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 4}.Verify();
+  ASSERT_EQ(4U, results.size());
+  EXPECT_EQ(1040U, results[0].bytes);
+  EXPECT_EQ(10U, results[0].records);
+  EXPECT_TRUE(results[1].rebuilt);
+  EXPECT_TRUE(Verifier::Ok(results));
+  ExpectRecords(dir, records);
+}
+
+TEST_F(VerifierTest, RebuildIndexes) {
+  TempDir dir{};
+  const std::vector<std::vector<uint8_t>> records = WriteLog(dir);
+
+  std::vector<std::string> indexes;
+  for (uint32_t id = 1; id != 4; ++id) {
+    indexes.push_back(Read(dir.path() / (IdToName(id) + kIndexSuffix)));
+  }
+  // Remove the indexes of the first two segments, and truncate the last
+  // entries of the third.
+  std::filesystem::remove(dir.path() / (IdToName(1) + kIndexSuffix));
+  std::filesystem::remove(dir.path() / (IdToName(2) + kIndexSuffix));
+  std::filesystem::remove(dir.path() / (IdToName(2) + kChecksumSuffix));
+  std::filesystem::resize_file(dir.path() / (IdToName(3) + kIndexSuffix), 12);
+
+  const std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 2}.Verify();
+  ASSERT_EQ(4U, results.size());
+  EXPECT_TRUE(results[0].rebuilt);
+  EXPECT_TRUE(results[1].rebuilt);
+  EXPECT_TRUE(results[2].rebuilt);
+  EXPECT_TRUE(Verifier::Ok(results));
+
+  for (uint32_t id = 1; id != 4; ++id) {
+    EXPECT_EQ(indexes[id - 1],
+              Read(dir.path() / (IdToName(id) + kIndexSuffix)));
+  }
+  EXPECT_EQ(10U * Checksums::kEntrySize,
+            std::filesystem::file_size(dir.path() /
+                                       (IdToName(2) + kChecksumSuffix)));
+  ExpectRecords(dir, records);
+}
+
+TEST_F(VerifierTest, RebuildOffsets) {
+  TempDir dir{};
+  const std::vector<std::vector<uint8_t>> records = WriteLog(dir);
+  std::filesystem::remove(dir.path() / IdToName(OFFSET_SEGMENT_ID));
+
+  const std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 4}.Verify();
+  // The segment prepared ahead of the roll is also added.
+  ASSERT_LE(4U, results.size());
+  EXPECT_EQ(1U, results[0].id);
+  EXPECT_TRUE(Verifier::Ok(results));
+  ExpectRecords(dir, records);
+}
+
+TEST_F(VerifierTest, Corrupt) {
+  TempDir dir{};
+  WriteLog(dir);
+  // Corrupts the data of the third record of the second segment.
+  Corrupt(dir.path() / IdToName(2), 2 * 104 + 50);
+
+  const std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 4}.Verify();
+  ASSERT_EQ(4U, results.size());
+  EXPECT_EQ(0U, results[0].corrupt);
+  EXPECT_EQ(1U, results[1].corrupt);
+  EXPECT_EQ(10U, results[1].records);
+  EXPECT_FALSE(Verifier::Ok(results));
+}
+
+TEST_F(VerifierTest, Partial) {
+  TempDir dir{};
+  WriteLog(dir);
+  std::ofstream{dir.path() / IdToName(4), std::ios::app} << "abc";
+
+  // Partial records are expected at the end of the last segment.
+  std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 4}.Verify();
+  ASSERT_EQ(4U, results.size());
+  EXPECT_EQ(3U, results[3].partial);
+  EXPECT_TRUE(Verifier::Ok(results));
+
+  // Though not in sealed segments, which no longer match the offsets.
+  std::ofstream{dir.path() / IdToName(1), std::ios::app} << "abc";
+  results = Verifier{dir.path(), LogOptions(), 4}.Verify();
+  ASSERT_EQ(4U, results.size());
+  EXPECT_EQ(3U, results[0].partial);
+  EXPECT_TRUE(results[1].misplaced);
+  EXPECT_FALSE(Verifier::Ok(results));
+}
+
+TEST_F(VerifierTest, Missing) {
+  TempDir dir{};
+  WriteLog(dir);
+  std::filesystem::remove(dir.path() / IdToName(2));
+
+  const std::vector<Verifier::Result> results =
+      Verifier{dir.path(), LogOptions(), 4}.Verify();
+  ASSERT_EQ(4U, results.size());
+  EXPECT_TRUE(results[1].missing);
+  EXPECT_FALSE(Verifier::Ok(results));
+}
+
+}  // namespace wombat::broker::log::testing
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <cstdint>
+#include <optional>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -12,12 +13,33 @@ namespace wombat::broker::log {
 
 class MockLog : public log::Log {
  public:
-  explicit MockLog(uint32_t size = 0) : Log{size} {}
+  explicit MockLog(uint64_t size = 0) : Log{size} {
+    // Treat every offset as aligned and every record as valid unless a test
+    // expects otherwise.
+    ON_CALL(*this, IsAligned(::testing::_))
+        .WillByDefault(::testing::Return(true));
+    ON_CALL(*this, Verify(::testing::_, ::testing::_))
+        .WillByDefault(::testing::Return(true));
+  }
+
+  MOCK_METHOD(uint64_t, start, (), (const, override));
 
   MOCK_METHOD(void, Append, (const std::vector<uint8_t>& data), (override));
 
-  MOCK_METHOD(std::vector<uint8_t>, Lookup, (uint32_t offset, uint32_t size),
+  MOCK_METHOD(std::vector<uint8_t>, Lookup, (uint64_t offset, uint32_t size),
+              (override));
+
+  MOCK_METHOD(bool, Seek, (uint64_t ordinal, uint64_t* offset), (override));
+
+  MOCK_METHOD(bool, SeekTime, (uint64_t timestamp, uint64_t* offset),
               (override));
+
+  MOCK_METHOD(bool, IsAligned, (uint64_t offset), (override));
+
+  MOCK_METHOD(bool, Verify, (uint64_t offset, View record), (override));
+
+  MOCK_METHOD(std::optional<View>, LookupView,
+              (uint64_t offset, uint32_t size), (override));
 };
 
 }  // namespace wombat::broker::log
@@ -0,0 +1,129 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/checksums.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/inmemorysegment.h"
+#include "log/tempdir.h"
+#include "log/view.h"
+
+namespace wombat::broker::log::testing {
+
+class ChecksumsTest : public ::testing::Test {
+ protected:
+  // Appends data to segment and its checksum.
+  void Append(Segment* segment, Checksums* checksums,
+              const std::vector<uint8_t>& data) {
+    segment->Append(data);
+    checksums->Append(data.data(), data.size());
+  }
+
+  View ToView(const std::vector<uint8_t>& data) {
+    return View{data.data(), static_cast<uint32_t>(data.size())};
+  }
+};
+
+TEST_F(ChecksumsTest, Verify) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Checksums checksums{std::make_shared<InMemorySegment>(2, path, 1000)};
+
+  Append(&segment, &checksums, {1, 2, 3});
+  Append(&segment, &checksums, {4, 5});
+  EXPECT_EQ(2U, checksums.size());
+
+  EXPECT_TRUE(checksums.Verify(0, ToView({1, 2, 3})));
+  EXPECT_TRUE(checksums.Verify(1, ToView({4, 5})));
+  EXPECT_FALSE(checksums.Verify(0, ToView({1, 2, 4})));
+  EXPECT_FALSE(checksums.Verify(1, ToView({4, 5, 6})));
+  // Appends without a checksum are not verified.
+  EXPECT_TRUE(checksums.Verify(2, ToView({7})));
+}
+
+TEST_F(ChecksumsTest, RecoverValid) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Checksums checksums{std::make_shared<InMemorySegment>(2, path, 1000)};
+
+  Append(&segment, &checksums, {1, 2, 3});
+  Append(&segment, &checksums, {4, 5});
+
+  EXPECT_EQ(0U, checksums.Recover(&segment));
+  EXPECT_EQ(5U, segment.size());
+  EXPECT_EQ(2U, checksums.size());
+}
+
+TEST_F(ChecksumsTest, RecoverUnchecksummedTail) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Checksums checksums{std::make_shared<InMemorySegment>(2, path, 1000)};
+
+  Append(&segment, &checksums, {1, 2, 3});
+  // Data written without its checksum is discarded.
+  segment.Append({4, 5});
+
+  EXPECT_EQ(2U, checksums.Recover(&segment));
+  EXPECT_EQ(3U, segment.size());
+  EXPECT_EQ(1U, checksums.size());
+}
+
+TEST_F(ChecksumsTest, RecoverTornTail) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Checksums checksums{std::make_shared<InMemorySegment>(2, path, 1000)};
+
+  Append(&segment, &checksums, {1, 2, 3});
+  Append(&segment, &checksums, {4, 5});
+  Append(&segment, &checksums, {6, 7, 8});
+  // Simulate the second append only partially reaching the disk.
+  segment.Truncate(4);
+  segment.Append({0, 0, 0, 0});
+
+  EXPECT_EQ(5U, checksums.Recover(&segment));
+  EXPECT_EQ(3U, segment.size());
+  EXPECT_EQ(1U, checksums.size());
+
+  // Appends continue after the recovered data.
+  Append(&segment, &checksums, {9});
+  EXPECT_EQ(0U, checksums.Recover(&segment));
+  EXPECT_TRUE(checksums.Verify(1, ToView({9})));
+}
+
+TEST_F(ChecksumsTest, RecoverMissingData) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Checksums checksums{std::make_shared<InMemorySegment>(2, path, 1000)};
+
+  Append(&segment, &checksums, {1, 2, 3});
+  Append(&segment, &checksums, {4, 5});
+  // Checksums of appends that never reached the segment are discarded.
+  segment.Truncate(3);
+
+  EXPECT_EQ(0U, checksums.Recover(&segment));
+  EXPECT_EQ(3U, segment.size());
+  EXPECT_EQ(1U, checksums.size());
+}
+
+TEST_F(ChecksumsTest, Rebuild) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Checksums checksums{std::make_shared<InMemorySegment>(2, path, 1000)};
+
+  segment.Append({0, 0, 0, 1, 0xaa});
+  segment.Append({0, 0, 0, 2, 0xbb, 0xcc});
+  // Trailing data that is not a complete record.
+  segment.Append({0, 0});
+
+  checksums.Rebuild(&segment);
+  EXPECT_EQ(3U, checksums.size());
+  EXPECT_TRUE(checksums.Verify(0, ToView({0, 0, 0, 1, 0xaa})));
+  EXPECT_TRUE(checksums.Verify(1, ToView({0, 0, 0, 2, 0xbb, 0xcc})));
+  EXPECT_EQ(0U, checksums.Recover(&segment));
+}
+
+}  // namespace wombat::broker::log::testing
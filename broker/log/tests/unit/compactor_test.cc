@@ -0,0 +1,177 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/compactor.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/inmemorysegment.h"
+#include "log/recordbatch.h"
+#include "log/tempdir.h"
+#include "log/view.h"
+
+namespace wombat::broker::log::testing {
+
+class CompactorTest : public ::testing::Test {
+ protected:
+  // Appends a keyed batch to segment, with the base offset set to its
+  // position as the segment starts at offset kStart.
+  void AppendBatch(
+      Segment* segment,
+      const std::vector<std::pair<std::string, std::optional<uint8_t>>>&
+          records) {
+    RecordBatch::Builder builder{};
+    for (const auto& [key, value] : records) {
+      const std::vector<uint8_t> k(key.begin(), key.end());
+      if (value) {
+        builder.Add(1000, k, std::vector<uint8_t>(100, *value));
+      } else {
+        builder.Add(1000, k, std::nullopt);
+      }
+    }
+    std::vector<uint8_t> enc = builder.Build();
+    RecordBatch::SetBaseOffset(enc.data(), kStart + segment->size());
+    segment->Append(enc);
+  }
+
+  // Returns the record at position in segment, which is only the header if
+  // the record is padding.
+  std::optional<RecordBatch> Parse(Segment* segment, uint32_t position,
+                                   std::vector<uint8_t>* enc) {
+    const std::vector<uint8_t> prefix = segment->Lookup(position, 4);
+    const uint32_t size =
+        4 + ((prefix[0] << 24) | (prefix[1] << 16) | (prefix[2] << 8) |
+             prefix[3]);
+    *enc = segment->Lookup(position, size);
+    return RecordBatch::Parse(
+        View{enc->data(), static_cast<uint32_t>(enc->size())});
+  }
+
+  // Returns the key and value of each record in the batch.
+  std::vector<std::pair<std::string, std::optional<uint8_t>>> Records(
+      const RecordBatch& batch) {
+    std::vector<std::pair<std::string, std::optional<uint8_t>>> records;
+    batch.ForEach([&](const RecordBatch::Record& record) {
+      std::string key(reinterpret_cast<const char*>(record.key->data),
+                      record.key->size);
+      std::optional<uint8_t> value;
+      if (record.value) {
+        value = record.value->data[0];
+      }
+      records.emplace_back(key, value);
+      return true;
+    });
+    return records;
+  }
+
+  const uint64_t kStart = 0xffaa;
+};
+
+TEST_F(CompactorTest, Rewrite) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 100'000};
+
+  AppendBatch(&segment, {{"a", 0}, {"b", 0}});
+  AppendBatch(&segment, {{"c", 0}});
+  const uint32_t third = segment.size();
+  AppendBatch(&segment, {{"a", 1}, {"c", 1}});
+  const uint32_t fourth = segment.size();
+  AppendBatch(&segment, {{"d", std::nullopt}});
+
+  Compactor::KeyMap keys;
+  Compactor::AddKeys(&segment, kStart, &keys);
+  EXPECT_EQ(4U, keys.size());
+
+  InMemorySegment out{2, path, 100'000};
+  std::vector<uint32_t> positions;
+  ASSERT_TRUE(
+      Compactor::Rewrite(&segment, kStart, keys, false, &out, &positions));
+
+  // Records stay at the same offsets so the segment size is unchanged.
+  EXPECT_EQ(segment.size(), out.size());
+  ASSERT_EQ(4U, positions.size());
+
+  // The first batch only keeps b, followed by padding covering a and the
+  // second batch.
+  std::vector<uint8_t> enc;
+  std::optional<RecordBatch> batch = Parse(&out, 0, &enc);
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->Validate());
+  EXPECT_EQ(kStart, batch->header().base_offset);
+  const std::vector<std::pair<std::string, std::optional<uint8_t>>> b{
+      {"b", 0}};
+  EXPECT_EQ(b, Records(*batch));
+
+  EXPECT_EQ(enc.size(), positions[1]);
+  batch = Parse(&out, positions[1], &enc);
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->padding());
+  EXPECT_TRUE(batch->VerifyCrc());
+  EXPECT_EQ(kStart + positions[1], batch->header().base_offset);
+  EXPECT_EQ(third - positions[1], batch->header().length + 4);
+
+  // The later batches are unchanged, keeping the tombstone.
+  EXPECT_EQ(third, positions[2]);
+  EXPECT_EQ(fourth, positions[3]);
+  EXPECT_EQ(segment.Lookup(third, segment.size() - third),
+            out.Lookup(third, out.size() - third));
+
+  // Compacting again has nothing to remove.
+  InMemorySegment again{3, path, 100'000};
+  positions.clear();
+  EXPECT_FALSE(
+      Compactor::Rewrite(&out, kStart, keys, false, &again, &positions));
+  EXPECT_EQ(0U, again.size());
+}
+
+TEST_F(CompactorTest, RemoveTombstones) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 100'000};
+
+  AppendBatch(&segment, {{"a", 0}});
+  AppendBatch(&segment, {{"a", std::nullopt}});
+
+  Compactor::KeyMap keys;
+  Compactor::AddKeys(&segment, kStart, &keys);
+
+  InMemorySegment out{2, path, 100'000};
+  std::vector<uint32_t> positions;
+  ASSERT_TRUE(
+      Compactor::Rewrite(&segment, kStart, keys, true, &out, &positions));
+  EXPECT_EQ(segment.size(), out.size());
+
+  // Both batches are removed and merged into a single padding.
+  const std::vector<uint32_t> expected_positions{0};
+  EXPECT_EQ(expected_positions, positions);
+  std::vector<uint8_t> enc;
+  const std::optional<RecordBatch> batch = Parse(&out, 0, &enc);
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->padding());
+  EXPECT_EQ(segment.size(), batch->header().length + 4);
+}
+
+TEST_F(CompactorTest, KeepUnkeyedRecords) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 100'000};
+
+  RecordBatch::Builder builder{};
+  builder.Add(1000, std::vector<uint8_t>(100, 1));
+  segment.Append(builder.Build());
+  segment.Append({0, 0, 0, 2, 1, 2});
+
+  Compactor::KeyMap keys;
+  Compactor::AddKeys(&segment, kStart, &keys);
+  EXPECT_TRUE(keys.empty());
+
+  InMemorySegment out{2, path, 100'000};
+  std::vector<uint32_t> positions;
+  EXPECT_FALSE(
+      Compactor::Rewrite(&segment, kStart, keys, true, &out, &positions));
+}
+
+}  // namespace wombat::broker::log::testing
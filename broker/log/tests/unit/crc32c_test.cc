@@ -0,0 +1,61 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/crc32c.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace wombat::broker::log::testing {
+
+class Crc32cTest : public ::testing::Test {
+ protected:
+  uint32_t Checksum(const std::string& s) {
+    return Crc32c(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+  }
+};
+
+TEST_F(Crc32cTest, KnownValues) {
+  EXPECT_EQ(0U, Checksum(""));
+  EXPECT_EQ(0xe3069283U, Checksum("123456789"));
+
+  // Test vectors from RFC 3720.
+  const std::vector<uint8_t> zeros(32, 0x00);
+  EXPECT_EQ(0x8a9136aaU, Crc32c(zeros.data(), zeros.size()));
+  const std::vector<uint8_t> ones(32, 0xff);
+  EXPECT_EQ(0x62a8ab43U, Crc32c(ones.data(), ones.size()));
+  std::vector<uint8_t> ascending(32);
+  for (uint8_t i = 0; i != ascending.size(); ++i) {
+    ascending[i] = i;
+  }
+  EXPECT_EQ(0x46dd794eU, Crc32c(ascending.data(), ascending.size()));
+}
+
+TEST_F(Crc32cTest, MatchesPortable) {
+  std::vector<uint8_t> data(1000);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = i * 31 + 7;
+  }
+  // Check every alignment and length handled by the tail loops.
+  for (size_t offset = 0; offset != 16; ++offset) {
+    for (size_t size = 0; size != 64; ++size) {
+      EXPECT_EQ(Crc32cPortable(data.data() + offset, size),
+                Crc32c(data.data() + offset, size));
+    }
+  }
+  EXPECT_EQ(Crc32cPortable(data.data(), data.size()),
+            Crc32c(data.data(), data.size()));
+}
+
+TEST_F(Crc32cTest, Extend) {
+  const std::string s = "hello, world";
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(s.data());
+  EXPECT_EQ(Crc32c(data, s.size()), Crc32c(data + 5, s.size() - 5,
+                                           Crc32c(data, 5)));
+  EXPECT_EQ(Crc32cPortable(data, s.size()),
+            Crc32cPortable(data + 5, s.size() - 5, Crc32cPortable(data, 5)));
+}
+
+}  // namespace wombat::broker::log::testing
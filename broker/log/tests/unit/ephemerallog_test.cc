@@ -0,0 +1,119 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/ephemerallog.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::log::testing {
+
+class EphemeralLogTest : public ::testing::Test {
+ protected:
+  // Returns a record of size bytes filled with seed.
+  std::vector<uint8_t> Record(uint32_t size, uint8_t seed) {
+    return std::vector<uint8_t>(size, seed);
+  }
+};
+
+TEST_F(EphemeralLogTest, AppendAndLookup) {
+  EphemeralLog log{100, 4};
+  for (uint8_t i = 0; i != 5; ++i) {
+    log.Append(Record(30, i));
+  }
+  EXPECT_EQ(0U, log.start());
+  EXPECT_EQ(150U, log.size());
+
+  // The fourth record did not fit the first segment so starts the second.
+  for (uint8_t i = 0; i != 5; ++i) {
+    uint64_t offset;
+    ASSERT_TRUE(log.Seek(i, &offset));
+    EXPECT_EQ(i * 30U, offset);
+    EXPECT_EQ(Record(30, i), log.Lookup(offset, 30));
+
+    const std::optional<View> view = log.LookupView(offset, 30);
+    ASSERT_TRUE(view);
+    EXPECT_EQ(Record(30, i),
+              std::vector<uint8_t>(view->data, view->data + view->size));
+  }
+
+  // Lookups do not span segments.
+  EXPECT_TRUE(log.Lookup(60, 60).empty());
+  EXPECT_TRUE(log.Lookup(150, 1).empty());
+
+  uint64_t offset;
+  ASSERT_TRUE(log.Seek(5, &offset));
+  EXPECT_EQ(150U, offset);
+  EXPECT_FALSE(log.Seek(6, &offset));
+}
+
+TEST_F(EphemeralLogTest, DropOldest) {
+  EphemeralLog log{100, 3};
+  // Three records fill each segment.
+  for (uint8_t i = 0; i != 12; ++i) {
+    log.Append(Record(30, i));
+  }
+
+  // The first segment was dropped when the fourth segment was added.
+  EXPECT_EQ(90U, log.start());
+  EXPECT_EQ(360U, log.size());
+  EXPECT_TRUE(log.Lookup(0, 30).empty());
+  EXPECT_FALSE(log.LookupView(60, 30));
+  EXPECT_FALSE(log.IsAligned(0));
+
+  uint64_t offset;
+  EXPECT_FALSE(log.Seek(2, &offset));
+  ASSERT_TRUE(log.Seek(3, &offset));
+  EXPECT_EQ(90U, offset);
+  for (uint8_t i = 3; i != 12; ++i) {
+    EXPECT_EQ(Record(30, i), log.Lookup(i * 30, 30));
+  }
+
+  // The ring keeps dropping the oldest segment.
+  for (uint8_t i = 12; i != 30; ++i) {
+    log.Append(Record(30, i));
+  }
+  EXPECT_EQ(630U, log.start());
+  EXPECT_EQ(900U, log.size());
+  for (uint8_t i = 21; i != 30; ++i) {
+    ASSERT_TRUE(log.Seek(i, &offset));
+    EXPECT_EQ(i * 30U, offset);
+    EXPECT_EQ(Record(30, i), log.Lookup(offset, 30));
+  }
+}
+
+TEST_F(EphemeralLogTest, IsAligned) {
+  EphemeralLog log{100, 4};
+  log.Append(Record(30, 1));
+  log.Append(Record(50, 2));
+  log.Append(Record(40, 3));
+
+  EXPECT_TRUE(log.IsAligned(0));
+  EXPECT_TRUE(log.IsAligned(30));
+  EXPECT_TRUE(log.IsAligned(80));
+  EXPECT_TRUE(log.IsAligned(120));
+  EXPECT_FALSE(log.IsAligned(10));
+  EXPECT_FALSE(log.IsAligned(90));
+}
+
+TEST_F(EphemeralLogTest, LargeRecord) {
+  EphemeralLog log{100, 2};
+  log.Append(Record(30, 1));
+  // A record larger than a segment is given a segment of its own.
+  log.Append(Record(250, 2));
+  log.Append(Record(30, 3));
+
+  EXPECT_EQ(30U, log.start());
+  EXPECT_EQ(Record(250, 2), log.Lookup(30, 250));
+  EXPECT_EQ(Record(30, 3), log.Lookup(280, 30));
+}
+
+TEST_F(EphemeralLogTest, InvalidSize) {
+  EXPECT_THROW(EphemeralLog(0, 4), LogException);
+  EXPECT_THROW(EphemeralLog(100, 1), LogException);
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,173 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "log/checkpoint.h"
+#include "log/flusher.h"
+#include "log/inmemorysegment.h"
+#include "log/options.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+using namespace std::chrono_literals;  // NOLINT
+
+// Counts the number of times the segment is synced.
+class CountingSegment : public InMemorySegment {
+ public:
+  CountingSegment() : InMemorySegment{1, GeneratePath(), 1000} {}
+
+  void Sync() override {
+    ++syncs;
+    InMemorySegment::Sync();
+  }
+
+  std::atomic<int> syncs = 0;
+};
+
+class FlusherTest : public ::testing::Test {};
+
+TEST_F(FlusherTest, NoneFlushesImmediately) {
+  std::shared_ptr<CountingSegment> segment =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kNone;
+  Flusher flusher{options, 0xa};
+
+  EXPECT_EQ(0xaU, flusher.flushed());
+  flusher.Written(segment, 0xff);
+  EXPECT_EQ(0xffU, flusher.flushed());
+  EXPECT_TRUE(flusher.Wait(0xff, 0ms));
+  EXPECT_EQ(0, segment->syncs);
+}
+
+TEST_F(FlusherTest, GroupCommitFlushes) {
+  std::shared_ptr<CountingSegment> segment =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kGroupCommit;
+  Flusher flusher{options, 0};
+
+  flusher.Written(segment, 0xa);
+  flusher.Written(segment, 0xff);
+  EXPECT_TRUE(flusher.Wait(0xff, 10s));
+  EXPECT_EQ(0xffU, flusher.flushed());
+  // Appends may be batched into a single sync.
+  EXPECT_LE(1, segment->syncs);
+  EXPECT_GE(2, segment->syncs);
+}
+
+TEST_F(FlusherTest, GroupCommitSyncsAllSegments) {
+  std::shared_ptr<CountingSegment> segment1 =
+      std::make_shared<CountingSegment>();
+  std::shared_ptr<CountingSegment> segment2 =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kGroupCommit;
+  Flusher flusher{options, 0};
+
+  flusher.Written(segment1, 0xa);
+  flusher.Written(segment2, 0xff);
+  EXPECT_TRUE(flusher.Wait(0xff, 10s));
+  EXPECT_LE(1, segment1->syncs);
+  EXPECT_LE(1, segment2->syncs);
+}
+
+TEST_F(FlusherTest, IntervalFlushesAfterBytes) {
+  std::shared_ptr<CountingSegment> segment =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kInterval;
+  options.flush_interval_ms = 60'000;
+  options.flush_interval_bytes = 100;
+  Flusher flusher{options, 0};
+
+  flusher.Written(segment, 10);
+  EXPECT_FALSE(flusher.Wait(10, 50ms));
+
+  flusher.Written(segment, 100);
+  EXPECT_TRUE(flusher.Wait(100, 10s));
+  EXPECT_EQ(1, segment->syncs);
+}
+
+TEST_F(FlusherTest, IntervalFlushesAfterTime) {
+  std::shared_ptr<CountingSegment> segment =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kInterval;
+  options.flush_interval_ms = 10;
+  options.flush_interval_bytes = 1'000'000;
+  Flusher flusher{options, 0};
+
+  flusher.Written(segment, 10);
+  EXPECT_TRUE(flusher.Wait(10, 10s));
+}
+
+TEST_F(FlusherTest, NoneWritesCheckpointImmediately) {
+  TempDir dir{};
+  Options options{};
+  options.durability = Durability::kNone;
+  Flusher flusher{options, 0};
+
+  Checkpoint checkpoint{};
+  checkpoint.active = 1;
+  checkpoint.end = 0xff;
+  flusher.WriteCheckpoint(dir.path(), checkpoint);
+
+  const std::optional<Checkpoint> written = Checkpoint::Read(dir.path());
+  ASSERT_TRUE(written);
+  EXPECT_EQ(checkpoint, *written);
+}
+
+TEST_F(FlusherTest, CheckpointWrittenOnceFlushed) {
+  TempDir dir{};
+  std::shared_ptr<CountingSegment> segment =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kInterval;
+  options.flush_interval_ms = 60'000;
+  options.flush_interval_bytes = 0x100;
+  Flusher flusher{options, 0};
+
+  Checkpoint checkpoint{};
+  checkpoint.active = 1;
+  checkpoint.end = 0xff;
+  flusher.Written(segment, 0xff);
+  flusher.WriteCheckpoint(dir.path(), checkpoint);
+
+  // The checkpoint is not written until the data it covers is flushed, and
+  // does not cause a sync.
+  std::this_thread::sleep_for(10ms);
+  EXPECT_FALSE(Checkpoint::Read(dir.path()));
+  EXPECT_EQ(0, segment->syncs);
+
+  flusher.Written(segment, 0x100);
+  ASSERT_TRUE(flusher.Wait(0x100, 10s));
+  for (int i = 0; i != 1000 && !Checkpoint::Read(dir.path()); ++i) {
+    std::this_thread::sleep_for(1ms);
+  }
+  const std::optional<Checkpoint> written = Checkpoint::Read(dir.path());
+  ASSERT_TRUE(written);
+  EXPECT_EQ(checkpoint, *written);
+}
+
+TEST_F(FlusherTest, FlushOnDestruct) {
+  std::shared_ptr<CountingSegment> segment =
+      std::make_shared<CountingSegment>();
+  Options options{};
+  options.durability = Durability::kInterval;
+  options.flush_interval_ms = 60'000;
+  {
+    Flusher flusher{options, 0};
+    flusher.Written(segment, 10);
+  }
+  EXPECT_EQ(1, segment->syncs);
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,187 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/index.h"
+#include "log/inmemorysegment.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class IndexTest : public ::testing::Test {
+ protected:
+  // Appends a record with a size prefix to segment and index.
+  void AppendRecord(Segment* segment, Index* index, uint32_t size) {
+    const uint32_t position = segment->size();
+    std::vector<uint8_t> record(4 + size, 0xff);
+    const uint32_t enc = htonl(size);
+    std::memcpy(record.data(), &enc, 4);
+    segment->Append(record);
+    index->Append(position, record.size());
+  }
+};
+
+TEST_F(IndexTest, OpenEmpty) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 0xaa, 10};
+
+  EXPECT_EQ(0xaaU, index.base());
+  EXPECT_EQ(0xaaU, index.next());
+
+  uint32_t position;
+  EXPECT_FALSE(index.Lookup(0xaa, &segment, &position));
+  EXPECT_TRUE(index.IsAligned(0, &segment));
+  EXPECT_FALSE(index.IsAligned(1, &segment));
+}
+
+TEST_F(IndexTest, Ordinal) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 5, 10};
+
+  // Records at positions 0, 7, 14, 21, 28.
+  for (int i = 0; i != 5; ++i) {
+    AppendRecord(&segment, &index, 3);
+  }
+
+  for (uint32_t i = 0; i != 5; ++i) {
+    uint64_t ordinal;
+    EXPECT_TRUE(index.Ordinal(i * 7, &segment, &ordinal));
+    EXPECT_EQ(5 + i, ordinal);
+  }
+
+  uint64_t ordinal;
+  EXPECT_FALSE(index.Ordinal(3, &segment, &ordinal));
+  EXPECT_FALSE(index.Ordinal(35, &segment, &ordinal));
+}
+
+TEST_F(IndexTest, LookupRecords) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 5, 10};
+
+  // Records at positions 0, 7, 14, 21, 28.
+  for (int i = 0; i != 5; ++i) {
+    AppendRecord(&segment, &index, 3);
+  }
+  EXPECT_EQ(10U, index.next());
+
+  for (uint32_t i = 0; i != 5; ++i) {
+    uint32_t position;
+    EXPECT_TRUE(index.Lookup(5 + i, &segment, &position));
+    EXPECT_EQ(i * 7, position);
+  }
+
+  uint32_t position;
+  EXPECT_FALSE(index.Lookup(4, &segment, &position));
+  EXPECT_FALSE(index.Lookup(10, &segment, &position));
+}
+
+TEST_F(IndexTest, IsAligned) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 0, 10};
+
+  for (int i = 0; i != 5; ++i) {
+    AppendRecord(&segment, &index, 3);
+  }
+
+  for (uint32_t position = 0; position != 40; ++position) {
+    // Aligned at each record and the end of the segment.
+    EXPECT_EQ(position % 7 == 0 && position <= 35,
+              index.IsAligned(position, &segment));
+  }
+}
+
+TEST_F(IndexTest, RecoverFromEntries) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  {
+    Index index{std::make_shared<InMemorySegment>(2, path, 1000), 5, 10};
+    for (int i = 0; i != 5; ++i) {
+      AppendRecord(&segment, &index, 3);
+    }
+  }
+
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 0, 10};
+  index.Recover(&segment);
+  EXPECT_EQ(5U, index.base());
+  EXPECT_EQ(10U, index.next());
+
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(9, &segment, &position));
+  EXPECT_EQ(28U, position);
+}
+
+TEST_F(IndexTest, OrdinalsPast32Bits) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  const uint64_t base = 0xfffffffe;
+  {
+    Index index{std::make_shared<InMemorySegment>(2, path, 1000), base, 10};
+    for (int i = 0; i != 5; ++i) {
+      AppendRecord(&segment, &index, 3);
+    }
+    EXPECT_EQ(base + 5, index.next());
+  }
+
+  // The entries persisted keep the full ordinals.
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 0, 10};
+  index.Recover(&segment);
+  EXPECT_EQ(base, index.base());
+  EXPECT_EQ(base + 5, index.next());
+
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(base + 4, &segment, &position));
+  EXPECT_EQ(28U, position);
+  uint64_t ordinal;
+  EXPECT_TRUE(index.Ordinal(21, &segment, &ordinal));
+  EXPECT_EQ(base + 3, ordinal);
+}
+
+TEST_F(IndexTest, RecoverWithoutEntries) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  {
+    // Index to a different segment so the index is lost.
+    Index index{std::make_shared<InMemorySegment>(3, path, 1000), 0, 10};
+    for (int i = 0; i != 5; ++i) {
+      AppendRecord(&segment, &index, 3);
+    }
+  }
+
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 0, 10};
+  index.Recover(&segment);
+  EXPECT_EQ(5U, index.next());
+
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(3, &segment, &position));
+  EXPECT_EQ(21U, position);
+}
+
+TEST_F(IndexTest, RecoverIgnoresIncompleteRecord) {
+  const std::filesystem::path path = GeneratePath();
+  InMemorySegment segment{1, path, 1000};
+  Index index{std::make_shared<InMemorySegment>(2, path, 1000), 0, 10};
+  AppendRecord(&segment, &index, 3);
+  // Size prefix for a record that was never written.
+  segment.Append({0, 0, 0, 10, 1});
+
+  Index recovered{std::make_shared<InMemorySegment>(2, path, 1000), 0, 10};
+  recovered.Recover(&segment);
+  EXPECT_EQ(1U, recovered.next());
+  // The end of the last complete record is aligned but the incomplete
+  // record is not.
+  EXPECT_TRUE(recovered.IsAligned(7, &segment));
+  EXPECT_FALSE(recovered.IsAligned(8, &segment));
+}
+
+}  // namespace wombat::broker::log::testing
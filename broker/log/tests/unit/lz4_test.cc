@@ -0,0 +1,99 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/lz4.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace wombat::broker::log::testing {
+
+class Lz4Test : public ::testing::Test {
+ protected:
+  // Compresses then decompresses data, returning the decompressed data or
+  // nothing if decompression failed.
+  std::vector<uint8_t> RoundTrip(const std::vector<uint8_t>& data,
+                                 size_t* compressed_size = nullptr) {
+    const std::vector<uint8_t> compressed =
+        Lz4Compress(data.data(), data.size());
+    if (compressed_size) {
+      *compressed_size = compressed.size();
+    }
+    std::vector<uint8_t> decompressed(data.size());
+    if (!Lz4Decompress(compressed.data(), compressed.size(),
+                       decompressed.data(), decompressed.size())) {
+      return {};
+    }
+    return decompressed;
+  }
+};
+
+TEST_F(Lz4Test, Empty) {
+  const std::vector<uint8_t> data{};
+  EXPECT_EQ(data, RoundTrip(data));
+}
+
+TEST_F(Lz4Test, Short) {
+  // Data shorter than the minimum match limit is stored as literals.
+  const std::vector<uint8_t> data{1, 1, 1, 1, 1, 1, 1, 1};
+  size_t size;
+  EXPECT_EQ(data, RoundTrip(data, &size));
+  EXPECT_EQ(data.size() + 1, size);
+}
+
+TEST_F(Lz4Test, Repeated) {
+  // Long runs overlap the bytes they copy and need continued lengths.
+  std::vector<uint8_t> data(100'000, 7);
+  data[50'000] = 8;
+  size_t size;
+  EXPECT_EQ(data, RoundTrip(data, &size));
+  EXPECT_LT(size, 1000U);
+}
+
+TEST_F(Lz4Test, Text) {
+  std::string text;
+  for (int i = 0; i != 1000; ++i) {
+    text += "{\"key\": \"user-" + std::to_string(i % 37) +
+            "\", \"value\": " + std::to_string(i * 7) + "}";
+  }
+  const std::vector<uint8_t> data(text.begin(), text.end());
+  size_t size;
+  EXPECT_EQ(data, RoundTrip(data, &size));
+  EXPECT_LT(size, data.size() / 2);
+}
+
+TEST_F(Lz4Test, Random) {
+  std::mt19937 gen{1};
+  std::vector<uint8_t> data(64 * 1024);
+  for (uint8_t& b : data) {
+    b = gen();
+  }
+  EXPECT_EQ(data, RoundTrip(data));
+}
+
+TEST_F(Lz4Test, Corrupt) {
+  std::vector<uint8_t> data(1000, 3);
+  const std::vector<uint8_t> compressed =
+      Lz4Compress(data.data(), data.size());
+
+  // Decompressing to the wrong size fails.
+  std::vector<uint8_t> out(data.size() + 1);
+  EXPECT_FALSE(Lz4Decompress(compressed.data(), compressed.size(),
+                             out.data(), out.size()));
+  EXPECT_FALSE(Lz4Decompress(compressed.data(), compressed.size(),
+                             out.data(), data.size() - 1));
+
+  // A truncated block fails.
+  EXPECT_FALSE(Lz4Decompress(compressed.data(), compressed.size() - 1,
+                             out.data(), data.size()));
+
+  // A match before the start of the data fails.
+  const std::vector<uint8_t> invalid{0x10, 1, 0x10, 0};
+  EXPECT_FALSE(
+      Lz4Decompress(invalid.data(), invalid.size(), out.data(), 5));
+}
+
+}  // namespace wombat::broker::log::testing
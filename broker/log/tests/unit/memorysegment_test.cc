@@ -0,0 +1,69 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "log/memorysegment.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::log::testing {
+
+class MemorySegmentTest : public ::testing::Test {};
+
+TEST_F(MemorySegmentTest, AppendAndLookup) {
+  MemorySegment segment{1, 10};
+  EXPECT_EQ(0U, segment.size());
+  EXPECT_EQ(10U, segment.available());
+
+  segment.Append({1, 2, 3});
+  segment.Append({4, 5, 6, 7});
+  EXPECT_EQ(7U, segment.size());
+  EXPECT_EQ(3U, segment.available());
+  EXPECT_FALSE(segment.is_full());
+
+  EXPECT_EQ((std::vector<uint8_t>{3, 4, 5}), segment.Lookup(2, 3));
+  EXPECT_TRUE(segment.Lookup(5, 3).empty());
+
+  const std::optional<View> view = segment.LookupView(3, 4);
+  ASSERT_TRUE(view);
+  EXPECT_EQ((std::vector<uint8_t>{4, 5, 6, 7}),
+            std::vector<uint8_t>(view->data, view->data + view->size));
+  EXPECT_FALSE(segment.LookupView(6, 2));
+}
+
+TEST_F(MemorySegmentTest, AppendFull) {
+  MemorySegment segment{1, 4};
+  segment.Append({1, 2, 3});
+  EXPECT_THROW(segment.Append({4, 5}), LogException);
+
+  segment.Append({4});
+  EXPECT_TRUE(segment.is_full());
+  EXPECT_EQ((std::vector<uint8_t>{1, 2, 3, 4}), segment.Lookup(0, 4));
+}
+
+TEST_F(MemorySegmentTest, Truncate) {
+  MemorySegment segment{1, 4};
+  segment.Append({1, 2, 3, 4});
+
+  // Truncating to zero allows the segment to be reused.
+  segment.Truncate(0);
+  EXPECT_EQ(0U, segment.size());
+  EXPECT_TRUE(segment.Lookup(0, 1).empty());
+
+  segment.Append({5, 6});
+  EXPECT_EQ((std::vector<uint8_t>{5, 6}), segment.Lookup(0, 2));
+}
+
+TEST_F(MemorySegmentTest, Independent) {
+  // Segments with the same id do not share data.
+  MemorySegment a{1, 4};
+  MemorySegment b{1, 4};
+  a.Append({1, 2});
+  EXPECT_EQ(0U, b.size());
+  EXPECT_TRUE(b.Lookup(0, 2).empty());
+}
+
+}  // namespace wombat::broker::log::testing
@@ -1,5 +1,10 @@
 // Copyright 2020 Andrew Dunstall
 
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "log/inmemorysegment.h"
 #include "log/offsets.h"
@@ -13,7 +18,7 @@ TEST_F(OffsetsTest, OpenEmpty) {
   Offsets offsets(std::make_shared<InMemorySegment>(0x2478, GeneratePath(), 3));
 
   uint32_t id;
-  uint32_t start;
+  uint64_t start;
   EXPECT_FALSE(offsets.Lookup(0, &id, &start));
 }
 
@@ -25,7 +30,7 @@ TEST_F(OffsetsTest, LookupZeroOffset) {
   offsets.Insert(start, id);
 
   uint32_t id_lookup;
-  uint32_t start_lookup;
+  uint64_t start_lookup;
   EXPECT_TRUE(offsets.Lookup(0, &id_lookup, &start_lookup));
   EXPECT_EQ(id, id_lookup);
   EXPECT_EQ(start, start_lookup);
@@ -42,7 +47,7 @@ TEST_F(OffsetsTest, LookupPositiveOffset) {
   offsets.Insert(start, id);
 
   uint32_t id_lookup;
-  uint32_t start_lookup;
+  uint64_t start_lookup;
   EXPECT_FALSE(offsets.Lookup(0, &id_lookup, &start_lookup));
 
   EXPECT_TRUE(offsets.Lookup(0xaa, &id_lookup, &start_lookup));
@@ -66,7 +71,7 @@ TEST_F(OffsetsTest, LookupMultiOffset) {
   offsets.Insert(start2, id2);
 
   uint32_t id_lookup;
-  uint32_t start_lookup;
+  uint64_t start_lookup;
   EXPECT_FALSE(offsets.Lookup(0x9f, &id_lookup, &start_lookup));
 
   EXPECT_TRUE(offsets.Lookup(0xa0, &id_lookup, &start_lookup));
@@ -97,6 +102,35 @@ TEST_F(OffsetsTest, MaxOffset) {
   EXPECT_EQ(0xb0U, offsets.MaxOffset());
 }
 
+TEST_F(OffsetsTest, LookupManySegments) {
+  const std::filesystem::path path = GeneratePath();
+  {
+    Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+    for (uint32_t id = 1; id <= 1000; ++id) {
+      offsets.Insert((id - 1) * 100, id);
+    }
+  }
+
+  Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+  EXPECT_EQ(99900U, offsets.MaxOffset());
+  for (uint32_t id = 1; id <= 1000; ++id) {
+    uint32_t id_lookup;
+    uint64_t start_lookup;
+    EXPECT_TRUE(offsets.Lookup((id - 1) * 100, &id_lookup, &start_lookup));
+    EXPECT_EQ(id, id_lookup);
+    EXPECT_EQ((id - 1) * 100, start_lookup);
+    EXPECT_TRUE(offsets.Lookup((id - 1) * 100 + 99, &id_lookup, &start_lookup));
+    EXPECT_EQ(id, id_lookup);
+
+    uint64_t start;
+    EXPECT_TRUE(offsets.Start(id, &start));
+    EXPECT_EQ((id - 1) * 100, start);
+  }
+  uint64_t start;
+  EXPECT_FALSE(offsets.Start(1001, &start));
+  EXPECT_FALSE(offsets.Start(0, &start));
+}
+
 TEST_F(OffsetsTest, LoadPersistent) {
   auto path = GeneratePath();
 
@@ -112,7 +146,7 @@ TEST_F(OffsetsTest, LoadPersistent) {
     Offsets offsets(std::make_shared<InMemorySegment>(0x2478, path, 100));
 
     uint32_t id_lookup;
-    uint32_t start_lookup;
+    uint64_t start_lookup;
     EXPECT_FALSE(offsets.Lookup(0x0f, &id_lookup, &start_lookup));
 
     EXPECT_TRUE(offsets.Lookup(0xa0, &id_lookup, &start_lookup));
@@ -131,4 +165,111 @@ TEST_F(OffsetsTest, LoadPersistent) {
   }
 }
 
+TEST_F(OffsetsTest, Truncate) {
+  const std::filesystem::path path = GeneratePath();
+  const std::filesystem::path start_path = GeneratePath();
+  {
+    Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100),
+                    std::make_shared<InMemorySegment>(2, start_path, 100));
+    offsets.Insert(0, 1);
+    offsets.Insert(10, 2);
+    offsets.Insert(20, 3);
+    EXPECT_EQ(0U, offsets.start());
+
+    offsets.Truncate(10);
+    EXPECT_EQ(10U, offsets.start());
+
+    uint32_t id;
+    uint64_t start;
+    EXPECT_FALSE(offsets.Lookup(5, &id, &start));
+    EXPECT_TRUE(offsets.Lookup(15, &id, &start));
+    EXPECT_EQ(2U, id);
+    EXPECT_FALSE(offsets.Start(1, &start));
+  }
+
+  // The start is persisted.
+  Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100),
+                  std::make_shared<InMemorySegment>(2, start_path, 100));
+  EXPECT_EQ(10U, offsets.start());
+  uint32_t id;
+  uint64_t start;
+  EXPECT_FALSE(offsets.Lookup(5, &id, &start));
+  EXPECT_TRUE(offsets.Lookup(25, &id, &start));
+  EXPECT_EQ(3U, id);
+  EXPECT_EQ(20U, offsets.MaxOffset());
+}
+
+TEST_F(OffsetsTest, LargeOffsets) {
+  const std::filesystem::path path = GeneratePath();
+  const uint64_t large = 0x1ffffaaaa;
+  {
+    Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+    offsets.Insert(0, 1);
+    offsets.Insert(large, 2);
+  }
+
+  Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+  EXPECT_EQ(large, offsets.MaxOffset());
+  uint32_t id;
+  uint64_t start;
+  EXPECT_TRUE(offsets.Lookup(large + 10, &id, &start));
+  EXPECT_EQ(2U, id);
+  EXPECT_EQ(large, start);
+  EXPECT_TRUE(offsets.Lookup(large - 1, &id, &start));
+  EXPECT_EQ(1U, id);
+}
+
+TEST_F(OffsetsTest, UpgradeLegacyFormat) {
+  const std::filesystem::path path = GeneratePath();
+  const std::filesystem::path start_path = GeneratePath();
+  {
+    // Files written with 32 bit offsets.
+    InMemorySegment segment{1, path, 100};
+    segment.Append({0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 10, 0, 0, 0, 2});
+    InMemorySegment start_segment{2, start_path, 100};
+    start_segment.Append({0, 0, 0, 10});
+  }
+  {
+    Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100),
+                    std::make_shared<InMemorySegment>(2, start_path, 100));
+    EXPECT_EQ(10U, offsets.start());
+    EXPECT_EQ(10U, offsets.MaxOffset());
+    offsets.Insert(0x100000000, 3);
+    offsets.Truncate(0x100000000);
+  }
+
+  Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100),
+                  std::make_shared<InMemorySegment>(2, start_path, 100));
+  EXPECT_EQ(0x100000000U, offsets.start());
+  uint32_t id;
+  uint64_t start;
+  EXPECT_TRUE(offsets.Lookup(0x100000001, &id, &start));
+  EXPECT_EQ(3U, id);
+  EXPECT_EQ(0x100000000U, start);
+}
+
+TEST_F(OffsetsTest, DiscardPartialEntry) {
+  const std::filesystem::path path = GeneratePath();
+  {
+    Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+    offsets.Insert(0, 1);
+  }
+  {
+    // Simulate a crash while writing an entry.
+    InMemorySegment segment{1, path, 100};
+    segment.Append({0, 0, 0});
+  }
+  {
+    Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+    offsets.Insert(10, 2);
+  }
+
+  Offsets offsets(std::make_shared<InMemorySegment>(1, path, 100));
+  uint32_t id;
+  uint64_t start;
+  EXPECT_TRUE(offsets.Lookup(15, &id, &start));
+  EXPECT_EQ(2U, id);
+  EXPECT_EQ(10U, start);
+}
+
 }  // namespace wombat::broker::log::testing
@@ -0,0 +1,90 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <chrono>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "log/readahead.h"
+
+namespace wombat::broker::log::testing {
+
+class ReadaheadTest : public ::testing::Test {};
+
+TEST_F(ReadaheadTest, Sequential) {
+  Readahead readahead{1000};
+  uint64_t from;
+  uint32_t ahead;
+
+  // Looking up the size then the record at the same offset is not
+  // sequential.
+  EXPECT_FALSE(readahead.Lookup(0, 4, &from, &ahead));
+  EXPECT_FALSE(readahead.Lookup(0, 104, &from, &ahead));
+
+  // Moving to the next record reads ahead a window beyond the lookup.
+  EXPECT_TRUE(readahead.Lookup(104, 4, &from, &ahead));
+  EXPECT_EQ(108U, from);
+  EXPECT_EQ(1000U, ahead);
+  EXPECT_FALSE(readahead.Lookup(104, 104, &from, &ahead));
+
+  // Reads ahead again once within half a window of the data read ahead,
+  // continuing from the data already read ahead.
+  EXPECT_FALSE(readahead.Lookup(208, 400, &from, &ahead));
+  EXPECT_TRUE(readahead.Lookup(608, 100, &from, &ahead));
+  EXPECT_EQ(1108U, from);
+  EXPECT_EQ(600U, ahead);
+}
+
+TEST_F(ReadaheadTest, Random) {
+  Readahead readahead{1000};
+  uint64_t from;
+  uint32_t ahead;
+  for (uint64_t offset : {5000, 0, 3000, 1000, 8000}) {
+    EXPECT_FALSE(readahead.Lookup(offset, 4, &from, &ahead));
+    EXPECT_FALSE(readahead.Lookup(offset, 100, &from, &ahead));
+  }
+  EXPECT_FALSE(readahead.Reading(0, 10000));
+}
+
+TEST_F(ReadaheadTest, Streams) {
+  Readahead readahead{1000};
+  uint64_t from;
+  uint32_t ahead;
+
+  // Interleaved streams are each detected.
+  EXPECT_FALSE(readahead.Lookup(0, 100, &from, &ahead));
+  EXPECT_FALSE(readahead.Lookup(5000, 100, &from, &ahead));
+  EXPECT_TRUE(readahead.Lookup(100, 100, &from, &ahead));
+  EXPECT_EQ(200U, from);
+  EXPECT_TRUE(readahead.Lookup(5100, 100, &from, &ahead));
+  EXPECT_EQ(5200U, from);
+
+  EXPECT_TRUE(readahead.Reading(0, 1000));
+  EXPECT_TRUE(readahead.Reading(5000, 6000));
+  EXPECT_FALSE(readahead.Reading(1000, 5000));
+  // A stream at the end of the range has finished reading it.
+  EXPECT_FALSE(readahead.Reading(0, 200));
+}
+
+TEST_F(ReadaheadTest, ReplacesLeastRecentStream) {
+  Readahead readahead{1000};
+  uint64_t from;
+  uint32_t ahead;
+  EXPECT_FALSE(readahead.Lookup(0, 100, &from, &ahead));
+  for (uint64_t i = 1; i != Readahead::kStreams + 1; ++i) {
+    EXPECT_FALSE(readahead.Lookup(i * 10000, 100, &from, &ahead));
+  }
+  // The first stream was replaced so is new again.
+  EXPECT_FALSE(readahead.Lookup(100, 100, &from, &ahead));
+  EXPECT_TRUE(readahead.Lookup(200, 100, &from, &ahead));
+}
+
+TEST_F(ReadaheadTest, Idle) {
+  Readahead readahead{1000, std::chrono::milliseconds{0}};
+  uint64_t from;
+  uint32_t ahead;
+  EXPECT_FALSE(readahead.Lookup(0, 100, &from, &ahead));
+  EXPECT_TRUE(readahead.Lookup(100, 100, &from, &ahead));
+  EXPECT_FALSE(readahead.Reading(0, 1000));
+}
+
+}  // namespace wombat::broker::log::testing
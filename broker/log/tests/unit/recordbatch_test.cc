@@ -0,0 +1,175 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/recordbatch.h"
+#include "log/view.h"
+
+namespace wombat::broker::log {
+
+class RecordBatchTest : public ::testing::Test {
+ protected:
+  std::vector<uint8_t> Build() {
+    RecordBatch::Builder builder{};
+    builder.Add(1'600'000'000'100, {1, 2, 3});
+    builder.Add(1'600'000'000'000, std::vector<uint8_t>(200, 0xab));
+    builder.Add(1'600'000'000'350, {});
+    EXPECT_EQ(builder.size(), builder.Build().size());
+    return builder.Build();
+  }
+
+  View ToView(const std::vector<uint8_t>& enc) {
+    return View{enc.data(), static_cast<uint32_t>(enc.size())};
+  }
+};
+
+TEST_F(RecordBatchTest, BuildParse) {
+  const std::vector<uint8_t> enc = Build();
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->Validate());
+
+  const RecordBatch::Header& header = batch->header();
+  EXPECT_EQ(enc.size() - sizeof(uint32_t), header.length);
+  EXPECT_EQ(0U, header.base_offset);
+  EXPECT_EQ(0U, header.attributes);
+  EXPECT_EQ(3U, header.count);
+  EXPECT_EQ(1'600'000'000'000U, header.first_timestamp);
+  EXPECT_EQ(1'600'000'000'350U, header.max_timestamp);
+
+  // The header is shared so each small record costs two bytes.
+  EXPECT_EQ(RecordBatch::kHeaderSize + 2 + 3 + 3 + 200 + 3,
+            static_cast<uint32_t>(enc.size()));
+}
+
+TEST_F(RecordBatchTest, ForEach) {
+  const std::vector<uint8_t> enc = Build();
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+
+  std::vector<uint64_t> timestamps;
+  std::vector<std::vector<uint8_t>> records;
+  EXPECT_TRUE(batch->ForEach([&](const RecordBatch::Record& record) {
+    EXPECT_FALSE(record.key);
+    timestamps.push_back(record.timestamp);
+    records.emplace_back(record.value->data,
+                         record.value->data + record.value->size);
+    return true;
+  }));
+
+  const std::vector<uint64_t> expected_timestamps{
+      1'600'000'000'100, 1'600'000'000'000, 1'600'000'000'350};
+  EXPECT_EQ(expected_timestamps, timestamps);
+  const std::vector<std::vector<uint8_t>> expected_records{
+      {1, 2, 3}, std::vector<uint8_t>(200, 0xab), {}};
+  EXPECT_EQ(expected_records, records);
+}
+
+TEST_F(RecordBatchTest, SetBaseOffset) {
+  std::vector<uint8_t> enc = Build();
+  RecordBatch::SetBaseOffset(enc.data(), 0x1ffffaaaa);
+
+  // The base offset is not covered by the CRC.
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+  EXPECT_EQ(0x1ffffaaaaU, batch->header().base_offset);
+  EXPECT_TRUE(batch->Validate());
+}
+
+TEST_F(RecordBatchTest, Corrupt) {
+  std::vector<uint8_t> enc = Build();
+  enc[RecordBatch::kHeaderSize + 3] ^= 1;
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+  EXPECT_FALSE(batch->VerifyCrc());
+  EXPECT_FALSE(batch->Validate());
+}
+
+TEST_F(RecordBatchTest, ParseIncomplete) {
+  std::vector<uint8_t> enc = Build();
+  enc.pop_back();
+  EXPECT_FALSE(RecordBatch::Parse(ToView(enc)));
+
+  enc.resize(RecordBatch::kHeaderSize - 1);
+  EXPECT_FALSE(RecordBatch::Parse(ToView(enc)));
+}
+
+TEST_F(RecordBatchTest, EmptyBatch) {
+  const std::vector<uint8_t> enc = RecordBatch::Builder{}.Build();
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->Validate());
+  EXPECT_EQ(0U, batch->header().count);
+}
+
+TEST_F(RecordBatchTest, Keyed) {
+  RecordBatch::Builder builder{};
+  builder.Add(1'600'000'000'000, {'a'}, std::vector<uint8_t>{1, 2, 3});
+  builder.Add(1'600'000'000'100, {'b', 'b'}, std::vector<uint8_t>{});
+  builder.Add(1'600'000'000'200, {'a'}, std::nullopt);
+  const std::vector<uint8_t> enc = builder.Build();
+  EXPECT_EQ(builder.size(), enc.size());
+
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->keyed());
+  EXPECT_TRUE(batch->Validate());
+  EXPECT_EQ(3U, batch->header().count);
+
+  std::vector<std::string> keys;
+  std::vector<std::optional<std::vector<uint8_t>>> values;
+  EXPECT_TRUE(batch->ForEach([&](const RecordBatch::Record& record) {
+    keys.emplace_back(record.key->data, record.key->data + record.key->size);
+    if (record.value) {
+      values.emplace_back(std::vector<uint8_t>(
+          record.value->data, record.value->data + record.value->size));
+    } else {
+      values.emplace_back(std::nullopt);
+    }
+    return true;
+  }));
+
+  // An empty value is distinct from a tombstone.
+  const std::vector<std::string> expected_keys{"a", "bb", "a"};
+  EXPECT_EQ(expected_keys, keys);
+  const std::vector<std::optional<std::vector<uint8_t>>> expected_values{
+      std::vector<uint8_t>{1, 2, 3}, std::vector<uint8_t>{}, std::nullopt};
+  EXPECT_EQ(expected_values, values);
+}
+
+TEST_F(RecordBatchTest, MixKeyed) {
+  RecordBatch::Builder builder{};
+  builder.Add(1'600'000'000'000, {'a'}, std::vector<uint8_t>{1});
+  EXPECT_THROW(builder.Add(1'600'000'000'000, {1}), std::invalid_argument);
+
+  RecordBatch::Builder unkeyed{};
+  unkeyed.Add(1'600'000'000'000, {1});
+  EXPECT_THROW(unkeyed.Add(1'600'000'000'000, {'a'}, std::nullopt),
+               std::invalid_argument);
+}
+
+TEST_F(RecordBatchTest, Padding) {
+  std::vector<uint8_t> enc = RecordBatch::Padding(0xffaa, 1000);
+  ASSERT_EQ(RecordBatch::kHeaderSize, enc.size());
+
+  // Padding is parsed from its header alone, ignoring what follows.
+  enc.resize(1000);
+  const std::optional<RecordBatch> batch = RecordBatch::Parse(ToView(enc));
+  ASSERT_TRUE(batch);
+  EXPECT_TRUE(batch->padding());
+  EXPECT_TRUE(batch->VerifyCrc());
+  EXPECT_EQ(RecordBatch::kHeaderSize, batch->data().size);
+  EXPECT_EQ(1000U - sizeof(uint32_t), batch->header().length);
+  EXPECT_EQ(0xffaaU, batch->header().base_offset);
+  EXPECT_EQ(0U, batch->header().count);
+
+  // Producers may not append padding.
+  EXPECT_FALSE(batch->Validate());
+}
+
+}  // namespace wombat::broker::log
@@ -0,0 +1,93 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "log/inmemorysegment.h"
+#include "log/segment.h"
+#include "log/segmentcache.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::log::testing {
+
+class SegmentCacheTest : public ::testing::Test {
+ protected:
+  std::shared_ptr<Segment> NewSegment() {
+    return std::make_shared<InMemorySegment>(1, GeneratePath(), 1000);
+  }
+
+  const int kLog = 0;
+  const int kOtherLog = 0;
+};
+
+TEST_F(SegmentCacheTest, LookupInserted) {
+  SegmentCache cache{2};
+  std::shared_ptr<Segment> segment = NewSegment();
+
+  EXPECT_EQ(nullptr, cache.Lookup(&kLog, 1));
+  cache.Insert(&kLog, 1, segment);
+  EXPECT_EQ(segment, cache.Lookup(&kLog, 1));
+  // Segments are keyed by log.
+  EXPECT_EQ(nullptr, cache.Lookup(&kOtherLog, 1));
+
+  const SegmentCache::Stats stats = cache.stats();
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(2U, stats.misses);
+  EXPECT_EQ(0U, stats.evictions);
+}
+
+TEST_F(SegmentCacheTest, EvictLeastRecentlyUsed) {
+  SegmentCache cache{2};
+  std::shared_ptr<Segment> segment1 = NewSegment();
+  std::shared_ptr<Segment> segment2 = NewSegment();
+  std::shared_ptr<Segment> segment3 = NewSegment();
+
+  cache.Insert(&kLog, 1, segment1);
+  cache.Insert(&kLog, 2, segment2);
+  // Use segment 1 so segment 2 is least recently used.
+  cache.Lookup(&kLog, 1);
+  cache.Insert(&kLog, 3, segment3);
+
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_EQ(segment1, cache.Lookup(&kLog, 1));
+  EXPECT_EQ(nullptr, cache.Lookup(&kLog, 2));
+  EXPECT_EQ(segment3, cache.Lookup(&kLog, 3));
+  EXPECT_EQ(1U, cache.stats().evictions);
+}
+
+TEST_F(SegmentCacheTest, EvictedSegmentStaysOpenWhileUsed) {
+  SegmentCache cache{1};
+  std::shared_ptr<Segment> segment = NewSegment();
+  segment->Append({1, 2, 3});
+
+  cache.Insert(&kLog, 1, segment);
+  std::shared_ptr<Segment> used = cache.Lookup(&kLog, 1);
+  segment = nullptr;
+  cache.Insert(&kLog, 2, NewSegment());
+
+  const std::vector<uint8_t> expected{1, 2, 3};
+  EXPECT_EQ(expected, used->Lookup(0, 3));
+}
+
+TEST_F(SegmentCacheTest, EraseAll) {
+  SegmentCache cache{4};
+  cache.Insert(&kLog, 1, NewSegment());
+  cache.Insert(&kOtherLog, 1, NewSegment());
+  cache.Insert(&kLog, 2, NewSegment());
+
+  cache.EraseAll(&kLog);
+
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_EQ(nullptr, cache.Lookup(&kLog, 1));
+  EXPECT_NE(nullptr, cache.Lookup(&kOtherLog, 1));
+}
+
+TEST_F(SegmentCacheTest, ZeroCapacity) {
+  SegmentCache cache{0};
+  cache.Insert(&kLog, 1, NewSegment());
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(nullptr, cache.Lookup(&kLog, 1));
+}
+
+}  // namespace wombat::broker::log::testing
@@ -0,0 +1,112 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/tailcache.h"
+#include "log/view.h"
+
+namespace wombat::broker::log::testing {
+
+class TailCacheTest : public ::testing::Test {};
+
+TEST_F(TailCacheTest, LookupEmpty) {
+  TailCache cache{16, 100};
+  EXPECT_EQ(100U, cache.start());
+  EXPECT_FALSE(cache.Lookup(99, 1));
+  EXPECT_FALSE(cache.Lookup(100, 1));
+
+  const TailCache::Stats stats = cache.stats();
+  EXPECT_EQ(0U, stats.hits);
+  EXPECT_EQ(2U, stats.misses);
+}
+
+TEST_F(TailCacheTest, Lookup) {
+  TailCache cache{16, 100};
+  cache.Append({1, 2, 3, 4});
+  cache.Append({5, 6});
+
+  const std::vector<uint8_t> expected{2, 3, 4, 5};
+  EXPECT_EQ(expected, cache.Lookup(101, 4));
+  EXPECT_FALSE(cache.Lookup(104, 3));
+
+  const std::optional<View> view = cache.LookupView(104, 2);
+  ASSERT_TRUE(view);
+  EXPECT_EQ(std::vector<uint8_t>({5, 6}),
+            std::vector<uint8_t>(view->data, view->data + view->size));
+
+  const TailCache::Stats stats = cache.stats();
+  EXPECT_EQ(2U, stats.hits);
+  EXPECT_EQ(1U, stats.misses);
+}
+
+TEST_F(TailCacheTest, EvictsOldest) {
+  TailCache cache{8, 0};
+  cache.Append({1, 2, 3, 4, 5});
+  cache.Append({6, 7, 8, 9, 10});
+
+  // Only the last 8 bytes are cached, wrapping around the buffer.
+  EXPECT_EQ(2U, cache.start());
+  EXPECT_FALSE(cache.Lookup(1, 2));
+  const std::vector<uint8_t> expected{3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(expected, cache.Lookup(2, 8));
+
+  // Data wrapping around the buffer cannot be viewed.
+  EXPECT_FALSE(cache.LookupView(2, 8));
+  EXPECT_TRUE(cache.LookupView(2, 6));
+}
+
+TEST_F(TailCacheTest, AppendLargerThanCache) {
+  TailCache cache{4, 0};
+  cache.Append({1, 2});
+  cache.Append({3, 4, 5, 6, 7, 8});
+
+  EXPECT_EQ(4U, cache.start());
+  const std::vector<uint8_t> expected{5, 6, 7, 8};
+  EXPECT_EQ(expected, cache.Lookup(4, 4));
+}
+
+TEST_F(TailCacheTest, IsAligned) {
+  TailCache cache{8, 0};
+  cache.Append({1, 2, 3, 4, 5});
+  cache.Append({6, 7, 8});
+  cache.Append({9, 10});
+
+  bool aligned;
+  // The first record is partially evicted.
+  EXPECT_FALSE(cache.IsAligned(1, &aligned));
+  EXPECT_TRUE(cache.IsAligned(2, &aligned));
+  EXPECT_FALSE(aligned);
+  EXPECT_TRUE(cache.IsAligned(5, &aligned));
+  EXPECT_TRUE(aligned);
+  EXPECT_TRUE(cache.IsAligned(7, &aligned));
+  EXPECT_FALSE(aligned);
+  EXPECT_TRUE(cache.IsAligned(8, &aligned));
+  EXPECT_TRUE(aligned);
+  EXPECT_TRUE(cache.IsAligned(10, &aligned));
+  EXPECT_TRUE(aligned);
+  EXPECT_FALSE(cache.IsAligned(11, &aligned));
+}
+
+TEST_F(TailCacheTest, Verify) {
+  TailCache cache{8, 0};
+  cache.Append({1, 2, 3});
+  cache.Append({4, 5, 6});
+  cache.Append({7, 8, 9});
+
+  const std::vector<uint8_t> record{7, 8, 9};
+  const std::vector<uint8_t> corrupt{7, 0, 9};
+  bool valid;
+  EXPECT_TRUE(cache.Verify(6, View{record.data(), 3}, &valid));
+  EXPECT_TRUE(valid);
+  EXPECT_TRUE(cache.Verify(6, View{corrupt.data(), 3}, &valid));
+  EXPECT_FALSE(valid);
+  // Part of a record.
+  EXPECT_TRUE(cache.Verify(6, View{record.data(), 2}, &valid));
+  EXPECT_FALSE(valid);
+  EXPECT_FALSE(cache.Verify(0, View{record.data(), 3}, &valid));
+}
+
+}  // namespace wombat::broker::log::testing
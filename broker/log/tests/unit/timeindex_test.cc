@@ -0,0 +1,106 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "log/inmemorysegment.h"
+#include "log/tempdir.h"
+#include "log/timeindex.h"
+
+namespace wombat::broker::log::testing {
+
+class TimeIndexTest : public ::testing::Test {};
+
+TEST_F(TimeIndexTest, OpenEmpty) {
+  TimeIndex index{std::make_shared<InMemorySegment>(1, GeneratePath(), 1000),
+                  10};
+
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(0U, index.last());
+
+  uint32_t position;
+  EXPECT_FALSE(index.Lookup(0, &position));
+}
+
+TEST_F(TimeIndexTest, Lookup) {
+  TimeIndex index{std::make_shared<InMemorySegment>(1, GeneratePath(), 1000),
+                  10};
+
+  // Appends within the same resolution share the first appends entry.
+  index.Append(1003, 0);
+  index.Append(1008, 20);
+  index.Append(1015, 40);
+  index.Append(1042, 60);
+  EXPECT_EQ(1040U, index.last());
+
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(0, &position));
+  EXPECT_EQ(0U, position);
+  EXPECT_TRUE(index.Lookup(1000, &position));
+  EXPECT_EQ(0U, position);
+  EXPECT_TRUE(index.Lookup(1001, &position));
+  EXPECT_EQ(40U, position);
+  EXPECT_TRUE(index.Lookup(1010, &position));
+  EXPECT_EQ(40U, position);
+  EXPECT_TRUE(index.Lookup(1011, &position));
+  EXPECT_EQ(60U, position);
+  EXPECT_FALSE(index.Lookup(1041, &position));
+}
+
+TEST_F(TimeIndexTest, ClockMovesBackwards) {
+  TimeIndex index{std::make_shared<InMemorySegment>(1, GeneratePath(), 1000),
+                  1};
+
+  index.Append(1000, 0);
+  index.Append(900, 20);
+  index.Append(1001, 40);
+
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(900, &position));
+  EXPECT_EQ(0U, position);
+  EXPECT_TRUE(index.Lookup(1001, &position));
+  EXPECT_EQ(40U, position);
+}
+
+TEST_F(TimeIndexTest, LoadPersistent) {
+  const std::filesystem::path path = GeneratePath();
+  {
+    TimeIndex index{std::make_shared<InMemorySegment>(1, path, 1000), 1};
+    index.Append(0x1747a3b2c4d, 0);
+    index.Append(0x1747a3b2c4e, 20);
+  }
+
+  TimeIndex index{std::make_shared<InMemorySegment>(1, path, 1000), 1};
+  EXPECT_EQ(0x1747a3b2c4eU, index.last());
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(0x1747a3b2c4e, &position));
+  EXPECT_EQ(20U, position);
+}
+
+TEST_F(TimeIndexTest, Recover) {
+  const std::filesystem::path path = GeneratePath();
+  {
+    TimeIndex index{std::make_shared<InMemorySegment>(1, path, 1000), 1};
+    index.Append(1000, 0);
+    index.Append(1001, 20);
+    index.Append(1002, 40);
+  }
+
+  {
+    // The append at position 40 never reached the segment.
+    TimeIndex index{std::make_shared<InMemorySegment>(1, path, 1000), 1};
+    index.Recover(40);
+    EXPECT_EQ(1001U, index.last());
+    index.Append(1005, 40);
+  }
+
+  TimeIndex index{std::make_shared<InMemorySegment>(1, path, 1000), 1};
+  EXPECT_EQ(1005U, index.last());
+  uint32_t position;
+  EXPECT_TRUE(index.Lookup(1002, &position));
+  EXPECT_EQ(40U, position);
+}
+
+}  // namespace wombat::broker::log::testing
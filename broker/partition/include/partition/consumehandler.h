@@ -3,31 +3,108 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <unordered_map>
 
+#include "connection/connection.h"
 #include "connection/event.h"
 #include "frame/message.h"
 #include "frame/record.h"
 #include "log/log.h"
+#include "log/logreader.h"
+#include "log/view.h"
 #include "partition/handler.h"
+#include "server/responder.h"
 
 namespace wombat::broker::partition {
 
+// ConsumeHandler looks up the requested record, or record batch, in the log.
+// Records that can be viewed are returned directly, otherwise the record is
+// read with a log reader if the log supports readers, or else looked up
+// asynchronously and if the lookup does not complete before Handle returns the
+// response is sent with the responder.
+//
+// Record batches are served as stored, without decoding their records, except
+// padding left by compaction is served as its header alone.
+//
+// Readers are kept keyed by the offset of their next record, so a consumer
+// reading the log sequentially reuses the same reader, and its read ahead,
+// across requests.
 class ConsumeHandler : public Handler {
  public:
-  ConsumeHandler(uint32_t id, std::shared_ptr<log::Log> log);
+  // If concurrent the handler runs on a thread other than the thread
+  // appending to the log, so never views the log as views may be invalidated
+  // by appends.
+  ConsumeHandler(uint32_t id, std::shared_ptr<log::Log> log,
+                 bool concurrent = false);
 
   ~ConsumeHandler() override {}
 
   std::optional<connection::Event> Handle(const connection::Event& evt);
 
  private:
+  // Request is the state of a consume request whose lookup may complete
+  // after Handle returns.
+  struct Request {
+    uint32_t id;
+    frame::Version version;
+    // Set if the request is for a record batch.
+    bool batch;
+    std::shared_ptr<connection::Connection> connection;
+    std::shared_ptr<server::Responder> responder;
+    // Set once Handle has returned so the response must be sent with the
+    // responder.
+    bool returned;
+    std::optional<connection::Event> response;
+  };
+
   bool IsValidType(const frame::Message& msg) const;
 
-  frame::Record Lookup(uint32_t offset) const;
+  // Looks up the record at offset, first looking up the record size then the
+  // full record. Callbacks use the log directly rather than the handler as
+  // they are owned by the log.
+  static void Lookup(log::Log* log, uint64_t offset,
+                     std::shared_ptr<Request> request);
+
+  static void Complete(std::shared_ptr<Request> request,
+                       const frame::Message& msg);
+
+  // Reads the next record from reader and keeps the reader for the request
+  // following that record.
+  connection::Event Read(std::unique_ptr<log::LogReader> reader,
+                         frame::Version version, bool batch,
+                         std::shared_ptr<connection::Connection> connection);
+
+  // Returns the response to a request for the record at offset given the data
+  // looked up, verifying the record against its checksum with verify.
+  static frame::Message Response(
+      uint32_t id, frame::Version version, bool batch, uint64_t offset,
+      log::View data, const std::function<bool(log::View)>& verify);
+
+  // Returns the response to a request for the record batch at offset given
+  // the data looked up.
+  static frame::Message BatchResponse(uint32_t id, frame::Version version,
+                                      uint64_t offset, log::View data);
+
+  // Returns the response when there is no record at the requested offset.
+  static frame::Message Empty(uint32_t id, frame::Version version,
+                              bool batch);
+
+  // Returns a view of the record at offset if the log can be viewed directly.
+  std::optional<log::View> LookupView(uint64_t offset) const;
+
+  // Bounds the readers kept as consumers may stop without reaching the end
+  // of the log.
+  static constexpr size_t kMaxReaders = 64;
 
   std::shared_ptr<log::Log> log_;
+
+  bool concurrent_;
+
+  // Declared after the log as readers must not outlive the log.
+  std::unordered_map<uint64_t, std::unique_ptr<log::LogReader>> readers_;
 };
 
 }  // namespace wombat::broker::partition
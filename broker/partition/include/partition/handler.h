@@ -3,9 +3,11 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <optional>
 
 #include "connection/event.h"
+#include "server/responder.h"
 
 namespace wombat::broker::partition {
 
@@ -18,8 +20,16 @@ class Handler {
   virtual std::optional<connection::Event> Handle(
       const connection::Event& evt) = 0;
 
+  // Sets the responder used to send responses that complete after Handle
+  // returns.
+  void set_responder(std::shared_ptr<server::Responder> responder) {
+    responder_ = responder;
+  }
+
  protected:
   uint32_t id_;
+
+  std::shared_ptr<server::Responder> responder_;
 };
 
 }  // namespace wombat::broker::partition
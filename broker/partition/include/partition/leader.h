@@ -4,17 +4,27 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
 
+#include "connection/event.h"
 #include "log/log.h"
+#include "partition/migrator.h"
 #include "partition/partition.h"
+#include "partition/readerpool.h"
 #include "server/responder.h"
 
 namespace wombat::broker::partition {
 
 class Leader : public Partition {
  public:
+  // If reader_threads is non-zero and the log supports concurrent reads,
+  // consume requests are served by a pool of reader_threads threads rather
+  // than the partition thread. If migrator is set migrate requests move the
+  // log between log directories, otherwise they fail.
   Leader(uint32_t id, std::shared_ptr<server::Responder> responder,
-         std::shared_ptr<log::Log> log);
+         std::shared_ptr<log::Log> log, uint32_t reader_threads = 0,
+         std::unique_ptr<Migrator> migrator = nullptr);
 
   ~Leader() override;
 
@@ -24,10 +34,42 @@ class Leader : public Partition {
   Leader(Leader&& conn) = delete;
   Leader& operator=(Leader&& conn) = delete;
 
+  void Handle(const connection::Event& evt) override;
+
  private:
   // TODO(AD) Use composition instead so Process can be unittested?
   // So pass Leader to partition
   void Process() override;
+
+  // Routes requests to handlers using log.
+  void Open(std::shared_ptr<log::Log> log);
+
+  // Starts moving the log to the directory in the migrate request.
+  void Migrate(const connection::Event& evt);
+
+  // Closes the log once copied to its new directory and reopens it there,
+  // responding to the migrate request. If the log fails to reopen in either
+  // directory the request fails and Process retries reopening it.
+  void FinishMigrate();
+
+  std::shared_ptr<log::Log> log_;
+
+  std::shared_ptr<server::Responder> responder_;
+
+  uint32_t reader_threads_;
+
+  // Guards readers_ as requests are handled on the thread routing requests
+  // to partitions while the log is reopened on the partition thread.
+  std::mutex readers_mutex_;
+
+  // Null if consumes are served by the partition thread.
+  std::unique_ptr<ReaderPool> readers_;
+
+  // Null if the log cannot be moved.
+  std::unique_ptr<Migrator> migrator_;
+
+  // The migrate request being served while the log is moved.
+  std::optional<connection::Event> migrating_;
 };
 
 }  // namespace wombat::broker::partition
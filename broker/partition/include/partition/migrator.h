@@ -0,0 +1,85 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "log/log.h"
+#include "log/logdirs.h"
+
+namespace wombat::broker::partition {
+
+// Directory index of a migrate request moving the log to the least loaded
+// other directory.
+constexpr uint32_t kAnyDirectory = 0xffffffff;
+
+// Migrator moves the log of a partition between log directories while the
+// partition keeps serving requests. The log is copied in the background, then
+// the partition closes the log so the files changed since are copied, and
+// reopens it in its new directory (see log::LogDirs).
+class Migrator {
+ public:
+  using LogFactory = std::function<std::shared_ptr<log::Log>(
+      const std::filesystem::path& path)>;
+
+  // Moves the log with the given name, placed in dirs, reopening it with
+  // open.
+  Migrator(std::shared_ptr<log::LogDirs> dirs, const std::string& name,
+           LogFactory open);
+
+  // Waits for any copy in progress.
+  ~Migrator() {}
+
+  Migrator(const Migrator&) = delete;
+  Migrator& operator=(const Migrator&) = delete;
+  Migrator(Migrator&&) = delete;
+  Migrator& operator=(Migrator&&) = delete;
+
+  // Returns the index of the directory holding the log.
+  size_t dir() const { return dirs_->Place(name_); }
+
+  // Returns true if a move was started and not yet finished.
+  bool moving() const { return copy_.valid(); }
+
+  // Returns true once the background copy of the move completed, so the
+  // move can be finished.
+  bool copied() const;
+
+  // Starts moving the log to the directory with index dir, or the least
+  // loaded other directory if dir is kAnyDirectory, copying the log in the
+  // background. Returns false if the log cannot be moved to dir or a move is
+  // in progress.
+  bool Start(uint32_t dir);
+
+  // Finishes the move, which must be called with the log closed once copied.
+  // Returns the log opened in its new directory, or its previous directory if
+  // the move failed or the log fails to open in its new directory, setting
+  // moved to whether the log was moved. Throws LogException if the log also
+  // fails to open in its previous directory.
+  std::shared_ptr<log::Log> Finish(bool* moved);
+
+  // Opens the log in the directory holding it. Throws LogException if the log
+  // fails to open.
+  std::shared_ptr<log::Log> Reopen();
+
+ private:
+  std::shared_ptr<log::LogDirs> dirs_;
+
+  std::string name_;
+
+  LogFactory open_;
+
+  // Directory being moved to.
+  size_t target_;
+
+  // Completes with whether the log was copied.
+  std::future<bool> copy_;
+};
+
+}  // namespace wombat::broker::partition
@@ -21,6 +21,9 @@ class ProduceHandler : public Handler {
       const connection::Event& evt) override;
 
  private:
+  // Appends a record batch without re-encoding its records.
+  std::optional<connection::Event> HandleBatch(const connection::Event& evt);
+
   std::shared_ptr<log::Log> log_;
 };
 
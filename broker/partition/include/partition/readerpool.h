@@ -0,0 +1,68 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "connection/event.h"
+#include "log/log.h"
+#include "partition/router.h"
+#include "server/responder.h"
+
+namespace wombat::broker::partition {
+
+// ReaderPool serves the consume requests of a partition on a pool of threads,
+// concurrently with the partition thread appending to the log, so consumes
+// are not serialized behind produces and scale with the number of threads.
+//
+// Requests from a connection are always served by the same thread, so they
+// are answered in order and a consumer reading sequentially keeps reusing
+// the same log reader.
+class ReaderPool {
+ public:
+  // The log must support concurrent reads.
+  ReaderPool(uint32_t id, std::shared_ptr<server::Responder> responder,
+             std::shared_ptr<log::Log> log, uint32_t threads);
+
+  // Serves any queued requests before returning.
+  ~ReaderPool();
+
+  ReaderPool(const ReaderPool& pool) = delete;
+  ReaderPool& operator=(const ReaderPool& pool) = delete;
+
+  ReaderPool(ReaderPool&& pool) = delete;
+  ReaderPool& operator=(ReaderPool&& pool) = delete;
+
+  // Queues a consume request to be served by one of the threads.
+  void Handle(const connection::Event& evt);
+
+ private:
+  struct Worker {
+    explicit Worker(std::shared_ptr<server::Responder> responder);
+
+    connection::EventQueue events;
+    std::shared_ptr<server::Responder> responder;
+    // Each worker has its own handler so the readers it keeps are only used
+    // by its thread.
+    Router router;
+    std::thread thread;
+  };
+
+  void Poll(Worker* worker);
+
+  // Routes the request, answering with an error if the log fails to read
+  // it, as an exception would otherwise end the workers thread.
+  void Route(Worker* worker, const connection::Event& evt);
+
+  uint32_t id_;
+
+  std::atomic_bool running_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace wombat::broker::partition
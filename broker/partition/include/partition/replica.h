@@ -26,6 +26,8 @@ class Replica : public Partition {
 
  private:
   void Process() override;
+
+  std::shared_ptr<log::Log> log_;
 };
 
 }  // namespace wombat::broker::partition
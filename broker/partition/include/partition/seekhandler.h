@@ -0,0 +1,33 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "connection/event.h"
+#include "frame/message.h"
+#include "log/log.h"
+#include "partition/handler.h"
+
+namespace wombat::broker::partition {
+
+// SeekHandler resolves a record ordinal to the offset of that record so
+// consumers can seek by record number.
+class SeekHandler : public Handler {
+ public:
+  SeekHandler(uint32_t id, std::shared_ptr<log::Log> log);
+
+  ~SeekHandler() override {}
+
+  std::optional<connection::Event> Handle(
+      const connection::Event& evt) override;
+
+ private:
+  bool IsValidType(const frame::Message& msg) const;
+
+  std::shared_ptr<log::Log> log_;
+};
+
+}  // namespace wombat::broker::partition
@@ -0,0 +1,34 @@
+// Copyright 2020 Andrew Dunstall
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "connection/event.h"
+#include "frame/message.h"
+#include "log/log.h"
+#include "partition/handler.h"
+
+namespace wombat::broker::partition {
+
+// SeekTimeHandler resolves a timestamp to the offset of the first record
+// appended at or after it, so consumers can replay the log from a point in
+// time with a single request.
+class SeekTimeHandler : public Handler {
+ public:
+  SeekTimeHandler(uint32_t id, std::shared_ptr<log::Log> log);
+
+  ~SeekTimeHandler() override {}
+
+  std::optional<connection::Event> Handle(
+      const connection::Event& evt) override;
+
+ private:
+  bool IsValidType(const frame::Message& msg) const;
+
+  std::shared_ptr<log::Log> log_;
+};
+
+}  // namespace wombat::broker::partition
@@ -3,22 +3,30 @@
 #include "partition/consumehandler.h"
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include "connection/event.h"
+#include "frame/error.h"
 #include "frame/offset.h"
 #include "frame/record.h"
 #include "frame/utils.h"
 #include "glog/logging.h"
 #include "log/log.h"
+#include "log/logreader.h"
+#include "log/recordbatch.h"
+#include "log/view.h"
 #include "partition/handler.h"
+#include "server/responder.h"
 
 namespace wombat::broker::partition {
 
-ConsumeHandler::ConsumeHandler(uint32_t id, std::shared_ptr<log::Log> log)
-    : Handler(id), log_{log} {}
+ConsumeHandler::ConsumeHandler(uint32_t id, std::shared_ptr<log::Log> log,
+                               bool concurrent)
+    : Handler(id), log_{log}, concurrent_{concurrent}, readers_{} {}
 
 std::optional<connection::Event> ConsumeHandler::Handle(
     const connection::Event& evt) {
@@ -27,39 +35,211 @@ std::optional<connection::Event> ConsumeHandler::Handle(
     return std::nullopt;
   }
 
+  const frame::Version version = evt.message.version();
+  const bool batch = evt.message.type() == frame::Type::kConsumeBatchRequest;
   const std::optional<frame::Offset> off =
-      frame::Offset::Decode(evt.message.payload());
+      frame::Offset::Decode(evt.message.payload(), version);
   if (!off) {
     LOG(ERROR) << "ConsumeHandler::Handle called with invalid request";
     return std::nullopt;
   }
 
-  const frame::Record record = Lookup(off->offset());
-  const frame::Message msg{frame::Type::kConsumeResponse, id_, record.Encode()};
-  return connection::Event{msg, evt.connection};
+  // Records before the log start have been deleted so cannot be consumed.
+  if (off->offset() < log_->start()) {
+    const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+    const frame::Message msg{frame::Type::kErrorResponse, id_, error.Encode(),
+                             version};
+    return connection::Event{msg, evt.connection};
+  }
+
+  // A reader left at the offset by the previous request is known to be
+  // aligned.
+  auto it = readers_.find(off->offset());
+  if (it != readers_.end()) {
+    std::unique_ptr<log::LogReader> reader = std::move(it->second);
+    readers_.erase(it);
+    return Read(std::move(reader), version, batch, evt.connection);
+  }
+
+  // Reject offsets that do not point to a record rather than serving garbage.
+  if (!log_->IsAligned(off->offset())) {
+    const frame::Error error{frame::Error::Code::kMisalignedOffset};
+    const frame::Message msg{frame::Type::kErrorResponse, id_, error.Encode(),
+                             version};
+    return connection::Event{msg, evt.connection};
+  }
+
+  // If the log can be viewed directly avoid copying the record out of the log.
+  const std::optional<log::View> viewed =
+      concurrent_ ? std::nullopt : LookupView(off->offset());
+  if (viewed) {
+    log::Log* log = log_.get();
+    const uint64_t offset = off->offset();
+    return connection::Event{
+        Response(id_, version, batch, offset, *viewed,
+                 [log, offset](log::View record) {
+                   return log->Verify(offset, record);
+                 }),
+        evt.connection};
+  }
+
+  std::unique_ptr<log::LogReader> reader = log_->NewReader(off->offset());
+  if (reader) {
+    return Read(std::move(reader), version, batch, evt.connection);
+  }
+
+  std::shared_ptr<Request> request = std::make_shared<Request>(
+      Request{id_, version, batch, evt.connection, responder_, false,
+              std::nullopt});
+  Lookup(log_.get(), off->offset(), request);
+  request->returned = true;
+  return request->response;
 }
 
 bool ConsumeHandler::IsValidType(const frame::Message& msg) const {
-  return msg.type() == frame::Type::kConsumeRequest;
+  return msg.type() == frame::Type::kConsumeRequest ||
+         msg.type() == frame::Type::kConsumeBatchRequest;
 }
 
-frame::Record ConsumeHandler::Lookup(uint32_t offset) const {
+void ConsumeHandler::Lookup(log::Log* log, uint64_t offset,
+                            std::shared_ptr<Request> request) {
+  log->LookupAsync(
+      offset, sizeof(uint32_t),
+      [log, offset, request](std::vector<uint8_t> size_data) {
+        const std::optional<uint32_t> size = frame::DecodeU32(size_data);
+        if (!size) {
+          // If the offset is not found return empty record.
+          Complete(request,
+                   Empty(request->id, request->version, request->batch));
+          return;
+        }
+
+        log->LookupAsync(
+            offset, sizeof(uint32_t) + *size,
+            [log, offset, request](std::vector<uint8_t> data) {
+              const log::View view{data.data(),
+                                   static_cast<uint32_t>(data.size())};
+              Complete(request,
+                       Response(request->id, request->version,
+                                request->batch, offset, view,
+                                [log, offset](log::View record) {
+                                  return log->Verify(offset, record);
+                                }));
+            });
+      });
+}
+
+void ConsumeHandler::Complete(std::shared_ptr<Request> request,
+                              const frame::Message& msg) {
+  const connection::Event evt{msg, request->connection};
+  if (!request->returned) {
+    request->response = evt;
+  } else if (request->responder) {
+    request->responder->Respond(evt);
+  }
+}
+
+connection::Event ConsumeHandler::Read(
+    std::unique_ptr<log::LogReader> reader, frame::Version version,
+    bool batch, std::shared_ptr<connection::Connection> connection) {
+  const uint64_t offset = reader->offset();
+  const std::optional<log::View> record = reader->Next();
+  // If there is no record at the offset yet return empty record, keeping the
+  // reader for when the consumer retries.
+  const frame::Message msg =
+      record ? Response(id_, version, batch, offset, *record,
+                        [&reader](log::View data) {
+                          return reader->Verify(data);
+                        })
+             : Empty(id_, version, batch);
+
+  if (readers_.size() >= kMaxReaders) {
+    readers_.erase(readers_.begin());
+  }
+  readers_[reader->offset()] = std::move(reader);
+  return connection::Event{msg, connection};
+}
+
+frame::Message ConsumeHandler::Response(
+    uint32_t id, frame::Version version, bool batch, uint64_t offset,
+    log::View data, const std::function<bool(log::View)>& verify) {
+  if (batch) {
+    return BatchResponse(id, version, offset, data);
+  }
+
+  // Records are stored encoded so are served as stored once their size is
+  // checked, without decoding and re-encoding them.
   const std::optional<uint32_t> size =
-      frame::DecodeU32(log_->Lookup(offset, sizeof(uint32_t)));
+      frame::Record::EncodedSize(data.data, data.size);
   if (!size) {
     // If the offset is not found return empty record.
-    return frame::Record{};
+    return Empty(id, version, batch);
   }
+  const log::View record{data.data, *size, data.owner};
 
-  const std::vector<uint8_t> record =
-      log_->Lookup(offset, sizeof(uint32_t) + *size);
-  const std::optional<frame::Record> r = frame::Record::Decode(record);
-  if (r) {
-    return *r;
-  } else {
-    // If the offset is not found return empty record.
-    return frame::Record{};
+  // Never serve a corrupt record.
+  if (!verify(record)) {
+    LOG(ERROR) << "record at offset " << offset << " failed verification";
+    const frame::Error error{frame::Error::Code::kCorruptRecord};
+    return frame::Message{frame::Type::kErrorResponse, id, error.Encode(),
+                          version};
+  }
+
+  // The payload is the only copy of the record, moved into the message.
+  return frame::Message{frame::Type::kConsumeResponse, id,
+                        std::vector<uint8_t>(record.data,
+                                             record.data + record.size),
+                        version};
+}
+
+frame::Message ConsumeHandler::BatchResponse(uint32_t id,
+                                             frame::Version version,
+                                             uint64_t offset, log::View data) {
+  const std::optional<log::RecordBatch> batch = log::RecordBatch::Parse(data);
+  if (!batch) {
+    return Empty(id, version, true);
   }
+
+  // Batches are served as stored, verified against their own CRC rather than
+  // the checksum the log stored when the batch was appended.
+  if (batch->header().base_offset != offset || !batch->VerifyCrc()) {
+    LOG(ERROR) << "batch at offset " << offset << " failed verification";
+    const frame::Error error{frame::Error::Code::kCorruptRecord};
+    return frame::Message{frame::Type::kErrorResponse, id, error.Encode(),
+                          version};
+  }
+
+  // Padding left by compaction is served as its header alone, as consumers
+  // skip it using its length. The payload is the only copy of the batch,
+  // moved into the message.
+  return frame::Message{
+      frame::Type::kConsumeBatchResponse, id,
+      std::vector<uint8_t>(data.data, data.data + batch->data().size),
+      version};
+}
+
+frame::Message ConsumeHandler::Empty(uint32_t id, frame::Version version,
+                                     bool batch) {
+  if (batch) {
+    return frame::Message{frame::Type::kConsumeBatchResponse, id, {}, version};
+  }
+  return frame::Message{frame::Type::kConsumeResponse, id,
+                        frame::Record{}.Encode(), version};
+}
+
+std::optional<log::View> ConsumeHandler::LookupView(uint64_t offset) const {
+  const std::optional<log::View> size_view =
+      log_->LookupView(offset, sizeof(uint32_t));
+  if (!size_view) {
+    return std::nullopt;
+  }
+  const std::optional<uint32_t> size =
+      frame::DecodeU32(size_view->data, size_view->size);
+  if (!size) {
+    return std::nullopt;
+  }
+
+  return log_->LookupView(offset, sizeof(uint32_t) + *size);
 }
 
 }  // namespace wombat::broker::partition
@@ -5,10 +5,21 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
 
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/utils.h"
+#include "glog/logging.h"
 #include "log/log.h"
+#include "log/logexception.h"
 #include "partition/consumehandler.h"
 #include "partition/producehandler.h"
+#include "partition/readerpool.h"
+#include "partition/seekhandler.h"
+#include "partition/seektimehandler.h"
 #include "partition/stathandler.h"
 #include "server/responder.h"
 
@@ -17,25 +28,150 @@ namespace wombat::broker::partition {
 using namespace std::chrono_literals;  // NOLINT
 
 Leader::Leader(uint32_t id, std::shared_ptr<server::Responder> responder,
-               std::shared_ptr<log::Log> log)
-    : Partition{id, responder} {
+               std::shared_ptr<log::Log> log, uint32_t reader_threads,
+               std::unique_ptr<Migrator> migrator)
+    : Partition{id, responder},
+      log_{},
+      responder_{responder},
+      reader_threads_{reader_threads},
+      readers_{},
+      migrator_{std::move(migrator)},
+      migrating_{} {
+  Open(log);
+  Start();
+}
+
+Leader::~Leader() { Stop(); }
+
+void Leader::Open(std::shared_ptr<log::Log> log) {
+  log_ = log;
+  if (reader_threads_ != 0) {
+    if (log->concurrent_reads()) {
+      std::unique_ptr<ReaderPool> readers = std::make_unique<ReaderPool>(
+          id_, responder_, log, reader_threads_);
+      std::lock_guard lock{readers_mutex_};
+      readers_ = std::move(readers);
+    } else {
+      LOG(WARNING) << "partition " << id_
+                   << " log does not support concurrent reads, serving "
+                      "consumes on the partition thread";
+    }
+  }
+
+  const uint32_t id = id_;
+  router_ = Router{responder_};
   router_.AddRoute(frame::Type::kProduceRequest,
                    std::make_unique<ProduceHandler>(id, log));
+  router_.AddRoute(frame::Type::kProduceBatchRequest,
+                   std::make_unique<ProduceHandler>(id, log));
   router_.AddRoute(frame::Type::kConsumeRequest,
                    std::make_unique<ConsumeHandler>(id, log));
+  router_.AddRoute(frame::Type::kConsumeBatchRequest,
+                   std::make_unique<ConsumeHandler>(id, log));
   router_.AddRoute(frame::Type::kStatRequest,
                    std::make_unique<StatHandler>(id, log));
-
-  Start();
+  router_.AddRoute(frame::Type::kSeekRequest,
+                   std::make_unique<SeekHandler>(id, log));
+  router_.AddRoute(frame::Type::kSeekTimeRequest,
+                   std::make_unique<SeekTimeHandler>(id, log));
 }
 
-Leader::~Leader() { Stop(); }
+void Leader::Handle(const connection::Event& evt) {
+  std::lock_guard lock{readers_mutex_};
+  if (readers_ && (evt.message.type() == frame::Type::kConsumeRequest ||
+                   evt.message.type() == frame::Type::kConsumeBatchRequest)) {
+    readers_->Handle(evt);
+    return;
+  }
+  Partition::Handle(evt);
+}
 
 void Leader::Process() {
-  const std::optional<connection::Event> evt = events_.WaitForAndPop(50ms);
+  // If the log failed to reopen after a migrate, requests queue until it
+  // reopens.
+  if (!log_) {
+    try {
+      Open(migrator_->Reopen());
+    } catch (const log::LogException& e) {
+      // Note LogException logs the error.
+      std::this_thread::sleep_for(1s);
+      return;
+    }
+  }
+
+  // Only wait briefly for events while the log has operations in flight so
+  // they are completed promptly.
+  const std::optional<connection::Event> evt =
+      events_.WaitForAndPop(log_->in_flight() != 0 ? 1ms : 50ms);
   if (evt) {
-    router_.Route(*evt);
+    if (evt->message.type() == frame::Type::kMigrateRequest) {
+      Migrate(*evt);
+    } else {
+      router_.Route(*evt);
+    }
+  }
+  log_->Poll();
+
+  if (migrating_ && migrator_->copied()) {
+    FinishMigrate();
+  }
+}
+
+void Leader::Migrate(const connection::Event& evt) {
+  const frame::Version version = evt.message.version();
+  const std::optional<uint32_t> dir = frame::DecodeU32(evt.message.payload());
+  if (!migrator_ || !dir || !migrator_->Start(*dir)) {
+    const frame::Error error{frame::Error::Code::kMigrateFailed};
+    responder_->Respond(connection::Event{
+        frame::Message{frame::Type::kErrorResponse, id_, error.Encode(),
+                       version},
+        evt.connection});
+    return;
+  }
+  migrating_ = evt;
+}
+
+void Leader::FinishMigrate() {
+  // Complete lookups in flight, as closing the log drops them.
+  while (log_->in_flight() != 0) {
+    log_->Poll();
+  }
+
+  // Release every reference to the log so it closes before the files changed
+  // since the copy are copied. Requests queued meanwhile wait for the log to
+  // reopen.
+  std::unique_ptr<ReaderPool> readers;
+  {
+    // Consumes are served by the partition thread until the log reopens.
+    std::lock_guard lock{readers_mutex_};
+    readers = std::move(readers_);
+  }
+  readers.reset();
+  router_ = Router{responder_};
+  log_.reset();
+
+  bool moved = false;
+  try {
+    Open(migrator_->Finish(&moved));
+  } catch (const log::LogException& e) {
+    // Note LogException logs the error. The log is reopened by Process.
+    LOG(ERROR) << "partition " << id_ << " failed to reopen log after migrate";
+  }
+
+  const frame::Version version = migrating_->message.version();
+  if (moved) {
+    responder_->Respond(connection::Event{
+        frame::Message{frame::Type::kMigrateResponse, id_,
+                       frame::EncodeU32(migrator_->dir()), version},
+        migrating_->connection});
+  } else {
+    const frame::Error error{frame::Error::Code::kMigrateFailed};
+    responder_->Respond(connection::Event{
+        frame::Message{frame::Type::kErrorResponse, id_, error.Encode(),
+                       version},
+        migrating_->connection});
   }
+  migrating_.reset();
 }
 
 }  // namespace wombat::broker::partition
@@ -0,0 +1,89 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "partition/migrator.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "glog/logging.h"
+#include "log/log.h"
+#include "log/logdirs.h"
+#include "log/logexception.h"
+
+namespace wombat::broker::partition {
+
+Migrator::Migrator(std::shared_ptr<log::LogDirs> dirs, const std::string& name,
+                   LogFactory open)
+    : dirs_{std::move(dirs)}, name_{name}, open_{std::move(open)}, target_{0} {}
+
+bool Migrator::copied() const {
+  return copy_.valid() && copy_.wait_for(std::chrono::seconds{0}) ==
+                              std::future_status::ready;
+}
+
+bool Migrator::Start(uint32_t dir) {
+  if (moving()) {
+    return false;
+  }
+
+  const size_t current = this->dir();
+  const size_t target =
+      dir == kAnyDirectory ? dirs_->LeastLoaded(current) : dir;
+  if (target >= dirs_->dirs().size() || target == current) {
+    LOG(ERROR) << "cannot move log " << name_ << " to directory " << dir;
+    return false;
+  }
+  target_ = target;
+
+  LOG(INFO) << "moving log " << name_ << " to " << dirs_->dirs()[target_];
+  copy_ = std::async(std::launch::async, [this] {
+    try {
+      dirs_->Copy(name_, target_);
+      return true;
+    } catch (const log::LogException& e) {
+      // Note LogException logs the error.
+      return false;
+    }
+  });
+  return true;
+}
+
+std::shared_ptr<log::Log> Migrator::Finish(bool* moved) {
+  const size_t from = dir();
+  *moved = copy_.get();
+  if (*moved) {
+    try {
+      dirs_->Move(name_, target_);
+      std::shared_ptr<log::Log> log = Reopen();
+      dirs_->Remove(name_, from);
+      return log;
+    } catch (const log::LogException& e) {
+      // Note LogException logs the error.
+      *moved = false;
+    }
+  }
+
+  try {
+    if (dir() != from) {
+      dirs_->Revert(name_, from);
+    }
+    dirs_->Abort(name_, target_);
+  } catch (const log::LogException& e) {
+    // Note LogException logs the error. The log is still placed in from,
+    // and any copy left is removed when the log is next placed.
+  }
+  return Reopen();
+}
+
+std::shared_ptr<log::Log> Migrator::Reopen() {
+  std::shared_ptr<log::Log> log = open_(dirs_->Path(dir(), name_));
+  dirs_->Track(name_, log);
+  return log;
+}
+
+}  // namespace wombat::broker::partition
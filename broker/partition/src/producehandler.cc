@@ -4,11 +4,14 @@
 
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "connection/event.h"
 #include "frame/record.h"
 #include "glog/logging.h"
 #include "log/log.h"
+#include "log/recordbatch.h"
+#include "log/view.h"
 
 namespace wombat::broker::partition {
 
@@ -17,6 +20,9 @@ ProduceHandler::ProduceHandler(uint32_t id, std::shared_ptr<log::Log> log)
 
 std::optional<connection::Event> ProduceHandler::Handle(
     const connection::Event& evt) {
+  if (evt.message.type() == frame::Type::kProduceBatchRequest) {
+    return HandleBatch(evt);
+  }
   if (evt.message.type() != frame::Type::kProduceRequest) {
     LOG(ERROR) << "ProduceHandler::Handle called with invalid type";
     return std::nullopt;
@@ -33,4 +39,22 @@ std::optional<connection::Event> ProduceHandler::Handle(
   return std::nullopt;
 }
 
+std::optional<connection::Event> ProduceHandler::HandleBatch(
+    const connection::Event& evt) {
+  std::vector<uint8_t> batch = evt.message.payload();
+  const std::optional<log::RecordBatch> parsed = log::RecordBatch::Parse(
+      log::View{batch.data(), static_cast<uint32_t>(batch.size())});
+  if (!parsed || !parsed->Validate()) {
+    LOG(ERROR) << "ProduceHandler::Handle called with invalid record batch";
+    return std::nullopt;
+  }
+
+  // The batch is appended as received other than its base offset, which is
+  // not covered by the CRC. The partition thread is the only appender so the
+  // batch is appended at the current end of the log.
+  log::RecordBatch::SetBaseOffset(batch.data(), log_->size());
+  log_->Append(batch);
+  return std::nullopt;
+}
+
 }  // namespace wombat::broker::partition
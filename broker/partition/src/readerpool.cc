@@ -0,0 +1,102 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "partition/readerpool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/message.h"
+#include "log/log.h"
+#include "log/logexception.h"
+#include "partition/consumehandler.h"
+#include "partition/router.h"
+#include "server/responder.h"
+
+namespace wombat::broker::partition {
+
+using namespace std::chrono_literals;  // NOLINT
+
+namespace {
+
+// Returns the worker serving the connection. Connections are heap allocated
+// so the low bits of their address are mostly zero, hence the address is
+// mixed into the high bits with a multiplicative hash.
+size_t WorkerIndex(const connection::Connection* connection, size_t workers) {
+  const uint64_t h =
+      reinterpret_cast<uintptr_t>(connection) * 0x9e3779b97f4a7c15ULL;
+  return (h >> 32) % workers;
+}
+
+}  // namespace
+
+ReaderPool::Worker::Worker(std::shared_ptr<server::Responder> responder)
+    : events{}, responder{responder}, router{responder}, thread{} {}
+
+ReaderPool::ReaderPool(uint32_t id,
+                       std::shared_ptr<server::Responder> responder,
+                       std::shared_ptr<log::Log> log, uint32_t threads)
+    : id_{id}, running_{true}, workers_{} {
+  for (uint32_t i = 0; i != threads; ++i) {
+    std::unique_ptr<Worker> worker = std::make_unique<Worker>(responder);
+    worker->router.AddRoute(frame::Type::kConsumeRequest,
+                            std::make_unique<ConsumeHandler>(id, log, true));
+    worker->router.AddRoute(frame::Type::kConsumeBatchRequest,
+                            std::make_unique<ConsumeHandler>(id, log, true));
+    workers_.push_back(std::move(worker));
+  }
+  // Start the threads once every worker is created as workers_ is not
+  // modified after.
+  for (const std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread = std::thread{&ReaderPool::Poll, this, worker.get()};
+  }
+}
+
+ReaderPool::~ReaderPool() {
+  running_ = false;
+  for (const std::unique_ptr<Worker>& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+void ReaderPool::Handle(const connection::Event& evt) {
+  workers_[WorkerIndex(evt.connection.get(), workers_.size())]->events.Push(
+      evt);
+}
+
+void ReaderPool::Poll(Worker* worker) {
+  while (running_) {
+    const std::optional<connection::Event> evt =
+        worker->events.WaitForAndPop(50ms);
+    if (evt) {
+      Route(worker, *evt);
+    }
+  }
+
+  // Serve requests queued before stopping, so none are dropped when the pool
+  // is replaced while the partition keeps running.
+  std::optional<connection::Event> evt;
+  while ((evt = worker->events.TryPop())) {
+    Route(worker, *evt);
+  }
+}
+
+void ReaderPool::Route(Worker* worker, const connection::Event& evt) {
+  try {
+    worker->router.Route(evt);
+  } catch (const log::LogException& e) {
+    // Note LogException logs the error.
+    const frame::Error error{frame::Error::Code::kReadFailed};
+    const frame::Message msg{frame::Type::kErrorResponse, id_, error.Encode(),
+                             evt.message.version()};
+    worker->responder->Respond(connection::Event{msg, evt.connection});
+  }
+}
+
+}  // namespace wombat::broker::partition
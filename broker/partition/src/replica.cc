@@ -8,6 +8,8 @@
 
 #include "log/log.h"
 #include "partition/consumehandler.h"
+#include "partition/seekhandler.h"
+#include "partition/seektimehandler.h"
 #include "partition/stathandler.h"
 #include "server/responder.h"
 
@@ -17,11 +19,17 @@ using namespace std::chrono_literals;  // NOLINT
 
 Replica::Replica(uint32_t id, std::shared_ptr<server::Responder> responder,
                  std::shared_ptr<log::Log> log)
-    : Partition{id, responder} {
+    : Partition{id, responder}, log_{log} {
   router_.AddRoute(frame::Type::kConsumeRequest,
                    std::make_unique<ConsumeHandler>(id, log));
+  router_.AddRoute(frame::Type::kConsumeBatchRequest,
+                   std::make_unique<ConsumeHandler>(id, log));
   router_.AddRoute(frame::Type::kStatRequest,
                    std::make_unique<StatHandler>(id, log));
+  router_.AddRoute(frame::Type::kSeekRequest,
+                   std::make_unique<SeekHandler>(id, log));
+  router_.AddRoute(frame::Type::kSeekTimeRequest,
+                   std::make_unique<SeekTimeHandler>(id, log));
 
   Start();
 }
@@ -29,10 +37,14 @@ Replica::Replica(uint32_t id, std::shared_ptr<server::Responder> responder,
 Replica::~Replica() { Stop(); }
 
 void Replica::Process() {
-  const std::optional<connection::Event> evt = events_.WaitForAndPop(50ms);
+  // Only wait briefly for events while the log has operations in flight so
+  // they are completed promptly.
+  const std::optional<connection::Event> evt =
+      events_.WaitForAndPop(log_->in_flight() != 0 ? 1ms : 50ms);
   if (evt) {
     router_.Route(*evt);
   }
+  log_->Poll();
 
   // TODO(AD) Poll leader
 }
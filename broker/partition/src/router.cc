@@ -20,6 +20,7 @@ void Router::Route(const connection::Event& evt) const {
 }
 
 void Router::AddRoute(frame::Type type, std::unique_ptr<Handler> handler) {
+  handler->set_responder(responder_);
   handlers_[type] = std::move(handler);
 }
 
@@ -0,0 +1,56 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "partition/seekhandler.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/offset.h"
+#include "glog/logging.h"
+#include "log/log.h"
+
+namespace wombat::broker::partition {
+
+SeekHandler::SeekHandler(uint32_t id, std::shared_ptr<log::Log> log)
+    : Handler(id), log_{log} {}
+
+std::optional<connection::Event> SeekHandler::Handle(
+    const connection::Event& evt) {
+  if (!IsValidType(evt.message)) {
+    LOG(ERROR) << "SeekHandler::Handle called with invalid type";
+    return std::nullopt;
+  }
+
+  const frame::Version version = evt.message.version();
+  const std::optional<frame::Offset> ordinal =
+      frame::Offset::Decode(evt.message.payload(), version);
+  if (!ordinal) {
+    LOG(ERROR) << "SeekHandler::Handle called with invalid request";
+    return std::nullopt;
+  }
+
+  // Clients using Version::kV1 can only seek to ordinals and offsets below
+  // 2^32, while Version::kV2 carries both as 64 bits.
+  uint64_t offset;
+  if (!log_->Seek(ordinal->offset(), &offset) ||
+      offset > frame::Offset::Max(version)) {
+    const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+    const frame::Message msg{frame::Type::kErrorResponse, id_, error.Encode(),
+                             version};
+    return connection::Event{msg, evt.connection};
+  }
+
+  const frame::Offset resp{offset, version};
+  const frame::Message msg{frame::Type::kSeekResponse, id_, resp.Encode(),
+                           version};
+  return connection::Event{msg, evt.connection};
+}
+
+bool SeekHandler::IsValidType(const frame::Message& msg) const {
+  return msg.type() == frame::Type::kSeekRequest;
+}
+
+}  // namespace wombat::broker::partition
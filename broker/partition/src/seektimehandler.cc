@@ -0,0 +1,56 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "partition/seektimehandler.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/offset.h"
+#include "frame/timestamp.h"
+#include "glog/logging.h"
+#include "log/log.h"
+
+namespace wombat::broker::partition {
+
+SeekTimeHandler::SeekTimeHandler(uint32_t id, std::shared_ptr<log::Log> log)
+    : Handler(id), log_{log} {}
+
+std::optional<connection::Event> SeekTimeHandler::Handle(
+    const connection::Event& evt) {
+  if (!IsValidType(evt.message)) {
+    LOG(ERROR) << "SeekTimeHandler::Handle called with invalid type";
+    return std::nullopt;
+  }
+
+  const std::optional<frame::Timestamp> timestamp =
+      frame::Timestamp::Decode(evt.message.payload());
+  if (!timestamp) {
+    LOG(ERROR) << "SeekTimeHandler::Handle called with invalid request";
+    return std::nullopt;
+  }
+
+  // Clients using Version::kV1 cannot address offsets of 4 GiB or more.
+  const frame::Version version = evt.message.version();
+  uint64_t offset;
+  if (!log_->SeekTime(timestamp->timestamp(), &offset) ||
+      offset > frame::Offset::Max(version)) {
+    const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+    const frame::Message msg{frame::Type::kErrorResponse, id_, error.Encode(),
+                             version};
+    return connection::Event{msg, evt.connection};
+  }
+
+  const frame::Offset resp{offset, version};
+  const frame::Message msg{frame::Type::kSeekTimeResponse, id_, resp.Encode(),
+                           version};
+  return connection::Event{msg, evt.connection};
+}
+
+bool SeekTimeHandler::IsValidType(const frame::Message& msg) const {
+  return msg.type() == frame::Type::kSeekTimeRequest;
+}
+
+}  // namespace wombat::broker::partition
@@ -2,9 +2,11 @@
 
 #include "partition/stathandler.h"
 
+#include <cstdint>
 #include <memory>
 
 #include "connection/event.h"
+#include "frame/error.h"
 #include "frame/offset.h"
 #include "glog/logging.h"
 #include "log/log.h"
@@ -21,8 +23,18 @@ std::optional<connection::Event> StatHandler::Handle(
     return std::nullopt;
   }
 
-  const frame::Offset stat{log_->size()};
-  const frame::Message msg{frame::Type::kStatResponse, id_, stat.Encode()};
+  // Clients using Version::kV1 cannot address logs of 4 GiB or more.
+  const frame::Version version = evt.message.version();
+  if (log_->size() > frame::Offset::Max(version)) {
+    const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+    const frame::Message msg{frame::Type::kErrorResponse, id_, error.Encode(),
+                             version};
+    return connection::Event{msg, evt.connection};
+  }
+
+  const frame::Offset stat{log_->size(), version};
+  const frame::Message msg{frame::Type::kStatResponse, id_, stat.Encode(),
+                           version};
   return connection::Event{msg, evt.connection};
 }
 
@@ -1,19 +1,27 @@
 // Copyright 2020 Andrew Dunstall
 
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 
 #include "connection/connection.h"
 #include "connection/event.h"
+#include "frame/error.h"
 #include "frame/message.h"
 #include "frame/offset.h"
 #include "frame/record.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "log/log.h"
+#include "log/logreader.h"
 #include "log/mocklog.h"
+#include "log/recordbatch.h"
+#include "log/view.h"
 #include "partition/consumehandler.h"
+#include "server/responder.h"
 
 namespace wombat::broker::partition {
 
@@ -26,6 +34,80 @@ class FakeConnection : public connection::Connection {
   void Send(const frame::Message& msg) override{};
 };
 
+// DeferredLog completes asynchronous lookups when Complete is called rather
+// than before returning.
+class DeferredLog : public log::MockLog {
+ public:
+  void LookupAsync(uint64_t offset, uint32_t size,
+                   LookupCallback callback) override {
+    pending_.push_back([=] { callback(Lookup(offset, size)); });
+  }
+
+  void Complete() {
+    while (!pending_.empty()) {
+      const std::function<void()> lookup = pending_.front();
+      pending_.pop_front();
+      lookup();
+    }
+  }
+
+ private:
+  std::deque<std::function<void()>> pending_;
+};
+
+// FakeReader reads the given records starting at offset.
+class FakeReader : public log::LogReader {
+ public:
+  FakeReader(uint64_t offset, std::deque<std::vector<uint8_t>> records)
+      : offset_{offset}, records_{std::move(records)}, last_{} {}
+
+  uint64_t offset() const override { return offset_; }
+
+  std::optional<log::View> Next() override {
+    if (records_.empty()) {
+      return std::nullopt;
+    }
+    last_ = records_.front();
+    records_.pop_front();
+    offset_ += last_.size();
+    return log::View{last_.data(), static_cast<uint32_t>(last_.size())};
+  }
+
+  bool Verify(log::View record) override { return true; }
+
+ private:
+  uint64_t offset_;
+  std::deque<std::vector<uint8_t>> records_;
+  std::vector<uint8_t> last_;
+};
+
+// ReaderLog creates readers over the given records, which start at the
+// offset of the first reader created.
+class ReaderLog : public log::MockLog {
+ public:
+  explicit ReaderLog(std::deque<std::vector<uint8_t>> records)
+      : records_{std::move(records)} {}
+
+  std::unique_ptr<log::LogReader> NewReader(uint64_t offset) override {
+    ++readers;
+    return std::make_unique<FakeReader>(offset, records_);
+  }
+
+  int readers = 0;
+
+ private:
+  std::deque<std::vector<uint8_t>> records_;
+};
+
+class FakeResponder : public server::Responder {
+ public:
+  void Respond(const connection::Event& evt) override {
+    responses.push_back(evt);
+  }
+
+  std::vector<connection::Event> responses;
+};
+
 class ConsumeHandlerTest : public ::testing::Test {
  public:
   const uint32_t kPartitionId = 0xffaa;
@@ -58,6 +140,227 @@ TEST_F(ConsumeHandlerTest, HandleValidConsumeRequest) {
   EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
 }
 
+TEST_F(ConsumeHandlerTest, HandleValidConsumeRequestV2) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  const uint64_t large_offset = 0x1ffffaaaa;
+  const frame::Record record{{1, 2, 3, 4, 5}};
+  const std::vector<uint8_t> encoded = record.Encode();
+  const std::vector<uint8_t> encoded_size(encoded.begin(), encoded.begin() + 4);
+
+  EXPECT_CALL(*log, Lookup(large_offset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(encoded_size));
+  EXPECT_CALL(*log, Lookup(large_offset, encoded.size()))
+      .WillOnce(::testing::Return(encoded));
+
+  const frame::Offset offset{large_offset, frame::Version::kV2};
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           offset.Encode(), frame::Version::kV2};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Message expected_response{frame::Type::kConsumeResponse,
+                                         kPartitionId, record.Encode(),
+                                         frame::Version::kV2};
+  const connection::Event expected_event{expected_response, conn};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(ConsumeHandlerTest, HandleValidConsumeRequestFromView) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  const std::vector<uint8_t> payload{1, 2, 3, 4, 5};
+  const frame::Record record{payload};
+  const std::vector<uint8_t> encoded = record.Encode();
+
+  // Expect to view the record without falling back to Lookup.
+  EXPECT_CALL(*log, LookupView(kOffset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(
+          log::View{encoded.data(), sizeof(uint32_t)}));
+  EXPECT_CALL(*log, LookupView(kOffset, encoded.size()))
+      .WillOnce(::testing::Return(
+          log::View{encoded.data(), static_cast<uint32_t>(encoded.size())}));
+  EXPECT_CALL(*log, Lookup(::testing::_, ::testing::_)).Times(0);
+
+  const frame::Offset offset{kOffset};
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           offset.Encode()};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Message expected_response{frame::Type::kConsumeResponse,
+                                         kPartitionId, record.Encode()};
+  const connection::Event expected_event{expected_response, conn};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(ConsumeHandlerTest, HandleValidConsumeRequestAsync) {
+  std::shared_ptr<DeferredLog> log = std::make_shared<DeferredLog>();
+  std::shared_ptr<FakeResponder> responder = std::make_shared<FakeResponder>();
+  ConsumeHandler handler{kPartitionId, log};
+  handler.set_responder(responder);
+
+  const std::vector<uint8_t> payload{1, 2, 3, 4, 5};
+  const frame::Record record{payload};
+  const std::vector<uint8_t> encoded = record.Encode();
+  const std::vector<uint8_t> encoded_size(encoded.begin(), encoded.begin() + 4);
+
+  EXPECT_CALL(*log, Lookup(kOffset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(encoded_size));
+  EXPECT_CALL(*log, Lookup(kOffset, encoded.size()))
+      .WillOnce(::testing::Return(encoded));
+
+  const frame::Offset offset{kOffset};
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           offset.Encode()};
+
+  // The lookup has not completed so there is no response yet.
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, conn}));
+  EXPECT_TRUE(responder->responses.empty());
+
+  // Once complete the response is sent with the responder.
+  log->Complete();
+  const frame::Message expected_response{frame::Type::kConsumeResponse,
+                                         kPartitionId, record.Encode()};
+  const connection::Event expected_event{expected_response, conn};
+  ASSERT_EQ(1U, responder->responses.size());
+  EXPECT_EQ(expected_event, responder->responses[0]);
+}
+
+TEST_F(ConsumeHandlerTest, HandleValidConsumeRequestsWithReader) {
+  const frame::Record first{std::vector<uint8_t>{1, 2, 3, 4, 5}};
+  const frame::Record second{std::vector<uint8_t>{6, 7, 8}};
+  std::shared_ptr<ReaderLog> log = std::make_shared<ReaderLog>(
+      std::deque<std::vector<uint8_t>>{first.Encode(), second.Encode()});
+  ConsumeHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, Lookup(::testing::_, ::testing::_)).Times(0);
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  uint64_t next = kOffset;
+  for (const frame::Record& record : {first, second, frame::Record{}}) {
+    const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                             frame::Offset{next}.Encode()};
+    const frame::Message expected_response{frame::Type::kConsumeResponse,
+                                           kPartitionId, record.Encode()};
+    EXPECT_EQ(connection::Event(expected_response, conn),
+              handler.Handle(connection::Event{msg, conn}));
+    next += record.Encode().size();
+  }
+
+  // Requests following the previous record reuse its reader.
+  EXPECT_EQ(1, log->readers);
+}
+
+TEST_F(ConsumeHandlerTest, HandleValidConsumeBatchRequest) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  log::RecordBatch::Builder builder{};
+  builder.Add(1000, {1, 2, 3});
+  builder.Add(1001, {4, 5});
+  std::vector<uint8_t> batch = builder.Build();
+  log::RecordBatch::SetBaseOffset(batch.data(), kOffset);
+  const std::vector<uint8_t> batch_size(batch.begin(), batch.begin() + 4);
+
+  EXPECT_CALL(*log, Lookup(kOffset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(batch_size));
+  EXPECT_CALL(*log, Lookup(kOffset, batch.size()))
+      .WillOnce(::testing::Return(batch));
+
+  const frame::Message msg{frame::Type::kConsumeBatchRequest, kPartitionId,
+                           frame::Offset{kOffset}.Encode()};
+
+  // The batch is served as stored.
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Message expected_response{frame::Type::kConsumeBatchResponse,
+                                         kPartitionId, batch};
+  EXPECT_EQ(connection::Event(expected_response, conn),
+            handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(ConsumeHandlerTest, HandleConsumePadding) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  // Only the header of padding is stored, followed by a hole.
+  const std::vector<uint8_t> header = log::RecordBatch::Padding(kOffset, 500);
+  std::vector<uint8_t> padding = header;
+  padding.resize(500);
+  const std::vector<uint8_t> padding_size(padding.begin(),
+                                          padding.begin() + 4);
+
+  EXPECT_CALL(*log, Lookup(kOffset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(padding_size));
+  EXPECT_CALL(*log, Lookup(kOffset, padding.size()))
+      .WillOnce(::testing::Return(padding));
+
+  const frame::Message msg{frame::Type::kConsumeBatchRequest, kPartitionId,
+                           frame::Offset{kOffset}.Encode()};
+
+  // The padding is served as its header alone.
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Message expected_response{frame::Type::kConsumeBatchResponse,
+                                         kPartitionId, header};
+  EXPECT_EQ(connection::Event(expected_response, conn),
+            handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(ConsumeHandlerTest, HandleCorruptBatch) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  log::RecordBatch::Builder builder{};
+  builder.Add(1000, {1, 2, 3});
+  std::vector<uint8_t> batch = builder.Build();
+  log::RecordBatch::SetBaseOffset(batch.data(), kOffset);
+  batch.back() ^= 1;
+  const std::vector<uint8_t> batch_size(batch.begin(), batch.begin() + 4);
+
+  EXPECT_CALL(*log, Lookup(kOffset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(batch_size));
+  EXPECT_CALL(*log, Lookup(kOffset, batch.size()))
+      .WillOnce(::testing::Return(batch));
+
+  const frame::Message msg{frame::Type::kConsumeBatchRequest, kPartitionId,
+                           frame::Offset{kOffset}.Encode()};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Error error{frame::Error::Code::kCorruptRecord};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  EXPECT_EQ(connection::Event(expected_response, conn),
+            handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(ConsumeHandlerTest, HandleCorruptRecord) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  const std::vector<uint8_t> payload{1, 2, 3, 4, 5};
+  const std::vector<uint8_t> encoded = frame::Record{payload}.Encode();
+  const std::vector<uint8_t> encoded_size(encoded.begin(), encoded.begin() + 4);
+
+  EXPECT_CALL(*log, Lookup(kOffset, sizeof(uint32_t)))
+      .WillOnce(::testing::Return(encoded_size));
+  EXPECT_CALL(*log, Lookup(kOffset, encoded.size()))
+      .WillOnce(::testing::Return(encoded));
+  EXPECT_CALL(*log, Verify(kOffset, ::testing::_))
+      .WillOnce(::testing::Return(false));
+
+  const frame::Offset offset{kOffset};
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           offset.Encode()};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Error error{frame::Error::Code::kCorruptRecord};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, conn};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
 TEST_F(ConsumeHandlerTest, HandleOffsetExceedsLogSize) {
   std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
   ConsumeHandler handler{kPartitionId, log};
@@ -76,6 +379,44 @@ TEST_F(ConsumeHandlerTest, HandleOffsetExceedsLogSize) {
   EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
 }
 
+TEST_F(ConsumeHandlerTest, HandleMisalignedOffset) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, IsAligned(kOffset)).WillOnce(::testing::Return(false));
+  EXPECT_CALL(*log, Lookup(::testing::_, ::testing::_)).Times(0);
+
+  const frame::Offset offset{kOffset};
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           offset.Encode()};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Error error{frame::Error::Code::kMisalignedOffset};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, conn};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(ConsumeHandlerTest, HandleOffsetBeforeLogStart) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ConsumeHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, start()).WillOnce(::testing::Return(kOffset + 1));
+  EXPECT_CALL(*log, Lookup(::testing::_, ::testing::_)).Times(0);
+
+  const frame::Offset offset{kOffset};
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           offset.Encode()};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+  const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, conn};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
 TEST_F(ConsumeHandlerTest, HandleUnrecognizedRequestType) {
   ConsumeHandler handler{kPartitionId, nullptr};
 
@@ -0,0 +1,104 @@
+// Copyright 2020 Andrew Dunstall
+
+#include "partition/migrator.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "log/log.h"
+#include "log/logdirs.h"
+#include "log/logexception.h"
+#include "log/mocklog.h"
+#include "log/tempdir.h"
+
+namespace wombat::broker::partition {
+
+class MigratorTest : public ::testing::Test {
+ protected:
+  void WaitCopied(const Migrator& migrator) {
+    while (!migrator.copied()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+  }
+};
+
+TEST_F(MigratorTest, Move) {
+  log::TempDir dir{};
+  std::shared_ptr<log::LogDirs> dirs = std::make_shared<log::LogDirs>(
+      std::vector<std::filesystem::path>{dir.path() / "a", dir.path() / "b"});
+  ASSERT_EQ(0U, dirs->Place("p1"));
+  std::ofstream{dirs->Path(0, "p1") / "data"} << "data";
+
+  std::filesystem::path opened;
+  Migrator migrator{dirs, "p1", [&](const std::filesystem::path& path) {
+                      opened = path;
+                      return std::make_shared<log::MockLog>();
+                    }};
+  ASSERT_TRUE(migrator.Start(1));
+  WaitCopied(migrator);
+
+  bool moved;
+  EXPECT_NE(nullptr, migrator.Finish(&moved));
+  EXPECT_TRUE(moved);
+  EXPECT_EQ(dirs->Path(1, "p1"), opened);
+  EXPECT_EQ(1U, migrator.dir());
+  EXPECT_FALSE(std::filesystem::exists(dirs->Path(0, "p1")));
+}
+
+TEST_F(MigratorTest, ReopensPreviousDirectoryIfOpenFails) {
+  log::TempDir dir{};
+  std::shared_ptr<log::LogDirs> dirs = std::make_shared<log::LogDirs>(
+      std::vector<std::filesystem::path>{dir.path() / "a", dir.path() / "b"});
+  ASSERT_EQ(0U, dirs->Place("p1"));
+  std::ofstream{dirs->Path(0, "p1") / "data"} << "data";
+
+  // The log fails to open in its new directory.
+  Migrator migrator{dirs, "p1", [&](const std::filesystem::path& path) {
+                      if (path == dirs->Path(1, "p1")) {
+                        throw log::LogException{"failed to open log"};
+                      }
+                      return std::make_shared<log::MockLog>();
+                    }};
+  ASSERT_TRUE(migrator.Start(1));
+  WaitCopied(migrator);
+
+  bool moved;
+  EXPECT_NE(nullptr, migrator.Finish(&moved));
+  EXPECT_FALSE(moved);
+  EXPECT_EQ(0U, migrator.dir());
+  EXPECT_TRUE(std::filesystem::exists(dirs->Path(0, "p1") / "data"));
+  EXPECT_FALSE(std::filesystem::exists(dirs->Path(1, "p1")));
+}
+
+TEST_F(MigratorTest, FinishThrowsIfLogFailsToOpen) {
+  log::TempDir dir{};
+  std::shared_ptr<log::LogDirs> dirs = std::make_shared<log::LogDirs>(
+      std::vector<std::filesystem::path>{dir.path() / "a", dir.path() / "b"});
+  ASSERT_EQ(0U, dirs->Place("p1"));
+
+  bool fail = true;
+  Migrator migrator{dirs, "p1", [&](const std::filesystem::path&) {
+                      if (fail) {
+                        throw log::LogException{"failed to open log"};
+                      }
+                      return std::make_shared<log::MockLog>();
+                    }};
+  ASSERT_TRUE(migrator.Start(1));
+  WaitCopied(migrator);
+
+  bool moved;
+  EXPECT_THROW(migrator.Finish(&moved), log::LogException);
+  EXPECT_FALSE(moved);
+  EXPECT_EQ(0U, migrator.dir());
+
+  fail = false;
+  EXPECT_NE(nullptr, migrator.Reopen());
+}
+
+}  // namespace wombat::broker::partition
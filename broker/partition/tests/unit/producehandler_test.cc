@@ -10,6 +10,8 @@
 #include "gtest/gtest.h"
 #include "log/log.h"
 #include "log/mocklog.h"
+#include "log/recordbatch.h"
+#include "log/view.h"
 #include "partition/producehandler.h"
 
 namespace wombat::broker::partition {
@@ -32,6 +34,40 @@ TEST_F(ProduceHandlerTest, HandleValidProduceRequest) {
   EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
 }
 
+TEST_F(ProduceHandlerTest, HandleValidProduceBatchRequest) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>(0xffaa);
+  ProduceHandler handler{kPartitionId, log};
+
+  log::RecordBatch::Builder builder{};
+  builder.Add(1000, {1, 2, 3});
+  builder.Add(1001, {4, 5});
+  const std::vector<uint8_t> batch = builder.Build();
+  const frame::Message msg{frame::Type::kProduceBatchRequest, kPartitionId,
+                           batch};
+
+  // The batch is appended as received with the base offset set to the end of
+  // the log.
+  std::vector<uint8_t> expected = batch;
+  log::RecordBatch::SetBaseOffset(expected.data(), 0xffaa);
+  EXPECT_CALL(*log, Append(expected)).Times(1);
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(ProduceHandlerTest, HandleCorruptBatch) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  ProduceHandler handler{kPartitionId, log};
+
+  log::RecordBatch::Builder builder{};
+  builder.Add(1000, {1, 2, 3});
+  std::vector<uint8_t> batch = builder.Build();
+  batch.back() ^= 1;
+  const frame::Message msg{frame::Type::kProduceBatchRequest, kPartitionId,
+                           batch};
+
+  EXPECT_CALL(*log, Append(::testing::_)).Times(0);
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
+}
+
 TEST_F(ProduceHandlerTest, HandleInvalidType) {
   ProduceHandler handler{kPartitionId, nullptr};
   const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId, {}};
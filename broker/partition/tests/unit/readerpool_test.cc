@@ -0,0 +1,113 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "connection/connection.h"
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/message.h"
+#include "frame/offset.h"
+#include "frame/record.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "log/logexception.h"
+#include "log/mocklog.h"
+#include "partition/readerpool.h"
+#include "server/responder.h"
+
+namespace wombat::broker::partition {
+
+using namespace std::chrono_literals;  // NOLINT
+
+class FakeConnection : public connection::Connection {
+ public:
+  FakeConnection() : connection::Connection{nullptr} {}
+
+  std::optional<frame::Message> Receive() override { return std::nullopt; }
+
+  void Send(const frame::Message& msg) override{};
+};
+
+// QueueResponder queues responses so they can be waited for, as responses
+// are sent from the pools threads.
+class QueueResponder : public server::Responder {
+ public:
+  void Respond(const connection::Event& evt) override { responses.Push(evt); }
+
+  connection::EventQueue responses;
+};
+
+class ReaderPoolTest : public ::testing::Test {
+ public:
+  const uint32_t kPartitionId = 0xffaa;
+  const uint32_t kOffset = 0xffaa;
+};
+
+TEST_F(ReaderPoolTest, HandleConsumeRequests) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  std::shared_ptr<QueueResponder> responder =
+      std::make_shared<QueueResponder>();
+
+  const frame::Record record{std::vector<uint8_t>{1, 2, 3, 4, 5}};
+  const std::vector<uint8_t> encoded = record.Encode();
+  const std::vector<uint8_t> encoded_size(encoded.begin(), encoded.begin() + 4);
+
+  // Views may be invalidated by appends on the partition thread so are never
+  // used by the pool.
+  EXPECT_CALL(*log, LookupView(::testing::_, ::testing::_)).Times(0);
+  ON_CALL(*log, Lookup(kOffset, sizeof(uint32_t)))
+      .WillByDefault(::testing::Return(encoded_size));
+  ON_CALL(*log, Lookup(kOffset, encoded.size()))
+      .WillByDefault(::testing::Return(encoded));
+
+  const int kConnections = 8;
+  {
+    ReaderPool pool{kPartitionId, responder, log, 4};
+
+    const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                             frame::Offset{kOffset}.Encode()};
+    for (int i = 0; i != kConnections; ++i) {
+      pool.Handle(connection::Event{msg, std::make_shared<FakeConnection>()});
+    }
+
+    const frame::Message expected_response{frame::Type::kConsumeResponse,
+                                           kPartitionId, encoded};
+    for (int i = 0; i != kConnections; ++i) {
+      const std::optional<connection::Event> evt =
+          responder->responses.WaitForAndPop(5s);
+      ASSERT_TRUE(evt);
+      EXPECT_EQ(expected_response, evt->message);
+    }
+  }
+}
+
+TEST_F(ReaderPoolTest, HandleReadError) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  std::shared_ptr<QueueResponder> responder =
+      std::make_shared<QueueResponder>();
+
+  ON_CALL(*log, Lookup(::testing::_, ::testing::_))
+      .WillByDefault(::testing::Throw(log::LogException{"read failed"}));
+
+  ReaderPool pool{kPartitionId, responder, log, 1};
+
+  // The request is answered with an error and the worker keeps serving.
+  const frame::Message msg{frame::Type::kConsumeRequest, kPartitionId,
+                           frame::Offset{kOffset}.Encode()};
+  const frame::Error error{frame::Error::Code::kReadFailed};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  for (int i = 0; i != 2; ++i) {
+    pool.Handle(connection::Event{msg, std::make_shared<FakeConnection>()});
+    const std::optional<connection::Event> evt =
+        responder->responses.WaitForAndPop(5s);
+    ASSERT_TRUE(evt);
+    EXPECT_EQ(expected_response, evt->message);
+  }
+}
+
+}  // namespace wombat::broker::partition
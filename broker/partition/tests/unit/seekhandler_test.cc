@@ -0,0 +1,141 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "connection/connection.h"
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/message.h"
+#include "frame/offset.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "log/log.h"
+#include "log/mocklog.h"
+#include "partition/seekhandler.h"
+
+namespace wombat::broker::partition {
+
+class SeekHandlerTest : public ::testing::Test {
+ public:
+  const uint32_t kPartitionId = 0xffaa;
+  const uint32_t kOrdinal = 0x2f;
+  const uint32_t kOffset = 0xffaa;
+};
+
+TEST_F(SeekHandlerTest, HandleValidSeekRequest) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, Seek(kOrdinal, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(kOffset),
+                                 ::testing::Return(true)));
+
+  const frame::Offset ordinal{kOrdinal};
+  const frame::Message msg{frame::Type::kSeekRequest, kPartitionId,
+                           ordinal.Encode()};
+
+  const frame::Message expected_response{frame::Type::kSeekResponse,
+                                         kPartitionId,
+                                         frame::Offset{kOffset}.Encode()};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekHandlerTest, HandleSeekRequestV2) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekHandler handler{kPartitionId, log};
+
+  const uint64_t offset = 0x1ffffaaaa;
+  EXPECT_CALL(*log, Seek(kOrdinal, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(offset),
+                                 ::testing::Return(true)));
+
+  const frame::Offset ordinal{kOrdinal, frame::Version::kV2};
+  const frame::Message msg{frame::Type::kSeekRequest, kPartitionId,
+                           ordinal.Encode(), frame::Version::kV2};
+
+  const frame::Message expected_response{
+      frame::Type::kSeekResponse, kPartitionId,
+      frame::Offset{offset, frame::Version::kV2}.Encode(),
+      frame::Version::kV2};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekHandlerTest, HandleSeekRequestV2OrdinalPast32Bits) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekHandler handler{kPartitionId, log};
+
+  const uint64_t ordinal = 0x100000002;
+  const uint64_t offset = 0x3ffffaaaa;
+  EXPECT_CALL(*log, Seek(ordinal, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(offset),
+                                 ::testing::Return(true)));
+
+  const frame::Message msg{
+      frame::Type::kSeekRequest, kPartitionId,
+      frame::Offset{ordinal, frame::Version::kV2}.Encode(),
+      frame::Version::kV2};
+
+  const frame::Message expected_response{
+      frame::Type::kSeekResponse, kPartitionId,
+      frame::Offset{offset, frame::Version::kV2}.Encode(),
+      frame::Version::kV2};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekHandlerTest, HandleSeekRequestV1ExceedsLimit) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, Seek(kOrdinal, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(0x100000000),
+                                 ::testing::Return(true)));
+
+  const frame::Offset ordinal{kOrdinal};
+  const frame::Message msg{frame::Type::kSeekRequest, kPartitionId,
+                           ordinal.Encode()};
+
+  const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekHandlerTest, HandleOrdinalNotFound) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, Seek(kOrdinal, ::testing::_))
+      .WillOnce(::testing::Return(false));
+
+  const frame::Offset ordinal{kOrdinal};
+  const frame::Message msg{frame::Type::kSeekRequest, kPartitionId,
+                           ordinal.Encode()};
+
+  const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekHandlerTest, HandleUnrecognizedRequestType) {
+  SeekHandler handler{kPartitionId, nullptr};
+
+  const frame::Message msg{frame::Type::kProduceRequest, kPartitionId, {}};
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekHandlerTest, HandleInvalidRequest) {
+  SeekHandler handler{kPartitionId, nullptr};
+
+  const frame::Message msg{frame::Type::kSeekRequest, kPartitionId, {}};
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+}  // namespace wombat::broker::partition
@@ -0,0 +1,120 @@
+// Copyright 2020 Andrew Dunstall
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "connection/connection.h"
+#include "connection/event.h"
+#include "frame/error.h"
+#include "frame/message.h"
+#include "frame/offset.h"
+#include "frame/timestamp.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "log/log.h"
+#include "log/mocklog.h"
+#include "partition/seektimehandler.h"
+
+namespace wombat::broker::partition {
+
+class SeekTimeHandlerTest : public ::testing::Test {
+ public:
+  const uint32_t kPartitionId = 0xffaa;
+  const uint64_t kTimestamp = 0x1747a3b2c4d;
+  const uint32_t kOffset = 0xffaa;
+};
+
+TEST_F(SeekTimeHandlerTest, HandleValidSeekTimeRequest) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekTimeHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, SeekTime(kTimestamp, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(kOffset),
+                                 ::testing::Return(true)));
+
+  const frame::Timestamp timestamp{kTimestamp};
+  const frame::Message msg{frame::Type::kSeekTimeRequest, kPartitionId,
+                           timestamp.Encode()};
+
+  const frame::Message expected_response{frame::Type::kSeekTimeResponse,
+                                         kPartitionId,
+                                         frame::Offset{kOffset}.Encode()};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekTimeHandlerTest, HandleSeekTimeRequestV2) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekTimeHandler handler{kPartitionId, log};
+
+  const uint64_t offset = 0x1ffffaaaa;
+  EXPECT_CALL(*log, SeekTime(kTimestamp, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(offset),
+                                 ::testing::Return(true)));
+
+  const frame::Timestamp timestamp{kTimestamp};
+  const frame::Message msg{frame::Type::kSeekTimeRequest, kPartitionId,
+                           timestamp.Encode(), frame::Version::kV2};
+
+  const frame::Message expected_response{
+      frame::Type::kSeekTimeResponse, kPartitionId,
+      frame::Offset{offset, frame::Version::kV2}.Encode(),
+      frame::Version::kV2};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekTimeHandlerTest, HandleSeekTimeRequestV1ExceedsLimit) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekTimeHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, SeekTime(kTimestamp, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SetArgPointee<1>(0x100000000),
+                                 ::testing::Return(true)));
+
+  const frame::Timestamp timestamp{kTimestamp};
+  const frame::Message msg{frame::Type::kSeekTimeRequest, kPartitionId,
+                           timestamp.Encode()};
+
+  const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekTimeHandlerTest, HandleTimestampsNotIndexed) {
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
+  SeekTimeHandler handler{kPartitionId, log};
+
+  EXPECT_CALL(*log, SeekTime(kTimestamp, ::testing::_))
+      .WillOnce(::testing::Return(false));
+
+  const frame::Timestamp timestamp{kTimestamp};
+  const frame::Message msg{frame::Type::kSeekTimeRequest, kPartitionId,
+                           timestamp.Encode()};
+
+  const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, nullptr};
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekTimeHandlerTest, HandleUnrecognizedRequestType) {
+  SeekTimeHandler handler{kPartitionId, nullptr};
+
+  const frame::Message msg{frame::Type::kSeekRequest, kPartitionId, {}};
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+TEST_F(SeekTimeHandlerTest, HandleInvalidRequest) {
+  SeekTimeHandler handler{kPartitionId, nullptr};
+
+  const frame::Message msg{frame::Type::kSeekTimeRequest, kPartitionId,
+                           {1, 2, 3, 4}};
+  EXPECT_EQ(std::nullopt, handler.Handle(connection::Event{msg, nullptr}));
+}
+
+}  // namespace wombat::broker::partition
@@ -5,6 +5,7 @@
 
 #include "connection/connection.h"
 #include "connection/event.h"
+#include "frame/error.h"
 #include "frame/message.h"
 #include "frame/offset.h"
 #include "gmock/gmock.h"
@@ -48,6 +49,43 @@ TEST_F(StatHandlerTest, HandleValidStatRequest) {
   EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
 }
 
+TEST_F(StatHandlerTest, HandleStatRequestV2) {
+  const uint64_t log_size = 0x1ffffaaaa;
+
+  std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>(log_size);
+  StatHandler handler{kPartitionId, log};
+
+  const frame::Message msg{
+      frame::Type::kStatRequest, kPartitionId, {}, frame::Version::kV2};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+
+  const frame::Offset stat{log_size, frame::Version::kV2};
+  const frame::Message expected_response{frame::Type::kStatResponse,
+                                         kPartitionId, stat.Encode(),
+                                         frame::Version::kV2};
+  const connection::Event expected_event{expected_response, conn};
+
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
+TEST_F(StatHandlerTest, HandleStatRequestV1ExceedsLimit) {
+  std::shared_ptr<log::MockLog> log =
+      std::make_shared<log::MockLog>(0x100000000);
+  StatHandler handler{kPartitionId, log};
+
+  const frame::Message msg{frame::Type::kStatRequest, kPartitionId, {}};
+
+  std::shared_ptr<FakeConnection> conn = std::make_shared<FakeConnection>();
+
+  const frame::Error error{frame::Error::Code::kOffsetOutOfRange};
+  const frame::Message expected_response{frame::Type::kErrorResponse,
+                                         kPartitionId, error.Encode()};
+  const connection::Event expected_event{expected_response, conn};
+
+  EXPECT_EQ(expected_event, handler.Handle(connection::Event{msg, conn}));
+}
+
 TEST_F(StatHandlerTest, HandleUnrecognizedType) {
   std::shared_ptr<log::MockLog> log = std::make_shared<log::MockLog>();
   StatHandler handler{kPartitionId, log};